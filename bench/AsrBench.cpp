@@ -0,0 +1,411 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+#include "FakeRawData.h"
+#include "../src/transcribe/SpeakerTranscription.h"
+#include "../src/transcribe/StreamingTranscriber.h"
+#include "../src/util/Log.h"
+
+using namespace std;
+
+/**
+ * Streams a tone through the transcriber into a mock speech service on
+ * 127.0.0.1, which answers with one final result per second of audio it
+ * receives. The mock can hang up every --drop-every seconds and refuse
+ * connections for --down-ms afterwards, to exercise reconnects, replay and
+ * the bounded queue.
+ *
+ * With --speakers the audio is that many participants' own streams instead,
+ * each talking for two seconds in turn with the next one starting halfway,
+ * transcribed on at most --max-speakers channels.
+ */
+
+struct Options {
+    double seconds = 10;
+    unsigned chunkMs = 100;
+    unsigned queueMs = 2000;
+    unsigned replayMs = 300;
+    double dropEvery = 0;
+    unsigned downMs = 0;
+    unsigned speakers = 0;
+    unsigned maxSpeakers = 4;
+};
+
+const unsigned c_rate = 32000;
+
+void usage() {
+    cout << "usage: asr_bench [--seconds S] [--chunk-ms MS] [--queue-ms MS] [--replay-ms MS]\n"
+            "                 [--drop-every S] [--down-ms MS] [--speakers N] [--max-speakers N]" << endl;
+}
+
+bool parse(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto next = [&]() -> string { return i + 1 < argc ? argv[++i] : ""; };
+
+        if (arg == "--seconds") opt.seconds = stod(next());
+        else if (arg == "--chunk-ms") opt.chunkMs = stoul(next());
+        else if (arg == "--queue-ms") opt.queueMs = stoul(next());
+        else if (arg == "--replay-ms") opt.replayMs = stoul(next());
+        else if (arg == "--drop-every") opt.dropEvery = stod(next());
+        else if (arg == "--down-ms") opt.downMs = stoul(next());
+        else if (arg == "--speakers") opt.speakers = stoul(next());
+        else if (arg == "--max-speakers") opt.maxSpeakers = stoul(next());
+        else return false;
+    }
+
+    return opt.seconds > 0 && opt.chunkMs > 0;
+}
+
+/**
+ * Just enough of a WebSocket server to stand in for the speech service
+ */
+class MockService {
+    const Options& m_opt;
+    int m_listenFd = -1;
+    uint16_t m_port = 0;
+    thread m_thread;
+    vector<thread> m_clients;
+    atomic<bool> m_running{true};
+
+    bool readExact(int fd, char* buf, size_t len) {
+        while (len) {
+            auto n = recv(fd, buf, len, 0);
+            if (n <= 0)
+                return false;
+            buf += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    void sendFrame(int fd, uint8_t opcode, const string& payload) {
+        string frame;
+        frame += static_cast<char>(0x80 | opcode);
+        if (payload.size() < 126) {
+            frame += static_cast<char>(payload.size());
+        } else {
+            frame += static_cast<char>(126);
+            frame += static_cast<char>(payload.size() >> 8);
+            frame += static_cast<char>(payload.size() & 0xff);
+        }
+        frame += payload;
+        send(fd, frame.data(), frame.size(), MSG_NOSIGNAL);
+    }
+
+    bool upgrade(int fd) {
+        string request;
+        char buf[1024];
+        while (request.find("\r\n\r\n") == string::npos) {
+            auto n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0)
+                return false;
+            request.append(buf, n);
+        }
+
+        auto pos = request.find("Sec-WebSocket-Key: ");
+        if (pos == string::npos)
+            return false;
+        auto key = request.substr(pos + 19, request.find("\r\n", pos) - pos - 19)
+                   + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+        unsigned char digest[SHA_DIGEST_LENGTH];
+        SHA1(reinterpret_cast<const unsigned char*>(key.data()), key.size(), digest);
+        char accept[64];
+        EVP_EncodeBlock(reinterpret_cast<unsigned char*>(accept), digest, sizeof(digest));
+
+        string response = string("HTTP/1.1 101 Switching Protocols\r\n"
+                                 "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                                 "Sec-WebSocket-Accept: ") + accept + "\r\n\r\n";
+        send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+        return true;
+    }
+
+    /**
+     * One result per whole second received, and for the rest too when the
+     * client asks for everything
+     */
+    void result(int fd, uint64_t bytes, uint64_t& reported, unsigned& phrases, bool all = false) {
+        auto second = static_cast<uint64_t>(c_rate) * sizeof(int16_t);
+        while (bytes - reported >= second || (all && bytes > reported)) {
+            auto len = min(second, bytes - reported);
+            string json = "{\"type\":\"Results\",\"start\":" + to_string(static_cast<double>(reported) / second)
+                          + ",\"duration\":" + to_string(static_cast<double>(len) / second)
+                          + ",\"is_final\":true,\"channel\":{\"alternatives\":"
+                            "[{\"transcript\":\"phrase " + to_string(++phrases) + "\",\"confidence\":0.9}]}}";
+            sendFrame(fd, 0x1, json);
+            reported += len;
+        }
+    }
+
+    /**
+     * Serve one connection until it ends or is due to be dropped
+     */
+    void serve(int fd) {
+        if (!upgrade(fd))
+            return;
+
+        uint64_t bytes = 0;
+        uint64_t reported = 0;
+        unsigned phrases = 0;
+        auto dropAt = m_opt.dropEvery ? MetricsClock::nowNs() + static_cast<uint64_t>(m_opt.dropEvery * 1e9) : 0;
+        vector<char> payload;
+
+        while (m_running) {
+            if (dropAt && MetricsClock::nowNs() > dropAt)
+                return;
+
+            pollfd pfd{fd, POLLIN, 0};
+            if (poll(&pfd, 1, 20) <= 0)
+                continue;
+
+            unsigned char head[2];
+            if (!readExact(fd, reinterpret_cast<char*>(head), 2))
+                return;
+
+            uint64_t len = head[1] & 0x7f;
+            if (len >= 126) {
+                unsigned char ext[8];
+                auto n = len == 126 ? 2 : 8;
+                if (!readExact(fd, reinterpret_cast<char*>(ext), n))
+                    return;
+                len = 0;
+                for (int i = 0; i < n; i++)
+                    len = len << 8 | ext[i];
+            }
+
+            char mask[4];
+            payload.resize(len);
+            if (!readExact(fd, mask, 4) || !readExact(fd, payload.data(), len))
+                return;
+            for (size_t i = 0; i < len; i++)
+                payload[i] ^= mask[i & 3];
+
+            auto opcode = head[0] & 0x0f;
+            if (opcode == 0x2) {
+                bytes += len;
+                result(fd, bytes, reported, phrases);
+            } else if (opcode == 0x1 && string(payload.begin(), payload.end()).find("Finalize") != string::npos) {
+                result(fd, bytes, reported, phrases, true);
+            } else if (opcode == 0x1 && string(payload.begin(), payload.end()).find("CloseStream") != string::npos) {
+                // the partial last second
+                result(fd, bytes, reported, phrases, true);
+                sendFrame(fd, 0x8, string("\x03\xe8", 2));
+                return;
+            } else if (opcode == 0x8) {
+                return;
+            }
+        }
+    }
+
+    bool listenOn() {
+        m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(m_port);
+
+        if (bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 || listen(m_listenFd, 4) == -1)
+            return false;
+
+        socklen_t len = sizeof(addr);
+        getsockname(m_listenFd, reinterpret_cast<sockaddr*>(&addr), &len);
+        m_port = ntohs(addr.sin_port);
+        return true;
+    }
+
+    void run() {
+        while (m_running) {
+            pollfd pfd{m_listenFd, POLLIN, 0};
+            if (poll(&pfd, 1, 20) <= 0)
+                continue;
+
+            auto fd = accept(m_listenFd, nullptr, nullptr);
+            if (fd == -1)
+                continue;
+
+            // one connection per speaker at once
+            if (m_opt.speakers) {
+                m_clients.emplace_back([this, fd]() {
+                    serve(fd);
+                    close(fd);
+                });
+                continue;
+            }
+
+            serve(fd);
+            close(fd);
+
+            // down for a while: connections are refused
+            if (m_running && m_opt.downMs) {
+                close(m_listenFd);
+                usleep(m_opt.downMs * 1000);
+                listenOn();
+            }
+        }
+    }
+
+public:
+    explicit MockService(const Options& opt) : m_opt(opt) {}
+
+    ~MockService() {
+        m_running = false;
+        if (m_thread.joinable())
+            m_thread.join();
+        for (auto& client : m_clients)
+            client.join();
+        close(m_listenFd);
+    }
+
+    bool start() {
+        if (!listenOn())
+            return false;
+        m_thread = thread(&MockService::run, this);
+        return true;
+    }
+
+    uint16_t port() const { return m_port; }
+};
+
+/**
+ * Upper bound of the bucket holding the given fraction of observations
+ */
+double percentile(Histogram& histogram, double p) {
+    uint64_t buckets[c_histogramBuckets];
+    uint64_t sum;
+    histogram.snapshot(buckets, sum);
+
+    uint64_t total = 0;
+    for (auto count : buckets)
+        total += count;
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < c_histogramBuckets; i++) {
+        seen += buckets[i];
+        if (total && seen >= total * p)
+            return Histogram::bound(i);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse(argc, argv, opt)) {
+        usage();
+        return 1;
+    }
+
+    MockService service(opt);
+    if (!service.start()) {
+        Log::error("failed to start the mock service");
+        Log::flush();
+        return 1;
+    }
+
+    vector<string> events;
+    mutex eventsLock;
+    auto sink = [&](TranscriptEvent& event) {
+        lock_guard<mutex> lock(eventsLock);
+        events.push_back(event.toJson());
+    };
+
+    StreamingTranscriber::Options options;
+    options.url = "ws://127.0.0.1:" + to_string(service.port()) + "/v1/listen";
+    options.chunkMs = opt.chunkMs;
+    options.queueMs = opt.queueMs;
+    options.replayMs = opt.replayMs;
+
+    unique_ptr<StreamingTranscriber> transcriber;
+    unique_ptr<SpeakerTranscription> speakers;
+    if (opt.speakers) {
+        speakers = make_unique<SpeakerTranscription>(options, opt.maxSpeakers, sink, [](uint32_t nodeId) {
+            return "speaker " + to_string(nodeId);
+        });
+    } else {
+        transcriber = make_unique<StreamingTranscriber>(options, sink);
+        transcriber->start();
+    }
+
+    // 10 ms of audio every 10 ms, like the SDK delivers it
+    FakeAudioRawData audio(c_rate, 1, 10);
+    vector<char> silence(audio.GetBufferLen());
+    auto callbacks = static_cast<uint64_t>(opt.seconds * 100);
+    auto next = MetricsClock::nowNs();
+    uint64_t pushed = 0;
+    int64_t channels = 0;
+
+    auto& registry = MetricsRegistry::getInstance();
+    auto& open = registry.gauge("zoombot_asr_speaker_channels", "", "state=\"open\"");
+
+    for (uint64_t i = 0; i < callbacks; i++) {
+        if (!opt.speakers) {
+            transcriber->push(audio.GetBuffer(), audio.GetBufferLen(), audio.GetSampleRate(), audio.GetChannelNum());
+            pushed += audio.GetBufferLen();
+        }
+
+        // node n talks for two seconds from second n - 1, every speakers seconds
+        for (uint32_t node = 1; node <= opt.speakers; node++) {
+            auto second = (i / 100 + opt.speakers - (node - 1)) % opt.speakers;
+            auto* data = second < 2 ? audio.GetBuffer() : silence.data();
+            speakers->push(node, data, audio.GetBufferLen(), audio.GetSampleRate(), audio.GetChannelNum());
+            pushed += audio.GetBufferLen();
+        }
+        channels = max(channels, open.value());
+
+        next += 10000000;
+        timespec ts{static_cast<time_t>(next / 1000000000ull), static_cast<long>(next % 1000000000ull)};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+    }
+
+    if (transcriber)
+        transcriber->stop();
+    speakers.reset();
+    Log::flush();
+
+    auto counter = [&](const string& name, const string& labels = "") {
+        return registry.counter(name, "", labels).value();
+    };
+    auto& latency = registry.histogram("zoombot_asr_latency_seconds", "");
+
+    cout << "\n" << opt.seconds << " s of audio in " << opt.chunkMs << " ms chunks, queue " << opt.queueMs
+         << " ms, replay " << opt.replayMs << " ms";
+    if (opt.dropEvery)
+        cout << ", dropped every " << opt.dropEvery << " s and down " << opt.downMs << " ms";
+    if (opt.speakers)
+        cout << ", " << opt.speakers << " speakers on at most " << opt.maxSpeakers << " channels";
+    cout << "\n\n" << fixed << setprecision(3)
+         << "pushed bytes     " << pushed << "\n"
+         << "sent bytes       " << counter("zoombot_asr_sent_bytes_total") << "\n"
+         << "replayed bytes   " << counter("zoombot_asr_replayed_bytes_total") << "\n"
+         << "dropped bytes    " << counter("zoombot_asr_dropped_bytes_total", "reason=\"queue\"") << "\n"
+         << "reconnects       " << counter("zoombot_asr_reconnects_total") << "\n";
+    if (opt.speakers)
+        cout << "silence bytes    " << counter("zoombot_asr_speaker_skipped_bytes_total", "reason=\"silence\"") << "\n"
+             << "overflow bytes   " << counter("zoombot_asr_speaker_skipped_bytes_total", "reason=\"overflow\"") << "\n"
+             << "channels opened  " << channels << "\n";
+    cout << "results          " << events.size() << "\n"
+         << "latency          p50 < " << percentile(latency, 0.5) << " s, p99 < " << percentile(latency, 0.99)
+         << " s\n";
+    if (!events.empty())
+        cout << "last event       " << events.back() << "\n";
+    cout << endl;
+
+    return events.empty() ? 2 : 0;
+}
@@ -0,0 +1,220 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_FAKERAWDATA_H
+#define MEETING_SDK_LINUX_SAMPLE_FAKERAWDATA_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <time.h>
+#include <unistd.h>
+
+#include "zoom_sdk_raw_data_def.h"
+#include "rawdata/rawdata_audio_helper_interface.h"
+#include "rawdata/rawdata_video_source_helper_interface.h"
+
+using namespace std;
+
+/**
+ * Stand-ins for the SDK's raw data objects so the delegates can be driven
+ * without a meeting. Only the SDK headers are needed, not libmeetingsdk.
+ */
+
+/**
+ * 16-bit PCM chunk holding a sine tone, 10 ms by default
+ */
+class FakeAudioRawData : public AudioRawData {
+    vector<char> m_buffer;
+    unsigned int m_sampleRate;
+    unsigned int m_channels;
+
+public:
+    FakeAudioRawData(unsigned int sampleRate = 32000, unsigned int channels = 1, unsigned int ms = 10, double hz = 440)
+            : m_sampleRate(sampleRate), m_channels(channels) {
+        auto samples = sampleRate / 1000 * ms;
+        m_buffer.resize(samples * channels * sizeof(int16_t));
+
+        auto* pcm = reinterpret_cast<int16_t*>(m_buffer.data());
+        for (unsigned int i = 0; i < samples; i++) {
+            auto value = static_cast<int16_t>(8000 * sin(2 * M_PI * hz * i / sampleRate));
+            for (unsigned int c = 0; c < channels; c++)
+                pcm[i * channels + c] = value;
+        }
+    }
+
+    /**
+     * Replace the chunk, e.g. with a captured one. Without data the previous
+     * samples are kept and only the length changes.
+     */
+    void load(const char* data, unsigned int len, unsigned int sampleRate, unsigned int channels) {
+        m_buffer.resize(len);
+        if (data)
+            memcpy(m_buffer.data(), data, len);
+        m_sampleRate = sampleRate;
+        m_channels = channels;
+    }
+
+    bool CanAddRef() override { return false; }
+    bool AddRef() override { return false; }
+    int Release() override { return 0; }
+
+    char* GetBuffer() override { return m_buffer.data(); }
+    unsigned int GetBufferLen() override { return m_buffer.size(); }
+    unsigned int GetSampleRate() override { return m_sampleRate; }
+    unsigned int GetChannelNum() override { return m_channels; }
+};
+
+/**
+ * I420 frame with a moving gradient test pattern
+ */
+class FakeYUVRawDataI420 : public YUVRawDataI420 {
+    vector<char> m_buffer;
+    unsigned int m_width;
+    unsigned int m_height;
+    unsigned int m_sourceId;
+
+public:
+    FakeYUVRawDataI420(unsigned int width, unsigned int height, unsigned int sourceId = 16778240)
+            : m_buffer(width * height * 3 / 2), m_width(width), m_height(height), m_sourceId(sourceId) {
+        memset(m_buffer.data() + width * height, 128, width * height / 2);
+        advance(0);
+    }
+
+    /**
+     * Redraw the luma plane for the given frame number
+     */
+    void advance(unsigned int frame) {
+        for (unsigned int y = 0; y < m_height; y++)
+            memset(m_buffer.data() + y * m_width, static_cast<char>((y + frame) & 0xff), m_width);
+    }
+
+    /**
+     * Replace the frame, e.g. with a captured one. Without data the previous
+     * pixels are reused, with neutral chroma after a resize.
+     */
+    void load(const char* data, unsigned int len, unsigned int width, unsigned int height, unsigned int sourceId) {
+        auto resized = width != m_width || height != m_height;
+        m_buffer.resize(len);
+        m_width = width;
+        m_height = height;
+        m_sourceId = sourceId;
+
+        if (data)
+            memcpy(m_buffer.data(), data, len);
+        else if (resized && len >= width * height * 3 / 2)
+            memset(m_buffer.data() + width * height, 128, width * height / 2);
+    }
+
+    bool CanAddRef() override { return false; }
+    bool AddRef() override { return false; }
+    int Release() override { return 0; }
+
+    char* GetYBuffer() override { return m_buffer.data(); }
+    char* GetUBuffer() override { return m_buffer.data() + m_width * m_height; }
+    char* GetVBuffer() override { return m_buffer.data() + m_width * m_height * 5 / 4; }
+    char* GetBuffer() override { return m_buffer.data(); }
+    unsigned int GetBufferLen() override { return m_buffer.size(); }
+    bool IsLimitedI420() override { return false; }
+    unsigned int GetStreamWidth() override { return m_width; }
+    unsigned int GetStreamHeight() override { return m_height; }
+    unsigned int GetRotation() override { return 0; }
+    unsigned int GetSourceID() override { return m_sourceId; }
+};
+
+/**
+ * Takes the place of the SDK's video sender: records when each frame
+ * arrived and the first byte of its luma, optionally blocking like a
+ * congested encoder would
+ */
+class FakeVideoSender : public ZOOMSDK::IZoomSDKVideoSender {
+    vector<uint64_t> m_times;
+    vector<uint8_t> m_firstBytes;
+    unsigned int m_stallEvery = 0;
+    unsigned int m_stallUs = 0;
+
+public:
+    unsigned int badFrames = 0;
+
+    explicit FakeVideoSender(size_t frames) {
+        m_times.reserve(frames);
+        m_firstBytes.reserve(frames);
+    }
+
+    /**
+     * Block for stallUs in every stallEvery-th call
+     */
+    void stall(unsigned int stallEvery, unsigned int stallUs) {
+        m_stallEvery = stallEvery;
+        m_stallUs = stallUs;
+    }
+
+    ZOOMSDK::SDKError sendVideoFrame(char* frameBuffer, int width, int height, int frameLength, int rotation,
+                                     ZOOMSDK::FrameDataFormat format) override {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        if (m_times.size() < m_times.capacity()) {
+            m_times.push_back(static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec);
+            m_firstBytes.push_back(static_cast<uint8_t>(frameBuffer[0]));
+        }
+
+        if (frameLength != width * height * 3 / 2)
+            badFrames++;
+
+        if (m_stallEvery && m_times.size() % m_stallEvery == 0)
+            usleep(m_stallUs);
+
+        return ZOOMSDK::SDKERR_SUCCESS;
+    }
+
+    const vector<uint64_t>& times() const { return m_times; }
+    const vector<uint8_t>& firstBytes() const { return m_firstBytes; }
+};
+
+/**
+ * Takes the place of the SDK's virtual microphone sender: records when each
+ * frame arrived and whether it held sound, and counts frames that are not
+ * 10 ms of mono PCM at the rate they claim
+ */
+class FakeAudioSender : public ZOOMSDK::IZoomSDKAudioRawDataSender {
+    vector<uint64_t> m_times;
+    vector<bool> m_audible;
+
+public:
+    unsigned int badFrames = 0;
+
+    explicit FakeAudioSender(size_t frames) {
+        m_times.reserve(frames);
+        m_audible.reserve(frames);
+    }
+
+    ZOOMSDK::SDKError send(char* data, unsigned int data_length, int sample_rate,
+                           ZOOMSDK::ZoomSDKAudioChannel channel) override {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        auto* pcm = reinterpret_cast<const int16_t*>(data);
+        auto samples = data_length / sizeof(int16_t);
+
+        if (m_times.size() < m_times.capacity()) {
+            m_times.push_back(static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec);
+
+            int peak = 0;
+            for (size_t i = 0; i < samples; i++)
+                peak = max(peak, abs(static_cast<int>(pcm[i])));
+            m_audible.push_back(peak > 64);
+        }
+
+        if (channel != ZOOMSDK::ZoomSDKAudioChannel_Mono || samples != static_cast<unsigned int>(sample_rate) / 100)
+            badFrames++;
+
+        return ZOOMSDK::SDKERR_SUCCESS;
+    }
+
+    const vector<uint64_t>& times() const { return m_times; }
+    const vector<bool>& audible() const { return m_audible; }
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_FAKERAWDATA_H
@@ -0,0 +1,651 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FakeRawData.h"
+#include "../src/raw_record/RecordingJournal.h"
+#include "../src/raw_record/VideoQualityController.h"
+#include "../src/raw_record/ZoomSDKAudioRawDataDelegate.h"
+#include "../src/raw_record/ZoomSDKRendererDelegate.h"
+#include "../src/util/MemoryBudget.h"
+#include "../src/util/Threads.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+/**
+ * Drives the raw data delegates with synthetic audio and video at a
+ * configurable rate and reports throughput, callback latency, heap
+ * allocations per callback and bytes on disk.
+ */
+
+/*
+ * Allocation hook: every operator new on the calling thread is counted, so
+ * the driver can tell how many allocations a callback made.
+ */
+namespace {
+    thread_local uint64_t t_allocations = 0;
+}
+
+void* operator new(size_t size) {
+    t_allocations++;
+    if (auto* ptr = malloc(size ? size : 1))
+        return ptr;
+    throw bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+struct Options {
+    unsigned participants = 4;
+    unsigned width = 1280;
+    unsigned height = 720;
+    unsigned fps = 30;
+    unsigned videoStreams = 1;
+    double seconds = 10;
+    double speed = 0;
+    unsigned warmup = 100;
+    string audio = "separate";
+    string dir = "bench-out";
+    bool socketClient = false;
+    string replay;
+    string capture;
+    bool capturePayloads = false;
+    bool failOnAlloc = false;
+    unsigned preRoll = 0;
+    double recordAfter = 0;
+    double outageAt = -1;
+    unsigned outageMs = 2000;
+    unsigned syncMs = 0;
+    unsigned prealloc = 0;
+    bool dropBehind = false;
+    bool direct = false;
+    vector<pair<ThreadClass, string>> cpus;
+    bool dumpThreads = false;
+    unsigned memoryBudget = 0;
+    bool adaptive = false;
+};
+
+class Stream {
+    vector<uint64_t> m_latency;
+
+public:
+    string name;
+    uint64_t callbacks = 0;
+    uint64_t bytes = 0;
+    uint64_t allocations = 0;
+    uint64_t measured = 0;
+
+    // callbacks before this one, plus the warm-up, are not measured
+    uint64_t warmupStart = 0;
+
+    explicit Stream(string name) : name(move(name)) { m_latency.reserve(1 << 20); }
+
+    template <typename F>
+    void call(unsigned warmup, unsigned len, F&& callback) {
+        auto allocations = t_allocations;
+        auto start = MetricsClock::nowNs();
+
+        callback();
+
+        auto elapsed = MetricsClock::nowNs() - start;
+        callbacks++;
+        bytes += len;
+
+        if (callbacks <= warmupStart + warmup)
+            return;
+
+        this->allocations += t_allocations - allocations;
+        measured++;
+        if (m_latency.size() < m_latency.capacity())
+            m_latency.push_back(elapsed);
+    }
+
+    double percentileUs(double p) {
+        if (m_latency.empty())
+            return 0;
+
+        auto index = min<size_t>(m_latency.size() - 1, m_latency.size() * p);
+        nth_element(m_latency.begin(), m_latency.begin() + index, m_latency.end());
+        return m_latency[index] / 1000.0;
+    }
+};
+
+void usage() {
+    cout << "usage: media_bench [--participants N] [--resolution 360|720|1080] [--fps N] [--video-streams N]\n"
+            "                   [--seconds S] [--speed X (0 = as fast as possible)] [--warmup N]\n"
+            "                   [--audio mixed|separate|multichannel|transcribe|off] [--dir DIR] [--socket-client]\n"
+            "                   [--capture FILE [--capture-payloads]] [--replay FILE] [--fail-on-alloc]\n"
+            "                   [--preroll S] [--record-after S] [--sync-ms N] [--prealloc S] [--drop-behind]\n"
+            "                   [--direct] [--cpus main|socket|writer|analysis=LIST]... [--dump-threads]\n"
+            "                   [--memory-budget MB] [--adaptive] [--outage-at S [--outage-ms N]]" << endl;
+}
+
+bool parse(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto next = [&]() -> string { return i + 1 < argc ? argv[++i] : ""; };
+
+        if (arg == "--participants") opt.participants = stoul(next());
+        else if (arg == "--fps") opt.fps = stoul(next());
+        else if (arg == "--video-streams") opt.videoStreams = stoul(next());
+        else if (arg == "--seconds") opt.seconds = stod(next());
+        else if (arg == "--speed") opt.speed = stod(next());
+        else if (arg == "--warmup") opt.warmup = stoul(next());
+        else if (arg == "--audio") opt.audio = next();
+        else if (arg == "--dir") opt.dir = next();
+        else if (arg == "--socket-client") opt.socketClient = true;
+        else if (arg == "--replay") opt.replay = next();
+        else if (arg == "--capture") opt.capture = next();
+        else if (arg == "--capture-payloads") opt.capturePayloads = true;
+        else if (arg == "--fail-on-alloc") opt.failOnAlloc = true;
+        else if (arg == "--preroll") opt.preRoll = stoul(next());
+        else if (arg == "--record-after") opt.recordAfter = stod(next());
+        else if (arg == "--sync-ms") opt.syncMs = stoul(next());
+        else if (arg == "--prealloc") opt.prealloc = stoul(next());
+        else if (arg == "--drop-behind") opt.dropBehind = true;
+        else if (arg == "--direct") opt.direct = true;
+        else if (arg == "--dump-threads") opt.dumpThreads = true;
+        else if (arg == "--memory-budget") opt.memoryBudget = stoul(next());
+        else if (arg == "--adaptive") opt.adaptive = true;
+        else if (arg == "--outage-at") opt.outageAt = stod(next());
+        else if (arg == "--outage-ms") opt.outageMs = stoul(next());
+        else if (arg == "--cpus") {
+            auto value = next();
+            auto eq = value.find('=');
+            auto name = value.substr(0, eq);
+            auto threadClass = ThreadClass::Main;
+
+            if (name == "socket") threadClass = ThreadClass::Socket;
+            else if (name == "writer") threadClass = ThreadClass::Writer;
+            else if (name == "analysis") threadClass = ThreadClass::Analysis;
+            else if (name != "main" || eq == string::npos) return false;
+
+            opt.cpus.emplace_back(threadClass, value.substr(eq + 1));
+        }
+        else if (arg == "--resolution") {
+            auto res = stoul(next());
+            opt.height = res;
+            opt.width = res * 16 / 9;
+        } else {
+            return false;
+        }
+    }
+
+    return opt.fps > 0 && opt.speed >= 0;
+}
+
+/**
+ * Reads everything the socket server writes, like an external transcriber would
+ */
+void socketClient(atomic<bool>& running, atomic<uint64_t>& received) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, "/tmp/meeting.sock", sizeof(addr.sun_path) - 1);
+
+    int fd = -1;
+    while (running) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connect(fd, (sockaddr*) &addr, sizeof(addr)) == 0)
+            break;
+
+        close(fd);
+        fd = -1;
+        usleep(10000);
+    }
+
+    char buf[65536];
+    while (fd != -1) {
+        auto n = read(fd, buf, sizeof(buf));
+        if (n <= 0)
+            break;
+        received += n;
+    }
+
+    if (fd != -1)
+        close(fd);
+}
+
+uint64_t bytesOnDisk(const string& dir, const vector<string>& extensions) {
+    uint64_t total = 0;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        auto ext = entry.path().extension().string();
+        if (entry.is_regular_file() && find(extensions.begin(), extensions.end(), ext) != extensions.end())
+            total += entry.file_size();
+    }
+    return total;
+}
+
+/**
+ * Bytes of the outputs in a directory that are resident in the page cache
+ */
+uint64_t bytesCached(const string& dir) {
+    static const auto page = sysconf(_SC_PAGESIZE);
+    uint64_t total = 0;
+    vector<unsigned char> resident;
+
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        auto ext = entry.path().extension();
+        if (!entry.is_regular_file() || !(ext == ".pcm" || ext == ".wav" || ext == ".yuv") || !entry.file_size())
+            continue;
+
+        auto fd = open(entry.path().c_str(), O_RDONLY | O_CLOEXEC);
+        auto size = entry.file_size();
+        auto* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+            continue;
+
+        resident.resize((size + page - 1) / page);
+        if (mincore(map, size, resident.data()) == 0) {
+            for (auto pageResident : resident)
+                total += (pageResident & 1) * page;
+        }
+        munmap(map, size);
+    }
+
+    return total;
+}
+
+/**
+ * A "Key:   value kB" line of a /proc file, in bytes
+ */
+uint64_t procKb(const char* path, const string& key) {
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        if (line.compare(0, key.size(), key) == 0 && line[key.size()] == ':')
+            return stoull(line.substr(key.size() + 1)) * 1024;
+    }
+    return 0;
+}
+
+/**
+ * Sleep until the given media time has elapsed, scaled by --speed
+ */
+void pace(const Options& opt, const timespec& wallStart, uint64_t mediaNs) {
+    if (opt.speed <= 0)
+        return;
+
+    auto target = wallStart.tv_nsec + static_cast<uint64_t>(mediaNs / opt.speed);
+    timespec ts{};
+    ts.tv_sec = wallStart.tv_sec + target / 1000000000ull;
+    ts.tv_nsec = target % 1000000000ull;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+}
+
+struct Bench {
+    Options opt;
+
+    unique_ptr<ZoomSDKAudioRawDataDelegate> audio;
+    unique_ptr<ZoomSDKRendererDelegate> video;
+    unique_ptr<VideoQualityController> quality;
+
+    FakeAudioRawData pcm;
+    FakeYUVRawDataI420 frame;
+
+    Stream audioStream;
+    Stream videoStream;
+
+    uint64_t mediaNs = 0;
+    bool recording = false;
+
+    explicit Bench(const Options& opt) :
+            opt(opt),
+            frame(opt.width, opt.height),
+            audioStream("audio " + opt.audio),
+            videoStream(opt.replay.empty() ? "video " + to_string(opt.width) + "x" + to_string(opt.height) : "video") {}
+
+    /**
+     * Start recording once the media clock passes --record-after, so the
+     * pre-roll is flushed mid-run as when the privilege is granted
+     */
+    void startRecording(uint64_t now) {
+        if (recording || now < static_cast<uint64_t>(opt.recordAfter * 1e9))
+            return;
+
+        if (audio)
+            audio->setRecordingStarted(true);
+        recording = true;
+
+        // opening the files is a one-off, warm up again
+        audioStream.warmupStart = audioStream.callbacks;
+    }
+
+    /**
+     * Follow the adaptive controller as the SDK would, by resubscribing at
+     * another resolution and keeping fewer frames
+     */
+    void adapt() {
+        auto& writer = video->writer();
+        if (!quality->update(writer.queued(), VideoWriter::c_queueDepth, writer.busyNs(), MetricsClock::nowNs()))
+            return;
+
+        auto& step = quality->step();
+        writer.setDecimation(step.decimation);
+        frame.load(nullptr, step.width * step.height * 3 / 2, step.width, step.height, 16778240);
+    }
+
+    /**
+     * Whether media at this time is lost, as while the meeting reconnects
+     */
+    bool inOutage(uint64_t now) const {
+        if (opt.outageAt < 0)
+            return false;
+
+        auto from = static_cast<uint64_t>(opt.outageAt * 1e9);
+        return now >= from && now < from + opt.outageMs * 1000000ull;
+    }
+
+    /**
+     * Generate N participants of audio and M video streams from a virtual media clock
+     */
+    void synthesize() {
+        const uint64_t audioPeriod = 10000000;
+        const uint64_t videoPeriod = 1000000000ull / opt.fps;
+        const auto end = static_cast<uint64_t>(opt.seconds * 1e9);
+
+        uint64_t nextAudio = audio ? 0 : end;
+        uint64_t nextVideo = video ? 0 : end;
+        unsigned frameNumber = 0;
+
+        timespec wallStart{};
+        clock_gettime(CLOCK_MONOTONIC, &wallStart);
+
+        for (;;) {
+            auto now = min(nextAudio, nextVideo);
+            if (now >= end)
+                break;
+
+            pace(opt, wallStart, now);
+            startRecording(now);
+
+            if (nextAudio == now && inOutage(now)) {
+                nextAudio += audioPeriod;
+            } else if (nextAudio == now) {
+                if (opt.audio == "separate" || opt.audio == "multichannel") {
+                    for (unsigned p = 0; p < opt.participants; p++)
+                        audioStream.call(opt.warmup, pcm.GetBufferLen(), [&] { audio->onOneWayAudioRawDataReceived(&pcm, 16778240 + p * 1024); });
+                } else {
+                    audioStream.call(opt.warmup, pcm.GetBufferLen(), [&] { audio->onMixedAudioRawDataReceived(&pcm); });
+                }
+                nextAudio += audioPeriod;
+            }
+
+            if (nextVideo == now && inOutage(now)) {
+                frameNumber++;
+                nextVideo += videoPeriod;
+            } else if (nextVideo == now) {
+                if (quality)
+                    adapt();
+
+                frame.advance(frameNumber++);
+                for (unsigned s = 0; s < opt.videoStreams; s++)
+                    videoStream.call(opt.warmup, frame.GetBufferLen(), [&] { video->onRawDataFrameReceived(&frame); });
+                nextVideo += videoPeriod;
+            }
+        }
+
+        mediaNs = end;
+    }
+
+    /**
+     * Feed a capture back into the delegates with its original timing
+     */
+    bool replay() {
+        CallbackTraceReader reader;
+        if (!reader.open(opt.replay))
+            return false;
+
+        CallbackRecord record{};
+        vector<char> payload;
+        uint64_t hash;
+        uint64_t mismatches = 0;
+        uint64_t verified = 0;
+
+        timespec wallStart{};
+        clock_gettime(CLOCK_MONOTONIC, &wallStart);
+
+        while (reader.next(record, payload, hash)) {
+            pace(opt, wallStart, record.timestamp);
+            startRecording(record.timestamp);
+            mediaNs = record.timestamp;
+
+            const char* data = payload.empty() ? nullptr : payload.data();
+
+            switch (record.type) {
+                case CallbackType::MixedAudio:
+                case CallbackType::OneWayAudio:
+                case CallbackType::ShareAudio:
+                    if (!audio)
+                        break;
+
+                    pcm.load(data, record.len, record.a, record.b);
+                    audioStream.call(opt.warmup, record.len, [&] {
+                        if (record.type == CallbackType::MixedAudio)
+                            audio->onMixedAudioRawDataReceived(&pcm);
+                        else if (record.type == CallbackType::OneWayAudio)
+                            audio->onOneWayAudioRawDataReceived(&pcm, record.nodeId);
+                        else
+                            audio->onShareAudioRawDataReceived(&pcm);
+                    });
+                    break;
+
+                case CallbackType::Video:
+                    if (!video)
+                        break;
+
+                    frame.load(data, record.len, record.a, record.b, record.nodeId);
+                    videoStream.call(opt.warmup, record.len, [&] { video->onRawDataFrameReceived(&frame); });
+                    break;
+            }
+
+            // the payload as the delegates were given it, against the hash taken at capture
+            if (data && reader.header().version >= 2) {
+                verified++;
+                if (CallbackRecorder::hash(data, record.len) != hash)
+                    mismatches++;
+            }
+        }
+
+        if (mismatches)
+            cout << mismatches << " of " << verified << " payloads did not match their capture hash" << endl;
+        else if (verified)
+            cout << verified << " payloads matched their capture hash" << endl;
+
+        return true;
+    }
+};
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse(argc, argv, opt)) {
+        usage();
+        return 1;
+    }
+
+    fs::create_directories(opt.dir);
+    for (const auto& entry : fs::directory_iterator(opt.dir)) {
+        auto ext = entry.path().extension();
+        if (entry.is_regular_file()
+            && (ext == ".pcm" || ext == ".wav" || ext == ".yuv" || ext == ".journal" || ext == ".meta"))
+            fs::remove(entry.path());
+    }
+
+    auto& threads = ThreadRegistry::getInstance();
+    threads.enroll(ThreadClass::Main, "media_bench");
+    for (auto& [threadClass, cpus] : opt.cpus) {
+        if (!threads.configure(threadClass, ThreadPolicy{cpus})) {
+            Log::flush();
+            return 1;
+        }
+    }
+
+    FileSink::setDefaults(opt.prealloc, opt.dropBehind);
+    MemoryBudget::getInstance().setBudget(static_cast<uint64_t>(opt.memoryBudget) << 20);
+    if (opt.syncMs)
+        RecordingJournal::getInstance().open(opt.dir, opt.syncMs);
+
+    Bench bench(opt);
+
+    if (opt.audio != "off") {
+        auto perNode = opt.audio == "separate" || opt.audio == "multichannel";
+        bench.audio = make_unique<ZoomSDKAudioRawDataDelegate>(!perNode, opt.audio == "transcribe");
+        bench.audio->setDir(opt.dir);
+        bench.audio->setFilename("bench-audio.pcm");
+        bench.audio->setPreRollSeconds(opt.preRoll);
+
+        // chunks are placed by arrival, faster than real time they run ahead and are dropped
+        if (opt.audio == "multichannel")
+            bench.audio->setMultichannel(opt.participants, MultichannelRecorder::Overflow::Mix, nullptr);
+    }
+
+    if (opt.videoStreams > 0) {
+        bench.video = make_unique<ZoomSDKRendererDelegate>();
+        bench.video->setOutput(opt.dir, "bench-video.yuv", opt.direct);
+
+        if (opt.adaptive) {
+            auto resolution = ZoomSDKResolution_720P;
+            VideoQualityController::parseResolution(to_string(opt.height), resolution);
+            bench.quality = make_unique<VideoQualityController>(resolution);
+        }
+    }
+
+    atomic<bool> running{true};
+    atomic<uint64_t> received{0};
+    thread client;
+
+    if (opt.socketClient) {
+        usleep(100000);
+        client = thread(socketClient, ref(running), ref(received));
+        usleep(100000);
+    }
+
+    if (!opt.capture.empty())
+        CallbackRecorder::getInstance().open(opt.capture, opt.capturePayloads);
+
+    auto cachedBefore = procKb("/proc/meminfo", "Cached");
+    auto start = MetricsClock::nowNs();
+
+    if (opt.replay.empty())
+        bench.synthesize();
+    else if (!bench.replay())
+        return 1;
+
+    auto wall = (MetricsClock::nowNs() - start) / 1e9;
+    auto media = bench.mediaNs / 1e9;
+
+    CallbackRecorder::getInstance().close();
+    if (bench.audio)
+        bench.audio->closeFiles();
+    if (bench.video)
+        bench.video->closeFiles();
+    RecordingJournal::getInstance().close();
+    Log::flush();
+
+    auto cachedGrowth = static_cast<int64_t>(procKb("/proc/meminfo", "Cached") - cachedBefore);
+
+    cout << "\nmedia: " << fixed << setprecision(3) << media << " s, wall " << wall << " s ("
+         << setprecision(1) << media / wall << "x real time)\n\n";
+
+    string backend = opt.direct ? "direct" : "buffered";
+    if (opt.prealloc)
+        backend += "+prealloc";
+    if (opt.dropBehind)
+        backend += "+drop";
+
+    cout << left << setw(22) << "stream" << setw(24) << "backend" << right
+         << setw(10) << "callbacks" << setw(12) << "cb/s" << setw(10) << "MB/s"
+         << setw(10) << "p50 us" << setw(10) << "p99 us" << setw(12) << "allocs/cb"
+         << setw(14) << "disk bytes" << "\n";
+
+    auto report = [&](Stream& stream, const vector<string>& extensions) {
+        if (!stream.callbacks)
+            return;
+
+        auto allocs = stream.measured ? static_cast<double>(stream.allocations) / stream.measured : 0.0;
+        cout << left << setw(22) << stream.name << setw(24) << backend << right
+             << setw(10) << stream.callbacks
+             << setw(12) << setprecision(0) << stream.callbacks / wall
+             << setw(10) << setprecision(1) << stream.bytes / wall / 1e6
+             << setw(10) << setprecision(2) << stream.percentileUs(0.5)
+             << setw(10) << stream.percentileUs(0.99)
+             << setw(12) << allocs
+             << setw(14) << bytesOnDisk(opt.dir, extensions) << "\n";
+    };
+
+    // multichannel audio goes to a WAV
+    report(bench.audioStream, {".pcm", ".wav"});
+    report(bench.videoStream, {".yuv"});
+
+    constexpr double mib = 1024 * 1024;
+    cout << "\nrss " << setprecision(1) << procKb("/proc/self/status", "VmRSS") / mib << " MiB (peak "
+         << procKb("/proc/self/status", "VmHWM") / mib << " MiB), page cache " << showpos << cachedGrowth / mib
+         << noshowpos << " MiB, outputs cached " << bytesCached(opt.dir) / mib << " MiB\n";
+
+    if (opt.memoryBudget) {
+        auto& registry = MetricsRegistry::getInstance();
+        auto skipped = [&](const string& reason) {
+            return registry.counter("zoombot_video_frames_skipped_total", "", "reason=\"" + reason + "\"").value();
+        };
+        auto steps = [&](Degradation level) {
+            return registry.counter("zoombot_degradation_steps_total", "",
+                                    "level=\"" + string(MemoryBudget::degradationName(level)) + "\"").value();
+        };
+
+        cout << "memory budget " << opt.memoryBudget << " MiB: video frames decimated " << skipped("decimated")
+             << ", dropped " << skipped("budget") << ", queue full " << skipped("queue_full")
+             << "; entered drop_analysis " << steps(Degradation::DropAnalysis)
+             << "x, decimate_video " << steps(Degradation::DecimateVideo) << "x, drop_video "
+             << steps(Degradation::DropVideo) << "x\n";
+    }
+
+    if (bench.quality) {
+        ifstream meta(opt.dir + "/bench-video.yuv.meta");
+        auto changes = count(istreambuf_iterator<char>(meta), istreambuf_iterator<char>(), '\n');
+        cout << "adaptive video ended at " << bench.quality->describe() << ", " << changes
+             << " formats in bench-video.yuv.meta\n";
+    }
+
+    if (opt.socketClient)
+        cout << "\nsocket client received " << received << " bytes\n";
+
+    if (opt.dumpThreads)
+        cout << "\n" << threads.dump();
+
+    cout << endl;
+
+    auto allocations = bench.audioStream.allocations + bench.videoStream.allocations;
+    if (opt.failOnAlloc && allocations > 0) {
+        cout << "FAIL: " << allocations << " heap allocations on the callback path after warm-up" << endl;
+        Logger::getInstance().shutdown();
+        _exit(2);
+    }
+
+    // the socket server threads block in accept(), leave without unwinding them
+    Logger::getInstance().shutdown();
+    _exit(0);
+}
@@ -0,0 +1,64 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../src/util/Metrics.h"
+
+using namespace std;
+
+/**
+ * Micro-benchmark for the hot-path metric updates.
+ * Reports nanoseconds per operation for one thread and for several threads
+ * hammering the same metric.
+ */
+
+constexpr uint64_t c_iterations = 20000000;
+
+template <typename Op>
+double timeOp(unsigned threads, const Op& op) {
+    auto start = chrono::steady_clock::now();
+
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&op] {
+            for (uint64_t i = 0; i < c_iterations; i++)
+                op();
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    auto elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    return elapsed / c_iterations;
+}
+
+template <typename Op>
+void report(const string& name, const Op& op) {
+    auto threads = max(2u, thread::hardware_concurrency());
+
+    cout << left << setw(28) << name
+         << right << setw(10) << fixed << setprecision(2) << timeOp(1, op) << " ns/op"
+         << setw(10) << timeOp(threads, op) << " ns/op (" << threads << " threads)" << endl;
+}
+
+int main() {
+    auto& registry = MetricsRegistry::getInstance();
+
+    auto& counter = registry.counter("bench_counter_total", "benchmark counter");
+    auto& gauge = registry.gauge("bench_gauge", "benchmark gauge");
+    auto& histogram = registry.histogram("bench_histogram_seconds", "benchmark histogram");
+    uint64_t ns = 0;
+
+    report("Counter::inc", [&] { counter.inc(); });
+    report("Gauge::set", [&] { gauge.set(42); });
+    report("Histogram::observe", [&] { histogram.observe(ns += 977); });
+    report("MetricsClock::nowNs", [] { asm volatile("" :: "r"(MetricsClock::nowNs())); });
+
+    CallbackMetrics callback("bench");
+    report("CallbackMetrics::Scope", [&] { CallbackMetrics::Scope scope(callback); });
+
+    return 0;
+}
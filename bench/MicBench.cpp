@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "FakeRawData.h"
+#include "../src/raw_send/AudioSender.h"
+#include "../src/raw_send/PcmInput.h"
+#include "../src/util/Log.h"
+
+using namespace std;
+
+/**
+ * Runs the virtual microphone against a stand-in for the SDK's sender while
+ * playing a client on its socket: a tone in 20 ms chunks, each delayed by up
+ * to --jitter-ms, with a --gap-ms stall every --gap-every seconds after
+ * which the client catches up in a burst, like a congested TTS link.
+ */
+
+struct Options {
+    unsigned rate = 16000;
+    double seconds = 10;
+    unsigned jitterMs = 0;
+    double gapEvery = 0;
+    unsigned gapMs = 0;
+    bool silence = false;
+};
+
+const string c_socketPath = "/tmp/zoombot-mic-bench.sock";
+const unsigned c_outputRate = 32000;
+const unsigned c_chunkMs = 20;
+
+void usage() {
+    cout << "usage: mic_bench [--rate HZ] [--seconds S] [--jitter-ms MS] [--gap-every S --gap-ms MS]\n"
+            "                 [--conceal silence|repeat]" << endl;
+}
+
+bool parse(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto next = [&]() -> string { return i + 1 < argc ? argv[++i] : ""; };
+
+        if (arg == "--rate") opt.rate = stoul(next());
+        else if (arg == "--seconds") opt.seconds = stod(next());
+        else if (arg == "--jitter-ms") opt.jitterMs = stoul(next());
+        else if (arg == "--gap-every") opt.gapEvery = stod(next());
+        else if (arg == "--gap-ms") opt.gapMs = stoul(next());
+        else if (arg == "--conceal") opt.silence = next() == "silence";
+        else return false;
+    }
+
+    return opt.rate > 0 && opt.seconds > 0;
+}
+
+void sleepUntil(uint64_t ns) {
+    timespec ts{static_cast<time_t>(ns / 1000000000ull), static_cast<long>(ns % 1000000000ull)};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+}
+
+/**
+ * Connects to the input socket and streams the tone
+ */
+void speak(const Options& opt, atomic<bool>& running) {
+    auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, c_socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == -1) {
+        Log::error("failed to connect to " + c_socketPath);
+        close(fd);
+        return;
+    }
+
+    auto samples = opt.rate * c_chunkMs / 1000;
+    vector<int16_t> chunk(samples);
+    mt19937 random(1);
+    uniform_int_distribution<unsigned> jitter(0, opt.jitterMs * 1000);
+
+    const uint64_t period = c_chunkMs * 1000000ull;
+    auto gapChunks = static_cast<uint64_t>(opt.gapEvery * 1000 / c_chunkMs);
+    auto start = MetricsClock::nowNs();
+    uint64_t stall = 0;
+
+    for (uint64_t n = 0; running; n++) {
+        if (gapChunks && n && n % gapChunks == 0)
+            stall = MetricsClock::nowNs() + opt.gapMs * 1000000ull;
+
+        // chunks due during a stall all go out when it ends
+        uint64_t due = start + n * period + jitter(random) * 1000ull;
+        sleepUntil(max(due, stall));
+
+        for (unsigned i = 0; i < samples; i++)
+            chunk[i] = static_cast<int16_t>(8000 * sin(2 * M_PI * 440 * (n * samples + i) / opt.rate));
+
+        if (send(fd, chunk.data(), chunk.size() * sizeof(int16_t), MSG_NOSIGNAL) == -1)
+            break;
+    }
+
+    close(fd);
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse(argc, argv, opt)) {
+        usage();
+        return 1;
+    }
+
+    JitterBuffer buffer(c_outputRate);
+    buffer.setConcealment(opt.silence ? JitterBuffer::Concealment::Silence : JitterBuffer::Concealment::Repeat);
+
+    auto input = PcmInput::create("unix:" + c_socketPath, opt.rate);
+    if (!input || !input->start(buffer)) {
+        Log::flush();
+        return 1;
+    }
+
+    FakeAudioSender fake(static_cast<size_t>(opt.seconds * 100) + 64);
+    AudioSender sender;
+    sender.start(&fake, buffer);
+
+    atomic<bool> running{true};
+    thread client(speak, cref(opt), ref(running));
+
+    // sample the buffered delay as the sender sees it
+    vector<double> latency;
+    auto end = MetricsClock::nowNs() + static_cast<uint64_t>(opt.seconds * 1e9);
+    while (MetricsClock::nowNs() < end) {
+        latency.push_back(buffer.level() * 1000.0 / c_outputRate);
+        usleep(10000);
+    }
+
+    running = false;
+    client.join();
+    sender.stop();
+    input->stop();
+    Log::flush();
+
+    auto& times = fake.times();
+    vector<double> deviation;
+    for (size_t i = 1; i < times.size(); i++)
+        deviation.push_back(abs(static_cast<double>(times[i] - times[i - 1]) - 1e7) / 1000);
+    sort(deviation.begin(), deviation.end());
+    sort(latency.begin(), latency.end());
+
+    auto percentile = [](const vector<double>& v, double p) {
+        return v.empty() ? 0.0 : v[min<size_t>(v.size() - 1, v.size() * p)];
+    };
+
+    auto audible = count(fake.audible().begin(), fake.audible().end(), true);
+    auto& registry = MetricsRegistry::getInstance();
+
+    cout << "\ninput " << opt.rate << " Hz, jitter " << opt.jitterMs << " ms, ";
+    if (opt.gapMs)
+        cout << opt.gapMs << " ms gap every " << opt.gapEvery << " s, ";
+    cout << (opt.silence ? "silence" : "repeat") << " concealment\n\n"
+         << fixed << setprecision(2)
+         << "frames sent      " << sender.sent() << " (" << audible << " audible)\n"
+         << "send jitter      p50 " << percentile(deviation, 0.5) << " us, p99 " << percentile(deviation, 0.99)
+         << " us\n"
+         << "buffered         p50 " << percentile(latency, 0.5) << " ms, p99 " << percentile(latency, 0.99)
+         << " ms\n"
+         << "target           " << buffer.targetMs() << " ms\n"
+         << "underruns        " << registry.counter("zoombot_mic_underruns_total", "").value() << "\n"
+         << "concealed        " << registry.counter("zoombot_mic_concealed_frames_total", "").value() << "\n"
+         << "trimmed samples  " << registry.counter("zoombot_mic_trimmed_samples_total", "").value() << "\n"
+         << "skipped          " << sender.skipped() << "\n"
+         << "bad frame sizes  " << fake.badFrames << "\n" << endl;
+
+    return fake.badFrames ? 2 : 0;
+}
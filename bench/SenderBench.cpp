@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "FakeRawData.h"
+#include "../src/raw_send/VideoSender.h"
+#include "../src/util/Log.h"
+
+using namespace std;
+
+/**
+ * Runs the paced video sender against a stand-in for the SDK's sender and
+ * reports how evenly frames went out. With --source shm it also plays the
+ * producer, writing a frame ring at --producer-fps.
+ */
+
+struct Options {
+    string source = "pattern";
+    unsigned width = 1280;
+    unsigned height = 720;
+    unsigned fps = 30;
+    unsigned producerFps = 0;
+    double seconds = 5;
+    unsigned stallEvery = 0;
+    unsigned stallMs = 0;
+};
+
+const string c_shmName = "zoombot-sender-bench";
+
+void usage() {
+    cout << "usage: sender_bench [--source pattern|file:PATH|shm] [--resolution 360|720|1080] [--fps N]\n"
+            "                    [--producer-fps N] [--seconds S] [--stall-every N --stall-ms MS]" << endl;
+}
+
+bool parse(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto next = [&]() -> string { return i + 1 < argc ? argv[++i] : ""; };
+
+        if (arg == "--source") opt.source = next();
+        else if (arg == "--fps") opt.fps = stoul(next());
+        else if (arg == "--producer-fps") opt.producerFps = stoul(next());
+        else if (arg == "--seconds") opt.seconds = stod(next());
+        else if (arg == "--stall-every") opt.stallEvery = stoul(next());
+        else if (arg == "--stall-ms") opt.stallMs = stoul(next());
+        else if (arg == "--resolution") {
+            auto res = stoul(next());
+            opt.height = res;
+            opt.width = res * 16 / 9;
+        } else {
+            return false;
+        }
+    }
+
+    return opt.fps > 0 && opt.seconds > 0;
+}
+
+/**
+ * Writes numbered frames into a shared-memory ring like an external renderer would
+ */
+void produce(const Options& opt, atomic<bool>& running) {
+    const uint32_t slots = 3;
+    uint32_t frameSize = opt.width * opt.height * 3 / 2;
+    auto size = ShmFrameRing::size(frameSize, slots);
+
+    auto fd = shm_open(("/" + c_shmName).c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd == -1 || ftruncate(fd, size) == -1) {
+        Log::error("failed to create shared memory " + c_shmName);
+        return;
+    }
+
+    auto* ring = static_cast<ShmFrameRing*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    close(fd);
+
+    ring->width = opt.width;
+    ring->height = opt.height;
+    ring->frameSize = frameSize;
+    ring->slots = slots;
+    ring->slotSize = ShmFrameRing::stride(frameSize);
+    ring->version = ShmFrameRing::c_version;
+    ring->magic = ShmFrameRing::c_magic;
+
+    auto period = 1000000000ull / (opt.producerFps ? opt.producerFps : opt.fps);
+    auto next = MetricsClock::nowNs();
+
+    for (uint64_t n = 0; running; n++) {
+        auto& slot = ring->slot(n);
+        slot.sequence.store(2 * n + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        auto* frame = ring->frame(n);
+        memset(frame, static_cast<char>(n & 0xff), opt.width * opt.height);
+        memset(frame + opt.width * opt.height, 128, frameSize - opt.width * opt.height);
+
+        slot.sequence.store(2 * n + 2, memory_order_release);
+        ring->published.store(n + 1, memory_order_release);
+
+        next += period;
+        timespec ts{static_cast<time_t>(next / 1000000000ull), static_cast<long>(next % 1000000000ull)};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+    }
+
+    munmap(ring, size);
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse(argc, argv, opt)) {
+        usage();
+        return 1;
+    }
+
+    atomic<bool> running{true};
+    thread producer;
+    auto spec = opt.source;
+
+    if (opt.source == "shm") {
+        spec = "shm:" + c_shmName;
+        producer = thread(produce, cref(opt), ref(running));
+        usleep(100000);
+    }
+
+    auto source = FrameSource::create(spec);
+    if (!source) {
+        Log::flush();
+        return 1;
+    }
+
+    FakeVideoSender fake(static_cast<size_t>(opt.seconds * opt.fps * 2) + 16);
+    fake.stall(opt.stallEvery, opt.stallMs * 1000);
+
+    VideoSender sender;
+    sender.setSource(move(source));
+
+    auto ok = sender.start(&fake, opt.width, opt.height, opt.fps);
+    if (ok)
+        usleep(static_cast<useconds_t>(opt.seconds * 1e6));
+    sender.stop();
+
+    running = false;
+    if (producer.joinable())
+        producer.join();
+    shm_unlink(("/" + c_shmName).c_str());
+    Log::flush();
+
+    if (!ok)
+        return 1;
+
+    // distance of every interval from the period
+    auto& times = fake.times();
+    double period = 1e9 / opt.fps;
+    vector<double> deviation;
+    unsigned changes = 0;
+
+    for (size_t i = 1; i < times.size(); i++) {
+        deviation.push_back(abs(static_cast<double>(times[i] - times[i - 1]) - period) / 1000);
+        if (fake.firstBytes()[i] != fake.firstBytes()[i - 1])
+            changes++;
+    }
+    sort(deviation.begin(), deviation.end());
+
+    auto percentile = [&](double p) {
+        return deviation.empty() ? 0.0 : deviation[min<size_t>(deviation.size() - 1, deviation.size() * p)];
+    };
+
+    auto elapsed = times.size() > 1 ? (times.back() - times.front()) / 1e9 : 0.0;
+
+    cout << "\nsource " << spec << ", " << opt.width << "x" << opt.height << " at " << opt.fps << " fps\n\n"
+         << fixed << setprecision(2)
+         << "frames sent      " << sender.sent() << " (" << (elapsed ? (times.size() - 1) / elapsed : 0.0) << " fps)\n"
+         << "new frames       " << changes + (times.empty() ? 0 : 1) << "\n"
+         << "interval jitter  p50 " << percentile(0.5) << " us, p99 " << percentile(0.99) << " us, max "
+         << (deviation.empty() ? 0.0 : deviation.back()) << " us\n"
+         << "late             " << sender.late() << "\n"
+         << "skipped          " << sender.skipped() << "\n"
+         << "bad frame sizes  " << fake.badFrames << "\n" << endl;
+
+    return fake.badFrames ? 2 : 0;
+}
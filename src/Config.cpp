@@ -1,4 +1,5 @@
 #include "Config.h"
+#include "util/Log.h"
 
 Config::Config() :
         m_app(m_name, "zoomsdk"),
@@ -26,11 +27,74 @@ Config::Config() :
     m_rawRecordAudioCmd->add_option("-d, --dir", m_audioDir, "Audio Output Directory");
     m_rawRecordAudioCmd->add_flag("-s, --separate-participants", m_separateParticipantAudio, "Output to separate PCM files for each participant");
     m_rawRecordAudioCmd->add_flag("-t, --transcribe", m_transcribe, "Transcribe audio to text");
+    m_rawRecordAudioCmd->add_option("--preroll-seconds", m_preRollSeconds, "Seconds of audio kept in memory before recording starts, also exported on SIGUSR2 (0 disables)")->capture_default_str();
+    m_rawRecordAudioCmd->add_option("--asr-url", m_asrUrl, "Streaming transcription endpoint used with --transcribe and --deepgram-api-key")->capture_default_str();
+    m_rawRecordAudioCmd->add_option("--asr-chunk-ms", m_asrChunkMs, "Audio sent for transcription per message")
+            ->check(CLI::Range(10, 1000))->capture_default_str();
+    m_rawRecordAudioCmd->add_option("--asr-queue-ms", m_asrQueueMs, "Audio held while the transcription service is slow or unreachable, the oldest is dropped beyond")
+            ->check(CLI::Range(100, 600000))->capture_default_str();
+    m_rawRecordAudioCmd->add_option("--asr-replay-ms", m_asrReplayMs, "Audio sent again after reconnecting to the transcription service")
+            ->check(CLI::Range(0, 5000))->capture_default_str();
+    m_rawRecordAudioCmd->add_option("--asr-max-speakers", m_asrMaxSpeakers, "Speakers transcribed at once with --transcribe and --separate-participants")
+            ->check(CLI::Range(1, 32))->capture_default_str();
+    m_rawRecordAudioCmd->add_flag("--multichannel", m_multichannel, "Record each participant on their own channel of one aligned WAV instead of separate files");
+    m_rawRecordAudioCmd->add_option("--max-channels", m_maxChannels, "Channels of the --multichannel WAV")
+            ->check(CLI::Range(1, 64))->capture_default_str();
+    m_rawRecordAudioCmd->add_option("--channel-overflow", m_channelOverflow, "Participants beyond --max-channels are mixed into the last channel or dropped")
+            ->check(CLI::IsMember({"mix", "drop"}))->capture_default_str();
 
     m_rawRecordVideoCmd->add_option("-f, --file", m_videoFile, "Output YUV video file")->required();
     m_rawRecordVideoCmd->add_option("-d, --dir", m_videoDir, "Video Output Directory");
+    m_rawRecordVideoCmd->add_flag("--direct-io", m_directIO, "Write raw video with O_DIRECT, bypassing the page cache");
+    m_rawRecordVideoCmd->add_option("--resolution", m_videoResolution, "Subscribed video resolution, the ceiling with --adaptive")
+            ->check(CLI::IsMember({"360", "720", "1080"}))->capture_default_str();
+    m_rawRecordVideoCmd->add_flag("--adaptive", m_adaptiveVideo, "Lower the resolution and frame rate while the disk falls behind");
+    m_rawRecordVideoCmd->add_flag("--follow-speaker", m_followSpeaker, "Record whoever is talking instead of the first participant");
+    m_rawRecordVideoCmd->add_option("--follow-debounce-ms", m_followDebounceMs, "How long someone talks before the video follows them")
+            ->check(CLI::Range(200, 10000))->capture_default_str();
 
     m_app.add_option("--deepgram-api-key", m_deepgramApiKey, "Deepgram API Key for transcription");
+
+    m_app.add_option("--send-video", m_sendVideo, "Send video into the meeting from pattern, file:PATH (raw I420) or shm:NAME");
+
+    m_app.add_option("--send-audio", m_sendAudio, "Speak into the meeting from file:PATH or unix:PATH (16-bit mono PCM)");
+    m_app.add_option("--send-audio-rate", m_sendAudioRate, "Sample rate of the --send-audio input")
+            ->check(CLI::Range(8000, 48000))->capture_default_str();
+    m_app.add_option("--send-audio-conceal", m_sendAudioConceal, "Fill gaps in the --send-audio input with silence or a fading repeat")
+            ->check(CLI::IsMember({"silence", "repeat"}))->capture_default_str();
+
+    m_app.add_option("--metrics-port", m_metricsPort, "Serve Prometheus metrics on 127.0.0.1:<port> (0 disables)")->capture_default_str();
+
+    m_app.add_option("--log-level", m_logLevel, "Minimum log level: debug, info, success, warn or error")->capture_default_str();
+    m_app.add_flag("--log-json", m_logJson, "Write log lines as JSON objects");
+
+    m_app.add_flag("--trace", m_trace, "Start with per-frame tracing enabled (SIGUSR1 toggles it at runtime)");
+    m_app.add_option("--trace-sample", m_traceSample, "Trace one in every N callbacks")->capture_default_str();
+    m_app.add_option("--trace-dir", m_traceDir, "Directory for exported Chrome trace files")->capture_default_str();
+
+    m_app.add_option("--capture-callbacks", m_captureFile, "Record raw data callbacks to a file for media_bench --replay");
+    m_app.add_flag("--capture-payloads", m_capturePayloads, "Store callback payloads in the capture instead of hashes");
+
+    m_app.add_option("--sync-interval-ms", m_syncIntervalMs, "Sync recordings to disk and checkpoint the journal every N ms (0 disables the journal)")->capture_default_str();
+    m_app.add_option("--journal-dir", m_journalDir, "Directory for recording session journals")->capture_default_str();
+
+    m_app.add_flag("--finalize", m_finalize, "Convert, compress, mux and checksum the session's recordings before exiting; the bot exits when the meeting ends");
+    m_app.add_option("--finalize-jobs", m_finalizeJobs, "Finalize jobs run at once (0 uses every core)")
+            ->check(CLI::Range(0, 256))->capture_default_str();
+    m_app.add_option("--finalize-timeout", m_finalizeTimeoutS, "Seconds finalizing may take before the bot exits regardless")
+            ->check(CLI::Range(1, 86400))->capture_default_str();
+
+    m_app.add_option("--prealloc-seconds", m_preallocSeconds, "Reserve disk space for this many seconds of each output at a time (0 disables)")->capture_default_str();
+    m_app.add_flag("--drop-behind", m_dropBehind, "Write recordings back early and drop them from the page cache");
+
+    m_app.add_option("--memory-budget-mb", m_memoryBudgetMb, "Memory for buffered media; near it analysis is dropped, then video is decimated, never audio (0 is unlimited)")->capture_default_str();
+
+    m_app.add_option("--cpus-main", m_cpusMain, "CPUs for the main thread, e.g. 0-3,6; SDK threads inherit them");
+    m_app.add_option("--cpus-socket", m_cpusSocket, "CPUs for the socket and metrics server threads");
+    m_app.add_option("--cpus-writer", m_cpusWriter, "CPUs for the log and journal writer threads");
+    m_app.add_option("--cpus-analysis", m_cpusAnalysis, "CPUs for analysis threads");
+    m_app.add_option("--background-nice", m_backgroundNice, "Nice value for writer and analysis threads")->capture_default_str();
+    m_app.add_flag("--background-batch", m_backgroundBatch, "Run writer and analysis threads with SCHED_BATCH");
 }
 
 int Config::read(int ac, char **av) {
@@ -53,7 +117,7 @@ bool Config::parseUrl(const string& join_url) {
     auto url = ada::parse<ada::url>(join_url);
 
     if (!url) {
-        cerr << "unable to parse join URL" << endl;
+        Log::error("unable to parse join URL");
         return false;
     }
 
@@ -103,7 +167,7 @@ const string &Config::zak() const
 }
 
 bool Config::useRawAudio() const {
-    return !m_audioFile.empty() || m_separateParticipantAudio || m_transcribe;
+    return !m_audioFile.empty() || m_separateParticipantAudio || m_transcribe || m_multichannel;
 }
 
 bool Config::useRawVideo() const {
@@ -132,7 +196,161 @@ const string& Config::videoFile() const {
 }
 
 bool Config::separateParticipantAudio() const {
-    return m_separateParticipantAudio;
+    return m_separateParticipantAudio || m_multichannel;
+}
+
+unsigned int Config::preRollSeconds() const {
+    return m_preRollSeconds;
+}
+
+const string& Config::asrUrl() const {
+    return m_asrUrl;
+}
+
+unsigned int Config::asrChunkMs() const {
+    return m_asrChunkMs;
+}
+
+unsigned int Config::asrQueueMs() const {
+    return m_asrQueueMs;
+}
+
+unsigned int Config::asrReplayMs() const {
+    return m_asrReplayMs;
+}
+
+unsigned int Config::asrMaxSpeakers() const {
+    return m_asrMaxSpeakers;
+}
+
+bool Config::multichannel() const {
+    return m_multichannel;
+}
+
+unsigned int Config::maxChannels() const {
+    return m_maxChannels;
+}
+
+const string& Config::channelOverflow() const {
+    return m_channelOverflow;
+}
+
+const string& Config::sendVideo() const {
+    return m_sendVideo;
+}
+
+const string& Config::sendAudio() const {
+    return m_sendAudio;
+}
+
+unsigned int Config::sendAudioRate() const {
+    return m_sendAudioRate;
+}
+
+const string& Config::sendAudioConceal() const {
+    return m_sendAudioConceal;
+}
+
+const string& Config::videoResolution() const {
+    return m_videoResolution;
+}
+
+bool Config::adaptiveVideo() const {
+    return m_adaptiveVideo;
+}
+
+bool Config::followSpeaker() const {
+    return m_followSpeaker;
+}
+
+unsigned int Config::followDebounceMs() const {
+    return m_followDebounceMs;
+}
+
+int Config::metricsPort() const {
+    return m_metricsPort;
+}
+
+const string& Config::logLevel() const {
+    return m_logLevel;
+}
+
+bool Config::logJson() const {
+    return m_logJson;
+}
+
+bool Config::trace() const {
+    return m_trace;
+}
+
+unsigned int Config::traceSample() const {
+    return m_traceSample;
+}
+
+const string& Config::traceDir() const {
+    return m_traceDir;
+}
+
+const string& Config::captureFile() const {
+    return m_captureFile;
+}
+
+bool Config::capturePayloads() const {
+    return m_capturePayloads;
+}
+
+unsigned int Config::syncIntervalMs() const {
+    return m_syncIntervalMs;
+}
+
+const string& Config::journalDir() const {
+    return m_journalDir;
+}
+
+bool Config::finalize() const {
+    return m_finalize;
+}
+
+unsigned int Config::finalizeJobs() const {
+    return m_finalizeJobs;
+}
+
+unsigned int Config::finalizeTimeoutS() const {
+    return m_finalizeTimeoutS;
+}
+
+unsigned int Config::preallocSeconds() const {
+    return m_preallocSeconds;
+}
+
+bool Config::dropBehind() const {
+    return m_dropBehind;
+}
+
+bool Config::directIO() const {
+    return m_directIO;
+}
+
+unsigned int Config::memoryBudgetMb() const {
+    return m_memoryBudgetMb;
+}
+
+ThreadPolicy Config::threadPolicy(ThreadClass threadClass) const {
+    ThreadPolicy policy;
+
+    switch (threadClass) {
+        case ThreadClass::Main: policy.cpus = m_cpusMain; break;
+        case ThreadClass::Socket: policy.cpus = m_cpusSocket; break;
+        case ThreadClass::Writer: policy.cpus = m_cpusWriter; break;
+        case ThreadClass::Analysis: policy.cpus = m_cpusAnalysis; break;
+    }
+
+    if (threadClass == ThreadClass::Writer || threadClass == ThreadClass::Analysis) {
+        policy.nice = m_backgroundNice;
+        policy.batch = m_backgroundBatch;
+    }
+
+    return policy;
 }
 
 bool Config::isMeetingStart() const {
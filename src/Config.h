@@ -14,6 +14,8 @@
 
 #include <CLI/CLI.hpp>
 
+#include "util/Threads.h"
+
 using namespace std;
 using namespace ada;
 
@@ -29,10 +31,23 @@ class Config {
     string m_audioFile;
     bool m_separateParticipantAudio;
     bool m_transcribe;
+    unsigned int m_preRollSeconds = 30;
+    string m_asrUrl = "wss://api.deepgram.com/v1/listen?punctuate=true";
+    unsigned int m_asrChunkMs = 100;
+    unsigned int m_asrQueueMs = 10000;
+    unsigned int m_asrReplayMs = 300;
+    unsigned int m_asrMaxSpeakers = 4;
+    bool m_multichannel = false;
+    unsigned int m_maxChannels = 8;
+    string m_channelOverflow = "mix";
 
     CLI::App* m_rawRecordVideoCmd;
     string m_videoDir="out";
     string m_videoFile;
+    string m_videoResolution = "720";
+    bool m_adaptiveVideo = false;
+    bool m_followSpeaker = false;
+    unsigned int m_followDebounceMs = 1500;
 
     string m_joinUrl;
     string m_meetingId;
@@ -51,6 +66,44 @@ class Config {
 
     string m_deepgramApiKey;
 
+    string m_sendVideo;
+
+    string m_sendAudio;
+    unsigned int m_sendAudioRate = 16000;
+    string m_sendAudioConceal = "repeat";
+
+    int m_metricsPort = 0;
+
+    string m_logLevel = "info";
+    bool m_logJson = false;
+
+    bool m_trace = false;
+    unsigned int m_traceSample = 1;
+    string m_traceDir = "out";
+
+    string m_captureFile;
+    bool m_capturePayloads = false;
+
+    unsigned int m_syncIntervalMs = 1000;
+    string m_journalDir = "out";
+
+    bool m_finalize = false;
+    unsigned int m_finalizeJobs = 0;
+    unsigned int m_finalizeTimeoutS = 600;
+
+    unsigned int m_preallocSeconds = 60;
+    bool m_dropBehind = false;
+    bool m_directIO = false;
+
+    unsigned int m_memoryBudgetMb = 0;
+
+    string m_cpusMain;
+    string m_cpusSocket;
+    string m_cpusWriter;
+    string m_cpusAnalysis;
+    int m_backgroundNice = 0;
+    bool m_backgroundBatch = false;
+
 public:
     Config();
 
@@ -87,9 +140,61 @@ public:
     const string& videoDir() const;
 
     bool separateParticipantAudio() const;
+    unsigned int preRollSeconds() const;
+
+    const string& asrUrl() const;
+    unsigned int asrChunkMs() const;
+    unsigned int asrQueueMs() const;
+    unsigned int asrReplayMs() const;
+    unsigned int asrMaxSpeakers() const;
+    bool multichannel() const;
+    unsigned int maxChannels() const;
+    const string& channelOverflow() const;
+
+    const string& videoResolution() const;
+    bool adaptiveVideo() const;
+    bool followSpeaker() const;
+    unsigned int followDebounceMs() const;
+
+    int metricsPort() const;
+
+    const string& logLevel() const;
+    bool logJson() const;
+
+    bool trace() const;
+    unsigned int traceSample() const;
+    const string& traceDir() const;
+
+    const string& captureFile() const;
+    bool capturePayloads() const;
+
+    unsigned int syncIntervalMs() const;
+    const string& journalDir() const;
+
+    bool finalize() const;
+    unsigned int finalizeJobs() const;
+    unsigned int finalizeTimeoutS() const;
+
+    unsigned int preallocSeconds() const;
+    bool dropBehind() const;
+    bool directIO() const;
+
+    unsigned int memoryBudgetMb() const;
+
+    /**
+     * Placement of a class of threads; writer and analysis threads are
+     * background work and also get the nice and SCHED_BATCH settings
+     */
+    ThreadPolicy threadPolicy(ThreadClass threadClass) const;
 
     const string& deepgramApiKey() const { return m_deepgramApiKey; }
 
+    const string& sendVideo() const;
+
+    const string& sendAudio() const;
+    unsigned int sendAudioRate() const;
+    const string& sendAudioConceal() const;
+
     void setAudioFileOverride(const string& filename) { m_audioFile = filename; }
     void setForceRawRecording(bool enable) { m_forceRawRecording = enable; }
     bool forceRawRecording() const { return m_forceRawRecording; }
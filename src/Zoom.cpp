@@ -3,6 +3,8 @@
 #include "rawdata/rawdata_audio_helper_interface.h"
 #include "rawdata/rawdata_renderer_interface.h"
 #include "rawdata/rawdata_video_source_helper_interface.h"
+#include "raw_record/Finalizer.h"
+#include "raw_record/RecordingJournal.h"
 
 using namespace ZOOMSDK;
 
@@ -14,6 +16,15 @@ SDKError Zoom::config(int ac, char** av) {
         return SDKERR_INTERNAL_ERROR;
     }
 
+    auto& logger = Logger::getInstance();
+    logger.setJson(m_config.logJson());
+
+    LogLevel level;
+    if (Logger::parseLevel(m_config.logLevel(), level))
+        logger.setLevel(level);
+    else
+        Log::error("unknown log level " + m_config.logLevel());
+
     return SDKERR_SUCCESS;
 }
 
@@ -67,6 +78,9 @@ SDKError Zoom::createServices() {
 
     auto meetingServiceEvent = new MeetingServiceEvent();
     meetingServiceEvent->setOnMeetingJoin(onJoin);
+    meetingServiceEvent->setOnMeetingEnd([this]() {
+        m_meetingEnded = true;
+    });
 
     err = m_meetingService->SetEvent(meetingServiceEvent);
     if (hasError(err)) {
@@ -178,6 +192,39 @@ SDKError Zoom::join() {
         param.app_privilege_token = m_config.joinToken().c_str();
     }
 
+    // the SDK only takes an external camera before joining
+    if (!m_config.sendVideo().empty()) {
+        auto source = FrameSource::create(m_config.sendVideo());
+        auto* videoSourceHelper = GetRawdataVideoSourceHelper();
+
+        if (source && videoSourceHelper) {
+            if (!m_videoSource)
+                m_videoSource = new ZoomSDKVideoSource();
+            m_videoSource->setSource(move(source));
+
+            err = videoSourceHelper->setExternalVideoSource(m_videoSource);
+            hasError(err, "set external video source");
+        }
+    }
+
+    // and the virtual microphone likewise
+    if (!m_config.sendAudio().empty()) {
+        auto input = PcmInput::create(m_config.sendAudio(), m_config.sendAudioRate());
+        auto* audioHelper = GetAudioRawdataHelper();
+
+        if (input && audioHelper) {
+            if (!m_virtualMic)
+                m_virtualMic = new ZoomSDKVirtualAudioMic();
+            m_virtualMic->setInput(move(input));
+            m_virtualMic->setConcealment(m_config.sendAudioConceal() == "silence"
+                                         ? JitterBuffer::Concealment::Silence
+                                         : JitterBuffer::Concealment::Repeat);
+
+            err = audioHelper->setExternalAudioSource(m_virtualMic);
+            hasError(err, "set external audio source");
+        }
+    }
+
     // Configure audio settings
     auto* audioSettings = m_settingService->GetAudioSettings();
     if (audioSettings) {
@@ -228,6 +275,7 @@ SDKError Zoom::clean() {
         Log::info("Stopping PulseAudio recording process (" + to_string(m_recordingPid) + ")");
         kill(m_recordingPid, SIGTERM);
         m_recordingPid = 0;
+        m_recordingTiming.close();
     }
 
     if (m_meetingService) {
@@ -250,7 +298,22 @@ SDKError Zoom::clean() {
         m_videoHelper->unSubscribe();
     }
 
+    // its renderers write into the render delegate, and read the audio levels
+    m_follower.reset();
+    if (m_audioSource)
+        m_audioSource->setActiveSpeaker(nullptr);
+    m_activeSpeaker.reset();
+
+    // flushes and closes the output files
     delete m_renderDelegate;
+    delete m_audioSource;
+    delete m_videoSource;
+    delete m_virtualMic;
+    m_renderDelegate = nullptr;
+    m_audioSource = nullptr;
+    m_videoSource = nullptr;
+    m_virtualMic = nullptr;
+
     return CleanUPSDK();
 }
 
@@ -271,10 +334,33 @@ bool Zoom::tryAudioSubscription(bool mixedAudio) {
         return false;
     }
 
-    auto transcribe = m_config.transcribe();
-    m_audioSource = new ZoomSDKAudioRawDataDelegate(mixedAudio, transcribe);
-    m_audioSource->setDir(m_config.audioDir());
-    m_audioSource->setFilename(m_config.audioFile());
+    if (!m_audioSource) {
+        auto transcribe = m_config.transcribe();
+        m_audioSource = new ZoomSDKAudioRawDataDelegate(mixedAudio, transcribe);
+        m_audioSource->setDir(m_config.audioDir());
+        m_audioSource->setFilename(m_config.audioFile());
+        m_audioSource->setPreRollSeconds(m_config.preRollSeconds());
+
+        if (m_config.multichannel()) {
+            auto overflow = m_config.channelOverflow() == "drop" ? MultichannelRecorder::Overflow::Drop
+                                                                  : MultichannelRecorder::Overflow::Mix;
+            auto nameOf = [](uint32_t nodeId) { return Roster::getInstance().name(nodeId); };
+            m_audioSource->setMultichannel(m_config.maxChannels(), overflow, nameOf);
+        }
+
+        if (transcribe && !m_config.deepgramApiKey().empty()) {
+            StreamingTranscriber::Options options;
+            options.url = m_config.asrUrl();
+            options.apiKey = m_config.deepgramApiKey();
+            options.chunkMs = m_config.asrChunkMs();
+            options.queueMs = m_config.asrQueueMs();
+            options.replayMs = m_config.asrReplayMs();
+
+            // resolved once per speaker, from the audio thread
+            auto nameOf = [](uint32_t nodeId) { return Roster::getInstance().name(nodeId); };
+            m_audioSource->setTranscriber(move(options), m_config.asrMaxSpeakers(), nameOf);
+        }
+    }
 
     Log::info(string("Attempting audio subscription with mixedAudio=") + (mixedAudio ? "true" : "false"));
 
@@ -307,11 +393,14 @@ bool Zoom::startPulseAudioRecording() {
     Log::info("Starting PulseAudio recording to " + outputFile);
     
     // Fork a process to run parecord in the background
+    m_recordingTiming.open(outputFile, "parecord s16le 44100 2", 0);
+    auto forkedNs = MetricsClock::nowNs();
     pid_t pid = fork();
     
     if (pid == -1) {
         // Fork failed
         Log::error("Failed to fork process for PulseAudio recording");
+        m_recordingTiming.close();
         return false;
     } else if (pid == 0) {
         // Child process
@@ -327,6 +416,7 @@ bool Zoom::startPulseAudioRecording() {
     } else {
         // Parent process
         m_recordingPid = pid;
+        m_recordingTiming.stamp(forkedNs, 0, 0);
         Log::info("PulseAudio recording started with PID: " + to_string(m_recordingPid));
         
         // Wait a moment to make sure recording started
@@ -340,6 +430,7 @@ bool Zoom::startPulseAudioRecording() {
         } else {
             Log::error("Failed to start PulseAudio recording - process died immediately");
             m_recordingPid = 0;
+            m_recordingTiming.close();
             return false;
         }
     }
@@ -375,37 +466,51 @@ SDKError Zoom::startRawRecording() {
         Log::success("Raw recording started successfully");
     }
     
+    // Audio may already be flowing into the pre-roll since the join
+    if (m_config.useRawAudio()) {
+        if (!m_audioSubscribed)
+            m_audioSubscribed = tryAudioSubscription(!m_config.separateParticipantAudio());
+
+        if (m_audioSource)
+            m_audioSource->setRecordingStarted(true);
+    }
+
     // Set up video if configured
     bool videoConfigurationSuccessful = false;
     
     if (m_config.useRawVideo()) {
         Log::info("Setting up video recording");
-        if (!m_renderDelegate) {
+        if (!m_renderDelegate)
             m_renderDelegate = new ZoomSDKRendererDelegate();
-            m_videoSource = new ZoomSDKVideoSource();
-        }
 
-        err = createRenderer(&m_videoHelper, m_renderDelegate);
-        if (!hasError(err, "create raw video renderer")) {
-            m_renderDelegate->setDir(m_config.videoDir());
-            m_renderDelegate->setFilename(m_config.videoFile());
+        m_renderDelegate->setOutput(m_config.videoDir(), m_config.videoFile(), m_config.directIO());
+
+        auto resolution = ZoomSDKResolution_720P;
+        VideoQualityController::parseResolution(m_config.videoResolution(), resolution);
+        if (m_config.adaptiveVideo())
+            m_videoQuality = make_unique<VideoQualityController>(resolution);
+
+        if (m_config.followSpeaker()) {
+            videoConfigurationSuccessful = startFollowing(resolution);
+        } else if (!hasError(createRenderer(&m_videoHelper, m_renderDelegate), "create raw video renderer")) {
             videoConfigurationSuccessful = true;
 
-            auto participantCtl = m_meetingService->GetMeetingParticipantsController();
-            // Try to subscribe to video for active participants
-            if (participantCtl && participantCtl->GetParticipantsList()) {
-                unsigned int count = participantCtl->GetParticipantsList()->GetCount();
-                Log::info("Number of participants: " + to_string(count));
-
-                if (count > 0) {
-                    auto uid = participantCtl->GetParticipantsList()->GetItem(0);
-                    m_videoHelper->setRawDataResolution(ZoomSDKResolution_720P);
-                    m_videoHelper->subscribe(uid, RAW_DATA_TYPE_VIDEO);
-                }
+            // the first participant other than the bot
+            auto uid = Roster::getInstance().firstOther();
+            if (uid) {
+                m_videoHelper->setRawDataResolution(resolution);
+                m_videoHelper->subscribe(uid, RAW_DATA_TYPE_VIDEO);
+            } else {
+                Log::info("Nobody else in the meeting yet, raw video is not subscribed");
             }
         }
     }
     
+    // who was in the meeting while this recording was made
+    auto& metadataDir = m_config.useRawAudio() ? m_config.audioDir() : m_config.videoDir();
+    if (!metadataDir.empty() && Roster::getInstance().setOutput(metadataDir + "/roster.jsonl"))
+        publishRoster();
+
     Log::info("--- startRawRecording method completed ---");
     return SDKERR_SUCCESS;
 }
@@ -421,6 +526,7 @@ SDKError Zoom::stopRawRecording() {
         Log::info("Stopping PulseAudio recording process (" + to_string(m_recordingPid) + ")");
         kill(m_recordingPid, SIGTERM);
         m_recordingPid = 0;
+        m_recordingTiming.close();
     }
     
     auto recCtrl = m_meetingService->GetMeetingRecordingController();
@@ -430,6 +536,244 @@ SDKError Zoom::stopRawRecording() {
     return err;
 }
 
+void Zoom::finalize() {
+    if (!m_config.finalize())
+        return;
+
+    auto& journalPath = RecordingJournal::getInstance().path();
+    if (journalPath.empty()) {
+        Log::warn("nothing to finalize, the session journal is disabled (--sync-interval-ms 0)");
+        return;
+    }
+
+    Finalizer finalizer(m_config.finalizeJobs(), m_config.finalizeTimeoutS() * 1000ull);
+    finalizer.run(journalPath);
+}
+
+void Zoom::requestPreRollExport() {
+    m_preRollExportRequested = true;
+}
+
+void Zoom::handlePreRollExport() {
+    if (!m_preRollExportRequested.exchange(false))
+        return;
+
+    if (!m_audioSource) {
+        Log::warn("No raw audio subscription, nothing to export");
+        return;
+    }
+
+    m_audioSource->exportPreRoll(m_config.preRollSeconds());
+}
+
+void Zoom::adaptVideo() {
+    if (!m_videoQuality || !m_renderDelegate || (!m_videoHelper && !m_follower))
+        return;
+
+    auto& writer = m_renderDelegate->writer();
+    if (!m_videoQuality->update(writer.queued(), VideoWriter::c_queueDepth, writer.busyNs(), MetricsClock::nowNs()))
+        return;
+
+    // the writer notes the new format in the sidecar when its first frame arrives
+    auto& step = m_videoQuality->step();
+    writer.setDecimation(step.decimation);
+    if (m_follower)
+        m_follower->setResolution(step.resolution);
+    else
+        hasError(m_videoHelper->setRawDataResolution(step.resolution), "change raw video resolution");
+}
+
+bool Zoom::startFollowing(ZoomSDKResolution resolution) {
+    if (m_follower)
+        return true;
+
+    // the speaker is picked from each participant's own audio
+    if (!m_audioSubscribed)
+        m_audioSubscribed = tryAudioSubscription(!m_config.separateParticipantAudio());
+
+    if (!m_audioSource) {
+        Log::error("Following the active speaker needs raw audio");
+        return false;
+    }
+
+    m_activeSpeaker = make_unique<ActiveSpeaker>(m_config.followDebounceMs());
+    auto* participants = m_meetingService->GetMeetingParticipantsController();
+    auto* self = participants ? participants->GetMySelfUser() : nullptr;
+    if (self)
+        m_activeSpeaker->ignore(self->GetUserID());
+
+    m_follower = make_unique<SpeakerFollower>(*m_renderDelegate, *m_activeSpeaker, resolution);
+    if (!m_follower->start(Roster::getInstance().firstOther(), m_config.videoDir() + "/" + m_config.videoFile() + ".switches.jsonl")) {
+        m_follower.reset();
+        m_activeSpeaker.reset();
+        return false;
+    }
+
+    m_audioSource->setActiveSpeaker(m_activeSpeaker.get());
+    return true;
+}
+
+void Zoom::followSpeaker() {
+    if (m_follower)
+        m_follower->update(MetricsClock::nowNs());
+}
+
+void Zoom::refreshRoster(const vector<unsigned int>& userIds) {
+    auto* participants = m_meetingService ? m_meetingService->GetMeetingParticipantsController() : nullptr;
+    if (!participants)
+        return;
+
+    auto& roster = Roster::getInstance();
+    auto read = [&](unsigned int userId) {
+        auto* user = participants->GetUserByUserID(userId);
+        if (!user) {
+            roster.remove(userId);
+            return;
+        }
+
+        auto* name = user->GetUserName();
+        roster.update(userId, name ? name : "", user->IsHost(), user->IsMySelf());
+    };
+
+    if (!userIds.empty()) {
+        for (auto userId : userIds)
+            read(userId);
+        return;
+    }
+
+    // everyone, and nobody who is no longer listed
+    auto* list = participants->GetParticipantsList();
+    vector<unsigned int> present;
+    for (int i = 0; list && i < list->GetCount(); i++) {
+        present.push_back(list->GetItem(i));
+        read(present.back());
+    }
+
+    for (auto& participant : roster.snapshot()) {
+        if (find(present.begin(), present.end(), participant.userId) == present.end())
+            roster.remove(participant.userId);
+    }
+}
+
+void Zoom::publishRoster() {
+    auto json = Roster::getInstance().publish();
+    if (!json.empty() && m_audioSource)
+        m_audioSource->writeEvent(json + "\n");
+}
+
+void Zoom::registerCommands() {
+    auto& control = ControlChannel::getInstance();
+
+    auto inMeeting = [this](string& result) {
+        if (m_meetingService && m_meetingService->GetMeetingStatus() == MEETING_STATUS_INMEETING)
+            return true;
+        result = "not in a meeting";
+        return false;
+    };
+
+    auto succeeded = [](SDKError err, const string& done, string& result) {
+        result = err == SDKERR_SUCCESS ? done : "SDK error " + to_string(err);
+        return err == SDKERR_SUCCESS;
+    };
+
+    control.on("start-recording", [=, this](const JsonValue&, string& result) {
+        return inMeeting(result) && succeeded(startRawRecording(), "recording started", result);
+    });
+
+    control.on("stop-recording", [=, this](const JsonValue&, string& result) {
+        return inMeeting(result) && succeeded(stopRawRecording(), "recording stopped", result);
+    });
+
+    // raw video follows one participant at a time
+    control.on("subscribe", [=, this](const JsonValue& request, string& result) {
+        auto& userId = request["user_id"];
+        if (userId.type() != JsonValue::Type::Number) {
+            result = "user_id is required";
+            return false;
+        }
+
+        // a manual pick holds until someone else clearly takes the floor
+        if (m_follower) {
+            auto uid = static_cast<uint32_t>(userId.asNumber());
+            if (!m_follower->switchTo(uid, MetricsClock::nowNs())) {
+                result = "already showing " + to_string(uid) + " or switching";
+                return false;
+            }
+
+            m_activeSpeaker->setCurrent(uid, MetricsClock::nowNs());
+            result = "switching to " + to_string(uid);
+            return true;
+        }
+
+        if (!m_videoHelper) {
+            result = "raw video is not being recorded";
+            return false;
+        }
+
+        auto err = m_videoHelper->subscribe(static_cast<uint32_t>(userId.asNumber()), RAW_DATA_TYPE_VIDEO);
+        return succeeded(err, "subscribed to " + to_string(static_cast<uint32_t>(userId.asNumber())), result);
+    });
+
+    control.on("unsubscribe", [=, this](const JsonValue&, string& result) {
+        if (m_follower) {
+            result = "following the active speaker";
+            return false;
+        }
+
+        if (!m_videoHelper) {
+            result = "raw video is not being recorded";
+            return false;
+        }
+
+        return succeeded(m_videoHelper->unSubscribe(), "unsubscribed", result);
+    });
+
+    control.on("rotate", [this](const JsonValue&, string& result) {
+        if (!m_audioSource && !m_renderDelegate) {
+            result = "nothing is being recorded";
+            return false;
+        }
+
+        unsigned int segment = 0;
+        if (m_audioSource)
+            segment = max(segment, m_audioSource->rotate());
+        if (m_renderDelegate)
+            segment = max(segment, m_renderDelegate->rotate());
+
+        result = "segment " + to_string(segment);
+        return true;
+    });
+
+    control.on("flush", [this](const JsonValue&, string& result) {
+        if (!m_audioSource && !m_renderDelegate) {
+            result = "nothing is being recorded";
+            return false;
+        }
+
+        if (m_audioSource)
+            m_audioSource->flush();
+        if (m_renderDelegate)
+            m_renderDelegate->flush();
+
+        result = "flush requested";
+        return true;
+    });
+
+    control.on("stats", [](const JsonValue&, string& result) {
+        result = MetricsRegistry::getInstance().render();
+        return true;
+    });
+
+    control.on("roster", [](const JsonValue&, string& result) {
+        result = Roster::getInstance().toJson();
+        return true;
+    });
+
+    control.on("leave", [=, this](const JsonValue&, string& result) {
+        return inMeeting(result) && succeeded(leave(), "leaving", result);
+    });
+}
+
 bool Zoom::isMeetingStart() {
     return m_config.isMeetingStart();
 }
@@ -459,6 +803,23 @@ void Zoom::handleOnJoin() {
     auto *reminderController = m_meetingService->GetMeetingReminderController();
     reminderController->SetEvent(new MeetingReminderEvent());
 
+    // the roster follows participant events from here on, starting with who is already here
+    auto* participantsController = m_meetingService->GetMeetingParticipantsController();
+    if (participantsController) {
+        participantsController->SetEvent(new MeetingParticipantsCtrlEvent(
+                [this](const vector<unsigned int>& userIds) {
+                    refreshRoster(userIds);
+                    publishRoster();
+                },
+                [this](const vector<unsigned int>& userIds) {
+                    for (auto userId : userIds)
+                        Roster::getInstance().remove(userId);
+                    publishRoster();
+                }));
+        refreshRoster({});
+        Log::info("Roster has " + to_string(Roster::getInstance().snapshot().size()) + " participant(s)");
+    }
+
     // Make sure audio is unmuted and connected after a delay
     auto *audioController = m_meetingService->GetMeetingAudioController();
     if (audioController)
@@ -474,6 +835,13 @@ void Zoom::handleOnJoin() {
         Log::info("Unmuted audio after joining");
     }
 
+    // Subscribe to raw audio before the recording privilege arrives so the
+    // start of the meeting is held in the pre-roll; this fails harmlessly
+    // when the SDK only allows it once recording has started
+    if (m_config.useRawAudio()) {
+        m_audioSubscribed = tryAudioSubscription(!m_config.separateParticipantAudio());
+    }
+
     // Setup recording controller events
     Log::info("Setting up recording controller...");
     auto recordingCtrl = m_meetingService->GetMeetingRecordingController();
@@ -1,9 +1,13 @@
 #ifndef MEETING_SDK_LINUX_SAMPLE_ZOOM_H
 #define MEETING_SDK_LINUX_SAMPLE_ZOOM_H
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <functional>
+#include <vector>
 #include <chrono>
 #include <cstdlib>
 #include <unistd.h>
@@ -23,16 +27,24 @@
 
 #include "zoom_sdk_platform.h"
 
+#include "util/ControlChannel.h"
 #include "util/Log.h"
+#include "util/Roster.h"
 #include "Config.h"
 #include "events/AuthServiceEvent.h"
 #include "events/MeetingServiceEvent.h"
 #include "events/MeetingRecordingCtrlEvent.h"
+#include "events/MeetingParticipantsCtrlEvent.h"
 #include "events/MeetingReminderEvent.h"
 
+#include "raw_record/ActiveSpeaker.h"
+#include "raw_record/SpeakerFollower.h"
+#include "raw_record/StreamTiming.h"
 #include "raw_record/ZoomSDKAudioRawDataDelegate.h"
+#include "raw_record/VideoQualityController.h"
 #include "raw_record/ZoomSDKRendererDelegate.h"
 #include "raw_send/ZoomSDKVideoSource.h"
+#include "raw_send/ZoomSDKVirtualAudioMic.h"
 
 using namespace std;
 using namespace ZOOM_SDK_NAMESPACE;
@@ -58,20 +70,52 @@ class Zoom : public Singleton<Zoom>
 
     IZoomSDKRenderer *m_videoHelper;
     ZoomSDKRendererDelegate *m_renderDelegate;
+    unique_ptr<VideoQualityController> m_videoQuality;
+
+    // with --follow-speaker, in place of m_videoHelper
+    unique_ptr<ActiveSpeaker> m_activeSpeaker;
+    unique_ptr<SpeakerFollower> m_follower;
 
     IZoomSDKAudioRawDataHelper *m_audioHelper;
     ZoomSDKAudioRawDataDelegate *m_audioSource;
+    bool m_audioSubscribed = false;
+
+    // set from a signal handler, handled on the main loop
+    atomic<bool> m_preRollExportRequested = false;
+
+    // set from the SDK when the meeting ends
+    atomic<bool> m_meetingEnded = false;
 
     ZoomSDKVideoSource *m_videoSource;
+    ZoomSDKVirtualAudioMic *m_virtualMic = nullptr;
 
     pid_t m_recordingPid = 0;
 
+    // when parecord started, the only anchor its file gets
+    StreamTiming m_recordingTiming{"pulseaudio"};
+
     SDKError createServices();
     void generateJWT(const string &key, const string &secret);
 
     // Helper method to try audio subscription with different settings
     bool tryAudioSubscription(bool mixedAudio);
 
+    /**
+     * Record the active speaker's video, subscribing to audio to pick them
+     */
+    bool startFollowing(ZoomSDKResolution resolution);
+
+    /**
+     * Read participants' details from the SDK into the roster
+     * @param userIds participants to read, everyone in the meeting if empty
+     */
+    void refreshRoster(const vector<unsigned int>& userIds);
+
+    /**
+     * Record the roster and send it on the socket if it changed
+     */
+    void publishRoster();
+
     /**
      * Starts PulseAudio recording for external audio capture
      * @return true if recording started successfully
@@ -127,6 +171,42 @@ public:
     SDKError startRawRecording();
     SDKError stopRawRecording();
 
+    /**
+     * Ask for the audio pre-roll to be exported, safe in a signal handler
+     */
+    void requestPreRollExport();
+
+    /**
+     * Export the last seconds of audio if requested, from the main loop
+     */
+    void handlePreRollExport();
+
+    /**
+     * Adapt the video resolution and frame rate to the writer, from the main loop
+     */
+    void adaptVideo();
+
+    /**
+     * Move the raw video to whoever is talking, from the main loop
+     */
+    void followSpeaker();
+
+    /**
+     * Whether the main loop should stop now, with --finalize once the meeting ended
+     */
+    bool shouldExit() const { return m_meetingEnded && m_config.finalize(); }
+
+    /**
+     * Turn this session's raw outputs into finished files, with --finalize;
+     * blocks until done or --finalize-timeout, once the outputs are closed
+     */
+    void finalize();
+
+    /**
+     * Register the commands clients can send on the meeting socket
+     */
+    void registerCommands();
+
     bool isMeetingStart();
 
     static bool hasError(SDKError e, const string &action = "");
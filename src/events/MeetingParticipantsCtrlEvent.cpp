@@ -0,0 +1,34 @@
+#include "MeetingParticipantsCtrlEvent.h"
+
+vector<unsigned int> MeetingParticipantsCtrlEvent::toVector(IList<unsigned int>* list) {
+    vector<unsigned int> ids;
+    if (!list)
+        return ids;
+
+    for (int i = 0; i < list->GetCount(); i++)
+        ids.push_back(list->GetItem(i));
+    return ids;
+}
+
+void MeetingParticipantsCtrlEvent::onUserJoin(IList<unsigned int>* lstUserID, const zchar_t* strUserList) {
+    auto ids = toVector(lstUserID);
+    if (m_onChanged && !ids.empty())
+        m_onChanged(ids);
+}
+
+void MeetingParticipantsCtrlEvent::onUserLeft(IList<unsigned int>* lstUserID, const zchar_t* strUserList) {
+    auto ids = toVector(lstUserID);
+    if (m_onLeft && !ids.empty())
+        m_onLeft(ids);
+}
+
+void MeetingParticipantsCtrlEvent::onUserNamesChanged(IList<unsigned int>* lstUserID) {
+    auto ids = toVector(lstUserID);
+    if (m_onChanged && !ids.empty())
+        m_onChanged(ids);
+}
+
+void MeetingParticipantsCtrlEvent::onHostChangeNotification(unsigned int userId) {
+    if (m_onChanged)
+        m_onChanged({});
+}
@@ -0,0 +1,79 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_MEETINGPARTICIPANTSCTRLEVENT_H
+#define MEETING_SDK_LINUX_SAMPLE_MEETINGPARTICIPANTSCTRLEVENT_H
+
+#include <functional>
+#include <vector>
+#include "meeting_service_components/meeting_participants_ctrl_interface.h"
+
+#include "../util/Log.h"
+
+using namespace std;
+using namespace ZOOMSDK;
+
+/**
+ * Forwards participant changes, the rest of the interface is ignored
+ */
+class MeetingParticipantsCtrlEvent : public IMeetingParticipantsCtrlEvent {
+    function<void(const vector<unsigned int>&)> m_onChanged;
+    function<void(const vector<unsigned int>&)> m_onLeft;
+
+    static vector<unsigned int> toVector(IList<unsigned int>* list);
+
+public:
+    /**
+     * @param onChanged participants who joined or whose details changed, all of them if empty
+     * @param onLeft participants who left
+     */
+    MeetingParticipantsCtrlEvent(function<void(const vector<unsigned int>&)> onChanged,
+                                 function<void(const vector<unsigned int>&)> onLeft) :
+            m_onChanged(move(onChanged)), m_onLeft(move(onLeft)) {}
+
+    /**
+     * Fires when participants join the meeting
+     * @param lstUserID user IDs of the new participants
+     * @param strUserList unused, the user IDs as XML
+     */
+    void onUserJoin(IList<unsigned int>* lstUserID, const zchar_t* strUserList = nullptr) override;
+
+    /**
+     * Fires when participants leave the meeting
+     * @param lstUserID user IDs of the participants who left
+     * @param strUserList unused, the user IDs as XML
+     */
+    void onUserLeft(IList<unsigned int>* lstUserID, const zchar_t* strUserList = nullptr) override;
+
+    /**
+     * Fires when participants are renamed
+     * @param lstUserID user IDs of the renamed participants
+     */
+    void onUserNamesChanged(IList<unsigned int>* lstUserID) override;
+
+    /**
+     * Fires when the host changes, the old host's details change too
+     * @param userId user ID of the new host
+     */
+    void onHostChangeNotification(unsigned int userId) override;
+
+    void onLowOrRaiseHandStatusChanged(bool bLow, unsigned int userid) override {};
+    void onCoHostChangeNotification(unsigned int userId, bool isCoHost) override {};
+    void onInvalidReclaimHostkey() override {};
+    void onAllHandsLowered() override {};
+    void onLocalRecordingStatusChanged(unsigned int user_id, RecordingStatus status) override {};
+    void onAllowParticipantsRenameNotification(bool bAllow) override {};
+    void onAllowParticipantsUnmuteSelfNotification(bool bAllow) override {};
+    void onAllowParticipantsStartVideoNotification(bool bAllow) override {};
+    void onAllowParticipantsShareWhiteBoardNotification(bool bAllow) override {};
+    void onRequestLocalRecordingPrivilegeChanged(LocalRecordingRequestPrivilegeStatus status) override {};
+    void onAllowParticipantsRequestCloudRecording(bool bAllow) override {};
+    void onInMeetingUserAvatarPathUpdated(unsigned int userID) override {};
+    void onParticipantProfilePictureStatusChange(bool bHidden) override {};
+    void onFocusModeStateChanged(bool bEnabled) override {};
+    void onFocusModeShareTypeChanged(FocusModeShareType type) override {};
+    void onRobotRelationChanged(unsigned int authorizeUserID) override {};
+    void onVirtualNameTagStatusChanged(bool bOn, unsigned int userID) override {};
+    void onVirtualNameTagRosterInfoUpdated(unsigned int userID) override {};
+    void onCreateCompanionRelation(unsigned int parentUserID, unsigned int childUserID) override {};
+    void onRemoveCompanionRelation(unsigned int childUserID) override {};
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_MEETINGPARTICIPANTSCTRLEVENT_H
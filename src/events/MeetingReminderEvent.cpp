@@ -2,11 +2,11 @@
 
 void MeetingReminderEvent::onReminderNotify(IMeetingReminderContent* content, IMeetingReminderHandler* handle) {
     if (content) {
-        cout << "Reminder Notification Received" << endl;
-        cout << "Type: " << content->GetType() << endl;
-        cout << "Title: " << content->GetTitle() << endl;
-        cout << "Content: " << content->GetContent() << endl;
-        cout << "Is Blocking?: " << content->IsBlocking() << endl;
+        Log::info("Reminder Notification Received");
+        Log::info("Type: " + to_string(content->GetType()));
+        Log::info("Title: " + string(content->GetTitle() ? content->GetTitle() : ""));
+        Log::info("Content: " + string(content->GetContent() ? content->GetContent() : ""));
+        Log::info("Is Blocking?: " + to_string(content->IsBlocking()));
     }
 
     if (handle) {
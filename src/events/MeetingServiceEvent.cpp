@@ -1,6 +1,10 @@
 #include "MeetingServiceEvent.h"
 
 void MeetingServiceEvent::onMeetingStatusChanged(MeetingStatus status, int iResult) {
+    static auto& gauge = MetricsRegistry::getInstance().gauge("zoombot_meeting_status",
+                                                              "Current SDK MeetingStatus value");
+    gauge.set(status);
+
     if (m_onMeetingStatusChanged) {
         m_onMeetingStatusChanged(status, iResult);
         return;
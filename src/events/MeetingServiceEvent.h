@@ -8,6 +8,7 @@
 #include "meeting_service_interface.h"
 
 #include "../util/Log.h"
+#include "../util/Metrics.h"
 
 using namespace std;
 using namespace ZOOMSDK;
@@ -2,7 +2,17 @@
 #include <glib.h>
 #include "Config.h"
 #include "Zoom.h"
-
+#include "util/ControlChannel.h"
+#include "util/MemoryBudget.h"
+#include "util/Metrics.h"
+#include "util/Threads.h"
+#include "util/Trace.h"
+#include "raw_record/CallbackRecorder.h"
+#include "raw_record/FileSink.h"
+#include "raw_record/RecordingJournal.h"
+
+// set by SIGINT or SIGTERM, the main loop quits on its next tick
+volatile sig_atomic_t g_exitSignal = 0;
 
 /**
  *  Callback fired atexit()
@@ -12,25 +22,73 @@ void onExit() {
     zoom->leave();
     zoom->clean();
 
-    cout << "exiting..." << endl;
+    CallbackRecorder::getInstance().close();
+    RecordingJournal::getInstance().close();
+
+    // the outputs are all closed by now
+    zoom->finalize();
+
+    Log::info("exiting...");
+    Logger::getInstance().shutdown();
 }
 
 /**
- * Callback fired when a signal is trapped
+ * Callback fired when a signal is trapped. Only flags it, leaving and
+ * finalizing run from main() once the main loop has quit.
  * @param signal type of signal
  */
 void onSignal(int signal) {
-    onExit();
-    _Exit(signal);
+    // a second signal, e.g. while finalizing, exits right away
+    if (g_exitSignal)
+        _Exit(signal);
+
+    g_exitSignal = signal;
 }
 
 
+/**
+ * Callback fired on SIGUSR1 to start or stop tracing
+ * @param signal type of signal
+ */
+void onTraceSignal(int signal) {
+    Tracer::getInstance().requestToggle();
+}
+
+/**
+ * Callback fired on SIGUSR2 to export the last seconds of audio
+ * @param signal type of signal
+ */
+void onExportSignal(int signal) {
+    Zoom::getInstance().requestPreRollExport();
+}
+
+/**
+ * Callback fired on the main loop when control requests are queued
+ * @param data unused
+ * @return always FALSE, to run once
+ */
+gboolean onControl(gpointer data) {
+    ControlChannel::getInstance().dispatch();
+    return FALSE;
+}
+
 /**
  * Callback for glib event loop
  * @param data event data
  * @return always TRUE
  */
 gboolean onTimeout (gpointer data) {
+    Tracer::getInstance().handleToggle();
+    Zoom::getInstance().handlePreRollExport();
+    Zoom::getInstance().adaptVideo();
+    Zoom::getInstance().followSpeaker();
+    ControlChannel::getInstance().dispatch();
+
+    // main() returns and exit() finalizes
+    if (g_exitSignal || Zoom::getInstance().shouldExit()) {
+        g_main_loop_quit(static_cast<GMainLoop*>(data));
+        return FALSE;
+    }
     return TRUE;
 }
 
@@ -44,6 +102,9 @@ SDKError run(int argc, char** argv) {
     SDKError err{SDKERR_SUCCESS};
     auto* zoom = &Zoom::getInstance();
 
+    auto& threads = ThreadRegistry::getInstance();
+    threads.enroll(ThreadClass::Main, "zoombot-main");
+
     signal(SIGINT, onSignal);
     signal(SIGTERM, onSignal);
 
@@ -54,10 +115,53 @@ SDKError run(int argc, char** argv) {
     if (Zoom::hasError(err, "configure")) {
         return err;
     }
+
+    // before the SDK starts its threads, they inherit the main thread's CPUs
+    for (auto threadClass : {ThreadClass::Main, ThreadClass::Socket, ThreadClass::Writer, ThreadClass::Analysis}) {
+        if (!threads.configure(threadClass, zoom->getConfig().threadPolicy(threadClass)))
+            return SDKERR_INTERNAL_ERROR;
+    }
+
+    auto metricsPort = zoom->getConfig().metricsPort();
+    if (metricsPort > 0) {
+        MetricsServer::getInstance().start(metricsPort);
+    }
+
+    auto& tracer = Tracer::getInstance();
+    tracer.setDir(zoom->getConfig().traceDir());
+    tracer.setSampleEvery(zoom->getConfig().traceSample());
+    if (zoom->getConfig().trace()) {
+        tracer.enable();
+    }
+
+    signal(SIGUSR1, onTraceSignal);
+    signal(SIGUSR2, onExportSignal);
+
+    // requests from the meeting socket run on the main loop as soon as they arrive
+    zoom->registerCommands();
+    ControlChannel::getInstance().setWaker([]() {
+        g_idle_add(onControl, nullptr);
+    });
+
+    auto& captureFile = zoom->getConfig().captureFile();
+    if (!captureFile.empty()) {
+        CallbackRecorder::getInstance().open(captureFile, zoom->getConfig().capturePayloads());
+    }
         
+    FileSink::setDefaults(zoom->getConfig().preallocSeconds(), zoom->getConfig().dropBehind());
+    MemoryBudget::getInstance().setBudget(static_cast<uint64_t>(zoom->getConfig().memoryBudgetMb()) << 20);
+
+    // repair what a killed session left behind before writing anything new
+    auto syncIntervalMs = zoom->getConfig().syncIntervalMs();
+    if (syncIntervalMs > 0) {
+        auto& journalDir = zoom->getConfig().journalDir();
+        RecordingJournal::recoverDir(journalDir);
+        RecordingJournal::getInstance().open(journalDir, syncIntervalMs);
+    }
+
     // Set empty audio filename to skip SDK audio file output
     zoom->getConfig().setAudioFileOverride("");
-    cout << "Audio output configured to use only PulseAudio MP3 recording" << endl;
+    Log::info("Audio output configured to use only PulseAudio MP3 recording");
 
     // initialize the Zoom SDK
     err = zoom->init();
@@ -88,6 +192,10 @@ int main(int argc, char **argv) {
     g_timeout_add(100, onTimeout, eventLoop);
     g_main_loop_run(eventLoop);
 
+    // exit() runs onExit() on this thread, not in the signal handler
+    if (g_exitSignal)
+        return g_exitSignal;
+
     return err;
 }
 
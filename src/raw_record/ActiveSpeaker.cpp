@@ -0,0 +1,65 @@
+#include "ActiveSpeaker.h"
+
+#include <algorithm>
+
+ActiveSpeaker::ActiveSpeaker(unsigned int debounceMs) :
+        m_debounceNs(static_cast<uint64_t>(debounceMs) * 1000000) {}
+
+void ActiveSpeaker::observe(uint32_t nodeId, double energy, unsigned int ms, uint64_t nowNs) {
+    auto alpha = min(1.0, ms / c_smoothingMs);
+
+    lock_guard<mutex> lock(m_lock);
+    auto& level = m_levels[nodeId];
+    level.energy += (energy - level.energy) * alpha;
+    level.lastNs = nowNs;
+}
+
+void ActiveSpeaker::ignore(uint32_t nodeId) {
+    lock_guard<mutex> lock(m_lock);
+    m_ignored = nodeId;
+}
+
+uint32_t ActiveSpeaker::update(uint64_t nowNs) {
+    uint32_t loudest = 0;
+    double loudestEnergy = 0;
+    double currentEnergy = 0;
+    {
+        lock_guard<mutex> lock(m_lock);
+        for (auto& [nodeId, level] : m_levels) {
+            if (nodeId == m_ignored || nowNs - level.lastNs > c_staleNs)
+                continue;
+
+            if (nodeId == m_current)
+                currentEnergy = level.energy;
+
+            if (level.energy > loudestEnergy) {
+                loudest = nodeId;
+                loudestEnergy = level.energy;
+            }
+        }
+    }
+
+    // nobody talking, or the current speaker still holding the floor
+    if (!loudest || loudest == m_current || loudestEnergy < c_floor || currentEnergy * c_margin > loudestEnergy) {
+        m_candidate = 0;
+        return 0;
+    }
+
+    if (loudest != m_candidate) {
+        m_candidate = loudest;
+        m_candidateSinceNs = nowNs;
+        return 0;
+    }
+
+    if (nowNs - m_candidateSinceNs < m_debounceNs || (m_switchedNs && nowNs - m_switchedNs < c_holdNs))
+        return 0;
+
+    setCurrent(loudest, nowNs);
+    return loudest;
+}
+
+void ActiveSpeaker::setCurrent(uint32_t nodeId, uint64_t nowNs) {
+    m_current = nodeId;
+    m_candidate = 0;
+    m_switchedNs = nowNs;
+}
@@ -0,0 +1,77 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_ACTIVESPEAKER_H
+#define MEETING_SDK_LINUX_SAMPLE_ACTIVESPEAKER_H
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+
+/**
+ * Picks who is talking from each participant's audio energy. Levels are
+ * smoothed per node; a new speaker has to be the loudest, clearly louder
+ * than the current one, for the whole debounce window, and the previous
+ * switch has to be a few seconds old, so brief interjections and crosstalk
+ * do not make the video thrash between people.
+ */
+class ActiveSpeaker {
+    // below this mean square nobody is talking, about -40 dBFS
+    static constexpr double c_floor = 300.0 * 300.0;
+
+    // a new speaker is this many times louder than the current one, about 3 dB
+    static constexpr double c_margin = 2.0;
+
+    // time constant of the smoothed level
+    static constexpr double c_smoothingMs = 300;
+
+    // a node silent this long, muted or gone, no longer counts
+    static constexpr uint64_t c_staleNs = 500000000ull;
+
+    // least time between two switches
+    static constexpr uint64_t c_holdNs = 3000000000ull;
+
+    struct Level {
+        double energy = 0;
+        uint64_t lastNs = 0;
+    };
+
+    mutex m_lock;
+    unordered_map<uint32_t, Level> m_levels;
+
+    uint64_t m_debounceNs;
+    uint32_t m_ignored = 0;
+
+    // the rest belongs to the main loop
+    uint32_t m_current = 0;
+    uint32_t m_candidate = 0;
+    uint64_t m_candidateSinceNs = 0;
+    uint64_t m_switchedNs = 0;
+
+public:
+    explicit ActiveSpeaker(unsigned int debounceMs);
+
+    /**
+     * One chunk of a participant's audio, from the audio thread
+     * @param energy mean square of the chunk's samples
+     */
+    void observe(uint32_t nodeId, double energy, unsigned int ms, uint64_t nowNs);
+
+    /**
+     * Never pick this node, e.g. the bot's own
+     */
+    void ignore(uint32_t nodeId);
+
+    /**
+     * Decide whether to switch, from the main loop
+     * @return the new speaker, 0 to stay
+     */
+    uint32_t update(uint64_t nowNs);
+
+    /**
+     * Who is followed now, after a manual switch or a failed one
+     */
+    void setCurrent(uint32_t nodeId, uint64_t nowNs);
+    uint32_t current() const { return m_current; }
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_ACTIVESPEAKER_H
@@ -0,0 +1,100 @@
+#include "AudioLevel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+    // a full-scale square wave is 0 dBFS
+    constexpr double c_fullScale = 32768.0;
+    constexpr double c_silenceDb = -120.0;
+
+    double dbfs(double amplitude) {
+        return amplitude > 0 ? max(c_silenceDb, 20.0 * log10(amplitude / c_fullScale)) : c_silenceDb;
+    }
+}
+
+AudioLevel AudioLevel::measure(const int16_t* pcm, size_t samples) {
+    AudioLevel level;
+    level.samples = samples;
+
+    // the peak is the larger of the two, 0 when there are no samples
+    size_t i = 0;
+    int32_t high = 0;
+    int32_t low = 0;
+
+#if defined(__SSE2__)
+    // pairs of squares summed in 32 bits, unsigned since two full-scale samples make 2^31
+    auto zero = _mm_setzero_si128();
+    auto sum = _mm_setzero_si128();
+    auto maxv = _mm_set1_epi16(INT16_MIN);
+    auto minv = _mm_set1_epi16(INT16_MAX);
+
+    for (; i + 8 <= samples; i += 8) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm + i));
+        auto pairs = _mm_madd_epi16(v, v);
+        sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(pairs, zero));
+        sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(pairs, zero));
+        maxv = _mm_max_epi16(maxv, v);
+        minv = _mm_min_epi16(minv, v);
+    }
+
+    alignas(16) uint64_t sums[2];
+    alignas(16) int16_t maxs[8];
+    alignas(16) int16_t mins[8];
+    _mm_store_si128(reinterpret_cast<__m128i*>(sums), sum);
+    _mm_store_si128(reinterpret_cast<__m128i*>(maxs), maxv);
+    _mm_store_si128(reinterpret_cast<__m128i*>(mins), minv);
+
+    level.sumSquares = sums[0] + sums[1];
+    high = max<int32_t>(high, *max_element(maxs, maxs + 8));
+    low = min<int32_t>(low, *min_element(mins, mins + 8));
+#elif defined(__ARM_NEON)
+    auto sum = vdupq_n_u64(0);
+    auto maxv = vdupq_n_s16(INT16_MIN);
+    auto minv = vdupq_n_s16(INT16_MAX);
+
+    for (; i + 8 <= samples; i += 8) {
+        auto v = vld1q_s16(pcm + i);
+        auto lo = vmull_s16(vget_low_s16(v), vget_low_s16(v));
+        auto hi = vmull_s16(vget_high_s16(v), vget_high_s16(v));
+        sum = vpadalq_u32(sum, vreinterpretq_u32_s32(lo));
+        sum = vpadalq_u32(sum, vreinterpretq_u32_s32(hi));
+        maxv = vmaxq_s16(maxv, v);
+        minv = vminq_s16(minv, v);
+    }
+
+    level.sumSquares = vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+    high = max<int32_t>(high, vmaxvq_s16(maxv));
+    low = min<int32_t>(low, vminvq_s16(minv));
+#endif
+
+    for (; i < samples; i++) {
+        int32_t sample = pcm[i];
+        level.sumSquares += static_cast<uint64_t>(sample * sample);
+        high = max(high, sample);
+        low = min(low, sample);
+    }
+
+    level.peak = static_cast<uint32_t>(max(high, -low));
+    return level;
+}
+
+void AudioLevel::add(const AudioLevel& other) {
+    sumSquares += other.sumSquares;
+    samples += other.samples;
+    peak = max(peak, other.peak);
+}
+
+double AudioLevel::rmsDbfs() const {
+    return dbfs(sqrt(meanSquare()));
+}
+
+double AudioLevel::peakDbfs() const {
+    return dbfs(peak);
+}
@@ -0,0 +1,32 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_AUDIOLEVEL_H
+#define MEETING_SDK_LINUX_SAMPLE_AUDIOLEVEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * Energy and peak of a run of 16-bit samples, exact in integers so chunks
+ * can be summed into longer windows. measure() is vectorized (SSE2 or NEON)
+ * and touches each sample once, cheap enough for every callback.
+ */
+struct AudioLevel {
+    uint64_t sumSquares = 0;
+    uint64_t samples = 0;
+    uint32_t peak = 0;
+
+    static AudioLevel measure(const int16_t* pcm, size_t samples);
+
+    void add(const AudioLevel& other);
+
+    double meanSquare() const { return samples ? static_cast<double>(sumSquares) / samples : 0; }
+
+    /**
+     * Relative to a full-scale square wave, -120 for silence
+     */
+    double rmsDbfs() const;
+    double peakDbfs() const;
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_AUDIOLEVEL_H
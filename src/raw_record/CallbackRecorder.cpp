@@ -0,0 +1,150 @@
+#include "CallbackRecorder.h"
+
+#include <cstring>
+#include <ctime>
+
+#include "../util/Log.h"
+#include "../util/Metrics.h"
+
+CallbackRecorder::~CallbackRecorder() {
+    close();
+}
+
+bool CallbackRecorder::open(const string& path, bool payloads) {
+    lock_guard<mutex> lock(m_mutex);
+
+    if (m_file)
+        return true;
+
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file) {
+        Log::error("failed to open callback capture file: " + path);
+        return false;
+    }
+
+    m_fileBuffer.resize(1 << 20);
+    setvbuf(m_file, m_fileBuffer.data(), _IOFBF, m_fileBuffer.size());
+
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    CaptureHeader header;
+    header.startRealtimeNs = static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    fwrite(&header, sizeof(header), 1, m_file);
+
+    m_payloads = payloads;
+    m_start = MetricsClock::nowNs();
+    m_records = 0;
+    m_open = true;
+
+    Log::info("capturing raw data callbacks to " + path + (payloads ? " with payloads" : " (hashes only)"));
+    return true;
+}
+
+void CallbackRecorder::close() {
+    lock_guard<mutex> lock(m_mutex);
+
+    if (!m_file)
+        return;
+
+    m_open = false;
+    fclose(m_file);
+    m_file = nullptr;
+
+    Log::info("callback capture closed after " + to_string(m_records) + " records");
+}
+
+void CallbackRecorder::capture(CallbackType type, uint32_t nodeId, const char* data, uint32_t len,
+                               uint32_t a, uint32_t b, uint32_t c) {
+    auto now = MetricsClock::nowNs();
+
+    // hash outside the lock, it is the expensive part
+    uint64_t digest = hash(data, len);
+
+    lock_guard<mutex> lock(m_mutex);
+    if (!m_file)
+        return;
+
+    CallbackRecord record{};
+    record.type = type;
+    record.hasPayload = m_payloads;
+    record.nodeId = nodeId;
+    record.timestamp = now - m_start;
+    record.len = len;
+    record.a = a;
+    record.b = b;
+    record.c = c;
+
+    fwrite(&record, sizeof(record), 1, m_file);
+    if (m_payloads)
+        fwrite(data, 1, len, m_file);
+    fwrite(&digest, sizeof(digest), 1, m_file);
+
+    m_records++;
+}
+
+uint64_t CallbackRecorder::hash(const char* data, uint32_t len) {
+    // word at a time multiply/xorshift, fast enough for full video frames
+    uint64_t h = 0xcbf29ce484222325ull ^ len;
+    uint32_t i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        h = (h ^ word) * 0x100000001b3ull;
+        h ^= h >> 29;
+    }
+
+    for (; i < len; i++)
+        h = (h ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ull;
+
+    return h;
+}
+
+CallbackTraceReader::~CallbackTraceReader() {
+    if (m_file)
+        fclose(m_file);
+}
+
+bool CallbackTraceReader::open(const string& path) {
+    m_file = fopen(path.c_str(), "rb");
+    if (!m_file) {
+        Log::error("failed to open callback capture: " + path);
+        return false;
+    }
+
+    if (fread(&m_header, sizeof(m_header), 1, m_file) != 1 || string(m_header.magic, 4) != "ZCBT") {
+        Log::error(path + " is not a callback capture");
+        return false;
+    }
+
+    if (m_header.version != 1 && m_header.version != 2) {
+        Log::error("unsupported callback capture version " + to_string(m_header.version));
+        return false;
+    }
+
+    m_hashAfterPayload = m_header.version >= 2;
+
+    return true;
+}
+
+bool CallbackTraceReader::next(CallbackRecord& record, vector<char>& payload, uint64_t& hash) {
+    if (!m_file || fread(&record, sizeof(record), 1, m_file) != 1)
+        return false;
+
+    if (record.hasPayload) {
+        payload.resize(record.len);
+        if (fread(payload.data(), 1, record.len, m_file) != record.len)
+            return false;
+
+        if (!m_hashAfterPayload) {
+            hash = CallbackRecorder::hash(payload.data(), record.len);
+            return true;
+        }
+
+        return fread(&hash, sizeof(hash), 1, m_file) == 1;
+    }
+
+    payload.clear();
+    return fread(&hash, sizeof(hash), 1, m_file) == 1;
+}
@@ -0,0 +1,109 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_CALLBACKRECORDER_H
+#define MEETING_SDK_LINUX_SAMPLE_CALLBACKRECORDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../util/Singleton.h"
+
+using namespace std;
+
+/**
+ * Kind of SDK raw data callback stored in a capture
+ */
+enum class CallbackType : uint8_t {
+    MixedAudio = 1,
+    OneWayAudio = 2,
+    ShareAudio = 3,
+    Video = 4,
+};
+
+/**
+ * Fixed size record header of the capture format. The file starts with
+ * CaptureHeader and is followed by records, each trailed by the payload
+ * (len bytes) if it was kept and then its 64-bit CallbackRecorder::hash,
+ * taken when it was captured. Version 1 had no hash after a payload.
+ */
+struct CallbackRecord {
+    CallbackType type;
+    uint8_t hasPayload;
+    uint16_t reserved;
+    uint32_t nodeId;      // node_id for one-way audio, source id for video
+    uint64_t timestamp;   // ns since the capture started
+    uint32_t len;         // payload size as delivered by the SDK
+    uint32_t a;           // sample rate or width
+    uint32_t b;           // channel count or height
+    uint32_t c;           // rotation for video
+};
+
+static_assert(sizeof(CallbackRecord) == 32, "capture record layout changed");
+
+struct CaptureHeader {
+    char magic[4] = {'Z', 'C', 'B', 'T'};
+    uint32_t version = 2;
+    uint64_t startRealtimeNs = 0;
+};
+
+/**
+ * Records every raw data callback the delegates receive to a compact binary
+ * file for replay with media_bench --replay.
+ */
+class CallbackRecorder : public Singleton<CallbackRecorder> {
+    friend class Singleton<CallbackRecorder>;
+
+    mutex m_mutex;
+    FILE* m_file = nullptr;
+    vector<char> m_fileBuffer;
+    atomic<bool> m_open{false};
+    bool m_payloads = false;
+    uint64_t m_start = 0;
+    uint64_t m_records = 0;
+
+public:
+    ~CallbackRecorder();
+
+    /**
+     * Start capturing
+     * @param path capture file
+     * @param payloads store payloads instead of their hashes
+     */
+    bool open(const string& path, bool payloads);
+    void close();
+
+    bool isOpen() const { return m_open.load(memory_order_relaxed); }
+
+    void capture(CallbackType type, uint32_t nodeId, const char* data, uint32_t len,
+                 uint32_t a, uint32_t b, uint32_t c = 0);
+
+    static uint64_t hash(const char* data, uint32_t len);
+};
+
+/**
+ * Sequential reader for capture files
+ */
+class CallbackTraceReader {
+    FILE* m_file = nullptr;
+    CaptureHeader m_header;
+    bool m_hashAfterPayload = true;
+
+public:
+    ~CallbackTraceReader();
+
+    bool open(const string& path);
+
+    const CaptureHeader& header() const { return m_header; }
+
+    /**
+     * Read the next record
+     * @param payload filled with the payload, or left empty if only a hash was stored
+     * @param hash hash of the payload when it was captured
+     * @return false at the end of the file
+     */
+    bool next(CallbackRecord& record, vector<char>& payload, uint64_t& hash);
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_CALLBACKRECORDER_H
@@ -0,0 +1,429 @@
+#include "FileSink.h"
+
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "RecordingJournal.h"
+#include "../util/Log.h"
+#include "../util/Threads.h"
+
+namespace {
+    /**
+     * Aligned buffers kept for reuse, so streams that come and go (e.g.
+     * per-participant audio) don't allocate once the pool is warm
+     */
+    class BufferPool {
+        mutex m_lock;
+        unordered_map<size_t, vector<char*>> m_free;
+
+    public:
+        char* acquire(size_t size) {
+            {
+                lock_guard<mutex> lock(m_lock);
+                auto& free = m_free[size];
+                if (!free.empty()) {
+                    auto* buffer = free.back();
+                    free.pop_back();
+                    return buffer;
+                }
+            }
+
+            auto* buffer = static_cast<char*>(aligned_alloc(FileSink::c_directAlign, size));
+            if (!buffer)
+                throw bad_alloc();
+            return buffer;
+        }
+
+        void release(char* buffer, size_t size) {
+            lock_guard<mutex> lock(m_lock);
+            m_free[size].push_back(buffer);
+        }
+    };
+
+    BufferPool& bufferPool() {
+        // never destroyed, sinks may close during exit
+        static auto* pool = new BufferPool();
+        return *pool;
+    }
+
+    /**
+     * Waits for the writeback of finished windows and drops them from the
+     * page cache, off the threads that write. Windows come with their own
+     * duplicate of the fd, so a sink may close meanwhile.
+     */
+    class DropBehind {
+        struct Window {
+            int fd;
+            uint64_t from;
+        };
+
+        // a fixed ring, handing over a window never allocates
+        static constexpr size_t c_slots = 64;
+
+        mutex m_lock;
+        condition_variable m_wake;
+        array<Window, c_slots> m_windows{};
+        size_t m_head = 0;
+        size_t m_count = 0;
+        once_flag m_started;
+
+        void run() {
+            ThreadRegistry::getInstance().enroll(ThreadClass::Writer, "zoombot-dropbhd");
+
+            while (true) {
+                Window window{};
+                {
+                    unique_lock<mutex> lock(m_lock);
+                    m_wake.wait(lock, [this] { return m_count > 0; });
+                    window = m_windows[m_head];
+                    m_head = (m_head + 1) % c_slots;
+                    m_count--;
+                }
+
+                sync_file_range(window.fd, window.from, FileSink::c_dropWindow,
+                                SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+                posix_fadvise(window.fd, window.from, FileSink::c_dropWindow, POSIX_FADV_DONTNEED);
+                ::close(window.fd);
+            }
+        }
+
+    public:
+        void start() {
+            call_once(m_started, [this] { thread(&DropBehind::run, this).detach(); });
+        }
+
+        /**
+         * @return false if the ring is full, the fd is still the caller's
+         */
+        bool push(int fd, uint64_t from) {
+            {
+                lock_guard<mutex> lock(m_lock);
+                if (m_count == c_slots)
+                    return false;
+
+                m_windows[(m_head + m_count) % c_slots] = Window{fd, from};
+                m_count++;
+            }
+
+            m_wake.notify_one();
+            return true;
+        }
+    };
+
+    DropBehind& dropBehindThread() {
+        // never destroyed, its thread runs until exit
+        static auto* dropBehind = new DropBehind();
+        return *dropBehind;
+    }
+
+    size_t alignUp(size_t size) {
+        return (size + FileSink::c_directAlign - 1) / FileSink::c_directAlign * FileSink::c_directAlign;
+    }
+}
+
+unsigned int FileSink::s_preallocSeconds = 0;
+bool FileSink::s_dropBehind = false;
+
+void FileSink::setDefaults(unsigned int preallocSeconds, bool dropBehind) {
+    s_preallocSeconds = preallocSeconds;
+    s_dropBehind = dropBehind;
+
+    if (dropBehind)
+        dropBehindThread().start();
+}
+
+string FileSink::segmentPath(const string& path, unsigned int segment) {
+    if (!segment)
+        return path;
+
+    // the extension is only looked for in the file name, not the directories
+    auto slash = path.rfind('/');
+    auto dot = path.rfind('.');
+    if (dot == string::npos || (slash != string::npos && dot < slash) || dot == slash + 1)
+        dot = path.size();
+
+    return path.substr(0, dot) + "-" + to_string(segment) + path.substr(dot);
+}
+
+FileSink::~FileSink() {
+    close();
+
+    if (m_buffer)
+        bufferPool().release(m_buffer, m_capacity);
+}
+
+bool FileSink::open(const string& path, size_t bufferSize, bool direct) {
+    close();
+
+    // the journal thread may still be cutting back an earlier sink's file
+    RecordingJournal::getInstance().awaitRetired(path);
+
+    m_direct = false;
+    m_fd = -1;
+
+    if (direct) {
+        m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_DIRECT | O_CLOEXEC, 0644);
+        if (m_fd != -1)
+            m_direct = true;
+        else if (errno == EINVAL)
+            Log::warn(path + ": no O_DIRECT on this filesystem, using buffered I/O");
+    }
+
+    if (m_fd == -1)
+        m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+    if (m_fd == -1) {
+        Log::error("failed to open output file " + path + ": " + strerror(errno));
+        return false;
+    }
+
+    struct stat st{};
+    fstat(m_fd, &st);
+
+    m_path = path;
+    if (m_direct && st.st_size % c_directAlign)
+        disableDirect("existing file ends mid-block");
+
+    // whole blocks, all of it goes through the buffer
+    if (m_direct)
+        bufferSize = max(c_directAlign, alignUp(bufferSize));
+
+    m_written = 0;
+    m_base = st.st_size;
+    m_flushed.store(0, memory_order_release);
+    m_used = 0;
+    m_allocated = m_base;
+    m_preallocChunk = 0;
+    m_preallocFailed = false;
+    m_dropFrom = m_base;
+
+    if (bufferSize != m_capacity) {
+        if (m_buffer)
+            bufferPool().release(m_buffer, m_capacity);
+
+        m_buffer = bufferSize ? bufferPool().acquire(bufferSize) : nullptr;
+        m_capacity = bufferSize;
+    }
+
+    return true;
+}
+
+void FileSink::disableDirect(const char* reason) {
+    Log::warn(m_path + ": " + reason + ", using buffered I/O");
+
+    // without O_APPEND pwrite() still lands at the end, it is passed the offset
+    fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+    m_direct = false;
+}
+
+void FileSink::reserve(uint64_t end) {
+    if (!m_preallocChunk || end <= m_allocated)
+        return;
+
+    auto length = max(m_preallocChunk, end - m_allocated);
+    if (fallocate(m_fd, FALLOC_FL_KEEP_SIZE, m_allocated, length) == -1) {
+        // e.g. EOPNOTSUPP on tmpfs or NFS, don't try again
+        LOG_EVERY_MS(60000, Log::warn, "not preallocating " + m_path + ": " + strerror(errno));
+        m_preallocChunk = 0;
+        m_preallocFailed = true;
+        return;
+    }
+
+    m_allocated += length;
+}
+
+void FileSink::dropBehind(uint64_t end) {
+    if (end - m_dropFrom < 2 * c_dropWindow)
+        return;
+
+    // the window before the last one has had a window's time to reach the
+    // disk; waiting for it and dropping it from the page cache is the
+    // drop-behind thread's, this runs on the thread that writes. A full
+    // ring leaves the window cached until close().
+    auto fd = dup(m_fd);
+    if (fd != -1 && !dropBehindThread().push(fd, m_dropFrom))
+        ::close(fd);
+    m_dropFrom += c_dropWindow;
+
+    // and start writing back the last one
+    sync_file_range(m_fd, m_dropFrom, c_dropWindow, SYNC_FILE_RANGE_WRITE);
+}
+
+bool FileSink::writeAll(const char* buf, size_t len) {
+    reserve(flushedOffset() + len);
+
+    while (len > 0) {
+        auto ret = ::pwrite(m_fd, buf, len, flushedOffset());
+        if (ret == -1) {
+            if (errno == EINTR)
+                continue;
+
+            // the filesystem accepted O_DIRECT at open but not the write
+            if (errno == EINVAL && m_direct) {
+                disableDirect("O_DIRECT write rejected");
+                continue;
+            }
+
+            LOG_EVERY_MS(5000, Log::error, "failed to write " + m_path + ": " + strerror(errno));
+            return false;
+        }
+
+        buf += ret;
+        len -= ret;
+        m_flushed.store(m_flushed.load(memory_order_relaxed) + ret, memory_order_release);
+    }
+
+    if (s_dropBehind && !m_direct)
+        dropBehind(flushedOffset());
+
+    return true;
+}
+
+bool FileSink::writeDirect(const char* buf, size_t len) {
+    while (len > 0) {
+        auto chunk = min(len, m_capacity - m_used);
+        memcpy(m_buffer + m_used, buf, chunk);
+        m_used += chunk;
+        buf += chunk;
+        len -= chunk;
+
+        if (m_used == m_capacity) {
+            m_used = 0;
+            if (!writeAll(m_buffer, m_capacity))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void FileSink::writeTail() {
+    if (!m_used)
+        return;
+
+    // O_DIRECT can only write whole blocks, pad the last one; close() cuts
+    // the file back to its real length
+    auto length = flushedOffset() + m_used;
+    auto padded = alignUp(m_used);
+    memset(m_buffer + m_used, 0, padded - m_used);
+    m_used = 0;
+
+    if (writeAll(m_buffer, padded))
+        m_flushed.store(length - m_base, memory_order_release);
+}
+
+bool FileSink::write(const char* buf, size_t len) {
+    if (m_fd == -1)
+        return false;
+
+    m_written += len;
+
+    if (m_direct)
+        return writeDirect(buf, len);
+
+    if (m_used + len <= m_capacity) {
+        memcpy(m_buffer + m_used, buf, len);
+        m_used += len;
+        return true;
+    }
+
+    if (!flush())
+        return false;
+
+    // large writes such as whole video frames go straight through
+    if (len >= m_capacity)
+        return writeAll(buf, len);
+
+    memcpy(m_buffer, buf, len);
+    m_used = len;
+    return true;
+}
+
+bool FileSink::flush() {
+    if (m_fd == -1 || m_used == 0)
+        return true;
+
+    if (!m_direct) {
+        auto ok = writeAll(m_buffer, m_used);
+        m_used = 0;
+        return ok;
+    }
+
+    // whole blocks only, the rest waits for more data or close()
+    auto aligned = m_used / c_directAlign * c_directAlign;
+    if (!aligned)
+        return true;
+
+    auto ok = writeAll(m_buffer, aligned);
+    m_used -= aligned;
+    memmove(m_buffer, m_buffer + aligned, m_used);
+    return ok;
+}
+
+void FileSink::close() {
+    if (m_fd == -1)
+        return;
+
+    flush();
+    if (m_direct)
+        writeTail();
+
+    // the padded tail or preallocated space past the end goes back
+    auto trim = m_direct || m_allocated > flushedOffset();
+
+    // the final sync and the C record are the journal thread's, this may
+    // run on the audio thread while rotating
+    auto id = exchange(m_journalId, 0);
+    if (!id || !RecordingJournal::getInstance().retire(id, m_fd, m_path, flushedOffset(), trim))
+        finish(m_fd, m_path, flushedOffset(), trim, false);
+
+    m_fd = -1;
+}
+
+bool FileSink::finish(int fd, const string& path, uint64_t length, bool trim, bool sync) {
+    if (trim && ftruncate(fd, length) == -1)
+        Log::warn("failed to trim " + path + ": " + strerror(errno));
+
+    auto synced = !sync || fdatasync(fd) == 0;
+    if (!synced)
+        LOG_EVERY_MS(5000, Log::error, "failed to sync " + path + ": " + strerror(errno));
+
+    // pages already written back go now, the rest once they are clean
+    if (s_dropBehind)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+    ::close(fd);
+    return synced;
+}
+
+void FileSink::describe(const string& format, uint32_t block, uint64_t bytesPerSecond) {
+    if (m_fd == -1)
+        return;
+
+    // whole MiB, and at least one
+    constexpr uint64_t mib = 1024 * 1024;
+    if (s_preallocSeconds && !m_preallocFailed)
+        m_preallocChunk = max(mib, bytesPerSecond * s_preallocSeconds / mib * mib);
+
+    auto& journal = RecordingJournal::getInstance();
+    if (!journal.isOpen())
+        return;
+
+    if (!m_journalId)
+        m_journalId = journal.add(this);
+
+    if (m_journalId)
+        journal.format(m_journalId, offset(), block, format);
+}
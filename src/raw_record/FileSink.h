@@ -0,0 +1,153 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_FILESINK_H
+#define MEETING_SDK_LINUX_SAMPLE_FILESINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+/**
+ * Append-only output file that stays open for the life of a stream.
+ * Small writes are coalesced in a buffer allocated once at open(), so the
+ * steady-state write path makes no heap allocations and few syscalls.
+ *
+ * Once the stream's byte rate is known the file is preallocated in large
+ * chunks beyond its end (FALLOC_FL_KEEP_SIZE, so the size still only covers
+ * written bytes) and the unused tail is released on close. Optionally,
+ * finished data is written back and dropped from the page cache as it goes.
+ *
+ * With direct I/O everything goes through the buffer and leaves it in whole
+ * aligned blocks via O_DIRECT, bypassing the page cache; the unaligned tail
+ * is padded on close and the file cut back to its length. Filesystems
+ * without O_DIRECT get the buffered path.
+ */
+class FileSink {
+    string m_path;
+    int m_fd = -1;
+
+    // aligned, from a pool shared by all sinks
+    char* m_buffer = nullptr;
+    size_t m_capacity = 0;
+    size_t m_used = 0;
+
+    bool m_direct = false;
+
+    uint64_t m_written = 0;
+
+    // file size at open, offsets below are relative to the file
+    uint64_t m_base = 0;
+
+    // bytes handed to the kernel, read by the journal's sync thread
+    atomic<uint64_t> m_flushed{0};
+
+    uint32_t m_journalId = 0;
+
+    // file offset up to which space is reserved, and the next reservation
+    uint64_t m_allocated = 0;
+    uint64_t m_preallocChunk = 0;
+    bool m_preallocFailed = false;
+
+    // start of the range whose writeback has been started but not waited on
+    uint64_t m_dropFrom = 0;
+
+    static unsigned int s_preallocSeconds;
+    static bool s_dropBehind;
+
+    bool writeAll(const char* buf, size_t len);
+    bool writeDirect(const char* buf, size_t len);
+    void writeTail();
+    void disableDirect(const char* reason);
+    void reserve(uint64_t end);
+    void dropBehind(uint64_t end);
+
+public:
+    static constexpr size_t c_defaultBuffer = 64 * 1024;
+
+    // O_DIRECT offsets, lengths and buffers are multiples of this
+    static constexpr size_t c_directAlign = 4096;
+    static constexpr size_t c_directBuffer = 1024 * 1024;
+
+    // writeback is started every this many bytes, and the window before dropped
+    static constexpr uint64_t c_dropWindow = 8 * 1024 * 1024;
+
+    /**
+     * Storage policy for every sink, set once at start-up
+     * @param preallocSeconds seconds of the stream reserved at a time, 0 disables
+     * @param dropBehind write finished data back early and drop it from the page cache
+     */
+    static void setDefaults(unsigned int preallocSeconds, bool dropBehind);
+
+    /**
+     * Name of a later segment of an output, e.g. out/test-2.pcm for segment 2
+     * of out/test.pcm; segment 0 is the path itself
+     */
+    static string segmentPath(const string& path, unsigned int segment);
+
+    FileSink() = default;
+    ~FileSink();
+
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    /**
+     * Open or create a file for appending
+     * @param path output file
+     * @param bufferSize bytes coalesced before a write(2), 0 writes through
+     * @param direct bypass the page cache with O_DIRECT where possible
+     * @return true on success
+     */
+    bool open(const string& path, size_t bufferSize = c_defaultBuffer, bool direct = false);
+
+    bool write(const char* buf, size_t len);
+
+    /**
+     * Hand the buffered bytes to the kernel
+     */
+    bool flush();
+
+    /**
+     * Flush and close. A journaled output is handed to the journal thread,
+     * which trims, syncs and closes it and records it closed; others are
+     * trimmed and closed here.
+     */
+    void close();
+
+    /**
+     * Last steps of closing an output, cuts it back to length if asked
+     * @param sync fdatasync() before closing
+     * @return false if the sync failed
+     */
+    static bool finish(int fd, const string& path, uint64_t length, bool trim, bool sync);
+
+    bool isOpen() const { return m_fd != -1; }
+    bool isDirect() const { return m_direct; }
+    const string& path() const { return m_path; }
+    int fd() const { return m_fd; }
+
+    /**
+     * Bytes accepted since open(), buffered or not
+     */
+    uint64_t written() const { return m_written; }
+
+    /**
+     * File offset of the next byte written
+     */
+    uint64_t offset() const { return m_base + m_written; }
+
+    /**
+     * File offset up to which bytes have left the buffer, safe from any thread
+     */
+    uint64_t flushedOffset() const { return m_base + m_flushed.load(memory_order_acquire); }
+
+    /**
+     * Record the format of the bytes written from here on, in the journal if
+     * one is open, and size preallocation from it. Call again when it changes.
+     * @param format human readable, e.g. "pcm s16le 32000 1"
+     * @param block bytes per sample frame or video frame
+     * @param bytesPerSecond expected data rate
+     */
+    void describe(const string& format, uint32_t block, uint64_t bytesPerSecond);
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_FILESINK_H
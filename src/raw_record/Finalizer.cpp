@@ -0,0 +1,415 @@
+#include "Finalizer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+
+#include "MultichannelRecorder.h"
+#include "RecordingJournal.h"
+#include "../util/JobGraph.h"
+#include "../util/Json.h"
+#include "../util/Log.h"
+#include "../util/Metrics.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    string stem(const string& path) {
+        auto dot = path.rfind('.');
+        auto slash = path.rfind('/');
+        return dot == string::npos || (slash != string::npos && dot < slash) ? path : path.substr(0, dot);
+    }
+
+    string basename(const string& path) {
+        auto slash = path.rfind('/');
+        return slash == string::npos ? path : path.substr(slash + 1);
+    }
+
+    string dirname(const string& path) {
+        auto slash = path.rfind('/');
+        return slash == string::npos ? "." : path.substr(0, slash);
+    }
+
+    vector<string> ffmpeg(const vector<string>& args) {
+        vector<string> all{"ffmpeg", "-nostdin", "-y", "-v", "error"};
+        all.insert(all.end(), args.begin(), args.end());
+        return all;
+    }
+
+    string seconds(int64_t ns) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.6f", ns / 1e9);
+        return buf;
+    }
+
+    /**
+     * The one format of a raw video, from its .meta sidecar
+     */
+    bool videoFormat(const string& path, unsigned int& width, unsigned int& height, double& fps) {
+        ifstream in(path + ".meta");
+        string line;
+        size_t formats = 0;
+
+        while (getline(in, line)) {
+            JsonValue value;
+            if (!JsonValue::parse(line, value))
+                continue;
+
+            formats++;
+            width = static_cast<unsigned int>(value["width"].asNumber());
+            height = static_cast<unsigned int>(value["height"].asNumber());
+            fps = value["fps"].asNumber();
+        }
+
+        return formats == 1 && width && height && fps > 0;
+    }
+}
+
+Finalizer::Finalizer(unsigned int concurrency, uint64_t timeoutMs) :
+        m_concurrency(concurrency ? concurrency : max(1u, thread::hardware_concurrency())),
+        m_timeoutMs(timeoutMs) {}
+
+bool Finalizer::run(const string& journalPath) {
+    vector<RecordingJournal::Listing> outputs;
+    if (!RecordingJournal::outputs(journalPath, outputs))
+        return false;
+
+    JobGraph graph;
+
+    // every file to checksum and the job that makes it, raw outputs are there already
+    struct Product {
+        string path;
+        bool made = false;
+        size_t job = 0;
+    };
+    vector<Product> products;
+
+    // ffmpeg's own threads share the cores between the jobs running at once
+    auto threads = to_string(max(1u, thread::hardware_concurrency() / m_concurrency));
+
+    // outputs that can be muxed, with the job making the file that goes in
+    struct Track {
+        string path;
+        string input;
+        size_t job;
+    };
+    vector<Track> mixed;
+    vector<Track> videos;
+
+    for (auto& output : outputs) {
+        error_code ec;
+        if (output.formats.empty() || !fs::file_size(output.path, ec) || ec)
+            continue;
+
+        products.push_back({output.path});
+
+        auto& format = output.formats.front().second;
+        auto name = basename(output.path);
+        unsigned int rate = 0, channels = 0, width = 0, height = 0;
+
+        if (sscanf(format.c_str(), "pcm s16le %u %u", &rate, &channels) == 2) {
+            auto wav = stem(output.path) + ".wav";
+            auto flac = stem(output.path) + ".flac";
+            auto path = output.path;
+
+            auto wrap = graph.add("wav " + name, [=](const atomic<bool>& cancelled) {
+                return wrapWav(path, wav, rate, channels, cancelled);
+            });
+            auto encode = graph.add("flac " + name, [=](const atomic<bool>& cancelled) {
+                return command(ffmpeg({"-i", wav, "-c:a", "flac", flac}), cancelled);
+            }, {wrap});
+
+            products.push_back({wav, true, wrap});
+            products.push_back({flac, true, encode});
+
+            if (name.compare(0, 5, "node-") != 0 && name.compare(0, 8, "preroll-") != 0)
+                mixed.push_back({output.path, wav, wrap});
+        } else if (sscanf(format.c_str(), "wav s16le %u %u", &rate, &channels) == 2) {
+            // FLAC stops at 8 channels, wider recordings stay WAV
+            if (channels > 8)
+                continue;
+
+            auto flac = stem(output.path) + ".flac";
+            auto path = output.path;
+            auto encode = graph.add("flac " + name, [=](const atomic<bool>& cancelled) {
+                return command(ffmpeg({"-i", path, "-c:a", "flac", flac}), cancelled);
+            });
+
+            products.push_back({flac, true, encode});
+        } else if (sscanf(format.c_str(), "i420 %ux%u", &width, &height) == 2) {
+            double fps = 0;
+            if (output.formats.size() > 1 || !videoFormat(output.path, width, height, fps)) {
+                Log::warn(output.path + " has no single format in its .meta, left raw");
+                continue;
+            }
+
+            auto mp4 = stem(output.path) + ".mp4";
+            auto path = output.path;
+            auto size = to_string(width) + "x" + to_string(height);
+            auto frameRate = to_string(fps);
+
+            auto encode = graph.add("mp4 " + name, [=](const atomic<bool>& cancelled) {
+                return command(ffmpeg({"-f", "rawvideo", "-pix_fmt", "yuv420p", "-s", size, "-r", frameRate, "-i", path,
+                                       "-c:v", "libx264", "-preset", "veryfast", "-crf", "23",
+                                       "-threads", threads, mp4}), cancelled);
+            });
+
+            products.push_back({mp4, true, encode});
+            videos.push_back({output.path, mp4, encode});
+        }
+    }
+
+    // segments of a recording rotate together, pair them up in order
+    if (!videos.empty() && videos.size() == mixed.size()) {
+        for (size_t i = 0; i < videos.size(); i++) {
+            auto& video = videos[i];
+            auto& audio = mixed[i];
+
+            int64_t videoStart, audioStart;
+            if (!captureStartNs(video.path, videoStart) || !captureStartNs(audio.path, audioStart)) {
+                Log::warn("no timing for " + video.path + " or " + audio.path + ", not muxed");
+                continue;
+            }
+
+            // whichever started later is delayed by the difference
+            auto offset = audioStart - videoStart;
+            auto mp4 = video.input;
+            auto wav = audio.input;
+            auto av = stem(video.path) + ".av.mp4";
+
+            auto mux = graph.add("mux " + basename(av), [=](const atomic<bool>& cancelled) {
+                return command(ffmpeg({"-itsoffset", seconds(max<int64_t>(0, -offset)), "-i", mp4,
+                                       "-itsoffset", seconds(max<int64_t>(0, offset)), "-i", wav,
+                                       "-map", "0:v", "-map", "1:a", "-c:v", "copy", "-c:a", "aac", av}), cancelled);
+            }, {video.job, audio.job});
+
+            products.push_back({av, true, mux});
+        }
+    } else if (!videos.empty() && !mixed.empty()) {
+        Log::warn("video and mixed audio were not segmented alike, not muxed");
+    }
+
+    // hashes are filled in by their jobs, the manifest reads them after
+    vector<string> hashes(products.size());
+    vector<size_t> hashJobs;
+    for (size_t i = 0; i < products.size(); i++) {
+        auto& product = products[i];
+        vector<size_t> after;
+        if (product.made)
+            after.push_back(product.job);
+
+        hashJobs.push_back(graph.add("sha256 " + basename(product.path), [&, i](const atomic<bool>& cancelled) {
+            return sha256(products[i].path, hashes[i], cancelled);
+        }, after));
+    }
+
+    graph.add("SHA256SUMS", [&](const atomic<bool>&) {
+        map<string, string> manifests;
+        for (size_t i = 0; i < products.size(); i++) {
+            if (!hashes[i].empty())
+                manifests[dirname(products[i].path)] += hashes[i] + "  " + basename(products[i].path) + "\n";
+        }
+
+        for (auto& [dir, manifest] : manifests) {
+            ofstream out(dir + "/SHA256SUMS", ios::trunc);
+            if (!(out << manifest)) {
+                Log::error("failed to write " + dir + "/SHA256SUMS");
+                return false;
+            }
+        }
+        return true;
+    }, hashJobs, true);
+
+    Log::info("finalizing " + to_string(outputs.size()) + " output(s) in " + to_string(graph.jobs().size())
+              + " jobs, " + to_string(m_concurrency) + " at a time");
+
+    auto start = MetricsClock::nowNs();
+    auto ok = graph.run(m_concurrency, m_timeoutMs);
+    auto elapsed = MetricsClock::nowNs() - start;
+
+    // how long each job took and what it waited for, to tune the concurrency
+    auto reportPath = stem(journalPath) + ".finalize.jsonl";
+    ofstream report(reportPath, ios::app);
+    for (auto& job : graph.jobs()) {
+        string name;
+        JsonValue::appendString(name, job.name);
+
+        char times[96];
+        snprintf(times, sizeof(times), ",\"start_ms\":%.1f,\"duration_ms\":%.1f", job.startNs / 1e6, job.durationNs / 1e6);
+        report << "{\"job\":" << name << ",\"status\":\"" << JobGraph::statusName(job.status) << "\"" << times << "}\n";
+    }
+
+    char total[32];
+    snprintf(total, sizeof(total), "%.1f", elapsed / 1e6);
+    report << "{\"type\":\"summary\",\"jobs\":" << graph.jobs().size() << ",\"concurrency\":" << m_concurrency
+           << ",\"duration_ms\":" << total << ",\"ok\":" << (ok ? "true" : "false") << "}" << endl;
+
+    if (!report)
+        Log::warn("failed to write " + reportPath);
+
+    auto message = "finalized in " + string(total) + " ms, report in " + reportPath;
+    if (ok)
+        Log::success(message);
+    else
+        Log::warn(message + ", not every job succeeded");
+    return ok;
+}
+
+bool Finalizer::wrapWav(const string& pcmPath, const string& wavPath, unsigned int rate, unsigned int channels,
+                        const atomic<bool>& cancelled) {
+    auto in = ::open(pcmPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in == -1) {
+        Log::error("failed to open " + pcmPath + ": " + strerror(errno));
+        return false;
+    }
+
+    auto out = ::open(wavPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out == -1) {
+        Log::error("failed to create " + wavPath + ": " + strerror(errno));
+        ::close(in);
+        return false;
+    }
+
+    // whole sample frames only, a torn tail would shift every channel after it
+    auto block = channels * sizeof(int16_t);
+    uint64_t bytes = lseek(in, 0, SEEK_END) / block * block;
+    lseek(in, 0, SEEK_SET);
+
+    auto header = MultichannelRecorder::header(channels, rate, bytes);
+    auto ok = ::write(out, header.data(), header.size()) == static_cast<ssize_t>(header.size());
+
+    // in the kernel where it can, extents may even be shared
+    uint64_t copied = 0;
+    vector<char> buffer;
+    while (ok && copied < bytes && !cancelled) {
+        auto chunk = min<uint64_t>(bytes - copied, 64 << 20);
+        auto n = buffer.empty() ? copy_file_range(in, nullptr, out, nullptr, chunk, 0) : -1;
+
+        if (n == -1 && buffer.empty() && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+            buffer.resize(1 << 20);
+
+        if (!buffer.empty()) {
+            n = ::read(in, buffer.data(), min<uint64_t>(chunk, buffer.size()));
+            if (n > 0 && ::write(out, buffer.data(), n) != n)
+                n = -1;
+        }
+
+        if (n <= 0) {
+            Log::error("failed to copy " + pcmPath + " into " + wavPath + ": " + (n ? strerror(errno) : "short file"));
+            ok = false;
+            break;
+        }
+        copied += n;
+    }
+
+    ::close(in);
+    ok = ::close(out) == 0 && ok;
+    return ok && !cancelled;
+}
+
+bool Finalizer::sha256(const string& path, string& hex, const atomic<bool>& cancelled) {
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        Log::error("failed to open " + path + ": " + strerror(errno));
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    auto* ctx = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+
+    vector<char> buffer(1 << 20);
+    ssize_t n = 0;
+    while (!cancelled && (n = ::read(fd, buffer.data(), buffer.size())) > 0)
+        EVP_DigestUpdate(ctx, buffer.data(), n);
+
+    auto ok = !cancelled && n == 0;
+    if (!ok && !cancelled)
+        Log::error("failed to read " + path + ": " + strerror(errno));
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int len = 0;
+    EVP_DigestFinal_ex(ctx, digest, &len);
+    EVP_MD_CTX_free(ctx);
+    ::close(fd);
+
+    hex.clear();
+    for (unsigned int i = 0; ok && i < len; i++) {
+        char byte[3];
+        snprintf(byte, sizeof(byte), "%02x", digest[i]);
+        hex += byte;
+    }
+    return ok;
+}
+
+bool Finalizer::command(const vector<string>& args, const atomic<bool>& cancelled) {
+    // built before the fork, the child only execs
+    vector<char*> argv;
+    for (auto& arg : args)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    auto pid = fork();
+    if (pid == -1) {
+        Log::error("failed to fork for " + args[0] + ": " + strerror(errno));
+        return false;
+    }
+
+    if (pid == 0) {
+        auto null = ::open("/dev/null", O_RDONLY);
+        if (null != -1)
+            dup2(null, STDIN_FILENO);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, WNOHANG) == 0) {
+        if (cancelled) {
+            kill(pid, SIGTERM);
+            waitpid(pid, &status, 0);
+            return false;
+        }
+        usleep(20000);
+    }
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+        LOG_EVERY_MS(60000, Log::warn, args[0] + " not found, encoding is skipped");
+        return false;
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        Log::warn(args[0] + " failed with status " + to_string(WIFEXITED(status) ? WEXITSTATUS(status) : -1));
+        return false;
+    }
+    return true;
+}
+
+bool Finalizer::captureStartNs(const string& outputPath, int64_t& ns) {
+    ifstream in(outputPath + ".timing.jsonl");
+    string line;
+
+    while (getline(in, line)) {
+        JsonValue value;
+        if (!JsonValue::parse(line, value) || !value["type"].isNull())
+            continue;
+
+        // the first stamp, less the media before it
+        ns = static_cast<int64_t>(value["mono_ns"].asNumber()) - static_cast<int64_t>(value["media_ns"].asNumber());
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,64 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_FINALIZER_H
+#define MEETING_SDK_LINUX_SAMPLE_FINALIZER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Turns the raw outputs a session journal lists into finished files once
+ * recording is over, as a job graph over every core:
+ *   <stem>.wav and <stem>.flac for each PCM output
+ *   <stem>.flac for a multichannel WAV of up to 8 channels
+ *   <stem>.mp4 for raw video that kept one format
+ *   <video stem>.av.mp4, the video with the mixed audio, aligned by their
+ *   .timing.jsonl sidecars
+ *   SHA256SUMS in each directory, over the raw outputs and what was made
+ * Encoding runs ffmpeg; without it only the WAVs and checksums are made.
+ * The raw outputs are kept. Each job's timing is appended to
+ * session-<time>.finalize.jsonl next to the journal.
+ */
+class Finalizer {
+    unsigned int m_concurrency;
+    uint64_t m_timeoutMs;
+
+public:
+    /**
+     * @param concurrency jobs at once, 0 for one per core
+     */
+    Finalizer(unsigned int concurrency, uint64_t timeoutMs);
+
+    /**
+     * Finalize a session and wait for it, up to the timeout
+     * @return true if every job succeeded
+     */
+    bool run(const string& journalPath);
+
+    /**
+     * Copy raw 16-bit PCM into a WAV, RF64 if it needs to be
+     */
+    static bool wrapWav(const string& pcmPath, const string& wavPath, unsigned int rate, unsigned int channels,
+                        const atomic<bool>& cancelled);
+
+    /**
+     * SHA-256 of a file as hex
+     */
+    static bool sha256(const string& path, string& hex, const atomic<bool>& cancelled);
+
+    /**
+     * Run a program to completion, terminated if cancelled
+     * @return true if it exited with 0
+     */
+    static bool command(const vector<string>& args, const atomic<bool>& cancelled);
+
+    /**
+     * Capture time of the start of an output, from its timing sidecar
+     * @return false without a sidecar or a stamp in it
+     */
+    static bool captureStartNs(const string& outputPath, int64_t& ns);
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_FINALIZER_H
@@ -0,0 +1,360 @@
+#include "MultichannelRecorder.h"
+
+#include <algorithm>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "../util/Json.h"
+#include "../util/Log.h"
+
+namespace {
+    void put16(string& out, uint16_t value) {
+        out += static_cast<char>(value & 0xff);
+        out += static_cast<char>(value >> 8);
+    }
+
+    void put32(string& out, uint32_t value) {
+        put16(out, value & 0xffff);
+        put16(out, value >> 16);
+    }
+
+    void put64(string& out, uint64_t value) {
+        put32(out, value & 0xffffffff);
+        put32(out, value >> 32);
+    }
+
+#if defined(__SSE2__)
+    using Vec = __m128i;
+    inline Vec load(const int16_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    inline void store(int16_t* p, Vec v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    inline Vec lo16(Vec a, Vec b) { return _mm_unpacklo_epi16(a, b); }
+    inline Vec hi16(Vec a, Vec b) { return _mm_unpackhi_epi16(a, b); }
+    inline Vec lo32(Vec a, Vec b) { return _mm_unpacklo_epi32(a, b); }
+    inline Vec hi32(Vec a, Vec b) { return _mm_unpackhi_epi32(a, b); }
+    inline Vec lo64(Vec a, Vec b) { return _mm_unpacklo_epi64(a, b); }
+    inline Vec hi64(Vec a, Vec b) { return _mm_unpackhi_epi64(a, b); }
+    inline Vec addSaturated(Vec a, Vec b) { return _mm_adds_epi16(a, b); }
+#define ZOOMBOT_INTERLEAVE_SIMD 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    using Vec = int16x8_t;
+    inline Vec load(const int16_t* p) { return vld1q_s16(p); }
+    inline void store(int16_t* p, Vec v) { vst1q_s16(p, v); }
+    inline Vec lo16(Vec a, Vec b) { return vzip1q_s16(a, b); }
+    inline Vec hi16(Vec a, Vec b) { return vzip2q_s16(a, b); }
+    inline Vec lo32(Vec a, Vec b) { return vreinterpretq_s16_s32(vzip1q_s32(vreinterpretq_s32_s16(a), vreinterpretq_s32_s16(b))); }
+    inline Vec hi32(Vec a, Vec b) { return vreinterpretq_s16_s32(vzip2q_s32(vreinterpretq_s32_s16(a), vreinterpretq_s32_s16(b))); }
+    inline Vec lo64(Vec a, Vec b) { return vreinterpretq_s16_s64(vzip1q_s64(vreinterpretq_s64_s16(a), vreinterpretq_s64_s16(b))); }
+    inline Vec hi64(Vec a, Vec b) { return vreinterpretq_s16_s64(vzip2q_s64(vreinterpretq_s64_s16(a), vreinterpretq_s64_s16(b))); }
+    inline Vec addSaturated(Vec a, Vec b) { return vqaddq_s16(a, b); }
+#define ZOOMBOT_INTERLEAVE_SIMD 1
+#endif
+
+    void addInto(int16_t* dst, const int16_t* src, size_t n, unsigned int stride) {
+        size_t i = 0;
+#ifdef ZOOMBOT_INTERLEAVE_SIMD
+        for (; stride == 1 && i + 8 <= n; i += 8)
+            store(dst + i, addSaturated(load(dst + i), load(src + i)));
+#endif
+        for (; i < n; i++) {
+            auto sum = static_cast<int32_t>(dst[i]) + src[i * stride];
+            dst[i] = static_cast<int16_t>(clamp(sum, -32768, 32767));
+        }
+    }
+}
+
+MultichannelRecorder::MultichannelRecorder(size_t channels, Overflow overflow, NameOf nameOf) :
+        m_channels(max<size_t>(1, channels)),
+        m_overflow(overflow),
+        m_nameOf(move(nameOf)),
+        m_padded(MetricsRegistry::getInstance().counter("zoombot_multichannel_padded_frames_total",
+                "Silent frames written for gaps in a participant's audio")),
+        m_late(MetricsRegistry::getInstance().counter("zoombot_multichannel_late_frames_total",
+                "Frames that arrived after their place was written and were moved later")),
+        m_droppedOverflow(MetricsRegistry::getInstance().counter("zoombot_multichannel_dropped_frames_total",
+                "Frames not recorded", "reason=\"overflow\"")),
+        m_droppedAhead(MetricsRegistry::getInstance().counter("zoombot_multichannel_dropped_frames_total",
+                "Frames not recorded", "reason=\"ahead\"")),
+        m_channelsUsed(MetricsRegistry::getInstance().gauge("zoombot_multichannel_channels",
+                "Channels assigned to participants")) {}
+
+MultichannelRecorder::~MultichannelRecorder() {
+    close();
+    m_channelsUsed.set(0);
+}
+
+bool MultichannelRecorder::open(const string& path, unsigned int rate, uint64_t nowNs) {
+    if (!rate)
+        return false;
+
+    close();
+
+    // frames placed are kept until written, the ring only has to cover how far apart chunks may land
+    if (rate != m_rate) {
+        m_rate = rate;
+        m_ringFrames = frames(c_ringMs);
+        m_ring.assign(m_ringFrames * m_channels, 0);
+        m_out.resize(c_blockFrames * m_channels);
+    }
+
+    m_rows.resize(m_channels);
+
+    if (!m_sink.open(path))
+        return false;
+
+    auto head = header(m_channels, m_rate, UINT64_MAX);
+    m_sink.write(head.data(), head.size());
+
+    auto block = static_cast<uint32_t>(m_channels * sizeof(int16_t));
+    m_sink.describe("wav s16le " + to_string(m_rate) + " " + to_string(m_channels), block,
+                    static_cast<uint64_t>(block) * m_rate);
+
+    m_path = path;
+    m_startNs = nowNs;
+    m_emitted = 0;
+    fill(m_ring.begin(), m_ring.end(), 0);
+
+    // participants keep their channels across files, and are placed again by their next chunk
+    for (auto& [nodeId, node] : m_nodes)
+        node.started = false;
+
+    auto mapPath = path + ".channels.jsonl";
+    m_map.open(mapPath, ios::app);
+    if (!m_map)
+        Log::warn("failed to open " + mapPath + ", channel assignments will not be recorded");
+
+    Log::info("Recording " + to_string(m_channels) + " participant channels to " + path);
+    return true;
+}
+
+uint64_t MultichannelRecorder::frameAt(uint64_t nowNs) const {
+    return nowNs > m_startNs ? (nowNs - m_startNs) * m_rate / 1000000000ull : 0;
+}
+
+void MultichannelRecorder::assign(uint32_t nodeId, Node& node) {
+    if (m_assigned < m_channels) {
+        node.channel = static_cast<int>(m_assigned++);
+        m_channelsUsed.set(static_cast<int64_t>(m_assigned));
+        return;
+    }
+
+    if (m_overflow == Overflow::Mix) {
+        node.channel = static_cast<int>(m_channels - 1);
+        node.mixed = true;
+    }
+
+    Log::warn("All " + to_string(m_channels) + " channels are taken, participant " + to_string(nodeId) +
+              (node.mixed ? " is mixed into the last one" : " is not recorded"));
+}
+
+void MultichannelRecorder::mapLine(uint32_t nodeId, const Node& node) {
+    if (!m_map)
+        return;
+
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    string name;
+    JsonValue::appendString(name, m_nameOf ? m_nameOf(nodeId) : "");
+
+    m_map << "{\"time_ns\":" << static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec
+          << ",\"node_id\":" << nodeId << ",\"name\":" << name;
+    if (node.channel < 0)
+        m_map << ",\"channel\":null,\"overflow\":\"drop\"";
+    else
+        m_map << ",\"channel\":" << node.channel << (node.mixed ? ",\"overflow\":\"mix\"" : "")
+              << ",\"first_frame\":" << node.next;
+    m_map << "}" << endl;
+}
+
+void MultichannelRecorder::write(uint32_t nodeId, const int16_t* pcm, size_t count, unsigned int channels,
+                                 uint64_t nowNs) {
+    if (!isOpen() || !count || !channels)
+        return;
+
+    auto [it, added] = m_nodes.try_emplace(nodeId);
+    auto& node = it->second;
+    if (added)
+        assign(nodeId, node);
+
+    // what can no longer change goes first, so the ring has room for this chunk
+    auto arrival = frameAt(nowNs);
+    auto start = arrival > count ? arrival - count : 0;
+    emit(arrival > frames(c_latencyMs) ? arrival - frames(c_latencyMs) : 0);
+
+    if (node.channel < 0) {
+        if (!node.started)
+            mapLine(nodeId, node);
+        node.started = true;
+        m_droppedOverflow.inc(count);
+        return;
+    }
+
+    // placed by arrival when first heard in this file, or back after a gap
+    if (!node.started || start > node.next + frames(c_gapMs)) {
+        if (node.started)
+            m_padded.inc(start - node.next);
+        node.next = start;
+    }
+
+    if (node.next < m_emitted) {
+        m_late.inc(m_emitted - node.next);
+        node.next = m_emitted;
+    }
+
+    if (!node.started) {
+        mapLine(nodeId, node);
+        node.started = true;
+    }
+
+    if (node.next + count > arrival + frames(c_aheadMs) || node.next + count > m_emitted + m_ringFrames) {
+        m_droppedAhead.inc(count);
+        return;
+    }
+
+    // added, so participants mixed into one channel sum
+    auto* plane = m_ring.data() + node.channel * m_ringFrames;
+    auto offset = node.next % m_ringFrames;
+    auto first = min<uint64_t>(count, m_ringFrames - offset);
+    addInto(plane + offset, pcm, first, channels);
+    if (first < count)
+        addInto(plane, pcm + first * channels, count - first, channels);
+    node.next += count;
+}
+
+void MultichannelRecorder::emit(uint64_t until) {
+    while (m_emitted < until) {
+        auto offset = m_emitted % m_ringFrames;
+        auto n = min<uint64_t>({until - m_emitted, m_ringFrames - offset, c_blockFrames});
+
+        for (size_t c = 0; c < m_channels; c++)
+            m_rows[c] = m_ring.data() + c * m_ringFrames + offset;
+
+        interleave(m_rows.data(), m_channels, n, m_out.data());
+        if (!m_sink.write(reinterpret_cast<const char*>(m_out.data()), n * m_channels * sizeof(int16_t)))
+            LOG_EVERY_MS(10000, Log::warn, "failed to write " + m_path);
+
+        for (size_t c = 0; c < m_channels; c++)
+            fill_n(m_ring.data() + c * m_ringFrames + offset, n, 0);
+        m_emitted += n;
+    }
+}
+
+void MultichannelRecorder::close() {
+    if (!isOpen())
+        return;
+
+    // everything received, what has not arrived yet is silence
+    uint64_t until = m_emitted;
+    for (auto& [nodeId, node] : m_nodes) {
+        if (node.started && node.channel >= 0)
+            until = max(until, node.next);
+    }
+    emit(until);
+
+    m_sink.close();
+    m_map.close();
+
+    if (!finalize())
+        Log::warn("failed to finish the header of " + m_path + ", it is read to the end of the file");
+}
+
+bool MultichannelRecorder::finalize() {
+    auto data = m_sink.written() - c_headerSize;
+    auto head = header(m_channels, m_rate, data);
+
+    auto fd = ::open(m_path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    auto ok = pwrite(fd, head.data(), head.size(), 0) == static_cast<ssize_t>(head.size());
+    ::close(fd);
+    return ok;
+}
+
+void MultichannelRecorder::interleave(const int16_t* const* planes, size_t channels, size_t frames, int16_t* out) {
+    size_t group = 0;
+
+#ifdef ZOOMBOT_INTERLEAVE_SIMD
+    // 8 channels by 8 frames at a time, transposed in registers
+    for (; group + 8 <= channels; group += 8) {
+        auto* p = planes + group;
+        size_t f = 0;
+        for (; f + 8 <= frames; f += 8) {
+            auto t0 = lo16(load(p[0] + f), load(p[1] + f)), t1 = hi16(load(p[0] + f), load(p[1] + f));
+            auto t2 = lo16(load(p[2] + f), load(p[3] + f)), t3 = hi16(load(p[2] + f), load(p[3] + f));
+            auto t4 = lo16(load(p[4] + f), load(p[5] + f)), t5 = hi16(load(p[4] + f), load(p[5] + f));
+            auto t6 = lo16(load(p[6] + f), load(p[7] + f)), t7 = hi16(load(p[6] + f), load(p[7] + f));
+
+            auto u0 = lo32(t0, t2), u1 = hi32(t0, t2), u2 = lo32(t1, t3), u3 = hi32(t1, t3);
+            auto u4 = lo32(t4, t6), u5 = hi32(t4, t6), u6 = lo32(t5, t7), u7 = hi32(t5, t7);
+
+            auto* o = out + f * channels + group;
+            store(o, lo64(u0, u4));
+            store(o + channels, hi64(u0, u4));
+            store(o + 2 * channels, lo64(u1, u5));
+            store(o + 3 * channels, hi64(u1, u5));
+            store(o + 4 * channels, lo64(u2, u6));
+            store(o + 5 * channels, hi64(u2, u6));
+            store(o + 6 * channels, lo64(u3, u7));
+            store(o + 7 * channels, hi64(u3, u7));
+        }
+
+        for (; f < frames; f++) {
+            for (size_t c = 0; c < 8; c++)
+                out[f * channels + group + c] = p[c][f];
+        }
+    }
+#endif
+
+    for (size_t f = 0; group < channels && f < frames; f++) {
+        for (size_t c = group; c < channels; c++)
+            out[f * channels + c] = planes[c][f];
+    }
+}
+
+string MultichannelRecorder::header(size_t channels, unsigned int rate, uint64_t dataBytes) {
+    // unknown while recording, as much as the file holds
+    auto streaming = dataBytes == UINT64_MAX;
+    auto riffBytes = dataBytes + c_headerSize - 8;
+    auto rf64 = !streaming && riffBytes > UINT32_MAX;
+    auto block = static_cast<uint16_t>(channels * sizeof(int16_t));
+
+    string out;
+    out.reserve(c_headerSize);
+    out += rf64 ? "RF64" : "RIFF";
+    put32(out, streaming || rf64 ? UINT32_MAX : static_cast<uint32_t>(riffBytes));
+    out += "WAVE";
+
+    // JUNK until the sizes need 64 bits, then ds64
+    out += rf64 ? "ds64" : "JUNK";
+    put32(out, 28);
+    put64(out, rf64 ? riffBytes : 0);
+    put64(out, rf64 ? dataBytes : 0);
+    put64(out, rf64 ? dataBytes / block : 0);
+    put32(out, 0);
+
+    // WAVE_FORMAT_EXTENSIBLE, PCM, no speaker positions: channels are participants
+    out += "fmt ";
+    put32(out, 40);
+    put16(out, 0xfffe);
+    put16(out, static_cast<uint16_t>(channels));
+    put32(out, rate);
+    put32(out, rate * block);
+    put16(out, block);
+    put16(out, 16);
+    put16(out, 22);
+    put16(out, 16);
+    put32(out, 0);
+    out.append("\x01\x00\x00\x00\x00\x00\x10\x00\x80\x00\x00\xaa\x00\x38\x9b\x71", 16);
+
+    out += "data";
+    put32(out, streaming || rf64 ? UINT32_MAX : static_cast<uint32_t>(dataBytes));
+    return out;
+}
@@ -0,0 +1,138 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_MULTICHANNELRECORDER_H
+#define MEETING_SDK_LINUX_SAMPLE_MULTICHANNELRECORDER_H
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../util/Metrics.h"
+#include "FileSink.h"
+
+using namespace std;
+
+/**
+ * Records every participant on their own channel of one 16-bit WAV, so the
+ * tracks line up sample for sample. Each chunk is placed on the timeline by
+ * its arrival time: a participant's first chunk, e.g. a late joiner's, and
+ * their first chunk after a gap start where their arrival says, and the
+ * frames in between are silence. Frames are held back a little for late
+ * chunks, then interleaved (SSE2 or NEON for each group of 8 channels) and
+ * written.
+ *
+ * A participant keeps their channel for the whole recording, assigned in
+ * order of first audio. Once every channel is taken, later participants are
+ * mixed into the last one or dropped. Assignments are appended to
+ * <file>.channels.jsonl.
+ *
+ * The header is written with unknown sizes, which readers take as "to the
+ * end of the file", and filled in on close; past 4 GiB the file becomes
+ * RF64 in place of a reserved JUNK chunk.
+ */
+class MultichannelRecorder {
+public:
+    enum class Overflow { Mix, Drop };
+    using NameOf = function<string(uint32_t nodeId)>;
+
+    // 16-bit WAVE_FORMAT_EXTENSIBLE with room for ds64
+    static constexpr size_t c_headerSize = 104;
+
+private:
+    // frames held back for chunks arriving late
+    static constexpr unsigned int c_latencyMs = 250;
+
+    // a chunk this much later than its participant's previous one ends a gap
+    static constexpr unsigned int c_gapMs = 100;
+
+    // a participant this far ahead of the clock has their chunks dropped
+    static constexpr unsigned int c_aheadMs = 500;
+
+    static constexpr unsigned int c_ringMs = 2000;
+
+    // frames interleaved per write
+    static constexpr size_t c_blockFrames = 1024;
+
+    struct Node {
+        int channel = -1;
+        bool mixed = false;
+
+        // placed in this file yet, and the frame their next chunk continues at
+        bool started = false;
+        uint64_t next = 0;
+    };
+
+    size_t m_channels;
+    Overflow m_overflow;
+    NameOf m_nameOf;
+
+    unordered_map<uint32_t, Node> m_nodes;
+    size_t m_assigned = 0;
+
+    FileSink m_sink;
+    string m_path;
+    ofstream m_map;
+    unsigned int m_rate = 0;
+    uint64_t m_startNs = 0;
+
+    // one plane per channel, zeroed once written so chunks add into it
+    vector<int16_t> m_ring;
+    vector<const int16_t*> m_rows;
+    vector<int16_t> m_out;
+    uint64_t m_ringFrames = 0;
+    uint64_t m_emitted = 0;
+
+    Counter& m_padded;
+    Counter& m_late;
+    Counter& m_droppedOverflow;
+    Counter& m_droppedAhead;
+    Gauge& m_channelsUsed;
+
+    uint64_t frameAt(uint64_t nowNs) const;
+    uint64_t frames(unsigned int ms) const { return static_cast<uint64_t>(m_rate) * ms / 1000; }
+    void assign(uint32_t nodeId, Node& node);
+    void mapLine(uint32_t nodeId, const Node& node);
+    void emit(uint64_t until);
+    bool finalize();
+
+public:
+    /**
+     * @param channels channels of the file, the most participants kept apart
+     * @param nameOf names participants in the channel map
+     */
+    MultichannelRecorder(size_t channels, Overflow overflow, NameOf nameOf);
+    ~MultichannelRecorder();
+
+    /**
+     * Start a file, its timeline starting now
+     */
+    bool open(const string& path, unsigned int rate, uint64_t nowNs);
+
+    /**
+     * One chunk of a participant's audio, from the audio thread
+     * @param channels interleaved channels of the chunk, the first is kept
+     */
+    void write(uint32_t nodeId, const int16_t* pcm, size_t frames, unsigned int channels, uint64_t nowNs);
+
+    /**
+     * Write out everything received and fill in the header
+     */
+    void close();
+
+    bool flush() { return m_sink.flush(); }
+    bool isOpen() const { return m_sink.isOpen(); }
+    unsigned int rate() const { return m_rate; }
+
+    /**
+     * Interleave planes into frames, out holds frames * channels samples
+     */
+    static void interleave(const int16_t* const* planes, size_t channels, size_t frames, int16_t* out);
+
+    /**
+     * Header of a file with this much data, RF64 beyond what RIFF can say
+     */
+    static string header(size_t channels, unsigned int rate, uint64_t dataBytes);
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_MULTICHANNELRECORDER_H
@@ -0,0 +1,80 @@
+#include "PreRollRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../util/MemoryBudget.h"
+
+PreRollRing::~PreRollRing() {
+    MemoryBudget::getInstance().release(MemoryPool::Audio, m_capacity);
+}
+
+void PreRollRing::reset(size_t bytesPerSecond, unsigned int seconds) {
+    lock_guard<mutex> lock(m_lock);
+
+    // audio is never degraded, the ring is held whatever the budget says
+    auto capacity = bytesPerSecond * seconds;
+    auto& budget = MemoryBudget::getInstance();
+    budget.release(MemoryPool::Audio, m_capacity);
+    budget.reserve(MemoryPool::Audio, capacity);
+
+    m_bytesPerSecond = bytesPerSecond;
+    m_buffer.reset(capacity ? new char[capacity] : nullptr);
+    m_capacity = capacity;
+    m_end = 0;
+}
+
+void PreRollRing::push(const char* buf, size_t len) {
+    if (!m_capacity)
+        return;
+
+    lock_guard<mutex> lock(m_lock);
+
+    // only the tail of an oversized chunk can be kept
+    if (len > m_capacity) {
+        m_end += len - m_capacity;
+        buf += len - m_capacity;
+        len = m_capacity;
+    }
+
+    auto offset = m_end % m_capacity;
+    auto first = min(len, m_capacity - offset);
+    memcpy(m_buffer.get() + offset, buf, first);
+    memcpy(m_buffer.get(), buf + first, len - first);
+
+    m_end += len;
+}
+
+uint64_t PreRollRing::writeSince(FileSink& sink, uint64_t& from) const {
+    uint64_t lost = 0;
+    if (from < begin()) {
+        lost = begin() - from;
+        from = begin();
+    }
+
+    while (from < m_end) {
+        auto offset = from % m_capacity;
+        auto len = min<uint64_t>(m_end - from, m_capacity - offset);
+        sink.write(m_buffer.get() + offset, len);
+        from += len;
+    }
+
+    return lost;
+}
+
+vector<char> PreRollRing::snapshot(unsigned int seconds) const {
+    lock_guard<mutex> lock(m_lock);
+
+    auto bytes = m_bytesPerSecond * seconds;
+    auto from = max<uint64_t>(begin(), m_end - min<uint64_t>(bytes, m_end));
+    vector<char> out(m_end - from);
+
+    auto offset = from % max<size_t>(m_capacity, 1);
+    auto first = min<size_t>(out.size(), m_capacity - offset);
+    if (!out.empty()) {
+        memcpy(out.data(), m_buffer.get() + offset, first);
+        memcpy(out.data() + first, m_buffer.get(), out.size() - first);
+    }
+
+    return out;
+}
@@ -0,0 +1,75 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_PREROLLRING_H
+#define MEETING_SDK_LINUX_SAMPLE_PREROLLRING_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "FileSink.h"
+
+using namespace std;
+
+/**
+ * Fixed-size byte ring holding the most recent PCM of one stream.
+ * Bytes are addressed by their position in the stream, so a reader can ask
+ * for everything after the last position it consumed and gets whatever is
+ * still held. Memory is allocated once by reset() and then only overwritten,
+ * and is charged to the audio pool of the memory budget.
+ */
+class PreRollRing {
+    unique_ptr<char[]> m_buffer;
+    size_t m_capacity = 0;
+    size_t m_bytesPerSecond = 0;
+
+    // stream position one past the newest byte
+    uint64_t m_end = 0;
+
+    // guards the buffer against snapshot() from another thread
+    mutable mutex m_lock;
+
+public:
+    ~PreRollRing();
+
+    /**
+     * Allocate the ring, discarding anything held
+     * @param bytesPerSecond stream byte rate
+     * @param seconds duration kept, 0 disables the ring
+     */
+    void reset(size_t bytesPerSecond, unsigned int seconds);
+
+    bool enabled() const { return m_capacity > 0; }
+    size_t capacity() const { return m_capacity; }
+
+    /**
+     * Stream position one past the newest byte
+     */
+    uint64_t end() const { return m_end; }
+
+    /**
+     * Stream position of the oldest byte still held
+     */
+    uint64_t begin() const { return m_end > m_capacity ? m_end - m_capacity : 0; }
+
+    /**
+     * Append bytes, overwriting the oldest once full
+     */
+    void push(const char* buf, size_t len);
+
+    /**
+     * Write the bytes after a stream position to a sink, from the ring's own
+     * thread. Bytes that were already overwritten are skipped.
+     * @param sink output file
+     * @param from position already written, updated to end()
+     * @return bytes lost because they were overwritten before being written
+     */
+    uint64_t writeSince(FileSink& sink, uint64_t& from) const;
+
+    /**
+     * Copy the newest bytes out, safe to call from any thread
+     * @param seconds most seconds to copy
+     */
+    vector<char> snapshot(unsigned int seconds) const;
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_PREROLLRING_H
@@ -0,0 +1,457 @@
+#include "RecordingJournal.h"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "FileSink.h"
+#include "../util/Log.h"
+#include "../util/Metrics.h"
+#include "../util/Threads.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    uint32_t crc32(const char* data, size_t len) {
+        uint32_t crc = 0xffffffff;
+        for (size_t i = 0; i < len; i++) {
+            crc ^= static_cast<uint8_t>(data[i]);
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+        }
+        return ~crc;
+    }
+
+    uint64_t realtimeNs() {
+        timespec ts{};
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+
+    string seal(const string& record) {
+        char crc[16];
+        snprintf(crc, sizeof(crc), "\t%08x\n", crc32(record.data(), record.size()));
+        return record + crc;
+    }
+
+    /**
+     * Split a sealed line into fields, false if it is torn or corrupt
+     */
+    bool unseal(const string& line, vector<string>& fields) {
+        auto tab = line.rfind('\t');
+        if (tab == string::npos)
+            return false;
+
+        auto crc = strtoul(line.c_str() + tab + 1, nullptr, 16);
+        if (crc != crc32(line.data(), tab))
+            return false;
+
+        fields.clear();
+        stringstream ss(line.substr(0, tab));
+        string field;
+        while (getline(ss, field, '\t'))
+            fields.push_back(field);
+
+        return !fields.empty();
+    }
+}
+
+RecordingJournal& RecordingJournal::getInstance() {
+    static auto* instance = new RecordingJournal();
+    return *instance;
+}
+
+bool RecordingJournal::open(const string& dir, unsigned int intervalMs) {
+    close();
+
+    error_code ec;
+    fs::create_directories(dir, ec);
+
+    auto path = dir + "/session-" + to_string(time(nullptr)) + ".journal";
+    auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        Log::error("failed to open recording journal " + path + ": " + strerror(errno));
+        return false;
+    }
+
+    {
+        lock_guard<mutex> lock(m_lock);
+        m_fd = fd;
+        m_path = path;
+        m_intervalMs = intervalMs;
+        m_running = true;
+        append("S\t" + to_string(c_version) + "\t" + to_string(realtimeNs()));
+    }
+
+    m_thread = thread(&RecordingJournal::run, this);
+
+    Log::info("journaling recordings to " + path + ", synced every " + to_string(intervalMs) + " ms");
+    return true;
+}
+
+void RecordingJournal::close() {
+    {
+        lock_guard<mutex> lock(m_lock);
+        if (!m_running)
+            return;
+        m_running = false;
+    }
+
+    m_wake.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+
+    lock_guard<mutex> lock(m_lock);
+
+    // outputs still open are left unclean for recovery, the rest is done
+    if (m_entries.empty())
+        append("E\t" + to_string(realtimeNs()));
+
+    fdatasync(m_fd);
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+void RecordingJournal::run() {
+    ThreadRegistry::getInstance().enroll(ThreadClass::Writer, "zoombot-journal");
+
+    unique_lock<mutex> lock(m_lock);
+    auto interval = chrono::milliseconds(m_intervalMs);
+    auto next = chrono::steady_clock::now() + interval;
+
+    // closed outputs are retired as they come, the rest synced on the interval
+    while (m_running) {
+        m_wake.wait_until(lock, next);
+        retireClosed(lock);
+
+        if (!m_running || chrono::steady_clock::now() >= next) {
+            syncAll(lock);
+            next = chrono::steady_clock::now() + interval;
+        }
+    }
+
+    retireClosed(lock);
+}
+
+void RecordingJournal::syncAll(unique_lock<mutex>& lock) {
+    static auto& syncSeconds = MetricsRegistry::getInstance().histogram(
+            "zoombot_fdatasync_seconds", "Time to make one recording output durable");
+
+    struct Pending {
+        uint32_t id;
+        int fd;
+        uint64_t offset;
+        string path;
+        bool synced;
+    };
+
+    auto now = to_string(realtimeNs());
+    vector<Pending> pending;
+
+    for (auto& [id, entry] : m_entries) {
+        // only bytes already handed to the kernel can be made durable
+        auto offset = entry.sink->flushedOffset();
+        if (offset == entry.durable)
+            continue;
+
+        // a duplicate stays valid if the sink closes its fd while syncing
+        auto fd = dup(entry.sink->fd());
+        if (fd == -1) {
+            LOG_EVERY_MS(5000, Log::error, "failed to sync " + entry.sink->path() + ": " + strerror(errno));
+            continue;
+        }
+
+        pending.push_back({id, fd, offset, entry.sink->path(), false});
+    }
+
+    if (pending.empty())
+        return;
+
+    lock.unlock();
+    for (auto& output : pending) {
+        ScopedTimer timer(syncSeconds);
+        output.synced = fdatasync(output.fd) == 0;
+        if (!output.synced)
+            LOG_EVERY_MS(5000, Log::error, "failed to sync " + output.path + ": " + strerror(errno));
+        ::close(output.fd);
+    }
+    lock.lock();
+
+    auto changed = false;
+    for (const auto& output : pending) {
+        // closed meanwhile, its C record already has the final offset
+        auto it = m_entries.find(output.id);
+        if (!output.synced || it == m_entries.end() || it->second.durable >= output.offset)
+            continue;
+
+        it->second.durable = output.offset;
+        append("K\t" + to_string(output.id) + "\t" + to_string(output.offset) + "\t" + now);
+        changed = true;
+    }
+
+    if (changed) {
+        lock.unlock();
+        fdatasync(m_fd);
+        lock.lock();
+    }
+}
+
+void RecordingJournal::retireClosed(unique_lock<mutex>& lock) {
+    static auto& syncSeconds = MetricsRegistry::getInstance().histogram(
+            "zoombot_fdatasync_seconds", "Time to make one recording output durable");
+
+    while (!m_closed.empty()) {
+        auto closed = std::move(m_closed);
+        m_closed.clear();
+
+        lock.unlock();
+        vector<bool> synced;
+        for (const auto& output : closed) {
+            ScopedTimer timer(syncSeconds);
+            synced.push_back(FileSink::finish(output.fd, output.path, output.length, output.trim, true));
+        }
+        lock.lock();
+
+        // an output that failed to sync is left unclean, recovery keeps its whole blocks
+        for (size_t i = 0; i < closed.size(); i++) {
+            if (synced[i])
+                append("C\t" + to_string(closed[i].id) + "\t" + to_string(closed[i].length));
+        }
+
+        lock.unlock();
+        fdatasync(m_fd);
+        lock.lock();
+
+        for (const auto& output : closed)
+            m_closing.erase(m_closing.find(output.path));
+        m_retired.notify_all();
+    }
+}
+
+void RecordingJournal::append(const string& record) {
+    auto line = seal(record);
+    if (::write(m_fd, line.data(), line.size()) != static_cast<ssize_t>(line.size()))
+        LOG_EVERY_MS(5000, Log::error, "failed to append to " + m_path + ": " + strerror(errno));
+}
+
+uint32_t RecordingJournal::add(FileSink* sink) {
+    lock_guard<mutex> lock(m_lock);
+    if (!m_running)
+        return 0;
+
+    error_code ec;
+    auto path = fs::absolute(sink->path(), ec).string();
+
+    auto id = m_nextId++;
+    m_entries[id] = Entry{sink, sink->flushedOffset()};
+    append("O\t" + to_string(id) + "\t" + path);
+
+    return id;
+}
+
+void RecordingJournal::format(uint32_t id, uint64_t offset, uint32_t block, const string& format) {
+    lock_guard<mutex> lock(m_lock);
+    if (m_fd == -1)
+        return;
+
+    append("F\t" + to_string(id) + "\t" + to_string(offset) + "\t" + to_string(block) + "\t" + format);
+}
+
+bool RecordingJournal::retire(uint32_t id, int fd, const string& path, uint64_t length, bool trim) {
+    error_code ec;
+    auto absolute = fs::absolute(path, ec).string();
+
+    {
+        lock_guard<mutex> lock(m_lock);
+        if (!m_running)
+            return false;
+
+        m_entries.erase(id);
+        m_closed.push_back(Closed{id, fd, absolute, length, trim});
+        m_closing.insert(absolute);
+    }
+
+    m_wake.notify_all();
+    return true;
+}
+
+void RecordingJournal::awaitRetired(const string& path) {
+    error_code ec;
+    auto absolute = fs::absolute(path, ec).string();
+
+    unique_lock<mutex> lock(m_lock);
+    m_retired.wait(lock, [&] { return !m_closing.count(absolute); });
+}
+
+bool RecordingJournal::recover(const string& path, bool dryRun) {
+    ifstream in(path);
+    if (!in) {
+        Log::error("failed to read journal " + path);
+        return false;
+    }
+
+    struct Output {
+        string path;
+        uint64_t segment = 0;
+        uint32_t block = 1;
+        uint64_t durable = 0;
+        bool closed = false;
+    };
+
+    map<string, Output> outputs;
+    vector<string> fields;
+    string line;
+    size_t records = 0;
+    bool ended = false;
+
+    while (getline(in, line)) {
+        // everything after a torn record is unreliable
+        if (!unseal(line, fields)) {
+            Log::warn(path + ": ignoring corrupt records after #" + to_string(records));
+            break;
+        }
+        records++;
+
+        auto& type = fields[0];
+        if ((type == "E" || type == "R") && fields.size() >= 2) {
+            ended = true;
+        } else if (type == "O" && fields.size() >= 3) {
+            outputs[fields[1]] = Output{fields[2]};
+        } else if (fields.size() >= 3 && outputs.count(fields[1])) {
+            auto& output = outputs[fields[1]];
+            uint64_t offset = stoull(fields[2]);
+
+            if (type == "F" && fields.size() >= 4) {
+                output.segment = offset;
+                output.block = max(1ul, stoul(fields[3]));
+            } else if (type == "K") {
+                output.durable = max(output.durable, offset);
+            } else if (type == "C") {
+                output.durable = offset;
+                output.closed = true;
+            }
+        }
+    }
+
+    if (ended) {
+        Log::info(path + ": session ended cleanly, nothing to recover");
+        return true;
+    }
+
+    for (auto& [id, output] : outputs) {
+        if (output.closed)
+            continue;
+
+        error_code ec;
+        uint64_t size = fs::file_size(output.path, ec);
+        if (ec) {
+            Log::warn(output.path + ": " + ec.message());
+            continue;
+        }
+
+        if (size < output.durable) {
+            Log::warn(output.path + ": " + to_string(size) + " bytes on disk but " + to_string(output.durable)
+                      + " were synced, keeping what is left");
+        }
+
+        // bytes past the durable offset survive a killed process, keep the whole blocks
+        uint64_t end = size;
+        if (size > output.segment)
+            end = output.segment + (size - output.segment) / output.block * output.block;
+        if (size >= output.durable)
+            end = max(end, output.durable);
+
+        if (end == size) {
+            Log::info(output.path + ": consistent at " + to_string(size) + " bytes");
+            continue;
+        }
+
+        Log::warn(output.path + ": cutting " + to_string(size - end) + " bytes of a torn write, keeping "
+                  + to_string(end) + (dryRun ? " (dry run)" : ""));
+
+        if (!dryRun && truncate(output.path.c_str(), end) == -1)
+            Log::error(output.path + ": failed to truncate: " + strerror(errno));
+    }
+
+    if (!dryRun) {
+        auto fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (fd != -1) {
+            auto record = seal("R\t" + to_string(realtimeNs()));
+            if (::write(fd, record.data(), record.size()) == -1)
+                Log::error("failed to mark " + path + " recovered: " + strerror(errno));
+            fdatasync(fd);
+            ::close(fd);
+        }
+    }
+
+    Log::success((dryRun ? "checked session " : "recovered session ") + path);
+    return true;
+}
+
+bool RecordingJournal::outputs(const string& path, vector<Listing>& out) {
+    ifstream in(path);
+    if (!in) {
+        Log::error("failed to read journal " + path);
+        return false;
+    }
+
+    map<string, size_t> byId;
+    map<string, size_t> byPath;
+    vector<string> fields;
+    string line;
+
+    while (getline(in, line)) {
+        if (!unseal(line, fields))
+            break;
+
+        auto& type = fields[0];
+        if (type == "O" && fields.size() >= 3) {
+            auto [it, added] = byPath.emplace(fields[2], out.size());
+            if (added)
+                out.push_back(Listing{fields[2], {}});
+            byId[fields[1]] = it->second;
+        } else if (type == "F" && fields.size() >= 5 && byId.count(fields[1])) {
+            auto& formats = out[byId[fields[1]]].formats;
+            if (formats.empty() || formats.back().second != fields[4])
+                formats.emplace_back(stoull(fields[2]), fields[4]);
+        }
+    }
+
+    return true;
+}
+
+size_t RecordingJournal::recoverDir(const string& dir, bool dryRun) {
+    error_code ec;
+    size_t recovered = 0;
+
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (entry.path().extension() != ".journal")
+            continue;
+
+        // a session that is still being written is not ours to repair
+        if (entry.path().string() == getInstance().path())
+            continue;
+
+        // cheap check of the last record before a full recovery
+        ifstream in(entry.path());
+        string line, last;
+        while (getline(in, line))
+            last = line;
+
+        vector<string> fields;
+        if (unseal(last, fields) && (fields[0] == "E" || fields[0] == "R"))
+            continue;
+
+        if (recover(entry.path().string(), dryRun))
+            recovered++;
+    }
+
+    return recovered;
+}
@@ -0,0 +1,163 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_RECORDINGJOURNAL_H
+#define MEETING_SDK_LINUX_SAMPLE_RECORDINGJOURNAL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+class FileSink;
+
+/**
+ * Per-session journal of the recording outputs. A background thread
+ * fdatasync()s every open output on an interval (group commit) and appends
+ * a checkpoint with the offset each one is durable up to, so a killed bot
+ * leaves enough behind for recover() to cut its files back to a
+ * consistent point.
+ *
+ * The journal is a text file of tab separated records, each ending in the
+ * CRC-32 of the rest of the line so a torn tail is detected:
+ *   S  version  realtime_ns                    session start
+ *   O  id  path                                output opened
+ *   F  id  offset  block  format               format from offset on
+ *   K  id  offset  realtime_ns                 durable up to offset
+ *   C  id  offset                              closed cleanly
+ *   E  realtime_ns                             session ended cleanly
+ *   R  realtime_ns                             recovered
+ */
+class RecordingJournal {
+public:
+    /**
+     * An output as a journal lists it
+     */
+    struct Listing {
+        string path;
+
+        // offset each format starts at, in order
+        vector<pair<uint64_t, string>> formats;
+    };
+
+private:
+    static constexpr int c_version = 1;
+
+    struct Entry {
+        FileSink* sink;
+        uint64_t durable;
+    };
+
+    // an output closed by its sink, its fd is now the journal's
+    struct Closed {
+        uint32_t id;
+        int fd;
+        string path;
+        uint64_t length;
+        bool trim;
+    };
+
+    string m_path;
+    int m_fd = -1;
+    unsigned int m_intervalMs = 0;
+
+    // guards the entries and the journal file; not held while syncing, so
+    // an output opening or closing on the audio thread never waits on disk
+    mutex m_lock;
+    unordered_map<uint32_t, Entry> m_entries;
+    uint32_t m_nextId = 1;
+
+    // handed over by retire(), and their absolute paths until they are done
+    vector<Closed> m_closed;
+    unordered_multiset<string> m_closing;
+    condition_variable m_retired;
+
+    thread m_thread;
+    condition_variable m_wake;
+    bool m_running = false;
+
+    RecordingJournal() = default;
+
+    void run();
+    void syncAll(unique_lock<mutex>& lock);
+    void retireClosed(unique_lock<mutex>& lock);
+    void append(const string& record);
+
+public:
+    /**
+     * Never destroyed, outputs may still close during exit
+     */
+    static RecordingJournal& getInstance();
+
+    /**
+     * Start a new session journal in a directory
+     * @param dir directory for session-<time>.journal
+     * @param intervalMs group commit interval
+     * @return true on success
+     */
+    bool open(const string& dir, unsigned int intervalMs);
+
+    /**
+     * Sync everything still open, mark the session clean and stop
+     */
+    void close();
+
+    bool isOpen() const { return m_fd != -1; }
+    const string& path() const { return m_path; }
+
+    /**
+     * Start journaling an open output
+     * @return id for the other calls, 0 when the journal is closed
+     */
+    uint32_t add(FileSink* sink);
+
+    /**
+     * Record the format of the bytes written from an offset on
+     * @param block size of one sample frame or video frame, recovery keeps whole blocks
+     */
+    void format(uint32_t id, uint64_t offset, uint32_t block, const string& format);
+
+    /**
+     * Stop journaling an output and take over its fd. The journal thread
+     * trims it to length, syncs and closes it and records it closed, so
+     * the caller never waits on the disk.
+     * @param trim cut the file back to length first
+     * @return false when the journal is not running, the fd is still the caller's
+     */
+    bool retire(uint32_t id, int fd, const string& path, uint64_t length, bool trim);
+
+    /**
+     * Wait until no retired output with this path is still being closed,
+     * before it is opened again
+     */
+    void awaitRetired(const string& path);
+
+    /**
+     * Cut the outputs of an unclean session back to their last consistent
+     * point: the durable offset, extended over whole blocks still on disk
+     * @param path journal file
+     * @param dryRun only report what would change
+     * @return false if the journal could not be read
+     */
+    static bool recover(const string& path, bool dryRun = false);
+
+    /**
+     * Outputs of a session in the order they were first opened, an output
+     * reopened later is listed once
+     * @return false if the journal could not be read
+     */
+    static bool outputs(const string& path, vector<Listing>& out);
+
+    /**
+     * Recover every unclean session journal in a directory
+     * @return number of sessions recovered
+     */
+    static size_t recoverDir(const string& dir, bool dryRun = false);
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_RECORDINGJOURNAL_H
@@ -0,0 +1,171 @@
+#include "SpeakerFollower.h"
+
+#include <ctime>
+
+#include "rawdata/zoom_rawdata_api.h"
+
+#include "../util/Json.h"
+#include "../util/Log.h"
+#include "../util/Roster.h"
+
+SpeakerFollower::SpeakerFollower(IZoomSDKRendererDelegate& output, ActiveSpeaker& speaker, ZoomSDKResolution resolution) :
+        m_output(output),
+        m_speaker(speaker),
+        m_resolution(resolution),
+        m_latency(MetricsRegistry::getInstance().histogram("zoombot_video_switch_latency_seconds",
+                "Time from deciding to follow a new speaker to their first frame")),
+        m_gap(MetricsRegistry::getInstance().histogram("zoombot_video_switch_gap_seconds",
+                "Time between the last frame of the old speaker and the first of the new one")),
+        m_switched(MetricsRegistry::getInstance().counter("zoombot_video_switches_total",
+                "Switches of the followed speaker", "result=\"switched\"")),
+        m_noVideo(MetricsRegistry::getInstance().counter("zoombot_video_switches_total",
+                "Switches of the followed speaker", "result=\"no_video\"")) {}
+
+SpeakerFollower::~SpeakerFollower() {
+    for (auto& slot : m_slots) {
+        if (!slot.renderer)
+            continue;
+
+        slot.renderer->unSubscribe();
+        destroyRenderer(slot.renderer);
+        slot.renderer = nullptr;
+    }
+}
+
+bool SpeakerFollower::start(uint32_t userId, const string& logPath) {
+    // both up front, so a switch never waits for a renderer
+    for (auto& slot : m_slots) {
+        if (createRenderer(&slot.renderer, &slot) != SDKERR_SUCCESS || !slot.renderer) {
+            Log::error("failed to create a renderer to follow the active speaker");
+            return false;
+        }
+        slot.renderer->setRawDataResolution(m_resolution);
+    }
+
+    m_log.open(logPath, ios::app);
+    if (!m_log)
+        Log::warn("failed to open " + logPath + ", speaker switches will not be recorded");
+
+    auto& live = m_slots[m_live.load()];
+    if (userId && live.renderer->subscribe(userId, RAW_DATA_TYPE_VIDEO) == SDKERR_SUCCESS) {
+        live.userId = userId;
+        m_speaker.setCurrent(userId, MetricsClock::nowNs());
+    }
+
+    Log::info("Following the active speaker's video");
+    return true;
+}
+
+void SpeakerFollower::onFrame(int index, YUVRawDataI420* data) {
+    auto now = MetricsClock::nowNs();
+
+    if (index != m_live.load(memory_order_acquire)) {
+        // the standby's first frame takes over, unless the switch was given up
+        auto pending = true;
+        if (!m_pending.compare_exchange_strong(pending, false))
+            return;
+
+        auto last = m_lastFrameNs.load(memory_order_relaxed);
+        m_gapNs.store(last ? now - last : 0, memory_order_relaxed);
+        m_live.store(index, memory_order_release);
+        m_tookOverNs.store(now, memory_order_release);
+    }
+
+    m_output.onRawDataFrameReceived(data);
+    m_lastFrameNs.store(now, memory_order_relaxed);
+}
+
+bool SpeakerFollower::switchTo(uint32_t userId, uint64_t nowNs) {
+    auto live = m_live.load();
+    if (m_switching || !userId || m_slots[live].userId == userId)
+        return false;
+
+    auto& standby = m_slots[1 - live];
+    if (!standby.renderer)
+        return false;
+
+    m_from = m_slots[live].userId;
+    standby.renderer->setRawDataResolution(m_resolution);
+    if (standby.renderer->subscribe(userId, RAW_DATA_TYPE_VIDEO) != SDKERR_SUCCESS) {
+        log("subscribe_failed", userId, 0, 0);
+        m_speaker.setCurrent(m_slots[live].userId, nowNs);
+        return false;
+    }
+
+    standby.userId = userId;
+    m_decisionNs = nowNs;
+    m_switching = true;
+    m_pending.store(true, memory_order_release);
+    return true;
+}
+
+void SpeakerFollower::update(uint64_t nowNs) {
+    if (m_switching) {
+        auto tookOver = m_tookOverNs.exchange(0, memory_order_acquire);
+        if (tookOver) {
+            // the old speaker's renderer becomes the standby
+            auto& old = m_slots[1 - m_live.load()];
+            if (old.renderer)
+                old.renderer->unSubscribe();
+            old.userId = 0;
+
+            auto latency = tookOver - m_decisionNs;
+            auto gap = m_gapNs.load(memory_order_relaxed);
+            m_latency.observe(latency);
+            m_gap.observe(gap);
+            m_switched.inc();
+            log("switched", liveUser(), latency, gap);
+            m_switching = false;
+            return;
+        }
+
+        if (nowNs - m_decisionNs < c_timeoutNs)
+            return;
+
+        auto pending = true;
+        if (!m_pending.compare_exchange_strong(pending, false))
+            return;
+
+        // their video is off, stay with who is shown
+        auto& standby = m_slots[1 - m_live.load()];
+        auto to = standby.userId;
+        if (standby.renderer)
+            standby.renderer->unSubscribe();
+        standby.userId = 0;
+
+        m_noVideo.inc();
+        log("no_video", to, 0, 0);
+        m_speaker.setCurrent(liveUser(), nowNs);
+        m_switching = false;
+        return;
+    }
+
+    auto next = m_speaker.update(nowNs);
+    if (next)
+        switchTo(next, nowNs);
+}
+
+void SpeakerFollower::setResolution(ZoomSDKResolution resolution) {
+    m_resolution = resolution;
+    for (auto& slot : m_slots) {
+        if (slot.renderer && slot.userId)
+            slot.renderer->setRawDataResolution(resolution);
+    }
+}
+
+void SpeakerFollower::log(const char* result, uint32_t to, uint64_t latencyNs, uint64_t gapNs) {
+    Log::info(string("video follows ") + to_string(to) + ": " + result);
+    if (!m_log)
+        return;
+
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    string name;
+    JsonValue::appendString(name, Roster::getInstance().name(to));
+
+    // flushed per line, switches are rare and readers may follow the file live
+    m_log << "{\"time_ns\":" << static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec
+          << ",\"result\":\"" << result << "\",\"from\":" << m_from << ",\"to\":" << to << ",\"name\":" << name
+          << ",\"latency_ms\":" << latencyNs / 1e6 << ",\"gap_ms\":" << gapNs / 1e6 << "}" << endl;
+}
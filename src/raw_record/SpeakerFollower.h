@@ -0,0 +1,110 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_SPEAKERFOLLOWER_H
+#define MEETING_SDK_LINUX_SAMPLE_SPEAKERFOLLOWER_H
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "zoom_sdk_raw_data_def.h"
+#include "rawdata/rawdata_renderer_interface.h"
+
+#include "../util/Metrics.h"
+#include "ActiveSpeaker.h"
+
+using namespace std;
+using namespace ZOOMSDK;
+
+/**
+ * Records the active speaker's video through two renderers. The live one
+ * feeds the output; to switch, the warm standby subscribes to the new
+ * speaker while the live one keeps writing, and takes over with its first
+ * frame. The output so never waits for a subscription, and a participant
+ * whose video never arrives costs nothing but a line in the switch log.
+ *
+ * Every switch is appended to <video>.switches.jsonl with the time from the
+ * decision to the new speaker's first frame (latency) and the time between
+ * the last frame of the old speaker and it (gap).
+ */
+class SpeakerFollower {
+    // a standby that shows no frame in this long is given up
+    static constexpr uint64_t c_timeoutNs = 3000000000ull;
+
+    class Slot : public IZoomSDKRendererDelegate {
+        SpeakerFollower& m_owner;
+        int m_index;
+
+    public:
+        IZoomSDKRenderer* renderer = nullptr;
+        uint32_t userId = 0;
+
+        Slot(SpeakerFollower& owner, int index) : m_owner(owner), m_index(index) {}
+
+        void onRawDataFrameReceived(YUVRawDataI420* data) override { m_owner.onFrame(m_index, data); }
+        void onRawDataStatusChanged(RawDataStatus status) override {};
+        void onRendererBeDestroyed() override { renderer = nullptr; }
+    };
+
+    IZoomSDKRendererDelegate& m_output;
+    ActiveSpeaker& m_speaker;
+    ZoomSDKResolution m_resolution;
+
+    Slot m_slots[2]{{*this, 0}, {*this, 1}};
+
+    // shared with the video thread
+    atomic<int> m_live{0};
+    atomic<bool> m_pending{false};
+    atomic<uint64_t> m_lastFrameNs{0};
+    atomic<uint64_t> m_tookOverNs{0};
+    atomic<uint64_t> m_gapNs{0};
+
+    // main loop only
+    bool m_switching = false;
+    uint32_t m_from = 0;
+    uint64_t m_decisionNs = 0;
+    ofstream m_log;
+
+    Histogram& m_latency;
+    Histogram& m_gap;
+    Counter& m_switched;
+    Counter& m_noVideo;
+
+    void onFrame(int index, YUVRawDataI420* data);
+    void log(const char* result, uint32_t to, uint64_t latencyNs, uint64_t gapNs);
+
+public:
+    /**
+     * @param output receives the live renderer's frames
+     * @param speaker decides who to follow
+     */
+    SpeakerFollower(IZoomSDKRendererDelegate& output, ActiveSpeaker& speaker, ZoomSDKResolution resolution);
+    ~SpeakerFollower();
+
+    /**
+     * Create both renderers and subscribe the live one
+     * @param userId first participant to show, 0 for nobody yet
+     * @param logPath switch log
+     */
+    bool start(uint32_t userId, const string& logPath);
+
+    /**
+     * Switch to whoever the tracker picked, and finish or give up switches
+     * in flight, from the main loop
+     */
+    void update(uint64_t nowNs);
+
+    /**
+     * Start switching to a participant, from the main loop
+     * @return false if already switching or showing them
+     */
+    bool switchTo(uint32_t userId, uint64_t nowNs);
+
+    void setResolution(ZoomSDKResolution resolution);
+
+    /**
+     * Participant whose video is written now
+     */
+    uint32_t liveUser() const { return m_slots[m_live.load()].userId; }
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_SPEAKERFOLLOWER_H
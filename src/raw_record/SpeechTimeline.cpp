@@ -0,0 +1,135 @@
+#include "SpeechTimeline.h"
+
+#include <cstdio>
+#include <ctime>
+
+namespace {
+    void appendNumber(string& out, double value) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.1f", value);
+        out += buf;
+    }
+}
+
+SpeechTimeline::SpeechTimeline(Output output) :
+        m_output(move(output)),
+        m_spurts(MetricsRegistry::getInstance().counter("zoombot_speech_spurts_total",
+                "Talk spurts ended, across participants")),
+        m_talking(MetricsRegistry::getInstance().gauge("zoombot_speech_talking",
+                "Participants talking now")) {
+    timespec real{};
+    clock_gettime(CLOCK_REALTIME, &real);
+    auto realNs = static_cast<int64_t>(real.tv_sec) * 1000000000ll + real.tv_nsec;
+    m_realtimeOffsetNs = realNs - static_cast<int64_t>(MetricsClock::nowNs());
+}
+
+SpeechTimeline::~SpeechTimeline() {
+    for (auto& [nodeId, node] : m_nodes) {
+        if (node.talking)
+            m_talking.sub(1);
+    }
+}
+
+void SpeechTimeline::add(uint32_t nodeId, const AudioLevel& level, unsigned int ms, uint64_t nowNs) {
+    auto& node = m_nodes[nodeId];
+    node.window.add(level);
+    node.windowMs += ms;
+    node.lastNs = nowNs;
+
+    if (node.windowMs >= c_windowMs) {
+        window(nodeId, node, nowNs);
+        node.window = {};
+        node.windowMs = 0;
+    }
+
+    // others' spurts end here when their audio stops coming
+    if (nowNs >= m_nextExpiryNs) {
+        expire(nowNs);
+        m_nextExpiryNs = nowNs + c_windowMs * 1000000ull;
+    }
+}
+
+void SpeechTimeline::window(uint32_t nodeId, Node& node, uint64_t nowNs) {
+    auto energy = node.window.meanSquare();
+
+    if (!node.talking) {
+        if (energy < c_startEnergy) {
+            node.loudWindows = 0;
+            return;
+        }
+
+        // the spurt is dated from its first loud window
+        if (node.loudWindows++ == 0) {
+            node.startNs = nowNs - node.windowMs * 1000000ull;
+            node.spurt = {};
+        }
+
+        node.spurt.add(node.window);
+        node.endNs = nowNs;
+        if (node.loudWindows >= c_attackWindows)
+            start(nodeId, node);
+        return;
+    }
+
+    if (energy >= c_endEnergy) {
+        node.spurt.add(node.quiet);
+        node.spurt.add(node.window);
+        node.quiet = {};
+        node.quietMs = 0;
+        node.endNs = nowNs;
+        return;
+    }
+
+    node.quiet.add(node.window);
+    node.quietMs += node.windowMs;
+    if (node.quietMs >= c_hangoverMs)
+        end(nodeId, node);
+}
+
+void SpeechTimeline::start(uint32_t nodeId, Node& node) {
+    node.talking = true;
+    node.quiet = {};
+    node.quietMs = 0;
+    m_talking.add(1);
+
+    m_output("{\"type\":\"speech\",\"event\":\"start\",\"node_id\":" + to_string(nodeId) +
+             ",\"time_ns\":" + to_string(realtime(node.startNs)) + "}", false);
+}
+
+void SpeechTimeline::end(uint32_t nodeId, Node& node) {
+    node.talking = false;
+    node.loudWindows = 0;
+    m_talking.sub(1);
+    m_spurts.inc();
+
+    auto line = "{\"type\":\"speech\",\"event\":\"end\",\"node_id\":" + to_string(nodeId) +
+                ",\"time_ns\":" + to_string(realtime(node.endNs)) +
+                ",\"start_ns\":" + to_string(realtime(node.startNs)) +
+                ",\"duration_ms\":" + to_string((node.endNs - node.startNs) / 1000000) + ",\"rms_dbfs\":";
+    appendNumber(line, node.spurt.rmsDbfs());
+    line += ",\"peak_dbfs\":";
+    appendNumber(line, node.spurt.peakDbfs());
+    line += "}";
+    m_output(line, true);
+}
+
+void SpeechTimeline::expire(uint64_t nowNs) {
+    for (auto& [nodeId, node] : m_nodes) {
+        if (nowNs - node.lastNs <= c_staleNs)
+            continue;
+
+        if (node.talking)
+            end(nodeId, node);
+        node.loudWindows = 0;
+        node.window = {};
+        node.windowMs = 0;
+    }
+}
+
+void SpeechTimeline::finish() {
+    for (auto& [nodeId, node] : m_nodes) {
+        if (node.talking)
+            end(nodeId, node);
+        node.loudWindows = 0;
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_SPEECHTIMELINE_H
+#define MEETING_SDK_LINUX_SAMPLE_SPEECHTIMELINE_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "../util/Metrics.h"
+#include "AudioLevel.h"
+
+using namespace std;
+
+/**
+ * Who spoke when, from each participant's audio levels as they arrive.
+ * Chunks are summed into fixed windows; a talk spurt starts after a couple
+ * of windows above the upper threshold and ends once the level has stayed
+ * under the lower one for the hangover, so breaths between words do not
+ * split it. A participant whose audio stops closes their spurt too.
+ *
+ * Lines are {"type":"speech","event":"start",...} when someone starts
+ * talking and {"type":"speech","event":"end",...} with the whole spurt's
+ * start, duration and levels when they stop.
+ */
+class SpeechTimeline {
+public:
+    /**
+     * @param line one JSON object, without newline
+     * @param complete the end of a spurt, which carries everything about it
+     */
+    using Output = function<void(const string& line, bool complete)>;
+
+private:
+    static constexpr unsigned int c_windowMs = 50;
+
+    // a window above this is talking, about -40 dBFS; one under the lower, about -46 dBFS, is quiet
+    static constexpr double c_startEnergy = 330.0 * 330.0;
+    static constexpr double c_endEnergy = 165.0 * 165.0;
+
+    static constexpr unsigned int c_attackWindows = 2;
+    static constexpr unsigned int c_hangoverMs = 500;
+
+    // a participant sending nothing for this long has stopped, e.g. muted
+    static constexpr uint64_t c_staleNs = 1000000000ull;
+
+    struct Node {
+        AudioLevel window;
+        unsigned int windowMs = 0;
+        uint64_t lastNs = 0;
+
+        bool talking = false;
+        unsigned int loudWindows = 0;
+        unsigned int quietMs = 0;
+
+        // the spurt so far, up to its last window above the lower threshold,
+        // and the quiet windows after it, counted only if talking resumes
+        uint64_t startNs = 0;
+        uint64_t endNs = 0;
+        AudioLevel spurt;
+        AudioLevel quiet;
+    };
+
+    unordered_map<uint32_t, Node> m_nodes;
+    Output m_output;
+
+    // realtime minus monotonic, to stamp lines like the other sidecars
+    int64_t m_realtimeOffsetNs;
+    uint64_t m_nextExpiryNs = 0;
+
+    Counter& m_spurts;
+    Gauge& m_talking;
+
+    void window(uint32_t nodeId, Node& node, uint64_t nowNs);
+    void start(uint32_t nodeId, Node& node);
+    void end(uint32_t nodeId, Node& node);
+    void expire(uint64_t nowNs);
+    uint64_t realtime(uint64_t monotonicNs) const { return monotonicNs + m_realtimeOffsetNs; }
+
+public:
+    explicit SpeechTimeline(Output output);
+    ~SpeechTimeline();
+
+    /**
+     * One chunk of a participant's audio, from the audio thread
+     * @param nowNs monotonic arrival time
+     */
+    void add(uint32_t nodeId, const AudioLevel& level, unsigned int ms, uint64_t nowNs);
+
+    /**
+     * End every spurt in progress, once callbacks have stopped
+     */
+    void finish();
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_SPEECHTIMELINE_H
@@ -0,0 +1,150 @@
+#include "StreamTiming.h"
+
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+
+#include "../util/Json.h"
+#include "../util/Log.h"
+
+StreamTiming::StreamTiming(const string& stream) :
+        m_jumps(MetricsRegistry::getInstance().counter("zoombot_timing_jumps_total",
+                "Discontinuities between a stream's media clock and the monotonic clock",
+                "stream=\"" + stream + "\"")),
+        m_gaps(MetricsRegistry::getInstance().histogram("zoombot_timing_gap_seconds",
+                "Gaps in a stream filled to keep its file on the capture clock",
+                "stream=\"" + stream + "\"")) {}
+
+bool StreamTiming::open(const string& outputPath, const string& format, uint64_t jumpNs) {
+    close();
+
+    auto path = outputPath + ".timing.jsonl";
+    m_out.open(path, ios::app);
+    if (!m_out) {
+        Log::warn("failed to open " + path + ", capture times will not be recorded");
+        return false;
+    }
+
+    m_jumpNs = jumpNs;
+    m_started = false;
+    m_resumed = false;
+    m_refit = false;
+
+    // both clocks as close together as two calls get
+    timespec mono{}, real{};
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &real);
+
+    auto slash = outputPath.rfind('/');
+    string stream, fmt;
+    JsonValue::appendString(stream, slash == string::npos ? outputPath : outputPath.substr(slash + 1));
+    JsonValue::appendString(fmt, format);
+
+    m_out << "{\"type\":\"start\",\"stream\":" << stream << ",\"format\":" << fmt
+          << ",\"mono_ns\":" << static_cast<uint64_t>(mono.tv_sec) * 1000000000ull + mono.tv_nsec
+          << ",\"real_ns\":" << static_cast<uint64_t>(real.tv_sec) * 1000000000ull + real.tv_nsec << "}" << endl;
+    return true;
+}
+
+void StreamTiming::stamp(uint64_t monoNs, uint64_t mediaNs, uint64_t position) {
+    if (!m_out.is_open())
+        return;
+
+    if (!m_started) {
+        m_started = true;
+        m_firstMono = monoNs;
+        m_firstMedia = mediaNs;
+        m_lastX = m_lastSkew = 0;
+        m_sw = m_sx = m_sy = m_sxx = m_sxy = m_drift = 0;
+        m_last = {monoNs, mediaNs, position};
+        line(monoNs, mediaNs, position, false);
+        return;
+    }
+
+    auto x = static_cast<double>(mediaNs - m_firstMedia) / 1e9;
+    auto skew = (static_cast<double>(monoNs - m_firstMono) - static_cast<double>(mediaNs - m_firstMedia)) / 1e9;
+
+    // off the line through the last point: the fit starts over from here
+    auto off = fabs(skew - (m_lastSkew + m_drift * (x - m_lastX))) * 1e9 > m_jumpNs;
+    auto jump = m_resumed || m_refit || off;
+    if (jump) {
+        if (!m_resumed && !m_refit)
+            m_jumps.inc();
+        m_resumed = false;
+        m_refit = false;
+
+        // the last point before it too, so nothing interpolates across the gap
+        lastLine();
+        m_sw = m_sx = m_sy = m_sxx = m_sxy = 0;
+    }
+
+    // older points fade with the media time since
+    auto decay = exp(-(x - m_lastX) / c_windowS);
+    m_sw = m_sw * decay + 1;
+    m_sx = m_sx * decay + x;
+    m_sy = m_sy * decay + skew;
+    m_sxx = m_sxx * decay + x * x;
+    m_sxy = m_sxy * decay + x * skew;
+
+    auto det = m_sw * m_sxx - m_sx * m_sx;
+    if (m_sw > 2 && det > 1e-9)
+        m_drift = (m_sw * m_sxy - m_sx * m_sy) / det;
+
+    m_lastX = x;
+    m_lastSkew = skew;
+    m_last = {monoNs, mediaNs, position};
+
+    m_lineWritten = false;
+    if (jump || monoNs - m_lastLineMono >= c_intervalNs)
+        line(monoNs, mediaNs, position, jump);
+}
+
+uint64_t StreamTiming::gapNs(uint64_t monoNs, uint64_t mediaNs) const {
+    if (!m_started || m_resumed)
+        return 0;
+
+    auto x = static_cast<double>(mediaNs - m_firstMedia) / 1e9;
+    auto skew = (static_cast<double>(monoNs - m_firstMono) - static_cast<double>(mediaNs - m_firstMedia)) / 1e9;
+    auto late = (skew - (m_lastSkew + m_drift * (x - m_lastX))) * 1e9;
+    return late > m_jumpNs ? static_cast<uint64_t>(late) : 0;
+}
+
+void StreamTiming::gap(uint64_t monoNs, uint64_t missingNs, uint64_t filledNs, const char* fill) {
+    m_gaps.observe(missingNs);
+    if (!m_out.is_open())
+        return;
+
+    m_refit = true;
+
+    lastLine();
+    m_out << "{\"type\":\"gap\",\"mono_ns\":" << monoNs << ",\"media_ns\":" << m_last.media
+          << ",\"position\":" << m_last.position << ",\"missing_ns\":" << missingNs
+          << ",\"filled_ns\":" << filledNs << ",\"fill\":\"" << fill << "\"}" << endl;
+}
+
+void StreamTiming::lastLine() {
+    if (m_started && !m_lineWritten)
+        line(m_last.mono, m_last.media, m_last.position, false);
+}
+
+void StreamTiming::line(uint64_t monoNs, uint64_t mediaNs, uint64_t position, bool jump) {
+    m_lastLineMono = monoNs;
+    m_lineWritten = true;
+
+    char drift[32];
+    snprintf(drift, sizeof(drift), "%.1f", driftPpm());
+
+    // flushed per line, a second of timing is worth a syscall and readers may follow the file live
+    m_out << "{\"mono_ns\":" << monoNs << ",\"media_ns\":" << mediaNs << ",\"position\":" << position
+          << ",\"skew_ns\":" << static_cast<int64_t>(m_lastSkew * 1e9) << ",\"drift_ppm\":" << drift
+          << ",\"jump\":" << (jump ? "true" : "false") << "}" << endl;
+}
+
+void StreamTiming::close() {
+    // the end of the file, so readers need not extrapolate
+    lastLine();
+
+    if (m_out.is_open())
+        m_out.close();
+    m_started = false;
+}
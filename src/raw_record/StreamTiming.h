@@ -0,0 +1,121 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_STREAMTIMING_H
+#define MEETING_SDK_LINUX_SAMPLE_STREAMTIMING_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "../util/Metrics.h"
+
+using namespace std;
+
+/**
+ * Capture timing of one output file, <output>.timing.jsonl. Each chunk or
+ * frame written is stamped with CLOCK_MONOTONIC at callback entry against
+ * its position in the file on the stream's nominal clock. Skew is how far
+ * the monotonic clock has moved past the media clock since the first stamp;
+ * drift is its slope, a least-squares fit over about the last minute.
+ *
+ * The file starts with the monotonic and realtime clocks read together, so
+ * other clocks can be related to it. A line follows every second, and
+ * whenever the skew jumps off the fitted line: a gap in the stream, or a
+ * burst after one. Between lines positions map to times linearly.
+ *   {"type":"start","stream":"test.pcm","format":"...","mono_ns":M,"real_ns":R}
+ *   {"mono_ns":M,"media_ns":T,"position":P,"skew_ns":S,"drift_ppm":D,"jump":false}
+ * position is the byte offset the chunk ends at for audio, and the number
+ * of the frame for video.
+ *
+ * Writers ask for gapNs() before writing, fill what is missing, e.g. with
+ * silence, and report it, so the file stays on the capture clock:
+ *   {"type":"gap","mono_ns":M,"media_ns":T,"position":P,"missing_ns":N,"filled_ns":F,"fill":"silence"}
+ * media_ns and position are where the filler starts. The fit starts over
+ * after it, as after a jump, so what the filler could not cover is not
+ * taken for drift.
+ */
+class StreamTiming {
+    static constexpr uint64_t c_intervalNs = 1000000000ull;
+
+    // time constant of the drift fit, in seconds of media
+    static constexpr double c_windowS = 60;
+
+    ofstream m_out;
+    uint64_t m_jumpNs = 0;
+    bool m_started = false;
+
+    uint64_t m_firstMono = 0;
+    uint64_t m_firstMedia = 0;
+    uint64_t m_lastLineMono = 0;
+
+    struct Point {
+        uint64_t mono = 0;
+        uint64_t media = 0;
+        uint64_t position = 0;
+    };
+
+    Point m_last;
+    bool m_lineWritten = false;
+
+    // the next stamp starts the fit over: after a stop, or a filled gap
+    bool m_resumed = false;
+    bool m_refit = false;
+
+    // the last point and the fit, seconds of media against seconds of skew
+    double m_lastX = 0;
+    double m_lastSkew = 0;
+    double m_sw = 0, m_sx = 0, m_sy = 0, m_sxx = 0, m_sxy = 0;
+    double m_drift = 0;
+
+    Counter& m_jumps;
+    Histogram& m_gaps;
+
+    void line(uint64_t monoNs, uint64_t mediaNs, uint64_t position, bool jump);
+    void lastLine();
+
+public:
+    /**
+     * @param stream audio or video, labels the jump counter
+     */
+    explicit StreamTiming(const string& stream);
+    ~StreamTiming() { close(); }
+
+    /**
+     * Start the sidecar of an output
+     * @param jumpNs skew away from the fit that counts as a discontinuity
+     */
+    bool open(const string& outputPath, const string& format, uint64_t jumpNs);
+
+    /**
+     * The data up to position was received at monoNs
+     * @param mediaNs position on the stream's nominal clock
+     */
+    void stamp(uint64_t monoNs, uint64_t mediaNs, uint64_t position);
+
+    /**
+     * How much later than the fitted clock data ending at mediaNs arrives,
+     * 0 unless it is past the jump threshold
+     */
+    uint64_t gapNs(uint64_t monoNs, uint64_t mediaNs) const;
+
+    /**
+     * Filler for a gap follows the last stamp
+     * @param filledNs how much of missingNs the filler covers
+     * @param fill what was written, e.g. silence
+     */
+    void gap(uint64_t monoNs, uint64_t missingNs, uint64_t filledNs, const char* fill);
+
+    /**
+     * The stream stopped on purpose, e.g. recording was stopped; the next
+     * stamp continues without a gap and refits
+     */
+    void resume() { m_resumed = true; }
+
+    void close();
+    bool isOpen() const { return m_out.is_open(); }
+
+    /**
+     * Parts per million the monotonic clock runs ahead of the stream's
+     */
+    double driftPpm() const { return m_drift * 1e6; }
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_STREAMTIMING_H
@@ -0,0 +1,137 @@
+#include "VideoQualityController.h"
+
+#include <algorithm>
+
+#include "../util/Log.h"
+
+namespace {
+    // from best to cheapest, decimation only once the resolution is at its lowest
+    const VideoQualityController::Step c_ladder[] = {
+            {ZoomSDKResolution_1080P, 1920, 1080, 1, 2.25},
+            {ZoomSDKResolution_720P, 1280, 720, 1, 1},
+            {ZoomSDKResolution_360P, 640, 360, 1, 0.25},
+            {ZoomSDKResolution_360P, 640, 360, 2, 0.125},
+            {ZoomSDKResolution_360P, 640, 360, 3, 1.0 / 12},
+    };
+
+    constexpr size_t c_steps = sizeof(c_ladder) / sizeof(c_ladder[0]);
+
+    string percent(double share) {
+        return to_string(static_cast<int>(share * 100)) + "%";
+    }
+}
+
+VideoQualityController::VideoQualityController(ZoomSDKResolution ceiling) :
+        m_ceiling(2),
+        m_stepGauge(MetricsRegistry::getInstance().gauge("zoombot_video_quality_step",
+                "Adaptive video step: 0 1080p, 1 720p, 2 360p, 3 and 4 360p decimated")),
+        m_down(MetricsRegistry::getInstance().counter("zoombot_video_quality_changes_total",
+                "Adaptive video resolution or frame rate changes", "direction=\"down\"")),
+        m_up(MetricsRegistry::getInstance().counter("zoombot_video_quality_changes_total",
+                "Adaptive video resolution or frame rate changes", "direction=\"up\"")) {
+    for (size_t i = 0; i < c_steps; i++) {
+        if (c_ladder[i].resolution == ceiling) {
+            m_ceiling = i;
+            break;
+        }
+    }
+
+    m_step = m_ceiling;
+    m_stepGauge.set(m_step);
+}
+
+const char* VideoQualityController::resolutionName(ZoomSDKResolution resolution) {
+    switch (resolution) {
+        case ZoomSDKResolution_90P: return "90p";
+        case ZoomSDKResolution_180P: return "180p";
+        case ZoomSDKResolution_360P: return "360p";
+        case ZoomSDKResolution_720P: return "720p";
+        case ZoomSDKResolution_1080P: return "1080p";
+        default: return "unknown";
+    }
+}
+
+bool VideoQualityController::parseResolution(const string& name, ZoomSDKResolution& resolution) {
+    if (name == "360")
+        resolution = ZoomSDKResolution_360P;
+    else if (name == "720")
+        resolution = ZoomSDKResolution_720P;
+    else if (name == "1080")
+        resolution = ZoomSDKResolution_1080P;
+    else
+        return false;
+
+    return true;
+}
+
+const VideoQualityController::Step& VideoQualityController::step() const {
+    return c_ladder[m_step];
+}
+
+string VideoQualityController::describe() const {
+    auto& step = c_ladder[m_step];
+    string out = resolutionName(step.resolution);
+    if (step.decimation > 1)
+        out += " at 1/" + to_string(step.decimation) + " frame rate";
+    return out;
+}
+
+bool VideoQualityController::update(size_t queued, size_t depth, uint64_t busyNs, uint64_t nowNs) {
+    if (!m_windowStart) {
+        m_windowStart = nowNs;
+        m_windowBusy = busyNs;
+        return false;
+    }
+
+    // the fullest the queue got, a short burst is enough to count
+    m_windowQueue = max(m_windowQueue, depth ? static_cast<double>(queued) / depth : 0.0);
+    if (nowNs - m_windowStart < c_windowNs)
+        return false;
+
+    auto queue = m_windowQueue;
+    auto busy = static_cast<double>(busyNs - m_windowBusy) / (nowNs - m_windowStart);
+    m_windowStart = nowNs;
+    m_windowBusy = busyNs;
+    m_windowQueue = 0;
+
+    // let the queue drain and the writer settle at the new rate before judging it
+    if (m_hold) {
+        m_hold--;
+        return false;
+    }
+
+    auto previous = m_step;
+    if (queue > c_pressureQueue || busy > c_pressureBusy) {
+        m_calm = 0;
+        if (++m_pressured >= c_downWindows && m_step + 1 < c_steps)
+            m_step++;
+    } else {
+        m_pressured = 0;
+
+        // only step up if the writer would still keep up at the higher cost
+        auto headroom = m_step > m_ceiling && queue < c_upQueue
+                && busy * c_ladder[m_step - 1].cost / c_ladder[m_step].cost < c_upBusy;
+
+        m_calm = headroom ? m_calm + 1 : 0;
+        if (m_calm >= c_upWindows)
+            m_step--;
+    }
+
+    if (m_step == previous)
+        return false;
+
+    m_pressured = m_calm = 0;
+    m_hold = c_holdWindows;
+    m_stepGauge.set(m_step);
+
+    auto reason = "queue " + percent(queue) + ", writer busy " + percent(busy);
+    if (m_step > previous) {
+        m_down.inc();
+        Log::warn("video falling behind, recording " + describe() + " (" + reason + ")");
+    } else {
+        m_up.inc();
+        Log::info("video caught up, recording " + describe() + " (" + reason + ")");
+    }
+
+    return true;
+}
@@ -0,0 +1,91 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_VIDEOQUALITYCONTROLLER_H
+#define MEETING_SDK_LINUX_SAMPLE_VIDEOQUALITYCONTROLLER_H
+
+#include <cstdint>
+#include <string>
+
+#include "zoom_sdk_raw_data_def.h"
+#include "rawdata/rawdata_renderer_interface.h"
+
+#include "../util/Metrics.h"
+
+using namespace std;
+using namespace ZOOMSDK;
+
+/**
+ * Steps the subscribed video resolution and frame decimation down while the
+ * writer falls behind and back up once it has headroom, so a slow disk costs
+ * quality rather than frames. Fed once per main loop tick with the writer's
+ * queue depth and the time it spent writing; decides once per second.
+ */
+class VideoQualityController {
+public:
+    struct Step {
+        ZoomSDKResolution resolution;
+        unsigned int width;
+        unsigned int height;
+        // keep one frame in this many
+        unsigned int decimation;
+        // write cost relative to 720p at full rate
+        double cost;
+    };
+
+private:
+    static constexpr uint64_t c_windowNs = 1000000000ull;
+
+    // queue share or write time share of a window that counts as falling behind
+    static constexpr double c_pressureQueue = 0.5;
+    static constexpr double c_pressureBusy = 0.85;
+
+    // stepping up must leave the writer below this share, and the queue near empty
+    static constexpr double c_upBusy = 0.7;
+    static constexpr double c_upQueue = 0.05;
+
+    // consecutive windows needed to step down or up, and windows ignored after a change
+    static constexpr unsigned int c_downWindows = 1;
+    static constexpr unsigned int c_upWindows = 10;
+    static constexpr unsigned int c_holdWindows = 3;
+
+    size_t m_ceiling;
+    size_t m_step;
+
+    uint64_t m_windowStart = 0;
+    uint64_t m_windowBusy = 0;
+    double m_windowQueue = 0;
+
+    unsigned int m_pressured = 0;
+    unsigned int m_calm = 0;
+    unsigned int m_hold = 0;
+
+    Gauge& m_stepGauge;
+    Counter& m_down;
+    Counter& m_up;
+
+public:
+    /**
+     * @param ceiling highest resolution to subscribe, also the starting one
+     */
+    explicit VideoQualityController(ZoomSDKResolution ceiling = ZoomSDKResolution_720P);
+
+    static const char* resolutionName(ZoomSDKResolution resolution);
+
+    /**
+     * Parse "360", "720" or "1080"
+     * @return false if it is none of those
+     */
+    static bool parseResolution(const string& name, ZoomSDKResolution& resolution);
+
+    /**
+     * @param queued frames waiting for the writer
+     * @param depth capacity of the writer queue
+     * @param busyNs total time the writer has spent writing
+     * @param nowNs monotonic time
+     * @return true if the step changed
+     */
+    bool update(size_t queued, size_t depth, uint64_t busyNs, uint64_t nowNs);
+
+    const Step& step() const;
+    string describe() const;
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_VIDEOQUALITYCONTROLLER_H
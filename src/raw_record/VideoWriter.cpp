@@ -0,0 +1,396 @@
+#include "VideoWriter.h"
+
+#include <cstring>
+#include <utility>
+
+#include "../util/Log.h"
+#include "../util/MemoryBudget.h"
+#include "../util/Threads.h"
+#include "../util/Trace.h"
+
+namespace {
+    Counter& skipped(const string& reason) {
+        return MetricsRegistry::getInstance().counter("zoombot_video_frames_skipped_total",
+                "Video frames not queued for writing", "reason=\"" + reason + "\"");
+    }
+}
+
+VideoWriter::VideoWriter(CallbackMetrics& metrics) :
+        m_decimated(skipped("decimated")),
+        m_overBudget(skipped("budget")),
+        m_queueFull(skipped("queue_full")),
+        m_metrics(metrics) {
+    m_spare.reserve(c_poolFrames);
+}
+
+VideoWriter::~VideoWriter() {
+    close();
+}
+
+void VideoWriter::setOutput(const string& path, bool directIO, unsigned int fps) {
+    // set before the lock is let go, so no frame starts a writer on the old output
+    unique_lock<mutex> lock(m_lock);
+    stop(lock);
+
+    m_path = path;
+    m_directIO = directIO;
+    m_fps = fps;
+    m_sourceFrameNs = 1e9 / fps;
+    m_intervals = 0;
+}
+
+bool VideoWriter::submit(const char* data, size_t len, unsigned int width, unsigned int height, uint64_t arrivalNs) {
+    auto level = MemoryBudget::getInstance().level();
+    if (level >= Degradation::DropVideo) {
+        m_overBudget.inc();
+        return false;
+    }
+
+    // every other frame, halving the rate keeps motion readable
+    auto decimation = m_keepOneIn.load(memory_order_relaxed);
+    if (level == Degradation::DecimateVideo)
+        decimation *= 2;
+    if (decimation > 1 && m_sequence++ % decimation) {
+        m_decimated.inc();
+        return false;
+    }
+
+    Frame* frame;
+    {
+        lock_guard<mutex> lock(m_lock);
+        if (m_closing)
+            return false;
+
+        if (!m_running) {
+            m_running = true;
+            m_thread = thread(&VideoWriter::run, this);
+        }
+
+        if (m_count == c_queueDepth) {
+            LOG_EVERY_MS(5000, Log::warn, "video queue full, the disk is not keeping up");
+            m_queueFull.inc();
+            return false;
+        }
+
+        // the first frame and a larger resolution allocate the pool, nothing else does
+        if (len > m_frameSize)
+            grow(len);
+
+        // a queued frame is charged until it is written, so a disk falling
+        // behind steps the budget through its degradation levels; the queue
+        // depth bounds it, drop_video stops it at the top of the next submit
+        MemoryBudget::getInstance().reserve(MemoryPool::Video, len);
+
+        frame = acquire();
+        if (!frame)
+            MemoryBudget::getInstance().release(MemoryPool::Video, len);
+    }
+
+    if (!frame) {
+        m_overBudget.inc();
+        return false;
+    }
+
+    // copied outside the lock so the writer thread is never held up by it
+    memcpy(frame->data.get(), data, len);
+    frame->len = len;
+    frame->width = width;
+    frame->height = height;
+    frame->decimation = decimation;
+    frame->arrivalNs = arrivalNs;
+    frame->sampled = Tracer::sampled();
+
+    {
+        lock_guard<mutex> lock(m_lock);
+
+        // closed while copying, the writer may be gone already
+        if (!m_running) {
+            MemoryBudget::getInstance().release(MemoryPool::Video, len);
+            m_spare.push_back(frame);
+            return false;
+        }
+
+        m_queue[(m_head + m_count++) % c_queueDepth] = frame;
+    }
+
+    m_wake.notify_one();
+    return true;
+}
+
+void VideoWriter::grow(size_t len) {
+    m_frameSize = len;
+
+    // buffers only grow; frames in flight are grown as they come back
+    for (auto* frame : m_spare)
+        resize(frame, len);
+
+    while (m_pooled < c_poolFrames) {
+        auto* frame = new Frame();
+        resize(frame, len);
+        m_spare.push_back(frame);
+        m_pooled++;
+    }
+}
+
+void VideoWriter::resize(Frame* frame, size_t len) {
+    if (frame->capacity >= len)
+        return;
+
+    frame->data.reset(new char[len]);
+    frame->capacity = len;
+}
+
+void VideoWriter::freePool() {
+    for (auto* frame : m_spare)
+        delete frame;
+    m_pooled -= m_spare.size();
+    m_spare.clear();
+    m_frameSize = 0;
+}
+
+VideoWriter::Frame* VideoWriter::acquire() {
+    // every spare holds a frame of m_frameSize, none left means frames raced a close
+    if (m_spare.empty())
+        return nullptr;
+
+    auto* frame = m_spare.back();
+    m_spare.pop_back();
+    return frame;
+}
+
+void VideoWriter::recycle(Frame* frame) {
+    // the pool keeps its size so a steady stream never allocates, a frame
+    // from before a larger resolution grows here rather than in the callback
+    lock_guard<mutex> lock(m_lock);
+    resize(frame, m_frameSize);
+    m_spare.push_back(frame);
+}
+
+size_t VideoWriter::queued() {
+    lock_guard<mutex> lock(m_lock);
+    return m_count;
+}
+
+void VideoWriter::run() {
+    ThreadRegistry::getInstance().enroll(ThreadClass::Writer, "zoombot-video");
+
+    unique_lock<mutex> lock(m_lock);
+    while (true) {
+        m_wake.wait(lock, [this] { return m_count || !m_running || requested(); });
+
+        if (requested() && !m_framesBefore) {
+            auto path = move(m_nextPath);
+            m_nextPath.clear();
+            auto flush = m_flushRequested;
+            m_flushRequested = false;
+
+            lock.unlock();
+            if (!path.empty()) {
+                // the next frame opens the new file
+                m_sink.close();
+                m_sidecar.close();
+                m_timing.close();
+                m_path = path;
+                if (m_previous)
+                    recycle(exchange(m_previous, nullptr));
+            } else if (flush && m_sink.isOpen()) {
+                m_sink.flush();
+            }
+            lock.lock();
+            continue;
+        }
+
+        if (!m_count)
+            break;
+
+        auto* frame = m_queue[m_head];
+        m_head = (m_head + 1) % c_queueDepth;
+        m_count--;
+        if (m_framesBefore)
+            m_framesBefore--;
+
+        lock.unlock();
+        auto start = MetricsClock::nowNs();
+        write(frame);
+        auto end = MetricsClock::nowNs();
+        m_busyNs.fetch_add(end - start, memory_order_relaxed);
+
+        // this thread takes no sampling decisions, the callback's carries over
+        if (frame->sampled) {
+            auto& tracer = Tracer::getInstance();
+            tracer.record("video_queue_wait", "queue", frame->arrivalNs, start);
+            tracer.record("sink_write", "stage", start, end, frame->len);
+        }
+        MemoryBudget::getInstance().release(MemoryPool::Video, frame->len);
+        if (auto* previous = exchange(m_previous, frame))
+            recycle(previous);
+        lock.lock();
+    }
+}
+
+void VideoWriter::write(Frame* frame) {
+    if (!m_sink.isOpen()) {
+        auto bufferSize = m_directIO ? FileSink::c_directBuffer : FileSink::c_defaultBuffer;
+        if (!m_sink.open(m_path, bufferSize, m_directIO)) {
+            m_metrics.dropped();
+            return;
+        }
+        m_width = m_height = 0;
+        m_frames = 0;
+        m_mediaNs = 0;
+        m_lastArrivalNs = 0;
+        m_timing.open(m_path, "i420", c_timingJumpNs);
+
+        m_sidecar.open(m_path + ".meta", ios::app);
+        if (!m_sidecar)
+            Log::warn("failed to open " + m_path + ".meta, format changes will not be recorded");
+    }
+
+    // frames missing before this one repeat the last, so the file keeps to the frame clock
+    if (auto missing = m_timing.gapNs(frame->arrivalNs, m_mediaNs))
+        fillGap(missing, frame->arrivalNs);
+    else
+        trackInterval(frame);
+    m_lastArrivalNs = frame->arrivalNs;
+
+    // journaled so recovery can cut the file back to whole frames, and
+    // sizes the preallocation
+    if (frame->width != m_width || frame->height != m_height) {
+        m_width = frame->width;
+        m_height = frame->height;
+        m_sink.describe("i420 " + to_string(m_width) + "x" + to_string(m_height), frame->len,
+                        static_cast<uint64_t>(frame->len) * m_fps / frame->decimation);
+        writeSidecar(frame);
+    } else if (frame->decimation != m_decimation) {
+        writeSidecar(frame);
+    }
+
+    if (m_sink.write(frame->data.get(), frame->len)) {
+        m_metrics.written(frame->len);
+        m_timing.stamp(frame->arrivalNs, m_mediaNs, m_frames);
+        m_mediaNs += frameNs(frame->decimation);
+        m_frames++;
+    } else {
+        m_metrics.dropped();
+    }
+}
+
+void VideoWriter::trackInterval(const Frame* frame) {
+    if (!m_lastArrivalNs || frame->arrivalNs <= m_lastArrivalNs)
+        return;
+
+    // a running mean at first, then an average over the last second or so;
+    // a frame dropped on the way moves it only a little
+    auto interval = static_cast<double>(frame->arrivalNs - m_lastArrivalNs) / frame->decimation;
+    interval = clamp(interval, m_sourceFrameNs / 2, m_sourceFrameNs * 2);
+    m_intervals = min(m_intervals + 1, c_intervalFrames);
+    m_sourceFrameNs += (interval - m_sourceFrameNs) / m_intervals;
+}
+
+uint64_t VideoWriter::frameNs(unsigned int decimation) const {
+    return static_cast<uint64_t>(m_sourceFrameNs * decimation + 0.5);
+}
+
+void VideoWriter::fillGap(uint64_t missingNs, uint64_t arrivalNs) {
+    auto interval = frameNs(m_decimation);
+    // to the nearest frame, rounding down would leave most of a frame of skew behind
+    auto repeats = m_previous ? (min(missingNs, c_maxRepeatNs) + interval / 2) / interval : 0;
+
+    uint64_t filled = 0;
+    for (; filled < repeats; filled++) {
+        if (!m_sink.write(m_previous->data.get(), m_previous->len))
+            break;
+        m_metrics.written(m_previous->len);
+    }
+
+    m_timing.gap(arrivalNs, missingNs, filled * interval, "repeat");
+    m_mediaNs += filled * interval;
+    m_frames += filled;
+    LOG_EVERY_MS(5000, Log::warn, "video gap of " + to_string(missingNs / 1000000) + " ms filled with "
+                                  + to_string(filled) + " repeated frames");
+}
+
+void VideoWriter::writeSidecar(const Frame* frame) {
+    m_decimation = frame->decimation;
+    if (!m_sidecar)
+        return;
+
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    auto now = static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+
+    // flushed per line, changes are rare and readers may follow the file live
+    m_sidecar << "{\"offset\":" << m_sink.offset() << ",\"frame\":" << m_frames << ",\"time_ns\":" << now
+              << ",\"format\":\"i420\",\"width\":" << frame->width << ",\"height\":" << frame->height
+              << ",\"frame_size\":" << frame->len << ",\"fps\":" << static_cast<double>(m_fps) / frame->decimation
+              << ",\"decimation\":" << frame->decimation << "}" << endl;
+}
+
+void VideoWriter::rotate(const string& path) {
+    {
+        lock_guard<mutex> lock(m_lock);
+        if (!m_running && !m_closing) {
+            m_path = path;
+            return;
+        }
+
+        // while closing, taken by the writer before it exits or by close() after
+        m_nextPath = path;
+        m_framesBefore = m_count;
+    }
+
+    m_wake.notify_all();
+}
+
+void VideoWriter::flush() {
+    {
+        lock_guard<mutex> lock(m_lock);
+        if (!m_running)
+            return;
+
+        m_flushRequested = true;
+        m_framesBefore = m_count;
+    }
+
+    m_wake.notify_all();
+}
+
+void VideoWriter::close() {
+    unique_lock<mutex> lock(m_lock);
+    stop(lock);
+}
+
+void VideoWriter::stop(unique_lock<mutex>& lock) {
+    // a close already under way on another thread is waited for
+    m_wake.wait(lock, [this] { return !m_closing; });
+    if (!m_running) {
+        // frames handed back by a callback that raced the last close
+        freePool();
+        return;
+    }
+
+    m_running = false;
+    m_closing = true;
+    lock.unlock();
+
+    m_wake.notify_all();
+    m_thread.join();
+
+    m_sink.close();
+    m_sidecar.close();
+    m_timing.close();
+    if (m_previous)
+        recycle(exchange(m_previous, nullptr));
+
+    lock.lock();
+    freePool();
+
+    if (!m_nextPath.empty())
+        m_path = move(m_nextPath);
+    m_nextPath.clear();
+    m_flushRequested = false;
+    m_framesBefore = 0;
+
+    m_closing = false;
+    m_wake.notify_all();
+}
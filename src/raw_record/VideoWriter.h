@@ -0,0 +1,194 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_VIDEOWRITER_H
+#define MEETING_SDK_LINUX_SAMPLE_VIDEOWRITER_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FileSink.h"
+#include "StreamTiming.h"
+#include "../util/Metrics.h"
+
+using namespace std;
+
+/**
+ * Writes raw video frames from a thread of its own so the SDK callback only
+ * copies the frame. Frame buffers are pooled, allocated whole on the first
+ * frame and on a larger resolution, so the callback allocates nothing in
+ * between. Queued frames are charged to the video pool of the memory
+ * budget until they are written; when the budget degrades, frames are
+ * decimated or dropped before they are copied.
+ *
+ * Every change of resolution or frame rate is appended to a sidecar next to
+ * the output (<output>.meta), one JSON object per line with the byte offset
+ * and frame number it starts at. Frames missing before one that arrives
+ * late, e.g. after a reconnect, are filled by repeating the last frame; the
+ * frame clock for that follows the interval the frames actually arrive at,
+ * so a stream slower than expected is not taken for one with gaps.
+ */
+class VideoWriter {
+public:
+    // frames queued behind a slow disk, about 3 s at 30 fps
+    static constexpr size_t c_queueDepth = 96;
+
+    // the queue, the frame being written and the last one held back
+    static constexpr size_t c_poolFrames = c_queueDepth + 2;
+
+    // a frame this far off the fitted frame clock is a discontinuity, a few frames
+    static constexpr uint64_t c_timingJumpNs = 100000000ull;
+
+    // longest gap filled with repeated frames, beyond it the file skips ahead
+    static constexpr uint64_t c_maxRepeatNs = 10000000000ull;
+
+    // arrivals the frame interval is averaged over, about a second at 30 fps
+    static constexpr unsigned int c_intervalFrames = 32;
+
+private:
+    struct Frame {
+        // left uninitialized, pages are touched as frames are copied in
+        unique_ptr<char[]> data;
+        size_t capacity = 0;
+        size_t len = 0;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        unsigned int decimation = 1;
+
+        // CLOCK_MONOTONIC at callback entry
+        uint64_t arrivalNs = 0;
+
+        // the callback was traced, so are its queue wait and write
+        bool sampled = false;
+    };
+
+    string m_path;
+    bool m_directIO = false;
+    unsigned int m_fps = 30;
+
+    FileSink m_sink;
+    unsigned int m_width = 0;
+    unsigned int m_height = 0;
+    unsigned int m_decimation = 1;
+    uint64_t m_frames = 0;
+    ofstream m_sidecar;
+
+    // capture time of each frame against the stream's own frame clock
+    StreamTiming m_timing{"video"};
+    uint64_t m_mediaNs = 0;
+
+    // interval between frames before decimation, estimated from their
+    // arrivals; starts at the nominal rate
+    double m_sourceFrameNs = 0;
+    unsigned int m_intervals = 0;
+    uint64_t m_lastArrivalNs = 0;
+
+    // the last frame written, held back from the pool to repeat over a gap
+    Frame* m_previous = nullptr;
+
+    mutex m_lock;
+    condition_variable m_wake;
+    thread m_thread;
+    bool m_running = false;
+
+    // set from when close() stops the thread until it has been joined,
+    // frames are dropped meanwhile rather than starting another
+    bool m_closing = false;
+
+    array<Frame*, c_queueDepth> m_queue{};
+    size_t m_head = 0;
+    size_t m_count = 0;
+    vector<Frame*> m_spare;
+
+    // frames the pool owns wherever they are, and the size they are grown to
+    size_t m_pooled = 0;
+    size_t m_frameSize = 0;
+
+    // rotation and flushes wait for the frames queued before them
+    string m_nextPath;
+    bool m_flushRequested = false;
+    size_t m_framesBefore = 0;
+
+    uint64_t m_sequence = 0;
+    atomic<unsigned int> m_keepOneIn{1};
+    atomic<uint64_t> m_busyNs{0};
+
+    Counter& m_decimated;
+    Counter& m_overBudget;
+    Counter& m_queueFull;
+    CallbackMetrics& m_metrics;
+
+    void run();
+    void write(Frame* frame);
+    void writeSidecar(const Frame* frame);
+    void fillGap(uint64_t missingNs, uint64_t arrivalNs);
+    void trackInterval(const Frame* frame);
+    uint64_t frameNs(unsigned int decimation) const;
+    void grow(size_t len);
+    void resize(Frame* frame, size_t len);
+    void freePool();
+    Frame* acquire();
+    void recycle(Frame* frame);
+    void stop(unique_lock<mutex>& lock);
+    bool requested() const { return !m_nextPath.empty() || m_flushRequested; }
+
+public:
+    /**
+     * @param metrics byte and drop counters of the stream
+     */
+    explicit VideoWriter(CallbackMetrics& metrics);
+    ~VideoWriter();
+
+    /**
+     * Set the output, takes effect with the next frame after close()
+     * @param fps expected frame rate, sizes preallocation and is the first
+     *            guess at the frame clock until frames have arrived
+     */
+    void setOutput(const string& path, bool directIO, unsigned int fps);
+
+    /**
+     * Copy a frame into the queue, from the SDK callback
+     * @param arrivalNs CLOCK_MONOTONIC at callback entry
+     * @return false if the frame was decimated, dropped or did not fit
+     */
+    bool submit(const char* data, size_t len, unsigned int width, unsigned int height, uint64_t arrivalNs);
+
+    /**
+     * Keep one frame in n, on top of any decimation by the memory budget
+     */
+    void setDecimation(unsigned int n) { m_keepOneIn.store(max(1u, n), memory_order_relaxed); }
+
+    /**
+     * Frames waiting to be written
+     */
+    size_t queued();
+
+    /**
+     * Total time the writer thread has spent writing frames
+     */
+    uint64_t busyNs() const { return m_busyNs.load(memory_order_relaxed); }
+
+    /**
+     * Continue in a new file once the frames queued so far are written
+     */
+    void rotate(const string& path);
+
+    /**
+     * Hand the frames queued so far to the kernel
+     */
+    void flush();
+
+    /**
+     * Write out everything queued, stop the thread and close the file. Safe
+     * against frames still arriving, they are dropped until it returns.
+     */
+    void close();
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_VIDEOWRITER_H
@@ -1,95 +1,454 @@
 #include "ZoomSDKAudioRawDataDelegate.h"
 
+namespace {
+    // length of this much audio, without overflowing on long files
+    uint64_t durationNs(uint64_t bytes, uint64_t bytesPerSecond) {
+        return bytes / bytesPerSecond * 1000000000ull + bytes % bytesPerSecond * 1000000000ull / bytesPerSecond;
+    }
+}
 
 ZoomSDKAudioRawDataDelegate::ZoomSDKAudioRawDataDelegate(bool useMixedAudio = true, bool transcribe = false) : m_useMixedAudio(useMixedAudio), m_transcribe(transcribe){
+    // mixed audio is forwarded as is until a transcriber takes it
+    server.setRawAudio(transcribe && useMixedAudio);
     server.start();
 }
 
+ZoomSDKAudioRawDataDelegate::~ZoomSDKAudioRawDataDelegate() {
+    m_timeline.finish();
+}
+
 void ZoomSDKAudioRawDataDelegate::onMixedAudioRawDataReceived(AudioRawData *data) {
+    capture(CallbackType::MixedAudio, 0, data);
+
     if (!m_useMixedAudio) {
         return;
     }
 
-    // write to socket (always do this for transcription regardless of recording state)
+    CallbackMetrics::Scope scope(m_mixedMetrics);
+    TraceCallback trace("audio_mixed", data->GetBufferLen());
+
+    // transcribe regardless of recording state
+    if (m_transcribe && m_transcriber) {
+        m_transcriber->push(data->GetBuffer(), data->GetBufferLen(), data->GetSampleRate(), data->GetChannelNum());
+        m_mixedMetrics.written(data->GetBufferLen());
+        return;
+    }
+
+    // or leave it to whoever reads the socket
     if (m_transcribe) {
+        TraceSpan span("socket_write", data->GetBufferLen());
         server.writeBuf(data->GetBuffer(), data->GetBufferLen());
+        m_mixedMetrics.written(data->GetBufferLen());
         return;
     }
 
+    preRoll(m_mixed, data);
+
     // Check if recording has started before writing to file
     if (!m_recordingStarted) {
+        if (!m_mixed.ring.enabled())
+            m_mixedMetrics.dropped();
         return;
     }
 
     // or write to file
-    if (m_dir.empty())
-        return Log::error("Output Directory cannot be blank");
-
-    if (m_filename.empty())
-        m_filename = "test.pcm";
+    if (m_dir.empty()) {
+        LOG_EVERY_MS(5000, Log::error, "Output Directory cannot be blank");
+        return;
+    }
 
-    // Indicate that recording has started
-    setRecordingStarted(true);
+    catchUp(m_mixed, data->GetBufferLen());
+    if (!m_mixed.sink.isOpen()) {
+        if (m_filename.empty())
+            m_filename = "test.pcm";
 
-    stringstream path;
-    path << m_dir << "/" << m_filename;
+        if (!openSink(m_mixed, m_dir + "/" + m_filename, data)) {
+            m_mixedMetrics.dropped();
+            return;
+        }
+    }
 
-    writeToFile(path.str(), data);
+    writeToFile(m_mixed, data, m_mixedMetrics, scope.start());
 }
 
 
 
 void ZoomSDKAudioRawDataDelegate::onOneWayAudioRawDataReceived(AudioRawData* data, uint32_t node_id) {
+    auto arrival = MetricsClock::nowNs();
+    capture(CallbackType::OneWayAudio, node_id, data);
+
+    // every participant's level, whatever else is done with their audio
+    if (data->GetSampleRate() && data->GetChannelNum()) {
+        auto samples = data->GetBufferLen() / sizeof(int16_t);
+        auto ms = static_cast<unsigned int>(samples / data->GetChannelNum() * 1000 / data->GetSampleRate());
+        auto level = AudioLevel::measure(reinterpret_cast<const int16_t*>(data->GetBuffer()), samples);
+
+        m_timeline.add(node_id, level, ms, arrival);
+        if (auto* speaker = m_activeSpeaker.load(memory_order_acquire))
+            speaker->observe(node_id, level.meanSquare(), ms, arrival);
+    }
+
     if (m_useMixedAudio) {
         return;
     }
-    
+
+    CallbackMetrics::Scope scope(m_oneWayMetrics);
+    TraceCallback trace("audio_oneway", node_id);
+
+    // each speaker transcribed on their own, regardless of recording state
+    if (m_transcribe && m_speakers) {
+        m_speakers->push(node_id, data->GetBuffer(), data->GetBufferLen(), data->GetSampleRate(), data->GetChannelNum());
+        m_oneWayMetrics.written(data->GetBufferLen());
+        return;
+    }
+
+    if (m_multichannel) {
+        writeMultichannel(node_id, data, arrival);
+        return;
+    }
+
+    auto it = m_nodes.find(node_id);
+    if (it == m_nodes.end()) {
+        lock_guard<mutex> lock(m_nodesLock);
+        it = m_nodes.try_emplace(node_id).first;
+    }
+
+    auto& stream = it->second;
+    preRoll(stream, data);
+
     // Check if recording has started before writing to file
     if (!m_recordingStarted) {
+        if (!stream.ring.enabled())
+            m_oneWayMetrics.dropped();
+        return;
+    }
+
+    catchUp(stream, data->GetBufferLen());
+    if (!stream.sink.isOpen() && !openSink(stream, m_dir + "/node-" + to_string(node_id) + ".pcm", data)) {
+        m_oneWayMetrics.dropped();
         return;
     }
 
-    stringstream path;
-    path << m_dir << "/node-" << node_id << ".pcm";
-    writeToFile(path.str(), data);
+    writeToFile(stream, data, m_oneWayMetrics, arrival);
 }
 
 void ZoomSDKAudioRawDataDelegate::onShareAudioRawDataReceived(AudioRawData* data) {
+    capture(CallbackType::ShareAudio, 0, data);
+
     // Logging removed to reduce console spam
     // The shared audio data is received but not processed further in this implementation
 }
 
 
-void ZoomSDKAudioRawDataDelegate::writeToFile(const string &path, AudioRawData *data)
+void ZoomSDKAudioRawDataDelegate::capture(CallbackType type, uint32_t nodeId, AudioRawData* data)
+{
+    auto& recorder = CallbackRecorder::getInstance();
+    if (recorder.isOpen())
+        recorder.capture(type, nodeId, data->GetBuffer(), data->GetBufferLen(), data->GetSampleRate(), data->GetChannelNum());
+}
+
+void ZoomSDKAudioRawDataDelegate::preRoll(AudioStream& stream, AudioRawData* data)
+{
+    if (!m_preRollSeconds)
+        return;
+
+    // sized from the first chunk, 16-bit samples
+    if (!stream.ring.enabled()) {
+        stream.ring.reset(data->GetSampleRate() * data->GetChannelNum() * sizeof(int16_t), m_preRollSeconds);
+        stream.written = 0;
+    }
+
+    stream.ring.push(data->GetBuffer(), data->GetBufferLen());
+}
+
+void ZoomSDKAudioRawDataDelegate::catchUp(AudioStream& stream, size_t chunk)
+{
+    // the next chunk opens the new segment, the pre-roll position carries over
+    auto segment = m_segment.load(memory_order_relaxed);
+    if (stream.segment != segment) {
+        stream.sink.close();
+        stream.timing.close();
+        stream.segment = segment;
+    }
+
+    auto flushes = m_flushes.load(memory_order_relaxed);
+    if (stream.flushes != flushes) {
+        if (stream.sink.isOpen())
+            stream.sink.flush();
+        stream.flushes = flushes;
+    }
+
+    // time spent stopped is not a gap to fill, nor audio to record: only the
+    // first start flushes the pre-roll, later ones carry on from this chunk
+    auto starts = m_starts.load(memory_order_relaxed);
+    if (stream.starts != starts) {
+        if (starts > 1 && stream.ring.enabled())
+            stream.written = max(stream.written, stream.ring.end() - min<uint64_t>(chunk, stream.ring.end()));
+
+        stream.timing.resume();
+        stream.starts = starts;
+    }
+}
+
+void ZoomSDKAudioRawDataDelegate::writeMultichannel(uint32_t nodeId, AudioRawData* data, uint64_t arrivalNs)
+{
+    if (!m_recordingStarted) {
+        m_oneWayMetrics.dropped();
+        return;
+    }
+
+    auto segment = m_segment.load(memory_order_relaxed);
+    if (m_multichannelSegment != segment) {
+        m_multichannel->close();
+        m_multichannelSegment = segment;
+    }
+
+    auto flushes = m_flushes.load(memory_order_relaxed);
+    if (m_multichannelFlushes != flushes) {
+        m_multichannel->flush();
+        m_multichannelFlushes = flushes;
+    }
+
+    if (!m_multichannel->isOpen()) {
+        auto name = m_filename.empty() ? string("test.pcm") : m_filename;
+        auto path = m_dir + "/" + name.substr(0, name.rfind('.')) + ".wav";
+        if (!m_multichannel->open(FileSink::segmentPath(path, segment), data->GetSampleRate(), arrivalNs)) {
+            m_oneWayMetrics.dropped();
+            return;
+        }
+    }
+
+    // the file's rate is the first participant's, the SDK sends everyone at the same
+    if (data->GetSampleRate() != m_multichannel->rate()) {
+        LOG_EVERY_MS(10000, Log::warn, "participant " + to_string(nodeId) + " sends " +
+                     to_string(data->GetSampleRate()) + " Hz, not the recording's " + to_string(m_multichannel->rate()));
+        m_oneWayMetrics.dropped();
+        return;
+    }
+
+    TraceSpan span("multichannel_write", data->GetBufferLen());
+    auto channels = data->GetChannelNum();
+    auto frames = data->GetBufferLen() / sizeof(int16_t) / max(1u, channels);
+    m_multichannel->write(nodeId, reinterpret_cast<const int16_t*>(data->GetBuffer()), frames, channels, arrivalNs);
+    m_oneWayMetrics.written(data->GetBufferLen());
+}
+
+bool ZoomSDKAudioRawDataDelegate::openSink(AudioStream& stream, const string& path, AudioRawData* data)
 {
-    static std::ofstream file;
-	file.open(path, std::ios::out | std::ios::binary | std::ios::app);
+    auto segmentPath = FileSink::segmentPath(path, stream.segment);
+    if (!stream.sink.open(segmentPath))
+        return false;
 
-	if (!file.is_open())
-        return Log::error("failed to open audio file path: " + path);
-	
-    file.write(data->GetBuffer(), data->GetBufferLen());
+    auto channels = data->GetChannelNum();
+    auto block = channels * sizeof(int16_t);
+    auto format = "pcm s16le " + to_string(data->GetSampleRate()) + " " + to_string(channels);
+    stream.sink.describe(format, block, block * data->GetSampleRate());
 
-    file.close();
-	file.flush();
+    stream.bytesPerSecond = block * data->GetSampleRate();
+    stream.timing.open(segmentPath, format, c_timingJumpNs);
+    return true;
+}
+
+void ZoomSDKAudioRawDataDelegate::writeToFile(AudioStream& stream, AudioRawData* data, CallbackMetrics& metrics,
+                                              uint64_t arrivalNs)
+{
+    TraceSpan span("sink_write", data->GetBufferLen());
+
+    // audio missing before this chunk, e.g. while reconnecting, becomes
+    // silence so everything after it stays at its time
+    if (stream.bytesPerSecond) {
+        auto end = stream.sink.written() + data->GetBufferLen();
+        if (auto missing = stream.timing.gapNs(arrivalNs, durationNs(end, stream.bytesPerSecond)))
+            fillGap(stream, data->GetChannelNum() * sizeof(int16_t), missing, arrivalNs, metrics);
+    }
+
+    if (!stream.ring.enabled()) {
+        if (stream.sink.write(data->GetBuffer(), data->GetBufferLen()))
+            metrics.written(data->GetBufferLen());
+        else
+            metrics.dropped();
+    } else {
+        // catches up on everything held since the last write, the whole
+        // pre-roll on the first chunk after recording starts
+        auto before = stream.sink.written();
+        if (stream.ring.writeSince(stream.sink, stream.written) > 0)
+            metrics.dropped();
+
+        metrics.written(stream.sink.written() - before);
+    }
+
+    // the file up to here had arrived by the time this chunk did
+    auto end = stream.sink.written();
+    if (stream.bytesPerSecond)
+        stream.timing.stamp(arrivalNs, durationNs(end, stream.bytesPerSecond), end);
+}
+
+void ZoomSDKAudioRawDataDelegate::fillGap(AudioStream& stream, size_t block, uint64_t missingNs, uint64_t arrivalNs,
+                                          CallbackMetrics& metrics)
+{
+    static const char silence[4096] = {};
+
+    // whole sample frames, the chunk after it must stay aligned
+    auto fill = min(missingNs, c_maxGapFillNs);
+    auto bytes = fill / 1000 * stream.bytesPerSecond / 1000000 / block * block;
+
+    uint64_t filled = 0;
+    while (filled < bytes) {
+        auto len = min<uint64_t>(bytes - filled, sizeof(silence));
+        if (!stream.sink.write(silence, len))
+            break;
+        filled += len;
+    }
+
+    metrics.written(filled);
+    stream.timing.gap(arrivalNs, missingNs, durationNs(filled, stream.bytesPerSecond), "silence");
+    LOG_EVERY_MS(5000, Log::warn, "audio gap of " + to_string(missingNs / 1000000) + " ms filled with silence");
 }
 
 void ZoomSDKAudioRawDataDelegate::setDir(const string &dir)
 {
     m_dir = dir;
+    closeFiles();
 }
 
 void ZoomSDKAudioRawDataDelegate::setFilename(const string &filename)
 {
     m_filename = filename;
+    m_mixed.sink.close();
+    m_mixed.timing.close();
+}
+
+void ZoomSDKAudioRawDataDelegate::setPreRollSeconds(unsigned int seconds)
+{
+    m_preRollSeconds = seconds;
+}
+
+void ZoomSDKAudioRawDataDelegate::setTranscriber(StreamingTranscriber::Options options, size_t maxSpeakers,
+                                                 SpeakerTranscription::NameOf nameOf)
+{
+    auto path = m_dir + "/transcript.jsonl";
+    if (!m_transcript.open(path, 0))
+        Log::warn("Transcripts will not be written to " + path);
+
+    auto sink = [this](TranscriptEvent& event) { writeTranscript(event); };
+
+    if (!m_useMixedAudio) {
+        m_speakers = make_unique<SpeakerTranscription>(move(options), maxSpeakers, sink, move(nameOf));
+        return;
+    }
+
+    m_transcriber = make_unique<StreamingTranscriber>(move(options), sink);
+    m_transcriber->start();
+    server.setRawAudio(false);
+}
+
+void ZoomSDKAudioRawDataDelegate::setMultichannel(size_t channels, MultichannelRecorder::Overflow overflow,
+                                                  MultichannelRecorder::NameOf nameOf)
+{
+    m_multichannel = make_unique<MultichannelRecorder>(channels, overflow, move(nameOf));
+}
+
+void ZoomSDKAudioRawDataDelegate::writeTranscript(const TranscriptEvent& event)
+{
+    auto line = event.toJson() + "\n";
+
+    lock_guard<mutex> lock(m_transcriptLock);
+    server.writeStr(line);
+    if (m_transcript.isOpen())
+        m_transcript.write(line.data(), line.size());
+}
+
+void ZoomSDKAudioRawDataDelegate::writeTimeline(const string& line, bool complete)
+{
+    auto out = line + "\n";
+
+    lock_guard<mutex> lock(m_transcriptLock);
+
+    // a JSON line in the middle of raw PCM would corrupt it, the file still gets it
+    if (!server.isRawAudio())
+        server.writeStr(out);
+
+    // one line per finished spurt, including one still going when recording stopped
+    if (!complete || (!m_recordingStarted && !m_timelineFile.isOpen()))
+        return;
+
+    auto path = m_dir + "/timeline.jsonl";
+    if (!m_timelineFile.isOpen() && !m_timelineFile.open(path, 0)) {
+        LOG_EVERY_MS(10000, Log::warn, "Speech timeline will not be written to " + path);
+        return;
+    }
+
+    m_timelineFile.write(out.data(), out.size());
+}
+
+void ZoomSDKAudioRawDataDelegate::writeEvent(const string& line)
+{
+    if (server.isRawAudio())
+        return;
+
+    lock_guard<mutex> lock(m_transcriptLock);
+    server.writeStr(line);
+}
+
+void ZoomSDKAudioRawDataDelegate::closeFiles()
+{
+    // spurts still open end with the recording
+    m_timeline.finish();
+    m_timelineFile.close();
+
+    m_mixed.sink.close();
+    m_mixed.timing.close();
+    if (m_multichannel)
+        m_multichannel->close();
+
+    lock_guard<mutex> lock(m_nodesLock);
+    for (auto& [nodeId, stream] : m_nodes) {
+        stream.sink.close();
+        stream.timing.close();
+    }
+}
+
+size_t ZoomSDKAudioRawDataDelegate::exportPreRoll(unsigned int seconds)
+{
+    auto prefix = m_dir + "/preroll-" + to_string(time(nullptr));
+    size_t files = 0;
+
+    auto write = [&](const PreRollRing& ring, const string& path) {
+        auto pcm = ring.snapshot(seconds);
+        if (pcm.empty())
+            return;
+
+        FileSink sink;
+        if (sink.open(path, 0) && sink.write(pcm.data(), pcm.size()))
+            files++;
+    };
+
+    write(m_mixed.ring, prefix + ".pcm");
+
+    {
+        lock_guard<mutex> lock(m_nodesLock);
+        for (auto& [nodeId, stream] : m_nodes)
+            write(stream.ring, prefix + "-node-" + to_string(nodeId) + ".pcm");
+    }
+
+    if (files)
+        Log::success("Exported the last " + to_string(seconds) + "s of audio to " + to_string(files) + " file(s) in " + m_dir);
+    else
+        Log::warn("No pre-roll audio to export, is --preroll-seconds set?");
+
+    return files;
 }
 
 void ZoomSDKAudioRawDataDelegate::setRecordingStarted(bool started)
 {
     if (started && !m_recordingStarted) {
         Log::success("Recording started, audio files will now be written");
+        if (m_preRollSeconds)
+            Log::info("Including up to " + to_string(m_preRollSeconds) + "s of audio received before the start");
     } else if (!started && m_recordingStarted) {
         Log::info("Recording stopped, audio files will no longer be written");
     }
+    if (started && !m_recordingStarted)
+        m_starts++;
     m_recordingStarted = started;
 }
@@ -1,17 +1,33 @@
 #ifndef MEETING_SDK_LINUX_SAMPLE_ZOOMSDKAUDIORAWDATADELEGATE_H
 #define MEETING_SDK_LINUX_SAMPLE_ZOOMSDKAUDIORAWDATADELEGATE_H
 
+#include <atomic>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "zoom_sdk_raw_data_def.h"
 #include "rawdata/rawdata_audio_helper_interface.h"
 
 #include "../util/Log.h"
+#include "../util/Metrics.h"
+#include "../util/Trace.h"
+#include "ActiveSpeaker.h"
+#include "AudioLevel.h"
+#include "CallbackRecorder.h"
+#include "FileSink.h"
+#include "MultichannelRecorder.h"
+#include "PreRollRing.h"
+#include "SpeechTimeline.h"
+#include "StreamTiming.h"
 #include "../util/SocketServer.h"
+#include "../transcribe/SpeakerTranscription.h"
+#include "../transcribe/StreamingTranscriber.h"
 
 using namespace std;
 using namespace ZOOMSDK;
@@ -23,14 +39,148 @@ class ZoomSDKAudioRawDataDelegate : public IZoomSDKAudioRawDataDelegate {
     string m_filename = "test.pcm";
     bool m_useMixedAudio;
     bool m_transcribe;
-    bool m_recordingStarted = false;
+    atomic<bool> m_recordingStarted = false;
+    unsigned int m_preRollSeconds = 0;
 
-    void writeToFile(const string& path, AudioRawData* data);
+    CallbackMetrics m_mixedMetrics{"audio_mixed"};
+    CallbackMetrics m_oneWayMetrics{"audio_oneway"};
+
+    /**
+     * Output of one audio stream. The ring always holds its last seconds, the
+     * file is opened on the first chunk after recording starts and kept open.
+     */
+    struct AudioStream {
+        PreRollRing ring;
+        FileSink sink;
+
+        // ring position already written to the sink
+        uint64_t written = 0;
+
+        // output segment, flush requests and recording starts this stream has caught up with
+        unsigned int segment = 0;
+        unsigned int flushes = 0;
+        unsigned int starts = 0;
+
+        // capture time of the file's chunks against its sample clock
+        StreamTiming timing{"audio"};
+        uint64_t bytesPerSecond = 0;
+    };
+
+    // a chunk this far off the fitted sample clock is a discontinuity
+    static constexpr uint64_t c_timingJumpNs = 100000000ull;
+
+    // longest gap filled with silence, beyond it the file skips ahead
+    static constexpr uint64_t c_maxGapFillNs = 600000000000ull;
+
+    AudioStream m_mixed;
+    unordered_map<uint32_t, AudioStream> m_nodes;
+
+    // held while m_nodes is modified or walked from another thread
+    mutex m_nodesLock;
+
+    // requested from the main loop, acted on by the audio thread with each stream's next chunk
+    atomic<unsigned int> m_segment{0};
+    atomic<unsigned int> m_flushes{0};
+    atomic<unsigned int> m_starts{0};
+
+    // chunk: bytes of the current chunk, already pushed to the ring
+    void catchUp(AudioStream& stream, size_t chunk);
+
+    // participants as channels of one file in place of m_nodes, with the segment and flushes it caught up with
+    unique_ptr<MultichannelRecorder> m_multichannel;
+    unsigned int m_multichannelSegment = 0;
+    unsigned int m_multichannelFlushes = 0;
+
+    void writeMultichannel(uint32_t nodeId, AudioRawData* data, uint64_t arrivalNs);
+
+    atomic<ActiveSpeaker*> m_activeSpeaker{nullptr};
+
+    void preRoll(AudioStream& stream, AudioRawData* data);
+    bool openSink(AudioStream& stream, const string& path, AudioRawData* data);
+    void writeToFile(AudioStream& stream, AudioRawData* data, CallbackMetrics& metrics, uint64_t arrivalNs);
+    void fillGap(AudioStream& stream, size_t block, uint64_t missingNs, uint64_t arrivalNs, CallbackMetrics& metrics);
+    void capture(CallbackType type, uint32_t nodeId, AudioRawData* data);
+
+    // transcript events, written from the transcribers' threads
+    FileSink m_transcript;
+
+    // held while a line of JSON is written to the socket
+    mutex m_transcriptLock;
+
+    void writeTranscript(const TranscriptEvent& event);
+
+    // who spoke when, from the audio thread; spurts go to the socket and timeline.jsonl
+    FileSink m_timelineFile;
+    SpeechTimeline m_timeline{[this](const string& line, bool complete) { writeTimeline(line, complete); }};
+
+    void writeTimeline(const string& line, bool complete);
+
+    // last, so they stop and deliver their final results before the rest goes
+    unique_ptr<StreamingTranscriber> m_transcriber;
+    unique_ptr<SpeakerTranscription> m_speakers;
 public:
     ZoomSDKAudioRawDataDelegate(bool useMixedAudio, bool transcribe);
+    ~ZoomSDKAudioRawDataDelegate();
     void setDir(const string& dir);
     void setFilename(const string& filename);
     void setRecordingStarted(bool started);
+
+    /**
+     * Keep the last seconds of each stream in memory, so audio received
+     * before recording starts is written once it does. Set before subscribing.
+     */
+    void setPreRollSeconds(unsigned int seconds);
+
+    /**
+     * Transcribe in-process instead of forwarding audio on the socket: the
+     * mixed stream, or with separate participants each speaker's own stream
+     * on one of at most maxSpeakers channels. Transcript events go to the
+     * socket and transcript.jsonl in the output directory, one JSON object
+     * per line. Set before subscribing.
+     */
+    void setTranscriber(StreamingTranscriber::Options options, size_t maxSpeakers,
+                        SpeakerTranscription::NameOf nameOf);
+
+    /**
+     * Record participants on the channels of one aligned WAV named after the
+     * output file, instead of a file each. Set before subscribing.
+     */
+    void setMultichannel(size_t channels, MultichannelRecorder::Overflow overflow, MultichannelRecorder::NameOf nameOf);
+
+    /**
+     * Continue every stream in a new file, <name>-<n>.<ext>, from its next chunk
+     * @return the new segment number
+     */
+    unsigned int rotate() { return ++m_segment; }
+
+    /**
+     * Hand every stream's buffered audio to the kernel with its next chunk
+     */
+    void flush() { m_flushes++; }
+
+    /**
+     * Report each participant's audio level to the tracker, or stop with nullptr
+     */
+    void setActiveSpeaker(ActiveSpeaker* speaker) { m_activeSpeaker.store(speaker, memory_order_release); }
+
+    /**
+     * Send one line of JSON to the socket client, between transcript events.
+     * Not sent while the socket carries raw audio.
+     */
+    void writeEvent(const string& line);
+
+    /**
+     * Write the last seconds held for each stream to new files in the output
+     * directory, whether or not recording has started
+     * @param seconds duration to export, at most the pre-roll
+     * @return number of files written
+     */
+    size_t exportPreRoll(unsigned int seconds);
+
+    /**
+     * Flush and close every output file, only once callbacks have stopped
+     */
+    void closeFiles();
     bool isRecordingStarted() const { return m_recordingStarted; }
 
     void onMixedAudioRawDataReceived(AudioRawData* data) override;
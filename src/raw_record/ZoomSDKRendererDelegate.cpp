@@ -12,31 +12,40 @@ ZoomSDKRendererDelegate::ZoomSDKRendererDelegate() {
     */
 
     m_faces.reserve(2);
+    updateOutput();
     m_socketServer.start();
 }
 
 void ZoomSDKRendererDelegate::onRawDataFrameReceived(YUVRawDataI420 *data)
 {
-    // Simple implementation that just writes to file without using OpenCV
-    if (m_dir.empty()) {
-        return Log::error("Output Directory cannot be blank");
+    auto& recorder = CallbackRecorder::getInstance();
+    if (recorder.isOpen()) {
+        recorder.capture(CallbackType::Video, data->GetSourceID(), data->GetBuffer(), data->GetBufferLen(),
+                         data->GetStreamWidth(), data->GetStreamHeight(), data->GetRotation());
     }
 
-    if (m_filename.empty()) {
-        m_filename = "meeting-video.yuv";
-    }
+    CallbackMetrics::Scope scope(m_metrics);
+    TraceCallback trace("video", data->GetSourceID());
 
-    stringstream path;
-    path << m_dir << "/" << m_filename;
+    // Simple implementation that just writes to file without using OpenCV
+    if (!m_hasDir.load(memory_order_relaxed)) {
+        LOG_EVERY_MS(5000, Log::error, "Output Directory cannot be blank");
+        return;
+    }
 
-    writeToFile(path.str(), data);
+    writeToFile(data, scope.start());
 
     // Log frame info - removed to reduce console spam
     
+    // analysis output is the first thing given up under memory pressure
+    auto frame = m_frameCount++;
+    if (!MemoryBudget::getInstance().allowAnalysis())
+        return;
+
     // Update socket with simple frame count info
-    stringstream ss;
-    ss << m_frameCount++;
-    m_socketServer.writeStr(ss.str());
+    TraceSpan span("socket_write");
+    auto end = to_chars(m_counter, m_counter + sizeof(m_counter), frame).ptr;
+    m_socketServer.writeBuf(m_counter, end - m_counter);
 
     // Temporarily comment out OpenCV code
     /*
@@ -70,25 +79,67 @@ void ZoomSDKRendererDelegate::onRawDataFrameReceived(YUVRawDataI420 *data)
     */
 }
 
-void ZoomSDKRendererDelegate::writeToFile(const string &path, YUVRawDataI420 *data)
+bool ZoomSDKRendererDelegate::writeToFile(YUVRawDataI420 *data, uint64_t arrivalNs)
 {
-    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::app);
-    if (!file.is_open()) {
-        return Log::error("failed to open video output file: " + path);
-    }
+    TraceSpan span("video_queue", data->GetBufferLen());
+    if (m_writer.submit(data->GetBuffer(), data->GetBufferLen(), data->GetStreamWidth(), data->GetStreamHeight(),
+                        arrivalNs))
+        return true;
+
+    m_metrics.dropped();
+    return false;
+}
+
+void ZoomSDKRendererDelegate::updateOutput()
+{
+    if (m_filename.empty())
+        m_filename = "meeting-video.yuv";
+    m_hasDir = !m_dir.empty();
+
+    // restarting the writer closes the file, only done for a new output
+    auto output = FileSink::segmentPath(m_dir + "/" + m_filename, m_segment);
+    if (output == m_output && m_directIO == m_outputDirect)
+        return;
 
-    file.write(data->GetBuffer(), data->GetBufferLen());
+    m_output = output;
+    m_outputDirect = m_directIO;
+    m_writer.setOutput(m_output, m_directIO, c_expectedFps);
+}
 
-    file.close();
-    file.flush();
+unsigned int ZoomSDKRendererDelegate::rotate()
+{
+    m_output = FileSink::segmentPath(m_dir + "/" + m_filename, ++m_segment);
+    m_writer.rotate(m_output);
+    return m_segment;
 }
 
 void ZoomSDKRendererDelegate::setDir(const string &dir)
 {
     m_dir = dir;
+    updateOutput();
 }
 
 void ZoomSDKRendererDelegate::setFilename(const string &filename)
 {
     m_filename = filename;
+    updateOutput();
+}
+
+void ZoomSDKRendererDelegate::setDirectIO(bool direct)
+{
+    m_directIO = direct;
+    updateOutput();
+}
+
+void ZoomSDKRendererDelegate::setOutput(const string& dir, const string& filename, bool direct)
+{
+    m_dir = dir;
+    m_filename = filename;
+    m_directIO = direct;
+    updateOutput();
+}
+
+void ZoomSDKRendererDelegate::closeFiles()
+{
+    m_writer.close();
 }
@@ -1,6 +1,7 @@
 #ifndef MEETING_SDK_LINUX_SAMPLE_ZOOMSDKRENDERERDELEGATE_H
 #define MEETING_SDK_LINUX_SAMPLE_ZOOMSDKRENDERERDELEGATE_H
 
+#include <charconv>
 #include <thread>
 #include <iostream>
 #include <fstream>
@@ -23,6 +24,11 @@
 
 #include "../util/SocketServer.h"
 #include "../util/Log.h"
+#include "../util/MemoryBudget.h"
+#include "../util/Metrics.h"
+#include "../util/Trace.h"
+#include "CallbackRecorder.h"
+#include "VideoWriter.h"
 
 // Temporarily comment out OpenCV namespace
 // using namespace cv;
@@ -39,10 +45,15 @@ public:
 
 class ZoomSDKRendererDelegate : public IZoomSDKRendererDelegate {
     const string c_window = "Face_Detection";
+
+    // the SDK's ceiling for raw video, sizes preallocation; the writer
+    // measures the real frame interval from the frames
+    static constexpr unsigned int c_expectedFps = 30;
     string m_dir = "out";
     string m_filename = "meeting-video.yuv";
 
     unsigned int m_frameCount = 0;
+    char m_counter[16];
     double m_scale=3;
     double m_fx = 1/m_scale;
 
@@ -52,14 +63,61 @@ class ZoomSDKRendererDelegate : public IZoomSDKRendererDelegate {
 
     SocketServer m_socketServer;
 
+    CallbackMetrics m_metrics{"video"};
+
+    VideoWriter m_writer{m_metrics};
+    bool m_directIO = false;
+    unsigned int m_segment = 0;
+
+    // output last given to the writer, it is only restarted when this changes
+    string m_output;
+    bool m_outputDirect = false;
+
+    // read by the callback in place of m_dir, which only the main thread touches
+    atomic<bool> m_hasDir{true};
+
+    void updateOutput();
+
 public:
     ZoomSDKRendererDelegate();
 
-    void writeToFile(const string& path, YUVRawDataI420* data);
+    bool writeToFile(YUVRawDataI420* data, uint64_t arrivalNs);
 
     void setDir(const string& dir);
     void setFilename(const string& filename);
 
+    /**
+     * Write the video with O_DIRECT, keeping it out of the page cache
+     */
+    void setDirectIO(bool direct);
+
+    /**
+     * Set the directory, file name and O_DIRECT at once, so the writer is
+     * restarted at most once and only if the output changed
+     */
+    void setOutput(const string& dir, const string& filename, bool direct);
+
+    /**
+     * The asynchronous writer behind the output file, for flow control
+     */
+    VideoWriter& writer() { return m_writer; }
+
+    /**
+     * Continue in a new file, <name>-<n>.<ext>, after the frames queued so far
+     * @return the new segment number
+     */
+    unsigned int rotate();
+
+    /**
+     * Hand the frames queued so far to the kernel
+     */
+    void flush() { m_writer.flush(); }
+
+    /**
+     * Flush and close the output file, only once callbacks have stopped
+     */
+    void closeFiles();
+
     void onRawDataFrameReceived(YUVRawDataI420* data) override;
     void onRawDataStatusChanged(RawDataStatus status) override {};
     void onRendererBeDestroyed() override {};
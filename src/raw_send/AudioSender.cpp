@@ -0,0 +1,98 @@
+#include "AudioSender.h"
+
+#include <cerrno>
+
+#include <time.h>
+
+#include "../util/Log.h"
+#include "../util/Threads.h"
+
+namespace {
+    void sleepUntil(uint64_t ns) {
+        timespec ts{};
+        ts.tv_sec = ns / 1000000000ull;
+        ts.tv_nsec = ns % 1000000000ull;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+    }
+}
+
+AudioSender::AudioSender() :
+        m_jitter(MetricsRegistry::getInstance().histogram("zoombot_mic_send_jitter_seconds",
+                "Distance of each virtual microphone frame from its deadline")),
+        m_latency(MetricsRegistry::getInstance().histogram("zoombot_mic_latency_seconds",
+                "Audio buffered ahead of each virtual microphone frame")),
+        m_sentCounter(MetricsRegistry::getInstance().counter("zoombot_mic_frames_total",
+                "Virtual microphone frames sent to the meeting")),
+        m_skippedCounter(MetricsRegistry::getInstance().counter("zoombot_mic_skipped_frames_total",
+                "Virtual microphone deadlines missed entirely")),
+        m_failed(MetricsRegistry::getInstance().counter("zoombot_mic_failures_total",
+                "Virtual microphone frames the SDK refused")) {}
+
+AudioSender::~AudioSender() {
+    stop();
+}
+
+bool AudioSender::start(IZoomSDKAudioRawDataSender* sender, JitterBuffer& buffer) {
+    stop();
+
+    if (!sender)
+        return false;
+
+    m_sender = sender;
+    m_buffer = &buffer;
+    m_frame.resize(buffer.frameSamples());
+
+    m_running = true;
+    m_thread = thread(&AudioSender::run, this);
+
+    Log::info("sending microphone audio at " + to_string(buffer.rate()) + " Hz");
+    return true;
+}
+
+void AudioSender::stop() {
+    if (!m_running.exchange(false))
+        return;
+
+    if (m_thread.joinable())
+        m_thread.join();
+
+    Log::info("sent " + to_string(sent()) + " audio frames, " + to_string(concealed()) + " concealed, "
+              + to_string(skipped()) + " skipped");
+}
+
+void AudioSender::run() {
+    ThreadRegistry::getInstance().enroll(ThreadClass::Main, "zoombot-mic");
+
+    auto rate = m_buffer->rate();
+    auto len = static_cast<unsigned int>(m_frame.size() * sizeof(int16_t));
+    auto* data = reinterpret_cast<char*>(m_frame.data());
+    auto deadline = MetricsClock::nowNs() + c_periodNs;
+
+    while (m_running.load(memory_order_relaxed)) {
+        sleepUntil(deadline);
+        m_jitter.observe(MetricsClock::nowNs() - deadline);
+
+        m_latency.observe(m_buffer->level() * 1000000000ull / rate);
+        if (!m_buffer->pop(m_frame.data()))
+            m_concealed++;
+
+        auto err = m_sender->send(data, len, static_cast<int>(rate), ZoomSDKAudioChannel_Mono);
+        if (err != SDKERR_SUCCESS) {
+            m_failed.inc();
+            LOG_EVERY_MS(5000, Log::warn, "failed to send audio frame with status " + to_string(err));
+        } else {
+            m_sent++;
+            m_sentCounter.inc();
+        }
+
+        // like VideoSender, a stall skips the missed frames instead of catching up
+        deadline += c_periodNs;
+        auto now = MetricsClock::nowNs();
+        if (now > deadline + c_periodNs) {
+            auto missed = (now - deadline) / c_periodNs;
+            deadline += missed * c_periodNs;
+            m_skipped += missed;
+            m_skippedCounter.inc(missed);
+        }
+    }
+}
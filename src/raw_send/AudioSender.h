@@ -0,0 +1,69 @@
+#ifndef MEETINGSDK_HEADLESS_LINUX_SAMPLE_AUDIOSENDER_H
+#define MEETINGSDK_HEADLESS_LINUX_SAMPLE_AUDIOSENDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "rawdata/rawdata_audio_helper_interface.h"
+
+#include "JitterBuffer.h"
+#include "../util/Metrics.h"
+
+using namespace std;
+using namespace ZOOMSDK;
+
+/**
+ * Sends one 10 ms frame from a JitterBuffer to the SDK every 10 ms from a
+ * thread of its own, on absolute deadlines like VideoSender. A missed
+ * period is skipped rather than sent in a burst, the buffer absorbs it.
+ */
+class AudioSender {
+    static constexpr uint64_t c_periodNs = 10000000;
+
+    IZoomSDKAudioRawDataSender* m_sender = nullptr;
+    JitterBuffer* m_buffer = nullptr;
+    vector<int16_t> m_frame;
+
+    thread m_thread;
+    atomic<bool> m_running{false};
+
+    atomic<uint64_t> m_sent{0};
+    atomic<uint64_t> m_concealed{0};
+    atomic<uint64_t> m_skipped{0};
+
+    Histogram& m_jitter;
+    Histogram& m_latency;
+    Counter& m_sentCounter;
+    Counter& m_skippedCounter;
+    Counter& m_failed;
+
+    void run();
+
+public:
+    AudioSender();
+    ~AudioSender();
+
+    /**
+     * Start sending, restarting if already running
+     */
+    bool start(IZoomSDKAudioRawDataSender* sender, JitterBuffer& buffer);
+    void stop();
+
+    bool isRunning() const { return m_running.load(memory_order_relaxed); }
+
+    uint64_t sent() const { return m_sent.load(memory_order_relaxed); }
+
+    /**
+     * Frames sent without input, from silence or a repeat
+     */
+    uint64_t concealed() const { return m_concealed.load(memory_order_relaxed); }
+
+    /**
+     * Deadlines missed entirely
+     */
+    uint64_t skipped() const { return m_skipped.load(memory_order_relaxed); }
+};
+
+#endif //MEETINGSDK_HEADLESS_LINUX_SAMPLE_AUDIOSENDER_H
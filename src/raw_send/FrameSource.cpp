@@ -0,0 +1,147 @@
+#include "FrameSource.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../util/Log.h"
+
+unique_ptr<FrameSource> FrameSource::create(const string& spec) {
+    if (spec == "pattern")
+        return make_unique<PatternFrameSource>();
+    if (spec.compare(0, 5, "file:") == 0 && spec.size() > 5)
+        return make_unique<FileFrameSource>(spec.substr(5));
+    if (spec.compare(0, 4, "shm:") == 0 && spec.size() > 4)
+        return make_unique<ShmFrameSource>(spec.substr(4));
+
+    Log::error("unknown video source " + spec + ", expected pattern, file:PATH or shm:NAME");
+    return nullptr;
+}
+
+bool PatternFrameSource::read(Frame& frame) {
+    auto luma = frame.width * frame.height;
+    memset(frame.data + luma, 128, frame.len - luma);
+
+    for (unsigned int y = 0; y < frame.height; y++)
+        memset(frame.data + y * frame.width, static_cast<char>((y + m_count) & 0xff), frame.width);
+
+    m_count++;
+    return true;
+}
+
+FileFrameSource::~FileFrameSource() {
+    if (m_fd != -1)
+        close(m_fd);
+}
+
+bool FileFrameSource::open(unsigned int width, unsigned int height) {
+    if (m_fd == -1)
+        m_fd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (m_fd == -1) {
+        Log::error("failed to open video source " + m_path + ": " + strerror(errno));
+        return false;
+    }
+
+    struct stat st{};
+    fstat(m_fd, &st);
+
+    m_frames = st.st_size / (width * height * 3 / 2);
+    m_next = 0;
+    if (!m_frames) {
+        Log::error(m_path + " holds no " + to_string(width) + "x" + to_string(height) + " I420 frame");
+        return false;
+    }
+
+    posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return true;
+}
+
+bool FileFrameSource::read(Frame& frame) {
+    auto offset = static_cast<off_t>(m_next++ % m_frames) * frame.len;
+
+    size_t done = 0;
+    while (done < frame.len) {
+        auto n = pread(m_fd, frame.data + done, frame.len - done, offset + done);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            LOG_EVERY_MS(5000, Log::error, "failed to read video source " + m_path + ": " + strerror(errno));
+            return false;
+        }
+        done += n;
+    }
+
+    return true;
+}
+
+ShmFrameSource::~ShmFrameSource() {
+    if (m_ring)
+        munmap(m_ring, m_size);
+}
+
+bool ShmFrameSource::open(unsigned int width, unsigned int height) {
+    if (m_ring)
+        return m_ring->width == width && m_ring->height == height;
+
+    auto fd = shm_open(("/" + m_name).c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd == -1) {
+        Log::error("failed to open shared memory " + m_name + ": " + strerror(errno));
+        return false;
+    }
+
+    struct stat st{};
+    fstat(fd, &st);
+
+    auto* map = st.st_size >= static_cast<off_t>(sizeof(ShmFrameRing))
+            ? mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        Log::error("failed to map shared memory " + m_name);
+        return false;
+    }
+
+    auto* ring = static_cast<ShmFrameRing*>(map);
+    auto valid = ring->magic == ShmFrameRing::c_magic && ring->version == ShmFrameRing::c_version
+            && ring->slots > 0 && ring->slotSize == ShmFrameRing::stride(ring->frameSize)
+            && static_cast<uint64_t>(st.st_size) >= ShmFrameRing::size(ring->frameSize, ring->slots);
+
+    if (!valid || ring->width != width || ring->height != height) {
+        Log::error("shared memory " + m_name + " is not a " + to_string(width) + "x" + to_string(height) + " frame ring");
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    m_ring = ring;
+    m_size = st.st_size;
+    m_last = 0;
+    return true;
+}
+
+bool ShmFrameSource::read(Frame& frame) {
+    auto published = m_ring->published.load(memory_order_acquire);
+    if (published == m_last)
+        return false;
+
+    // a frame is only usable if its slot was not rewritten while copying it
+    auto n = published - 1;
+    auto& slot = m_ring->slot(n);
+    auto before = slot.sequence.load(memory_order_acquire);
+    if (before != 2 * n + 2)
+        return false;
+
+    memcpy(frame.data, m_ring->frame(n), min<size_t>(frame.len, m_ring->frameSize));
+
+    atomic_thread_fence(memory_order_acquire);
+    if (slot.sequence.load(memory_order_relaxed) != before)
+        return false;
+
+    m_last = published;
+    return true;
+}
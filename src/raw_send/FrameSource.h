@@ -0,0 +1,134 @@
+#ifndef MEETINGSDK_HEADLESS_LINUX_SAMPLE_FRAMESOURCE_H
+#define MEETINGSDK_HEADLESS_LINUX_SAMPLE_FRAMESOURCE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+/**
+ * An I420 frame in a buffer owned by someone else
+ */
+struct Frame {
+    char* data;
+    unsigned int width;
+    unsigned int height;
+    unsigned int len;
+};
+
+/**
+ * Where the video sender gets its frames. Frames are read into buffers the
+ * sender allocated up front, so a source must not allocate per frame.
+ */
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    /**
+     * Prepare to produce frames of the given size
+     * @return false if the source cannot, e.g. a ring of another size
+     */
+    virtual bool open(unsigned int width, unsigned int height) = 0;
+
+    /**
+     * Fill the next frame
+     * @param frame buffer of width * height * 3 / 2 bytes
+     * @return false if there is no new frame, the previous one is sent again
+     */
+    virtual bool read(Frame& frame) = 0;
+
+    virtual string describe() const = 0;
+
+    /**
+     * Create a source from "pattern", "file:PATH" (raw I420, looped) or
+     * "shm:NAME" (a ShmFrameRing under /dev/shm)
+     * @return nullptr if the spec is not one of those
+     */
+    static unique_ptr<FrameSource> create(const string& spec);
+};
+
+/**
+ * Moving gradient test pattern
+ */
+class PatternFrameSource : public FrameSource {
+    unsigned int m_count = 0;
+
+public:
+    bool open(unsigned int width, unsigned int height) override { return true; }
+    bool read(Frame& frame) override;
+    string describe() const override { return "test pattern"; }
+};
+
+/**
+ * Raw I420 frames from a file, from the start again at its end
+ */
+class FileFrameSource : public FrameSource {
+    string m_path;
+    int m_fd = -1;
+    uint64_t m_frames = 0;
+    uint64_t m_next = 0;
+
+public:
+    explicit FileFrameSource(string path) : m_path(move(path)) {}
+    ~FileFrameSource() override;
+
+    bool open(unsigned int width, unsigned int height) override;
+    bool read(Frame& frame) override;
+    string describe() const override { return m_path; }
+};
+
+/**
+ * Layout of a shared-memory frame ring, written by another process. The
+ * header is followed by `slots` slots of `slotSize` bytes, each a sequence
+ * number and then the frame. A producer writing frame n into slot n % slots
+ * sets the sequence to 2n + 1, copies the frame, sets it to 2n + 2 and then
+ * stores n + 1 into `published`.
+ */
+struct ShmFrameRing {
+    static constexpr uint32_t c_magic = 0x5a425652; // "ZBVR"
+    static constexpr uint32_t c_version = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frameSize;
+    uint32_t slots;
+    uint64_t slotSize;
+    alignas(64) atomic<uint64_t> published;
+
+    struct alignas(64) Slot {
+        atomic<uint64_t> sequence;
+    };
+
+    static uint64_t stride(uint32_t frameSize) { return (sizeof(Slot) + frameSize + 63) / 64 * 64; }
+    static uint64_t size(uint32_t frameSize, uint32_t slots) { return sizeof(ShmFrameRing) + slots * stride(frameSize); }
+
+    Slot& slot(uint64_t n) {
+        return *reinterpret_cast<Slot*>(reinterpret_cast<char*>(this + 1) + (n % slots) * slotSize);
+    }
+
+    char* frame(uint64_t n) { return reinterpret_cast<char*>(&slot(n) + 1); }
+};
+
+/**
+ * Newest frame of a shared-memory ring, the last one again if none is new
+ */
+class ShmFrameSource : public FrameSource {
+    string m_name;
+    ShmFrameRing* m_ring = nullptr;
+    size_t m_size = 0;
+    uint64_t m_last = 0;
+
+public:
+    explicit ShmFrameSource(string name) : m_name(move(name)) {}
+    ~ShmFrameSource() override;
+
+    bool open(unsigned int width, unsigned int height) override;
+    bool read(Frame& frame) override;
+    string describe() const override { return "shm:" + m_name; }
+};
+
+#endif //MEETINGSDK_HEADLESS_LINUX_SAMPLE_FRAMESOURCE_H
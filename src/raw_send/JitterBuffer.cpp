@@ -0,0 +1,145 @@
+#include "JitterBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+JitterBuffer::JitterBuffer(unsigned int rate) :
+        m_rate(rate),
+        m_frame(rate / 100),
+        m_underruns(MetricsRegistry::getInstance().counter("zoombot_mic_underruns_total",
+                "Times the virtual microphone ran out of input")),
+        m_concealedFrames(MetricsRegistry::getInstance().counter("zoombot_mic_concealed_frames_total",
+                "Virtual microphone frames filled with silence or a repeat")),
+        m_trimmed(MetricsRegistry::getInstance().counter("zoombot_mic_trimmed_samples_total",
+                "Input samples dropped to keep the virtual microphone's latency bounded")),
+        m_targetGauge(MetricsRegistry::getInstance().gauge("zoombot_mic_target_ms",
+                "Delay the virtual microphone buffers before playing")) {
+    // room for twice the largest target plus a burst
+    m_ring.resize(samples(2 * c_maxTargetMs) + 10 * m_frame);
+    m_lastFrame.resize(m_frame);
+    m_targetGauge.set(m_targetMs);
+}
+
+void JitterBuffer::setConcealment(Concealment concealment) {
+    lock_guard<mutex> lock(m_lock);
+    m_concealment = concealment;
+}
+
+void JitterBuffer::push(const int16_t* in, size_t n) {
+    lock_guard<mutex> lock(m_lock);
+
+    // the input was late, not finished: wait longer from now on
+    if (m_dry && n) {
+        if (m_dryFrames <= c_gapFrames) {
+            m_underruns.inc();
+            m_concealedFrames.inc(m_dryFrames);
+            m_stable = 0;
+            m_targetMs = min(c_maxTargetMs, m_targetMs + c_raiseMs);
+            m_targetGauge.set(m_targetMs);
+        }
+        m_dry = false;
+    }
+
+    auto capacity = m_ring.size();
+    if (n > capacity) {
+        in += n - capacity;
+        n = capacity;
+    }
+
+    if (m_count + n > capacity) {
+        auto drop = m_count + n - capacity;
+        m_head = (m_head + drop) % capacity;
+        m_count -= drop;
+        m_trimmed.inc(drop);
+    }
+
+    auto tail = (m_head + m_count) % capacity;
+    auto first = min(n, capacity - tail);
+    memcpy(m_ring.data() + tail, in, first * sizeof(int16_t));
+    memcpy(m_ring.data(), in + first, (n - first) * sizeof(int16_t));
+    m_count += n;
+}
+
+void JitterBuffer::take(int16_t* out, size_t n) {
+    auto capacity = m_ring.size();
+    auto first = min(n, capacity - m_head);
+    memcpy(out, m_ring.data() + m_head, first * sizeof(int16_t));
+    memcpy(out + first, m_ring.data(), (n - first) * sizeof(int16_t));
+    m_head = (m_head + n) % capacity;
+    m_count -= n;
+}
+
+void JitterBuffer::conceal(int16_t* out, size_t n) {
+    if (m_dry)
+        m_dryFrames++;
+
+    if (m_concealment == Concealment::Silence || m_concealed >= c_repeatFrames) {
+        memset(out, 0, n * sizeof(int16_t));
+        m_concealed++;
+        return;
+    }
+
+    // each repeat at half the level of the one before, so a gap fades out
+    auto shift = ++m_concealed;
+    for (size_t i = 0; i < n; i++)
+        out[i] = static_cast<int16_t>(m_lastFrame[i] >> shift);
+}
+
+bool JitterBuffer::pop(int16_t* out) {
+    lock_guard<mutex> lock(m_lock);
+
+    if (m_buffering) {
+        if (m_count < samples(m_targetMs)) {
+            conceal(out, m_frame);
+            return false;
+        }
+        m_buffering = false;
+    }
+
+    if (m_count < m_frame) {
+        m_buffering = true;
+        m_dry = true;
+        m_dryFrames = 0;
+
+        conceal(out, m_frame);
+        return false;
+    }
+
+    // input arrived faster than it plays, drop back to the target
+    if (m_count > 2 * samples(m_targetMs) + m_frame) {
+        auto drop = m_count - samples(m_targetMs);
+        m_head = (m_head + drop) % m_ring.size();
+        m_count -= drop;
+        m_trimmed.inc(drop);
+    }
+
+    take(out, m_frame);
+    memcpy(m_lastFrame.data(), out, m_frame * sizeof(int16_t));
+    m_concealed = 0;
+
+    if (++m_stable >= c_stableFrames && m_targetMs > c_minTargetMs) {
+        m_targetMs = max(c_minTargetMs, m_targetMs - c_lowerMs);
+        m_targetGauge.set(m_targetMs);
+        m_stable = 0;
+    }
+
+    return true;
+}
+
+void JitterBuffer::reset() {
+    lock_guard<mutex> lock(m_lock);
+    m_head = m_count = 0;
+    m_buffering = true;
+    m_dry = false;
+    m_concealed = c_repeatFrames;
+}
+
+size_t JitterBuffer::level() const {
+    lock_guard<mutex> lock(m_lock);
+    return m_count;
+}
+
+unsigned int JitterBuffer::targetMs() const {
+    lock_guard<mutex> lock(m_lock);
+    return m_targetMs;
+}
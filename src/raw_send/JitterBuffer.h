@@ -0,0 +1,102 @@
+#ifndef MEETINGSDK_HEADLESS_LINUX_SAMPLE_JITTERBUFFER_H
+#define MEETINGSDK_HEADLESS_LINUX_SAMPLE_JITTERBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "../util/Metrics.h"
+
+using namespace std;
+
+/**
+ * Adaptive playout buffer between bursty PCM input and the fixed 10 ms
+ * frames the SDK takes. Playback starts, and restarts after running dry,
+ * once the target delay is buffered. Input resuming shortly after running
+ * dry was late rather than finished, an underrun: it raises the target, and
+ * ten seconds without one lower it again. Input piling up beyond twice the
+ * target is trimmed so latency stays bounded. Missing frames are concealed
+ * with silence or a fading repeat of the last frame.
+ */
+class JitterBuffer {
+public:
+    enum class Concealment {
+        Silence,
+        Repeat
+    };
+
+    static constexpr unsigned int c_minTargetMs = 40;
+    static constexpr unsigned int c_maxTargetMs = 400;
+
+private:
+    static constexpr unsigned int c_raiseMs = 20;
+    static constexpr unsigned int c_lowerMs = 10;
+    static constexpr unsigned int c_stableFrames = 1000;
+
+    // repeats of the last frame before falling back to silence
+    static constexpr unsigned int c_repeatFrames = 3;
+
+    // a gap up to this long is an underrun, a longer one the end of the input
+    static constexpr unsigned int c_gapFrames = 20;
+
+    mutable mutex m_lock;
+
+    vector<int16_t> m_ring;
+    size_t m_head = 0;
+    size_t m_count = 0;
+
+    unsigned int m_rate;
+    size_t m_frame;
+    unsigned int m_targetMs = c_minTargetMs;
+    bool m_buffering = true;
+    unsigned int m_stable = 0;
+
+    Concealment m_concealment = Concealment::Repeat;
+    vector<int16_t> m_lastFrame;
+    unsigned int m_concealed = 0;
+
+    bool m_dry = false;
+    unsigned int m_dryFrames = 0;
+
+    Counter& m_underruns;
+    Counter& m_concealedFrames;
+    Counter& m_trimmed;
+    Gauge& m_targetGauge;
+
+    size_t samples(unsigned int ms) const { return static_cast<size_t>(m_rate) * ms / 1000; }
+    void take(int16_t* out, size_t n);
+    void conceal(int16_t* out, size_t n);
+
+public:
+    /**
+     * @param rate output sample rate, frames are 10 ms of it
+     */
+    explicit JitterBuffer(unsigned int rate);
+
+    void setConcealment(Concealment concealment);
+
+    /**
+     * Add input, dropping the oldest samples if the buffer is full
+     */
+    void push(const int16_t* in, size_t n);
+
+    /**
+     * Fill one 10 ms frame
+     * @return false if it was concealed
+     */
+    bool pop(int16_t* out);
+
+    /**
+     * Drop everything buffered and start buffering again
+     */
+    void reset();
+
+    unsigned int rate() const { return m_rate; }
+    size_t frameSamples() const { return m_frame; }
+
+    size_t level() const;
+    unsigned int targetMs() const;
+};
+
+#endif //MEETINGSDK_HEADLESS_LINUX_SAMPLE_JITTERBUFFER_H
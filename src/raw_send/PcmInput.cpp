@@ -0,0 +1,191 @@
+#include "PcmInput.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../util/Log.h"
+#include "../util/Threads.h"
+
+PcmInput::PcmInput(string path, bool socket, unsigned int rate) :
+        m_path(move(path)),
+        m_socket(socket),
+        m_rate(rate) {}
+
+PcmInput::~PcmInput() {
+    stop();
+}
+
+unique_ptr<PcmInput> PcmInput::create(const string& spec, unsigned int rate) {
+    if (rate < 8000 || rate > 48000) {
+        Log::error("unsupported audio input rate " + to_string(rate) + ", expected 8000 to 48000");
+        return nullptr;
+    }
+
+    if (spec.rfind("file:", 0) == 0 && spec.size() > 5)
+        return make_unique<PcmInput>(spec.substr(5), false, rate);
+
+    if (spec.rfind("unix:", 0) == 0 && spec.size() > 5)
+        return make_unique<PcmInput>(spec.substr(5), true, rate);
+
+    Log::error("unknown audio source " + spec + ", expected file:PATH or unix:PATH");
+    return nullptr;
+}
+
+string PcmInput::describe() const {
+    return (m_socket ? "socket " : "") + m_path + " (" + to_string(m_rate) + " Hz)";
+}
+
+bool PcmInput::start(JitterBuffer& buffer) {
+    stop();
+
+    m_buffer = &buffer;
+    m_resampler.reset(m_rate, buffer.rate());
+    m_carry = 0;
+
+    auto chunk = m_rate * c_chunkMs / 1000;
+    m_raw.resize(chunk + 1);
+    m_resampled.resize(m_resampler.maxOutput(chunk + 1));
+
+    if (m_socket) {
+        m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (m_listenFd == -1) {
+            Log::error("unable to create audio input socket");
+            return false;
+        }
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, m_path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(m_path.c_str());
+
+        if (bind(m_listenFd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == -1
+            || listen(m_listenFd, 1) == -1) {
+            Log::error("unable to listen on audio input socket " + m_path + ": " + strerror(errno));
+            close(m_listenFd);
+            m_listenFd = -1;
+            return false;
+        }
+    }
+
+    m_running = true;
+    m_thread = thread(m_socket ? &PcmInput::runSocket : &PcmInput::runFile, this);
+
+    Log::info("reading microphone audio from " + describe());
+    return true;
+}
+
+void PcmInput::stop() {
+    if (!m_running.exchange(false))
+        return;
+
+    if (m_thread.joinable())
+        m_thread.join();
+
+    if (m_listenFd != -1) {
+        close(m_listenFd);
+        m_listenFd = -1;
+        unlink(m_path.c_str());
+    }
+}
+
+bool PcmInput::wait(int fd) const {
+    // wake up now and then to notice stop()
+    pollfd pfd{fd, POLLIN, 0};
+    return poll(&pfd, 1, 100) > 0;
+}
+
+ssize_t PcmInput::pump(int fd) {
+    auto* bytes = reinterpret_cast<char*>(m_raw.data());
+    auto room = (m_raw.size() - 1) * sizeof(int16_t);
+
+    auto ret = read(fd, bytes + m_carry, room);
+    if (ret <= 0)
+        return ret;
+
+    auto total = m_carry + ret;
+    auto samples = total / sizeof(int16_t);
+
+    auto n = m_resampler.process(m_raw.data(), samples, m_resampled.data());
+    m_buffer->push(m_resampled.data(), n);
+
+    // keep an odd trailing byte for the next read
+    m_carry = total % sizeof(int16_t);
+    if (m_carry)
+        bytes[0] = bytes[total - 1];
+
+    return ret;
+}
+
+void PcmInput::runFile() {
+    ThreadRegistry::getInstance().enroll(ThreadClass::Socket, "zoombot-mic-in");
+
+    auto fd = open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        Log::error("failed to open audio source " + m_path + ": " + strerror(errno));
+        return;
+    }
+
+    auto frame = m_buffer->frameSamples();
+
+    while (m_running.load(memory_order_relaxed)) {
+        // stay just ahead of playback, the file is not a live source
+        auto ahead = m_buffer->rate() * m_buffer->targetMs() / 1000 + 2 * frame;
+        if (m_buffer->level() >= ahead) {
+            usleep(5000);
+            continue;
+        }
+
+        auto ret = pump(fd);
+        if (ret == 0) {
+            Log::info("finished playing " + m_path);
+            break;
+        }
+
+        if (ret == -1 && errno != EINTR) {
+            Log::error("failed to read audio source " + m_path + ": " + strerror(errno));
+            break;
+        }
+    }
+
+    close(fd);
+}
+
+void PcmInput::runSocket() {
+    ThreadRegistry::getInstance().enroll(ThreadClass::Socket, "zoombot-mic-in");
+
+    while (m_running.load(memory_order_relaxed)) {
+        if (!wait(m_listenFd))
+            continue;
+
+        auto client = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client == -1)
+            continue;
+
+        Log::info("audio input client connected");
+        m_resampler.reset(m_rate, m_buffer->rate());
+        m_carry = 0;
+
+        while (m_running.load(memory_order_relaxed)) {
+            if (!wait(client))
+                continue;
+
+            auto ret = pump(client);
+            if (ret == 0)
+                break;
+
+            if (ret == -1 && errno != EINTR) {
+                Log::warn("failed to read audio input: " + string(strerror(errno)));
+                break;
+            }
+        }
+
+        close(client);
+        Log::info("audio input client disconnected");
+    }
+}
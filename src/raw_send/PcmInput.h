@@ -0,0 +1,77 @@
+#ifndef MEETINGSDK_HEADLESS_LINUX_SAMPLE_PCMINPUT_H
+#define MEETINGSDK_HEADLESS_LINUX_SAMPLE_PCMINPUT_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "JitterBuffer.h"
+#include "Resampler.h"
+
+using namespace std;
+
+/**
+ * Reads 16-bit little-endian mono PCM for the virtual microphone on a
+ * thread of its own, resamples it and hands it to a JitterBuffer. A file is
+ * played once, no faster than the buffer drains. A unix socket takes one
+ * client at a time, e.g. a TTS engine, and listens again when it hangs up;
+ * a client sending faster than real time is trimmed by the buffer.
+ */
+class PcmInput {
+    // read in 20 ms chunks of input
+    static constexpr unsigned int c_chunkMs = 20;
+
+    string m_path;
+    bool m_socket;
+    unsigned int m_rate;
+
+    JitterBuffer* m_buffer = nullptr;
+    Resampler m_resampler;
+
+    // one extra sample of room for a byte left over from the previous read
+    vector<int16_t> m_raw;
+    size_t m_carry = 0;
+    vector<int16_t> m_resampled;
+
+    int m_listenFd = -1;
+
+    thread m_thread;
+    atomic<bool> m_running{false};
+
+    void runFile();
+    void runSocket();
+
+    /**
+     * Read once from fd and pass what arrived on
+     * @return bytes read, 0 at the end, -1 on error
+     */
+    ssize_t pump(int fd);
+
+    bool wait(int fd) const;
+
+public:
+    PcmInput(string path, bool socket, unsigned int rate);
+    ~PcmInput();
+
+    /**
+     * Start reading into the buffer, whose rate the input is resampled to
+     */
+    bool start(JitterBuffer& buffer);
+    void stop();
+
+    string describe() const;
+
+    /**
+     * Create an input from "file:PATH" or "unix:PATH"
+     * @param rate sample rate of the PCM
+     * @return nullptr if the spec is not one of those
+     */
+    static unique_ptr<PcmInput> create(const string& spec, unsigned int rate);
+};
+
+#endif //MEETINGSDK_HEADLESS_LINUX_SAMPLE_PCMINPUT_H
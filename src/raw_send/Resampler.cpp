@@ -0,0 +1,38 @@
+#include "Resampler.h"
+
+#include <cstring>
+
+void Resampler::reset(unsigned int inRate, unsigned int outRate) {
+    m_inRate = inRate ? inRate : 1;
+    m_outRate = outRate ? outRate : 1;
+    m_step = static_cast<double>(m_inRate) / m_outRate;
+    m_position = 0;
+    m_last = 0;
+}
+
+size_t Resampler::process(const int16_t* in, size_t n, int16_t* out) {
+    if (!n)
+        return 0;
+
+    if (passthrough()) {
+        memcpy(out, in, n * sizeof(int16_t));
+        return n;
+    }
+
+    // sample i of the chunk is at position i + 1, the previous chunk's last at 0
+    size_t written = 0;
+    while (m_position < n) {
+        auto index = static_cast<size_t>(m_position);
+        auto frac = m_position - index;
+
+        auto a = index ? in[index - 1] : m_last;
+        auto b = in[index];
+        out[written++] = static_cast<int16_t>(a + (b - a) * frac);
+
+        m_position += m_step;
+    }
+
+    m_position -= n;
+    m_last = in[n - 1];
+    return written;
+}
@@ -0,0 +1,40 @@
+#ifndef MEETINGSDK_HEADLESS_LINUX_SAMPLE_RESAMPLER_H
+#define MEETINGSDK_HEADLESS_LINUX_SAMPLE_RESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * Streaming linear-interpolation resampler for 16-bit mono PCM. Chunks may
+ * be any length, the phase carries over from one to the next. Good enough
+ * for speech into a 32 kHz meeting; it does not low-pass when downsampling.
+ */
+class Resampler {
+    unsigned int m_inRate = 1;
+    unsigned int m_outRate = 1;
+    double m_step = 1;
+
+    // next output position in input samples, 0 being the last sample of the previous chunk
+    double m_position = 0;
+    int16_t m_last = 0;
+
+public:
+    void reset(unsigned int inRate, unsigned int outRate);
+
+    bool passthrough() const { return m_inRate == m_outRate; }
+
+    /**
+     * Most samples process() can produce from n input samples
+     */
+    size_t maxOutput(size_t n) const { return n * m_outRate / m_inRate + 2; }
+
+    /**
+     * @param out room for maxOutput(n) samples
+     * @return samples written to out
+     */
+    size_t process(const int16_t* in, size_t n, int16_t* out);
+};
+
+#endif //MEETINGSDK_HEADLESS_LINUX_SAMPLE_RESAMPLER_H
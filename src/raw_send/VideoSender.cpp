@@ -0,0 +1,126 @@
+#include "VideoSender.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <time.h>
+
+#include "../util/Log.h"
+#include "../util/Threads.h"
+
+namespace {
+    void sleepUntil(uint64_t ns) {
+        timespec ts{};
+        ts.tv_sec = ns / 1000000000ull;
+        ts.tv_nsec = ns % 1000000000ull;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+    }
+}
+
+VideoSender::VideoSender() :
+        m_jitter(MetricsRegistry::getInstance().histogram("zoombot_sender_jitter_seconds",
+                "Distance of each sent frame from its deadline")),
+        m_sentCounter(MetricsRegistry::getInstance().counter("zoombot_sender_frames_total",
+                "Video frames sent to the meeting")),
+        m_lateCounter(MetricsRegistry::getInstance().counter("zoombot_sender_late_frames_total",
+                "Video frames sent more than half a period late")),
+        m_skippedCounter(MetricsRegistry::getInstance().counter("zoombot_sender_skipped_frames_total",
+                "Video frame deadlines missed entirely")),
+        m_failed(MetricsRegistry::getInstance().counter("zoombot_sender_failures_total",
+                "Video frames the SDK refused")) {}
+
+VideoSender::~VideoSender() {
+    stop();
+}
+
+void VideoSender::setSource(unique_ptr<FrameSource> source) {
+    stop();
+    m_source = move(source);
+}
+
+bool VideoSender::start(IZoomSDKVideoSender* sender, unsigned int width, unsigned int height, unsigned int fps) {
+    stop();
+
+    if (!m_source || !sender || !width || !height || !fps)
+        return false;
+
+    if (!m_source->open(width, height))
+        return false;
+
+    size_t len = width * height * 3 / 2;
+    if (len != m_bufferSize) {
+        m_buffers.reset(new char[2 * len]);
+        m_bufferSize = len;
+    }
+
+    m_front = Frame{m_buffers.get(), width, height, static_cast<unsigned int>(len)};
+    m_back = Frame{m_buffers.get() + len, width, height, static_cast<unsigned int>(len)};
+
+    // nothing to repeat yet, start from black if the source has no frame
+    memset(m_front.data, 0, width * height);
+    memset(m_front.data + width * height, 128, len - width * height);
+    if (m_source->read(m_back))
+        swap(m_front, m_back);
+
+    m_sender = sender;
+    m_fps = fps;
+    m_running = true;
+    m_thread = thread(&VideoSender::run, this);
+
+    Log::info("sending " + to_string(width) + "x" + to_string(height) + " at " + to_string(fps) + " fps from "
+              + m_source->describe());
+    return true;
+}
+
+void VideoSender::stop() {
+    if (!m_running.exchange(false))
+        return;
+
+    if (m_thread.joinable())
+        m_thread.join();
+
+    Log::info("sent " + to_string(sent()) + " frames, " + to_string(late()) + " late, " + to_string(skipped())
+              + " skipped");
+}
+
+void VideoSender::run() {
+    ThreadRegistry::getInstance().enroll(ThreadClass::Main, "zoombot-sender");
+
+    const uint64_t period = 1000000000ull / m_fps;
+    auto deadline = MetricsClock::nowNs() + period;
+
+    while (m_running.load(memory_order_relaxed)) {
+        sleepUntil(deadline);
+
+        auto now = MetricsClock::nowNs();
+        auto lateness = now - deadline;
+        m_jitter.observe(lateness);
+        if (lateness > period / 2) {
+            m_late++;
+            m_lateCounter.inc();
+        }
+
+        auto err = m_sender->sendVideoFrame(m_front.data, m_front.width, m_front.height, m_front.len, 0,
+                                            FrameDataFormat_I420_FULL);
+        if (err != SDKERR_SUCCESS) {
+            m_failed.inc();
+            LOG_EVERY_MS(5000, Log::warn, "failed to send video frame with status " + to_string(err));
+        } else {
+            m_sent++;
+            m_sentCounter.inc();
+        }
+
+        if (m_source->read(m_back))
+            swap(m_front, m_back);
+
+        // a stall longer than a period skips the missed frames instead of catching up in a burst
+        deadline += period;
+        now = MetricsClock::nowNs();
+        if (now > deadline + period) {
+            auto missed = (now - deadline) / period;
+            deadline += missed * period;
+            m_skipped += missed;
+            m_skippedCounter.inc(missed);
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef MEETINGSDK_HEADLESS_LINUX_SAMPLE_VIDEOSENDER_H
+#define MEETINGSDK_HEADLESS_LINUX_SAMPLE_VIDEOSENDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "rawdata/rawdata_video_source_helper_interface.h"
+
+#include "FrameSource.h"
+#include "../util/Metrics.h"
+
+using namespace std;
+using namespace ZOOMSDK;
+
+/**
+ * Sends frames from a FrameSource to the SDK at a fixed rate from a thread
+ * of its own. Deadlines are absolute, so sleeping late does not drift the
+ * rate; a frame that misses a whole period is skipped rather than sent in a
+ * burst. The next frame is read right after a send, into the second of two
+ * buffers allocated by start(), so the send itself is on time.
+ */
+class VideoSender {
+    unique_ptr<FrameSource> m_source;
+    IZoomSDKVideoSender* m_sender = nullptr;
+
+    unique_ptr<char[]> m_buffers;
+    size_t m_bufferSize = 0;
+    Frame m_front{};
+    Frame m_back{};
+    unsigned int m_fps = 0;
+
+    thread m_thread;
+    atomic<bool> m_running{false};
+
+    atomic<uint64_t> m_sent{0};
+    atomic<uint64_t> m_late{0};
+    atomic<uint64_t> m_skipped{0};
+
+    Histogram& m_jitter;
+    Counter& m_sentCounter;
+    Counter& m_lateCounter;
+    Counter& m_skippedCounter;
+    Counter& m_failed;
+
+    void run();
+
+public:
+    VideoSender();
+    ~VideoSender();
+
+    void setSource(unique_ptr<FrameSource> source);
+    bool hasSource() const { return m_source != nullptr; }
+
+    /**
+     * Start sending, restarting if already running
+     * @param fps negotiated frame rate
+     * @return false if the source cannot produce frames of this size
+     */
+    bool start(IZoomSDKVideoSender* sender, unsigned int width, unsigned int height, unsigned int fps);
+    void stop();
+
+    bool isRunning() const { return m_running.load(memory_order_relaxed); }
+
+    uint64_t sent() const { return m_sent.load(memory_order_relaxed); }
+
+    /**
+     * Frames sent more than half a period after their deadline
+     */
+    uint64_t late() const { return m_late.load(memory_order_relaxed); }
+
+    /**
+     * Deadlines missed entirely
+     */
+    uint64_t skipped() const { return m_skipped.load(memory_order_relaxed); }
+};
+
+#endif //MEETINGSDK_HEADLESS_LINUX_SAMPLE_VIDEOSENDER_H
@@ -11,9 +11,16 @@ IZoomSDKVideoSender *ZoomSDKVideoSource::getSender() const {
     return m_videoSender;
 }
 
+void ZoomSDKVideoSource::setSource(unique_ptr<FrameSource> source) {
+    m_sender.setSource(move(source));
+}
+
 void ZoomSDKVideoSource::onInitialize(IZoomSDKVideoSender *sender,IList <VideoSourceCapability> *support_cap_list,
                                       VideoSourceCapability& suggest_cap){
     m_videoSender = sender;
+    m_width = suggest_cap.width;
+    m_height = suggest_cap.height;
+    m_fps = suggest_cap.frame;
     Log::success("onInitialize");
 
 }
@@ -22,19 +29,29 @@ void ZoomSDKVideoSource::onPropertyChange(IList <VideoSourceCapability> *support
                                           VideoSourceCapability suggest_cap) {
     m_width = suggest_cap.width;
     m_height = suggest_cap.height;
+    m_fps = suggest_cap.frame;
+
+    // renegotiated while sending, continue at the new size and rate
+    if (m_isReady)
+        m_sender.start(m_videoSender, m_width, m_height, m_fps);
 }
 
 void ZoomSDKVideoSource::onStartSend() {
     Log::info("sender is ready");
     m_isReady = true;
+
+    if (m_sender.hasSource())
+        m_sender.start(m_videoSender, m_width, m_height, m_fps);
 }
 
 void ZoomSDKVideoSource::onStopSend() {
     Log::info("sender stopped");
     m_isReady = false;
+    m_sender.stop();
 }
 
 void ZoomSDKVideoSource::onUninitialized() {
+    m_sender.stop();
     m_videoSender = nullptr;
 }
 
@@ -44,4 +61,4 @@ void ZoomSDKVideoSource::setWidth(const unsigned int& width) {
 
 void ZoomSDKVideoSource::setHeight(const unsigned int& height) {
     m_height = height;
-}
\ No newline at end of file
+}
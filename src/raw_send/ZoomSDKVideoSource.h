@@ -4,17 +4,11 @@
 
 #include "rawdata/rawdata_video_source_helper_interface.h"
 #include "../util/Log.h"
+#include "VideoSender.h"
 
 using namespace ZOOMSDK;
 using namespace std;
 
-struct Frame {
-    char* data;
-    unsigned int width;
-    unsigned int height;
-    unsigned int len;
-};
-
 class ZoomSDKVideoSource : public IZoomSDKVideoSource    {
     void onInitialize(IZoomSDKVideoSender* sender, IList<VideoSourceCapability >* support_cap_list, VideoSourceCapability& suggest_cap) override;
     void onPropertyChange(IList<VideoSourceCapability >* support_cap_list, VideoSourceCapability suggest_cap) override;
@@ -22,16 +16,24 @@ class ZoomSDKVideoSource : public IZoomSDKVideoSource    {
     void onStopSend() override;
     void onUninitialized() override;
 
-    IZoomSDKVideoSender* m_videoSender;
-    unsigned int m_height;
-    unsigned int m_width;
-    bool m_isReady;
+    IZoomSDKVideoSender* m_videoSender = nullptr;
+    unsigned int m_height = 0;
+    unsigned int m_width = 0;
+    unsigned int m_fps = 0;
+    bool m_isReady = false;
+
+    VideoSender m_sender;
 
 public:
     ZoomSDKVideoSource();
 
     IZoomSDKVideoSender* getSender() const;
 
+    /**
+     * Frames to send once the meeting asks for video
+     */
+    void setSource(unique_ptr<FrameSource> source);
+
     bool isReady();
     void setWidth(const unsigned int& width);
     void setHeight(const unsigned int& height);
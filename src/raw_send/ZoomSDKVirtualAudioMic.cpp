@@ -0,0 +1,38 @@
+#include "ZoomSDKVirtualAudioMic.h"
+
+void ZoomSDKVirtualAudioMic::setInput(unique_ptr<PcmInput> input) {
+    if (m_input)
+        m_input->stop();
+    m_input = move(input);
+}
+
+void ZoomSDKVirtualAudioMic::setConcealment(JitterBuffer::Concealment concealment) {
+    m_buffer.setConcealment(concealment);
+}
+
+void ZoomSDKVirtualAudioMic::onMicInitialize(IZoomSDKAudioRawDataSender* sender) {
+    m_audioSender = sender;
+    Log::success("onMicInitialize");
+
+    if (m_input)
+        m_input->start(m_buffer);
+}
+
+void ZoomSDKVirtualAudioMic::onMicStartSend() {
+    Log::info("microphone is ready");
+
+    // anything that piled up while muted is trimmed back to the target delay on the first frame
+    m_sender.start(m_audioSender, m_buffer);
+}
+
+void ZoomSDKVirtualAudioMic::onMicStopSend() {
+    Log::info("microphone stopped");
+    m_sender.stop();
+}
+
+void ZoomSDKVirtualAudioMic::onMicUninitialized() {
+    m_sender.stop();
+    if (m_input)
+        m_input->stop();
+    m_audioSender = nullptr;
+}
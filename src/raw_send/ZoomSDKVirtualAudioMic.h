@@ -0,0 +1,39 @@
+#ifndef MEETINGSDK_HEADLESS_LINUX_SAMPLE_ZOOMSDKVIRTUALAUDIOMIC_H
+#define MEETINGSDK_HEADLESS_LINUX_SAMPLE_ZOOMSDKVIRTUALAUDIOMIC_H
+
+#include <memory>
+
+#include "rawdata/rawdata_audio_helper_interface.h"
+#include "../util/Log.h"
+#include "AudioSender.h"
+#include "JitterBuffer.h"
+#include "PcmInput.h"
+
+using namespace ZOOMSDK;
+using namespace std;
+
+/**
+ * Virtual microphone: the input is read for as long as the SDK has the
+ * microphone, so a client can connect before the bot is unmuted, and the
+ * buffer plays out while the SDK wants audio
+ */
+class ZoomSDKVirtualAudioMic : public IZoomSDKVirtualAudioMicEvent {
+    static constexpr unsigned int c_sampleRate = 32000;
+
+    void onMicInitialize(IZoomSDKAudioRawDataSender* sender) override;
+    void onMicStartSend() override;
+    void onMicStopSend() override;
+    void onMicUninitialized() override;
+
+    IZoomSDKAudioRawDataSender* m_audioSender = nullptr;
+
+    JitterBuffer m_buffer{c_sampleRate};
+    unique_ptr<PcmInput> m_input;
+    AudioSender m_sender;
+
+public:
+    void setInput(unique_ptr<PcmInput> input);
+    void setConcealment(JitterBuffer::Concealment concealment);
+};
+
+#endif //MEETINGSDK_HEADLESS_LINUX_SAMPLE_ZOOMSDKVIRTUALAUDIOMIC_H
@@ -0,0 +1,172 @@
+#include "SpeakerTranscription.h"
+
+#include <algorithm>
+
+#include "../util/Log.h"
+
+SpeakerTranscription::SpeakerTranscription(StreamingTranscriber::Options options, size_t maxChannels,
+                                           StreamingTranscriber::Sink sink, NameOf nameOf) :
+        m_options(move(options)),
+        m_maxChannels(max<size_t>(1, maxChannels)),
+        m_sink(move(sink)),
+        m_nameOf(move(nameOf)),
+        m_speaking(MetricsRegistry::getInstance().gauge("zoombot_asr_speaker_channels",
+                "Per-speaker transcription channels", "state=\"speaking\"")),
+        m_open(MetricsRegistry::getInstance().gauge("zoombot_asr_speaker_channels",
+                "Per-speaker transcription channels", "state=\"open\"")),
+        m_overflow(MetricsRegistry::getInstance().counter("zoombot_asr_speaker_skipped_bytes_total",
+                "Participant audio not sent for transcription", "reason=\"overflow\"")),
+        m_silence(MetricsRegistry::getInstance().counter("zoombot_asr_speaker_skipped_bytes_total",
+                "Participant audio not sent for transcription", "reason=\"silence\"")) {
+    // never moved, the channels' threads call back into this
+    m_channels.reserve(m_maxChannels);
+}
+
+SpeakerTranscription::~SpeakerTranscription() {
+    // before the names go, the last results still look them up
+    for (auto& channel : m_channels) {
+        if (channel.speaker)
+            m_speaking.sub(1);
+
+        channel.transcriber->flush();
+        channel.transcriber->stop();
+        m_open.sub(1);
+    }
+}
+
+void SpeakerTranscription::push(uint32_t nodeId, const char* data, size_t len, unsigned int rate,
+                                unsigned int channels) {
+    if (!len || !rate || !channels)
+        return;
+
+    auto& speaker = m_speakers[nodeId];
+    auto wasActive = speaker.vad.active();
+    auto active = speaker.vad.update(reinterpret_cast<const int16_t*>(data), len / sizeof(int16_t), rate, channels);
+
+    // a channel reclaimed from a speaker who went quiet mid-sentence
+    if (speaker.channel >= 0 && m_channels[speaker.channel].speaker != nodeId)
+        speaker.channel = -1;
+
+    if (!active && wasActive && speaker.channel >= 0)
+        release(speaker);
+
+    if (active && speaker.channel < 0)
+        speaker.channel = assign(nodeId, rate, channels);
+
+    if (speaker.channel < 0) {
+        auto leadIn = static_cast<size_t>(rate) * channels * sizeof(int16_t) * c_leadInMs / 1000;
+        speaker.leadIn.append(data, len);
+        if (speaker.leadIn.size() > leadIn) {
+            auto skipped = speaker.leadIn.size() - leadIn;
+            speaker.leadIn.erase(0, skipped);
+            (active ? m_overflow : m_silence).inc(skipped);
+        }
+        return;
+    }
+
+    auto& channel = m_channels[speaker.channel];
+    channel.idleSinceNs = MetricsClock::nowNs();
+    name(nodeId, speaker);
+
+    if (!speaker.leadIn.empty()) {
+        channel.transcriber->push(speaker.leadIn.data(), speaker.leadIn.size(), rate, channels, nodeId);
+        speaker.leadIn.clear();
+    }
+
+    channel.transcriber->push(data, len, rate, channels, nodeId);
+}
+
+int SpeakerTranscription::assign(uint32_t nodeId, unsigned int rate, unsigned int channels) {
+    auto now = MetricsClock::nowNs();
+
+    // speakers whose stream stopped mid-sentence, having left or muted, give theirs up
+    for (auto& channel : m_channels) {
+        if (channel.speaker && now - channel.idleSinceNs >= c_idleNs) {
+            channel.transcriber->flush();
+            channel.speaker = 0;
+            m_speaking.sub(1);
+        }
+    }
+
+    auto take = [&](size_t i) {
+        auto& channel = m_channels[i];
+        channel.speaker = channel.last = nodeId;
+        m_speaking.add(1);
+        return static_cast<int>(i);
+    };
+
+    // a transcriber only takes the format it started with
+    auto free = [&](const Channel& channel) {
+        return !channel.speaker && channel.rate == rate && channel.channels == channels;
+    };
+
+    // the one this speaker had, if nobody took it since
+    for (size_t i = 0; i < m_channels.size(); i++) {
+        if (free(m_channels[i]) && m_channels[i].last == nodeId)
+            return take(i);
+    }
+
+    // otherwise the longest idle, preferring a new one over taking one just released
+    int idlest = -1;
+    for (size_t i = 0; i < m_channels.size(); i++) {
+        if (free(m_channels[i]) && (idlest < 0 || m_channels[i].idleSinceNs < m_channels[idlest].idleSinceNs))
+            idlest = static_cast<int>(i);
+    }
+
+    if (idlest >= 0 && now - m_channels[idlest].idleSinceNs >= c_idleNs)
+        return take(idlest);
+
+    if (m_channels.size() < m_maxChannels) {
+        Channel channel;
+        channel.transcriber = make_unique<StreamingTranscriber>(m_options, [this](TranscriptEvent& event) {
+            deliver(event);
+        });
+        channel.transcriber->start();
+        channel.rate = rate;
+        channel.channels = channels;
+        m_channels.push_back(move(channel));
+        m_open.add(1);
+        return take(m_channels.size() - 1);
+    }
+
+    if (idlest >= 0)
+        return take(idlest);
+
+    LOG_EVERY_MS(30000, Log::warn, "all " + to_string(m_maxChannels) +
+                                   " transcription channels are busy, skipping a speaker");
+    return -1;
+}
+
+void SpeakerTranscription::release(Speaker& speaker) {
+    auto& channel = m_channels[speaker.channel];
+    speaker.channel = -1;
+
+    // results for the utterance now rather than after the next speaker's first words
+    channel.transcriber->flush();
+    channel.speaker = 0;
+    channel.idleSinceNs = MetricsClock::nowNs();
+    m_speaking.sub(1);
+}
+
+void SpeakerTranscription::name(uint32_t nodeId, Speaker& speaker) {
+    if (speaker.named)
+        return;
+
+    auto name = m_nameOf ? m_nameOf(nodeId) : "";
+    speaker.named = true;
+
+    lock_guard<mutex> lock(m_namesLock);
+    m_names[nodeId] = move(name);
+}
+
+void SpeakerTranscription::deliver(TranscriptEvent& event) {
+    if (event.tag) {
+        lock_guard<mutex> lock(m_namesLock);
+        auto it = m_names.find(event.tag);
+        if (it != m_names.end())
+            event.speaker = it->second;
+    }
+
+    if (m_sink)
+        m_sink(event);
+}
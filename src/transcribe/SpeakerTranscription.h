@@ -0,0 +1,103 @@
+#ifndef MEETINGSDK_HEADLESS_LINUX_SAMPLE_SPEAKERTRANSCRIPTION_H
+#define MEETINGSDK_HEADLESS_LINUX_SAMPLE_SPEAKERTRANSCRIPTION_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../util/Metrics.h"
+#include "StreamingTranscriber.h"
+#include "VoiceActivity.h"
+
+using namespace std;
+
+/**
+ * Transcribes each participant's own audio stream, so every transcript
+ * event carries the node id and name of who spoke it.
+ *
+ * Only speech is sent: each stream passes through a voice activity
+ * detector, and a speaker is given one of a capped number of transcription
+ * channels when they start talking. A channel goes back to the pool once
+ * its speaker falls silent, so the cost follows how many people talk at
+ * once rather than how many attend. A speaker keeps their channel while
+ * it is free; while every channel is busy, further speech is dropped and
+ * counted.
+ */
+class SpeakerTranscription {
+public:
+    /**
+     * Resolves a participant's display name from their node id
+     */
+    using NameOf = function<string(uint32_t nodeId)>;
+
+private:
+    // audio kept from before speech is detected, so the first syllable is sent too
+    static constexpr unsigned int c_leadInMs = 300;
+
+    // a channel silent this long is handed over before another is opened
+    static constexpr uint64_t c_idleNs = 2000000000ull;
+
+    struct Channel {
+        unique_ptr<StreamingTranscriber> transcriber;
+        unsigned int rate = 0;
+        unsigned int channels = 0;
+
+        // node id of the speaker, 0 for none
+        uint32_t speaker = 0;
+        uint32_t last = 0;
+        uint64_t idleSinceNs = 0;
+    };
+
+    struct Speaker {
+        VoiceActivity vad;
+        string leadIn;
+        int channel = -1;
+        bool named = false;
+    };
+
+    StreamingTranscriber::Options m_options;
+    size_t m_maxChannels;
+    StreamingTranscriber::Sink m_sink;
+    NameOf m_nameOf;
+
+    vector<Channel> m_channels;
+    unordered_map<uint32_t, Speaker> m_speakers;
+
+    // names are looked up by the transcribers' threads
+    mutex m_namesLock;
+    unordered_map<uint32_t, string> m_names;
+
+    Gauge& m_speaking;
+    Gauge& m_open;
+    Counter& m_overflow;
+    Counter& m_silence;
+
+    int assign(uint32_t nodeId, unsigned int rate, unsigned int channels);
+    void release(Speaker& speaker);
+    void name(uint32_t nodeId, Speaker& speaker);
+    void deliver(TranscriptEvent& event);
+
+public:
+    /**
+     * @param maxChannels transcription channels open at most, one per concurrent speaker
+     * @param sink receives every channel's events, from each channel's own thread
+     */
+    SpeakerTranscription(StreamingTranscriber::Options options, size_t maxChannels,
+                         StreamingTranscriber::Sink sink, NameOf nameOf);
+
+    /**
+     * Stops every channel, delivering their final results
+     */
+    ~SpeakerTranscription();
+
+    /**
+     * Queue one participant's 16-bit PCM, from the audio thread
+     */
+    void push(uint32_t nodeId, const char* data, size_t len, unsigned int rate, unsigned int channels);
+};
+
+#endif //MEETINGSDK_HEADLESS_LINUX_SAMPLE_SPEAKERTRANSCRIPTION_H
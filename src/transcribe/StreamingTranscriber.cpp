@@ -0,0 +1,431 @@
+#include "StreamingTranscriber.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../util/Json.h"
+#include "../util/Log.h"
+#include "../util/MemoryBudget.h"
+#include "../util/Threads.h"
+
+namespace {
+    // a connection that lasted this long was not flapping, reconnect right away
+    constexpr uint64_t c_stableConnectionNs = 10000000000ull;
+
+    // wait this long for the last results after asking the service to finish
+    constexpr uint64_t c_finishNs = 3000000000ull;
+
+    void appendNumber(string& out, double value) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.3f", value);
+        out += buf;
+    }
+}
+
+StreamingTranscriber::StreamingTranscriber(Options options, Sink sink) :
+        m_options(move(options)),
+        m_sink(move(sink)),
+        m_queued(MetricsRegistry::getInstance().gauge("zoombot_asr_queued_chunks",
+                "Audio chunks waiting to be sent for transcription, over all transcribers")),
+        m_connected(MetricsRegistry::getInstance().gauge("zoombot_asr_connected",
+                "Open connections to the transcription service")),
+        m_sentBytes(MetricsRegistry::getInstance().counter("zoombot_asr_sent_bytes_total",
+                "Audio bytes sent for transcription, replays included")),
+        m_droppedQueue(MetricsRegistry::getInstance().counter("zoombot_asr_dropped_bytes_total",
+                "Audio bytes not transcribed", "reason=\"queue\"")),
+        m_droppedBudget(MetricsRegistry::getInstance().counter("zoombot_asr_dropped_bytes_total",
+                "Audio bytes not transcribed", "reason=\"budget\"")),
+        m_droppedFormat(MetricsRegistry::getInstance().counter("zoombot_asr_dropped_bytes_total",
+                "Audio bytes not transcribed", "reason=\"format\"")),
+        m_reconnects(MetricsRegistry::getInstance().counter("zoombot_asr_reconnects_total",
+                "Reconnections to the transcription service")),
+        m_replayedBytes(MetricsRegistry::getInstance().counter("zoombot_asr_replayed_bytes_total",
+                "Audio bytes sent again after reconnecting")),
+        m_results(MetricsRegistry::getInstance().counter("zoombot_asr_results_total",
+                "Transcript events received")),
+        m_latency(MetricsRegistry::getInstance().histogram("zoombot_asr_latency_seconds",
+                "Time from the end of a phrase's audio arriving to its final transcript")) {
+    m_options.chunkMs = max(10u, m_options.chunkMs);
+    m_sentTimes.resize(c_sentTimes);
+    m_sentTags.resize(c_sentTimes);
+}
+
+string TranscriptEvent::toJson() const {
+    string json = "{\"type\":\"transcript\",\"final\":";
+    json += final ? "true" : "false";
+    json += ",\"start\":";
+    appendNumber(json, start);
+    json += ",\"duration\":";
+    appendNumber(json, duration);
+    json += ",\"confidence\":";
+    appendNumber(json, confidence);
+    json += ",\"time_ns\":" + to_string(timeNs);
+
+    if (tag) {
+        json += ",\"node_id\":" + to_string(tag) + ",\"speaker\":";
+        JsonValue::appendString(json, speaker);
+    }
+
+    json += ",\"text\":";
+    JsonValue::appendString(json, text);
+    json += "}";
+    return json;
+}
+
+StreamingTranscriber::~StreamingTranscriber() {
+    stop();
+
+    if (m_reserved)
+        MemoryBudget::getInstance().release(MemoryPool::Analysis, m_reserved);
+}
+
+void StreamingTranscriber::start() {
+    if (m_running.exchange(true))
+        return;
+
+    m_thread = thread(&StreamingTranscriber::run, this);
+}
+
+void StreamingTranscriber::stop() {
+    if (!m_running.exchange(false))
+        return;
+
+    m_wake.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void StreamingTranscriber::setFormat(unsigned int rate, unsigned int channels) {
+    m_rate = rate;
+    m_channels = channels;
+    m_chunkBytes = static_cast<size_t>(rate) * channels * sizeof(int16_t) * m_options.chunkMs / 1000;
+
+    m_slots = max(2u, m_options.queueMs / m_options.chunkMs) + 1;
+    m_replaySlots = (m_options.replayMs + m_options.chunkMs - 1) / m_options.chunkMs;
+
+    // allocated once, the audio thread only copies from here on
+    m_queue.resize(m_slots * m_chunkBytes);
+    m_queueTimes.resize(m_slots);
+    m_queueTags.resize(m_slots);
+    m_replay.resize(m_replaySlots * m_chunkBytes);
+    m_chunk.resize(m_chunkBytes);
+
+    m_reserved = m_queue.size() + m_replay.size() + m_chunk.size();
+    MemoryBudget::getInstance().reserve(MemoryPool::Analysis, m_reserved);
+
+    m_wake.notify_all();
+}
+
+void StreamingTranscriber::publishQueued() {
+    // the gauges are shared by every transcriber, each adds its own change
+    m_queued.add(static_cast<int64_t>(m_count) - static_cast<int64_t>(m_published));
+    m_published = m_count;
+}
+
+void StreamingTranscriber::setConnected(bool connected) {
+    if (connected != m_isConnected)
+        m_connected.add(connected ? 1 : -1);
+    m_isConnected = connected;
+}
+
+void StreamingTranscriber::complete(size_t slot) {
+    // the service is behind, the oldest audio goes first
+    if (m_count == m_slots - 1) {
+        m_head = (m_head + 1) % m_slots;
+        m_headSeq++;
+        m_count--;
+        m_droppedQueue.inc(m_chunkBytes);
+    }
+
+    m_queueTimes[slot] = MetricsClock::nowNs();
+    m_queueTags[slot] = m_tag;
+    m_count++;
+    m_fill = 0;
+}
+
+void StreamingTranscriber::push(const char* data, size_t len, unsigned int rate, unsigned int channels,
+                                uint32_t tag) {
+    if (!MemoryBudget::getInstance().allowAnalysis()) {
+        m_droppedBudget.inc(len);
+        return;
+    }
+
+    lock_guard<mutex> lock(m_lock);
+
+    if (!m_rate) {
+        setFormat(rate, channels);
+    } else if (rate != m_rate || channels != m_channels) {
+        m_droppedFormat.inc(len);
+        return;
+    }
+
+    m_tag = tag;
+    while (len) {
+        auto tail = (m_head + m_count) % m_slots;
+        auto n = min(len, m_chunkBytes - m_fill);
+        memcpy(m_queue.data() + tail * m_chunkBytes + m_fill, data, n);
+        m_fill += n;
+        data += n;
+        len -= n;
+
+        if (m_fill == m_chunkBytes)
+            complete(tail);
+    }
+
+    publishQueued();
+}
+
+void StreamingTranscriber::flush() {
+    lock_guard<mutex> lock(m_lock);
+    if (!m_rate)
+        return;
+
+    if (m_fill) {
+        auto tail = (m_head + m_count) % m_slots;
+        memset(m_queue.data() + tail * m_chunkBytes + m_fill, 0, m_chunkBytes - m_fill);
+        complete(tail);
+        publishQueued();
+    }
+
+    m_finalize = true;
+}
+
+string StreamingTranscriber::url() const {
+    auto url = m_options.url;
+    url += url.find('?') == string::npos ? '?' : '&';
+    return url + "encoding=linear16&sample_rate=" + to_string(m_rate) + "&channels=" + to_string(m_channels);
+}
+
+bool StreamingTranscriber::connect() {
+    vector<string> headers;
+    if (!m_options.apiKey.empty())
+        headers.push_back("Authorization: Token " + m_options.apiKey);
+
+    if (!m_socket.connect(url(), headers)) {
+        LOG_EVERY_MS(30000, Log::warn, "failed to connect for transcription: " + m_socket.error());
+        return false;
+    }
+
+    setConnected(true);
+    m_connectionSeq = m_nextSeq;
+    m_lastSendNs = MetricsClock::nowNs();
+
+    if (!m_nextSeq) {
+        Log::success("connected for transcription");
+        return true;
+    }
+
+    m_reconnects.inc();
+    Log::info("reconnected for transcription");
+
+    // the words being spoken when the connection dropped
+    auto from = m_nextSeq > m_replaySlots ? m_nextSeq - m_replaySlots : 0;
+    for (auto seq = from; seq < m_nextSeq; seq++) {
+        if (seq < m_replayFrom)
+            continue;
+
+        if (m_connectionSeq == m_nextSeq)
+            m_connectionSeq = seq;
+
+        if (!sendChunk(m_replay.data() + seq % m_replaySlots * m_chunkBytes, seq))
+            return false;
+        m_replayedBytes.inc(m_chunkBytes);
+    }
+
+    return true;
+}
+
+bool StreamingTranscriber::sendChunk(const char* data, uint64_t seq) {
+    if (!m_socket.sendBinary(data, m_chunkBytes)) {
+        setConnected(false);
+        LOG_EVERY_MS(30000, Log::warn, "lost the transcription connection: " + m_socket.error());
+        return false;
+    }
+
+    m_sentBytes.inc(m_chunkBytes);
+    m_lastSendNs = MetricsClock::nowNs();
+    return true;
+}
+
+bool StreamingTranscriber::sendQueued() {
+    for (;;) {
+        uint64_t seq;
+        {
+            lock_guard<mutex> lock(m_lock);
+            if (!m_count) {
+                auto finalize = m_finalize;
+                m_finalize = false;
+                return !finalize || m_socket.sendText("{\"type\":\"Finalize\"}");
+            }
+
+            memcpy(m_chunk.data(), m_queue.data() + m_head * m_chunkBytes, m_chunkBytes);
+            seq = m_headSeq++;
+            m_sentTimes[seq % c_sentTimes] = m_queueTimes[m_head];
+            m_sentTags[seq % c_sentTimes] = m_queueTags[m_head];
+            m_head = (m_head + 1) % m_slots;
+            m_count--;
+            publishQueued();
+        }
+
+        // kept before sending, so a chunk lost with the connection is replayed
+        if (m_replaySlots) {
+            memcpy(m_replay.data() + seq % m_replaySlots * m_chunkBytes, m_chunk.data(), m_chunkBytes);
+
+            // chunks dropped from the queue leave a gap in the replay
+            if (seq != m_nextSeq)
+                m_replayFrom = seq;
+        }
+        m_nextSeq = seq + 1;
+
+        if (!sendChunk(m_chunk.data(), seq))
+            return false;
+    }
+}
+
+void StreamingTranscriber::receive(int timeoutMs) {
+    auto status = m_socket.receive(m_message, timeoutMs);
+    while (status == WebSocket::Status::Message) {
+        handle(m_message);
+        status = m_socket.receive(m_message, 0);
+    }
+
+    if (status == WebSocket::Status::Closed) {
+        setConnected(false);
+
+        // expected once finish() asked for the last results
+        if (m_running.load(memory_order_relaxed))
+            LOG_EVERY_MS(30000, Log::warn, "transcription connection closed: " + m_socket.error());
+    }
+}
+
+void StreamingTranscriber::handle(const string& message) {
+    JsonValue json;
+    if (!JsonValue::parse(message, json))
+        return;
+
+    auto& type = json["type"].asString();
+    if (type == "Error" || !json["err_code"].isNull()) {
+        auto& description = json["description"].isNull() ? json["err_msg"] : json["description"];
+        LOG_EVERY_MS(30000, Log::warn, "transcription error: " + description.asString());
+        return;
+    }
+
+    if (type != "Results")
+        return;
+
+    auto& alternative = json["channel"]["alternatives"][0];
+    auto& text = alternative["transcript"].asString();
+    if (text.empty())
+        return;
+
+    TranscriptEvent event;
+    event.final = json["is_final"].asBool();
+    event.duration = json["duration"].asNumber();
+    event.confidence = alternative["confidence"].asNumber();
+    event.text = text;
+
+    // timestamps restart with every connection, count from the first chunk instead
+    auto start = json["start"].asNumber();
+    event.start = static_cast<double>(m_connectionSeq) * m_options.chunkMs / 1000 + start;
+
+    auto sent = [&](uint64_t seq) { return seq < m_nextSeq && m_nextSeq - seq <= c_sentTimes; };
+    auto chunkNs = static_cast<uint64_t>(m_options.chunkMs) * 1000000;
+
+    // a chunk's time is when it filled up, its audio began a chunk earlier
+    auto first = m_connectionSeq + static_cast<uint64_t>(start * 1000 / m_options.chunkMs);
+    if (sent(first)) {
+        event.timeNs = m_sentTimes[first % c_sentTimes] - chunkNs;
+        event.tag = m_sentTags[first % c_sentTimes];
+    }
+
+    m_results.inc();
+
+    if (event.final) {
+        auto chunks = static_cast<uint64_t>((start + event.duration) * 1000 / m_options.chunkMs + 0.999);
+        auto last = m_connectionSeq + max<uint64_t>(chunks, 1) - 1;
+        if (sent(last))
+            m_latency.observe(MetricsClock::nowNs() - m_sentTimes[last % c_sentTimes]);
+    }
+
+    if (m_sink)
+        m_sink(event);
+}
+
+void StreamingTranscriber::finish() {
+    // whatever could not be sent any more is accounted as dropped
+    auto drop = [&]() {
+        lock_guard<mutex> lock(m_lock);
+        m_droppedQueue.inc(m_count * m_chunkBytes + m_fill);
+        m_count = m_fill = 0;
+        publishQueued();
+    };
+
+    if (!m_socket.isOpen() || !sendQueued()) {
+        drop();
+        return;
+    }
+
+    // ask for the last results, the service closes once it has sent them
+    m_socket.sendText("{\"type\":\"CloseStream\"}");
+
+    auto deadline = MetricsClock::nowNs() + c_finishNs;
+    while (m_socket.isOpen() && MetricsClock::nowNs() < deadline)
+        receive(c_pollMs);
+
+    m_socket.close();
+    setConnected(false);
+    drop();
+}
+
+void StreamingTranscriber::run() {
+    ThreadRegistry::getInstance().enroll(ThreadClass::Analysis, "zoombot-asr");
+
+    unsigned int backoffMs = 0;
+    uint64_t connectedAt = 0;
+
+    auto pause = [&]() {
+        backoffMs = min(c_maxBackoffMs, max(250u, backoffMs * 2));
+        unique_lock<mutex> lock(m_lock);
+        m_wake.wait_for(lock, chrono::milliseconds(backoffMs), [&] { return !m_running.load(); });
+    };
+
+    while (m_running.load(memory_order_relaxed)) {
+        if (!m_socket.isOpen()) {
+            {
+                unique_lock<mutex> lock(m_lock);
+                m_wake.wait(lock, [&] { return m_rate || !m_running.load(); });
+            }
+
+            // back off from a service that keeps hanging up, not just from one that is down
+            if (connectedAt) {
+                if (MetricsClock::nowNs() - connectedAt < c_stableConnectionNs)
+                    pause();
+                else
+                    backoffMs = 0;
+                connectedAt = 0;
+            }
+
+            if (!m_running.load(memory_order_relaxed))
+                break;
+
+            if (!connect()) {
+                pause();
+                continue;
+            }
+            connectedAt = MetricsClock::nowNs();
+        }
+
+        if (!sendQueued())
+            continue;
+
+        receive(c_pollMs);
+
+        // the service hangs up on a silent stream after a few seconds
+        if (m_socket.isOpen() && MetricsClock::nowNs() - m_lastSendNs > c_keepAliveNs) {
+            m_socket.sendText("{\"type\":\"KeepAlive\"}");
+            m_lastSendNs = MetricsClock::nowNs();
+        }
+    }
+
+    finish();
+}
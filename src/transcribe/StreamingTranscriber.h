@@ -0,0 +1,182 @@
+#ifndef MEETINGSDK_HEADLESS_LINUX_SAMPLE_STREAMINGTRANSCRIBER_H
+#define MEETINGSDK_HEADLESS_LINUX_SAMPLE_STREAMINGTRANSCRIBER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../util/Metrics.h"
+#include "../util/WebSocket.h"
+
+using namespace std;
+
+/**
+ * One result from the speech service
+ */
+struct TranscriptEvent {
+    bool final = false;
+
+    // seconds into the audio sent on this transcriber
+    double start = 0;
+    double duration = 0;
+    double confidence = 0;
+
+    // monotonic time the audio at start arrived
+    uint64_t timeNs = 0;
+
+    // what push() was given with that audio, e.g. the speaker's node id
+    uint32_t tag = 0;
+    string speaker;
+
+    string text;
+
+    /**
+     * One JSON object, with node_id and speaker if tagged
+     */
+    string toJson() const;
+};
+
+/**
+ * Streams meeting audio to a speech recognition service over a WebSocket
+ * (Deepgram's live API) and turns its results into transcript events.
+ *
+ * The audio thread only copies into fixed-size chunks of a bounded queue;
+ * when the service falls behind or is unreachable the oldest chunks are
+ * dropped and counted. A thread of its own sends the chunks, reads results
+ * and reconnects with backoff, first sending again the last chunks of the
+ * previous connection so words cut off by the disconnect are recognised.
+ */
+class StreamingTranscriber {
+public:
+    struct Options {
+        string url = "wss://api.deepgram.com/v1/listen";
+        string apiKey;
+
+        // audio sent per WebSocket message
+        unsigned int chunkMs = 100;
+
+        // audio held while the service is slow or unreachable
+        unsigned int queueMs = 10000;
+
+        // audio sent again after reconnecting
+        unsigned int replayMs = 300;
+    };
+
+    /**
+     * Receives each transcript event on the transcriber's thread
+     */
+    using Sink = function<void(TranscriptEvent& event)>;
+
+private:
+    static constexpr int c_pollMs = 20;
+    static constexpr uint64_t c_keepAliveNs = 5000000000ull;
+    static constexpr unsigned int c_maxBackoffMs = 5000;
+
+    // send times kept to measure how long results take
+    static constexpr size_t c_sentTimes = 512;
+
+    Options m_options;
+    Sink m_sink;
+
+    unsigned int m_rate = 0;
+    unsigned int m_channels = 0;
+    size_t m_chunkBytes = 0;
+
+    mutex m_lock;
+    condition_variable m_wake;
+
+    // one slot more than the queue holds, being filled by push()
+    vector<char> m_queue;
+    vector<uint64_t> m_queueTimes;
+    vector<uint32_t> m_queueTags;
+    uint32_t m_tag = 0;
+    size_t m_slots = 0;
+    size_t m_head = 0;
+    size_t m_count = 0;
+    size_t m_fill = 0;
+    size_t m_published = 0;
+
+    // the service is asked to finish its results once the queue is sent
+    bool m_finalize = false;
+
+    // sequence number of the chunk at m_head, counting from the first chunk
+    uint64_t m_headSeq = 0;
+
+    // last chunks sent, kept for replay
+    vector<char> m_replay;
+    size_t m_replaySlots = 0;
+    uint64_t m_replayFrom = 0;
+    uint64_t m_nextSeq = 0;
+
+    vector<char> m_chunk;
+    vector<uint64_t> m_sentTimes;
+    vector<uint32_t> m_sentTags;
+
+    // first chunk sent on the current connection, where its timestamps start
+    uint64_t m_connectionSeq = 0;
+    uint64_t m_lastSendNs = 0;
+
+    WebSocket m_socket;
+    bool m_isConnected = false;
+    string m_message;
+    size_t m_reserved = 0;
+
+    thread m_thread;
+    atomic<bool> m_running{false};
+
+    Gauge& m_queued;
+    Gauge& m_connected;
+    Counter& m_sentBytes;
+    Counter& m_droppedQueue;
+    Counter& m_droppedBudget;
+    Counter& m_droppedFormat;
+    Counter& m_reconnects;
+    Counter& m_replayedBytes;
+    Counter& m_results;
+    Histogram& m_latency;
+
+    void setFormat(unsigned int rate, unsigned int channels);
+    void complete(size_t slot);
+    void publishQueued();
+    void setConnected(bool connected);
+    string url() const;
+
+    bool connect();
+    bool sendChunk(const char* data, uint64_t seq);
+    bool sendQueued();
+    void receive(int timeoutMs);
+    void handle(const string& message);
+    void finish();
+    void run();
+
+public:
+    StreamingTranscriber(Options options, Sink sink);
+    ~StreamingTranscriber();
+
+    void start();
+
+    /**
+     * Send what is queued, wait briefly for the last results and disconnect
+     */
+    void stop();
+
+    /**
+     * Queue 16-bit PCM from the audio thread. The first call fixes the
+     * format, later chunks in another format are dropped.
+     * @param tag passed back with the results for this audio
+     */
+    void push(const char* data, size_t len, unsigned int rate, unsigned int channels, uint32_t tag = 0);
+
+    /**
+     * End of an utterance: pad the chunk being filled with silence and ask
+     * the service for its final results instead of waiting for more audio
+     */
+    void flush();
+};
+
+#endif //MEETINGSDK_HEADLESS_LINUX_SAMPLE_STREAMINGTRANSCRIBER_H
@@ -0,0 +1,36 @@
+#include "VoiceActivity.h"
+
+#include <algorithm>
+
+bool VoiceActivity::update(const int16_t* pcm, size_t samples, unsigned int rate, unsigned int channels) {
+    if (!samples || !rate || !channels)
+        return m_active;
+
+    double energy = 0;
+    for (size_t i = 0; i < samples; i++)
+        energy += static_cast<double>(pcm[i]) * pcm[i];
+    energy /= samples;
+
+    auto ms = static_cast<unsigned int>(samples / channels * 1000 / rate);
+    auto loud = energy > max(c_absoluteFloor, m_noise * c_margin);
+
+    // the floor follows quiet chunks quickly and creeps up under speech, so a louder room is learned
+    if (!loud)
+        m_noise = max(c_absoluteFloor, m_noise + (energy - m_noise) * 0.1);
+    else
+        m_noise *= 1.001;
+
+    if (loud) {
+        m_loudMs += ms;
+        m_quietMs = 0;
+        if (m_loudMs >= c_attackMs)
+            m_active = true;
+    } else {
+        m_loudMs = 0;
+        m_quietMs += ms;
+        if (m_quietMs >= c_hangoverMs)
+            m_active = false;
+    }
+
+    return m_active;
+}
@@ -0,0 +1,41 @@
+#ifndef MEETINGSDK_HEADLESS_LINUX_SAMPLE_VOICEACTIVITY_H
+#define MEETINGSDK_HEADLESS_LINUX_SAMPLE_VOICEACTIVITY_H
+
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * Energy voice activity detector for one 16-bit PCM stream. A chunk is
+ * speech when it is well above the stream's noise floor and above an
+ * absolute floor; speech starts after a few such chunks in a row and ends
+ * after a hangover of quiet, so pauses between words do not split it.
+ */
+class VoiceActivity {
+    // below this is silence however quiet the room, about -50 dBFS
+    static constexpr double c_absoluteFloor = 100.0 * 100.0;
+
+    // speech is at least this many times the noise floor's energy, about 12 dB
+    static constexpr double c_margin = 16.0;
+
+    static constexpr unsigned int c_attackMs = 30;
+    static constexpr unsigned int c_hangoverMs = 600;
+
+    double m_noise = c_absoluteFloor;
+    unsigned int m_loudMs = 0;
+    unsigned int m_quietMs = 0;
+    bool m_active = false;
+
+public:
+    /**
+     * Classify the next chunk of the stream
+     * @param channels interleaved channels, averaged
+     * @return whether the stream is in speech after this chunk
+     */
+    bool update(const int16_t* pcm, size_t samples, unsigned int rate, unsigned int channels);
+
+    bool active() const { return m_active; }
+};
+
+#endif //MEETINGSDK_HEADLESS_LINUX_SAMPLE_VOICEACTIVITY_H
@@ -0,0 +1,100 @@
+#include "ControlChannel.h"
+
+#include <cmath>
+
+#include "Log.h"
+
+ControlChannel::ControlChannel() :
+        m_ok(MetricsRegistry::getInstance().counter("zoombot_control_requests_total",
+                "Control requests received on the meeting socket", "result=\"ok\"")),
+        m_failed(MetricsRegistry::getInstance().counter("zoombot_control_requests_total",
+                "Control requests received on the meeting socket", "result=\"failed\"")),
+        m_rejected(MetricsRegistry::getInstance().counter("zoombot_control_requests_total",
+                "Control requests received on the meeting socket", "result=\"rejected\"")) {}
+
+void ControlChannel::on(const string& command, Handler handler) {
+    auto& entry = m_commands[command];
+    entry.handler = move(handler);
+    entry.latency = &MetricsRegistry::getInstance().histogram("zoombot_control_latency_seconds",
+            "Time from a control request arriving to its response", "command=\"" + command + "\"");
+}
+
+void ControlChannel::setWaker(function<void()> wake) {
+    lock_guard<mutex> lock(m_lock);
+    m_wake = move(wake);
+}
+
+string ControlChannel::response(const string& id, const string& command, bool ok, const string& result) {
+    string line = "{\"type\":\"response\",\"id\":" + (id.empty() ? "null" : id) + ",\"command\":";
+    JsonValue::appendString(line, command);
+    line += ok ? ",\"ok\":true,\"result\":" : ",\"ok\":false,\"error\":";
+    JsonValue::appendString(line, result);
+    line += "}\n";
+    return line;
+}
+
+void ControlChannel::submit(const string& line, Reply reply) {
+    Request request;
+    request.receivedNs = MetricsClock::nowNs();
+
+    if (!JsonValue::parse(line, request.json) || request.json.type() != JsonValue::Type::Object) {
+        m_rejected.inc();
+        reply(response("", "", false, "expected a JSON object per line"));
+        return;
+    }
+
+    // echoed back as given, so clients can match responses to requests
+    auto& id = request.json["id"];
+    if (id.type() == JsonValue::Type::String) {
+        JsonValue::appendString(request.id, id.asString());
+    } else if (id.type() == JsonValue::Type::Number && id.asNumber() == floor(id.asNumber())) {
+        request.id = to_string(static_cast<long long>(id.asNumber()));
+    }
+
+    request.command = request.json["command"].asString();
+    if (!m_commands.count(request.command)) {
+        string known;
+        for (auto& [name, command] : m_commands)
+            known += (known.empty() ? "" : ", ") + name;
+
+        m_rejected.inc();
+        reply(response(request.id, request.command, false, "unknown command, expected one of " + known));
+        return;
+    }
+
+    request.reply = move(reply);
+
+    function<void()> wake;
+    {
+        lock_guard<mutex> lock(m_lock);
+        m_queue.push_back(move(request));
+        wake = m_wake;
+    }
+
+    if (wake)
+        wake();
+}
+
+void ControlChannel::dispatch() {
+    for (;;) {
+        Request request;
+        {
+            lock_guard<mutex> lock(m_lock);
+            if (m_queue.empty())
+                return;
+
+            request = move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        auto& command = m_commands[request.command];
+        string result;
+        auto ok = command.handler(request.json, result);
+
+        Log::info("control: " + request.command + (ok ? " done" : " failed: " + result));
+        (ok ? m_ok : m_failed).inc();
+
+        request.reply(response(request.id, request.command, ok, result));
+        command.latency->observe(MetricsClock::nowNs() - request.receivedNs);
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_CONTROLCHANNEL_H
+#define MEETING_SDK_LINUX_SAMPLE_CONTROLCHANNEL_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "Json.h"
+#include "Metrics.h"
+#include "Singleton.h"
+
+using namespace std;
+
+/**
+ * Request/response commands from clients of the meeting socket, so the bot
+ * can be steered without a restart and rejoin.
+ *
+ * A request is one line of JSON, e.g. {"id":1,"command":"subscribe","user_id":16778240},
+ * answered with {"type":"response","id":1,"command":"subscribe","ok":true,"result":"..."}
+ * on the same socket, between whatever else the socket carries. Requests
+ * are queued by the socket thread and run on the main loop, where the SDK
+ * expects to be called from; the time from arrival to response is measured
+ * per command.
+ */
+class ControlChannel : public Singleton<ControlChannel> {
+    friend class Singleton<ControlChannel>;
+
+public:
+    /**
+     * Runs a command on the main loop
+     * @param request the whole request, for its arguments
+     * @param result text returned to the client, the reason on failure
+     * @return whether the command succeeded
+     */
+    using Handler = function<bool(const JsonValue& request, string& result)>;
+
+    /**
+     * Writes one response line back to the client that sent the request
+     */
+    using Reply = function<void(const string& line)>;
+
+private:
+    struct Request {
+        JsonValue json;
+        string id;
+        string command;
+        uint64_t receivedNs = 0;
+        Reply reply;
+    };
+
+    struct Command {
+        Handler handler;
+        Histogram* latency = nullptr;
+    };
+
+    map<string, Command> m_commands;
+
+    mutex m_lock;
+    deque<Request> m_queue;
+    function<void()> m_wake;
+
+    Counter& m_ok;
+    Counter& m_failed;
+    Counter& m_rejected;
+
+    ControlChannel();
+
+    static string response(const string& id, const string& command, bool ok, const string& result);
+
+public:
+    /**
+     * Register a command, before the socket starts taking requests
+     */
+    void on(const string& command, Handler handler);
+
+    /**
+     * Called from any thread when requests are queued, to wake the main loop
+     */
+    void setWaker(function<void()> wake);
+
+    /**
+     * Queue one request line, from the socket thread. Malformed requests
+     * and unknown commands are answered right away.
+     */
+    void submit(const string& line, Reply reply);
+
+    /**
+     * Run every queued request, from the main loop
+     */
+    void dispatch();
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_CONTROLCHANNEL_H
@@ -0,0 +1,144 @@
+#include "JobGraph.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include <pthread.h>
+
+#include "Log.h"
+#include "Metrics.h"
+
+size_t JobGraph::add(const string& name, Work work, const vector<size_t>& after, bool always) {
+    auto id = m_jobs.size();
+
+    Job job;
+    job.name = name;
+    job.work = move(work);
+    job.waiting = after.size();
+    job.always = always;
+    m_jobs.push_back(move(job));
+
+    for (auto before : after)
+        m_jobs[before].next.push_back(id);
+
+    return id;
+}
+
+bool JobGraph::run(unsigned int concurrency, uint64_t timeoutMs) {
+    if (!concurrency)
+        concurrency = max(1u, thread::hardware_concurrency());
+
+    {
+        lock_guard<mutex> lock(m_lock);
+        m_startNs = MetricsClock::nowNs();
+        m_unfinished = m_jobs.size();
+        for (size_t id = 0; id < m_jobs.size(); id++) {
+            if (!m_jobs[id].waiting)
+                m_ready.push_back(id);
+        }
+    }
+
+    vector<thread> workers;
+    for (size_t i = 0; i < min<size_t>(concurrency, m_jobs.size()); i++)
+        workers.emplace_back(&JobGraph::worker, this);
+
+    bool finished;
+    {
+        unique_lock<mutex> lock(m_lock);
+        finished = m_wake.wait_for(lock, chrono::milliseconds(timeoutMs), [this] { return !m_unfinished; });
+
+        if (!finished) {
+            Log::warn("jobs timed out after " + to_string(timeoutMs / 1000) + " s, stopping "
+                      + to_string(m_unfinished) + " unfinished");
+            m_cancelled = true;
+            for (auto& job : m_jobs) {
+                if (job.status == Status::Pending)
+                    job.status = Status::Cancelled;
+            }
+        }
+    }
+
+    m_wake.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+
+    for (auto& job : m_jobs) {
+        if (job.status != Status::Done)
+            return false;
+    }
+    return true;
+}
+
+void JobGraph::worker() {
+    // named but not placed: the meeting is over and finalizing may use every core
+    pthread_setname_np(pthread_self(), "zoombot-final");
+
+    unique_lock<mutex> lock(m_lock);
+    while (true) {
+        m_wake.wait(lock, [this] { return !m_ready.empty() || !m_unfinished || m_cancelled; });
+        if (m_cancelled || m_ready.empty())
+            break;
+
+        auto id = m_ready.front();
+        m_ready.pop_front();
+
+        auto& job = m_jobs[id];
+        job.status = Status::Running;
+        job.startNs = MetricsClock::nowNs() - m_startNs;
+
+        lock.unlock();
+        auto ok = job.work(m_cancelled);
+        lock.lock();
+
+        finish(id, ok ? Status::Done : m_cancelled ? Status::Cancelled : Status::Failed);
+        m_wake.notify_all();
+    }
+}
+
+void JobGraph::finish(size_t id, Status status) {
+    auto& job = m_jobs[id];
+    job.status = status;
+    job.durationNs = MetricsClock::nowNs() - m_startNs - job.startNs;
+    m_unfinished--;
+
+    char seconds[32];
+    snprintf(seconds, sizeof(seconds), "%.2f", job.durationNs / 1e9);
+    auto message = job.name + " " + statusName(status) + " in " + seconds + " s";
+    if (status == Status::Done)
+        Log::info(message);
+    else
+        Log::warn(message);
+
+    for (auto next : job.next)
+        settle(next, status == Status::Done);
+}
+
+void JobGraph::settle(size_t id, bool done) {
+    auto& job = m_jobs[id];
+    if (job.status != Status::Pending)
+        return;
+
+    if (done || job.always) {
+        if (!--job.waiting)
+            m_ready.push_back(id);
+        return;
+    }
+
+    job.status = Status::Skipped;
+    m_unfinished--;
+    for (auto next : job.next)
+        settle(next, false);
+}
+
+const char* JobGraph::statusName(Status status) {
+    switch (status) {
+        case Status::Pending: return "pending";
+        case Status::Running: return "running";
+        case Status::Done: return "done";
+        case Status::Failed: return "failed";
+        case Status::Skipped: return "skipped";
+        case Status::Cancelled: return "cancelled";
+    }
+    return "";
+}
@@ -0,0 +1,86 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_JOBGRAPH_H
+#define MEETING_SDK_LINUX_SAMPLE_JOBGRAPH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Jobs with dependencies run on a pool of threads, each as soon as
+ * everything it depends on is done. A failed job skips the jobs that depend
+ * on it, unless they run regardless, and the others carry on. At the
+ * deadline no more jobs start and the running ones are asked to stop.
+ */
+class JobGraph {
+public:
+    enum class Status {
+        Pending,
+        Running,
+        Done,
+        Failed,
+        Skipped,
+        Cancelled
+    };
+
+    /**
+     * @param cancelled set at the deadline, long jobs check it and give up
+     * @return false if the job failed
+     */
+    using Work = function<bool(const atomic<bool>& cancelled)>;
+
+    struct Job {
+        string name;
+        Work work;
+        vector<size_t> next;
+        size_t waiting = 0;
+        bool always = false;
+
+        Status status = Status::Pending;
+
+        // CLOCK_MONOTONIC relative to the start of run()
+        uint64_t startNs = 0;
+        uint64_t durationNs = 0;
+    };
+
+private:
+    vector<Job> m_jobs;
+
+    mutex m_lock;
+    condition_variable m_wake;
+    deque<size_t> m_ready;
+    size_t m_unfinished = 0;
+    uint64_t m_startNs = 0;
+    atomic<bool> m_cancelled{false};
+
+    void worker();
+    void finish(size_t id, Status status);
+    void settle(size_t id, bool done);
+
+public:
+    /**
+     * Add a job that runs after the given ones, added before it
+     * @param always run once they have finished, even if some did not succeed
+     * @return id of the job to make others depend on
+     */
+    size_t add(const string& name, Work work, const vector<size_t>& after = {}, bool always = false);
+
+    /**
+     * Run every job and wait for them, once
+     * @param concurrency jobs at once, 0 for one per core
+     * @return true if every job was done
+     */
+    bool run(unsigned int concurrency, uint64_t timeoutMs);
+
+    const vector<Job>& jobs() const { return m_jobs; }
+
+    static const char* statusName(Status status);
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_JOBGRAPH_H
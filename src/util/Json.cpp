@@ -0,0 +1,254 @@
+#include "Json.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+    const JsonValue c_null;
+
+    // nesting beyond this is not a message we expect
+    constexpr unsigned c_maxDepth = 32;
+
+    void appendUtf8(string& out, unsigned code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xc0 | code >> 6);
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xe0 | code >> 12);
+            out += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        } else {
+            out += static_cast<char>(0xf0 | code >> 18);
+            out += static_cast<char>(0x80 | (code >> 12 & 0x3f));
+            out += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        }
+    }
+}
+
+class JsonParser {
+    const string& m_text;
+    size_t m_pos = 0;
+
+    void skipSpace() {
+        while (m_pos < m_text.size() && (m_text[m_pos] == ' ' || m_text[m_pos] == '\t'
+                                         || m_text[m_pos] == '\n' || m_text[m_pos] == '\r'))
+            m_pos++;
+    }
+
+    bool consume(const char* word) {
+        size_t i = 0;
+        for (; word[i]; i++)
+            if (m_pos + i >= m_text.size() || m_text[m_pos + i] != word[i])
+                return false;
+        m_pos += i;
+        return true;
+    }
+
+    bool hex4(unsigned& code) {
+        if (m_pos + 4 > m_text.size())
+            return false;
+
+        code = 0;
+        for (int i = 0; i < 4; i++) {
+            auto c = m_text[m_pos++];
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    bool parseString(string& out) {
+        if (!consume("\""))
+            return false;
+
+        while (m_pos < m_text.size()) {
+            auto c = m_text[m_pos++];
+            if (c == '"')
+                return true;
+
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+
+            if (m_pos >= m_text.size())
+                return false;
+
+            switch (m_text[m_pos++]) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned code;
+                    if (!hex4(code))
+                        return false;
+
+                    // a surrogate pair spells one code point above the BMP
+                    unsigned low;
+                    if (code >= 0xd800 && code < 0xdc00 && consume("\\u") && hex4(low)
+                        && low >= 0xdc00 && low < 0xe000)
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+
+                    appendUtf8(out, code);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+
+        return false;
+    }
+
+public:
+    explicit JsonParser(const string& text) : m_text(text) {}
+
+    bool parse(JsonValue& out, unsigned depth = 0) {
+        if (depth > c_maxDepth)
+            return false;
+
+        skipSpace();
+        if (m_pos >= m_text.size())
+            return false;
+
+        auto c = m_text[m_pos];
+        if (c == '{') {
+            m_pos++;
+            out.m_type = JsonValue::Type::Object;
+            skipSpace();
+            if (consume("}"))
+                return true;
+
+            for (;;) {
+                skipSpace();
+                string key;
+                if (!parseString(key))
+                    return false;
+
+                skipSpace();
+                if (!consume(":"))
+                    return false;
+
+                out.m_members.emplace_back(move(key), JsonValue());
+                if (!parse(out.m_members.back().second, depth + 1))
+                    return false;
+
+                skipSpace();
+                if (consume("}"))
+                    return true;
+                if (!consume(","))
+                    return false;
+            }
+        }
+
+        if (c == '[') {
+            m_pos++;
+            out.m_type = JsonValue::Type::Array;
+            skipSpace();
+            if (consume("]"))
+                return true;
+
+            for (;;) {
+                out.m_items.emplace_back();
+                if (!parse(out.m_items.back(), depth + 1))
+                    return false;
+
+                skipSpace();
+                if (consume("]"))
+                    return true;
+                if (!consume(","))
+                    return false;
+            }
+        }
+
+        if (c == '"') {
+            out.m_type = JsonValue::Type::String;
+            return parseString(out.m_string);
+        }
+
+        if (consume("true")) {
+            out.m_type = JsonValue::Type::Boolean;
+            out.m_bool = true;
+            return true;
+        }
+
+        if (consume("false")) {
+            out.m_type = JsonValue::Type::Boolean;
+            return true;
+        }
+
+        if (consume("null"))
+            return true;
+
+        auto* start = m_text.c_str() + m_pos;
+        char* end = nullptr;
+        out.m_number = strtod(start, &end);
+        if (end == start)
+            return false;
+
+        out.m_type = JsonValue::Type::Number;
+        m_pos += end - start;
+        return true;
+    }
+
+    bool atEnd() {
+        skipSpace();
+        return m_pos == m_text.size();
+    }
+};
+
+bool JsonValue::parse(const string& text, JsonValue& out) {
+    out = JsonValue();
+
+    JsonParser parser(text);
+    return parser.parse(out) && parser.atEnd();
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+    if (m_type != Type::Array || index >= m_items.size())
+        return c_null;
+
+    return m_items[index];
+}
+
+const JsonValue& JsonValue::operator[](const string& key) const {
+    for (auto& [name, value] : m_members)
+        if (name == key)
+            return value;
+
+    return c_null;
+}
+
+void JsonValue::appendString(string& out, const string& str) {
+    out += '"';
+    for (auto ch : str) {
+        auto c = static_cast<unsigned char>(ch);
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
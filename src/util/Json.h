@@ -0,0 +1,60 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_JSON_H
+#define MEETING_SDK_LINUX_SAMPLE_JSON_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Minimal JSON reader for the small messages the bot receives, e.g. from a
+ * speech service. Lookups of missing keys or indices return a null value,
+ * so a path can be followed without checking every step.
+ */
+class JsonValue {
+public:
+    enum class Type {
+        Null,
+        Boolean,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+private:
+    Type m_type = Type::Null;
+    bool m_bool = false;
+    double m_number = 0;
+    string m_string;
+    vector<JsonValue> m_items;
+    vector<pair<string, JsonValue>> m_members;
+
+    friend class JsonParser;
+
+public:
+    /**
+     * @return false if text is not a single JSON value
+     */
+    static bool parse(const string& text, JsonValue& out);
+
+    Type type() const { return m_type; }
+    bool isNull() const { return m_type == Type::Null; }
+
+    bool asBool(bool fallback = false) const { return m_type == Type::Boolean ? m_bool : fallback; }
+    double asNumber(double fallback = 0) const { return m_type == Type::Number ? m_number : fallback; }
+    const string& asString() const { return m_string; }
+
+    size_t size() const { return m_type == Type::Array ? m_items.size() : m_members.size(); }
+
+    const JsonValue& operator[](size_t index) const;
+    const JsonValue& operator[](const string& key) const;
+
+    /**
+     * Append str to out as a quoted JSON string
+     */
+    static void appendString(string& out, const string& str);
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_JSON_H
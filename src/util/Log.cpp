@@ -0,0 +1,309 @@
+#include "Log.h"
+#include "Threads.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+    uint64_t realtimeNs() {
+        timespec ts{};
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+
+    uint64_t monotonicNs() {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+
+    const char* levelName(LogLevel level) {
+        switch (level) {
+            case LogLevel::Debug: return "debug";
+            case LogLevel::Info: return "info";
+            case LogLevel::Ok: return "success";
+            case LogLevel::Warn: return "warn";
+            case LogLevel::Error: return "error";
+        }
+        return "info";
+    }
+
+    const string& levelEmoji(LogLevel level) {
+        switch (level) {
+            case LogLevel::Debug: return Emoji::magnifier;
+            case LogLevel::Ok: return Emoji::checkMark;
+            case LogLevel::Warn: return Emoji::warning;
+            case LogLevel::Error: return Emoji::crossMark;
+            default: return Emoji::hourglass;
+        }
+    }
+
+    void appendJsonString(string& out, const char* str, size_t len) {
+        out += '"';
+        for (size_t i = 0; i < len; i++) {
+            auto c = static_cast<unsigned char>(str[i]);
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (c < 0x20) {
+                        char buf[8];
+                        snprintf(buf, sizeof(buf), "\\u%04x", c);
+                        out += buf;
+                    } else {
+                        out += static_cast<char>(c);
+                    }
+            }
+        }
+        out += '"';
+    }
+
+    thread_local shared_ptr<LogRing> t_ring;
+}
+
+LogRecord* LogRing::claim() {
+    auto head = m_head.load(memory_order_relaxed);
+    if (head - m_tail.load(memory_order_acquire) >= c_slots)
+        return nullptr;
+
+    return &m_slots[head % c_slots];
+}
+
+unsigned LogRing::publish() {
+    auto head = m_head.load(memory_order_relaxed) + 1;
+    m_head.store(head, memory_order_release);
+    return head - m_tail.load(memory_order_relaxed);
+}
+
+Logger& Logger::getInstance() {
+    // never destroyed so that atexit handlers and signal handlers can still log
+    static auto* instance = new Logger();
+    return *instance;
+}
+
+Logger::Logger() : m_pid(getpid()) {
+    m_running = true;
+    m_thread = thread(&Logger::run, this);
+}
+
+Logger::~Logger() {
+    shutdown();
+}
+
+LogRing& Logger::ring() {
+    if (!t_ring) {
+        t_ring = make_shared<LogRing>();
+
+        lock_guard<mutex> lock(m_ringsMutex);
+        m_rings.push_back(t_ring);
+    }
+
+    return *t_ring;
+}
+
+void Logger::log(LogLevel level, const string& message) {
+    if (!enabled(level))
+        return;
+
+    // forked children and late shutdown have no writer thread
+    if (!m_running.load(memory_order_acquire) || getpid() != m_pid)
+        return writeDirect(level, message);
+
+    auto& ring = this->ring();
+    auto* record = ring.claim();
+    if (!record) {
+        // errors are never lost, everything else is counted and reported later
+        if (level == LogLevel::Error)
+            return writeDirect(level, message);
+
+        m_dropped.fetch_add(1, memory_order_relaxed);
+        m_wake.notify_one();
+        return;
+    }
+
+    record->timestamp = realtimeNs();
+    record->tid = static_cast<pid_t>(syscall(SYS_gettid));
+    record->level = level;
+
+    auto len = min<size_t>(message.size(), LogRecord::c_capacity);
+    memcpy(record->message, message.data(), len);
+    if (message.size() > LogRecord::c_capacity)
+        memcpy(record->message + len - 3, "...", 3);
+    record->len = len;
+
+    auto pending = ring.publish();
+
+    if (level == LogLevel::Error || pending >= LogRing::c_slots / 2)
+        m_wake.notify_one();
+}
+
+void Logger::run() {
+    ThreadRegistry::getInstance().enroll(ThreadClass::Writer, "zoombot-log");
+
+    while (m_running.load(memory_order_acquire)) {
+        {
+            unique_lock<mutex> lock(m_wakeMutex);
+            m_wake.wait_for(lock, chrono::milliseconds(10));
+        }
+
+        drain();
+    }
+
+    drain();
+}
+
+void Logger::drain() {
+    lock_guard<mutex> drainLock(m_drainMutex);
+
+    vector<shared_ptr<LogRing>> rings;
+    {
+        lock_guard<mutex> lock(m_ringsMutex);
+        rings = m_rings;
+    }
+
+    // interleave the threads' lines back into time order
+    vector<const LogRecord*> records;
+    for (auto& ring : rings)
+        ring->peek([&](const LogRecord& record) { records.push_back(&record); });
+
+    stable_sort(records.begin(), records.end(), [](const LogRecord* a, const LogRecord* b) {
+        return a->timestamp < b->timestamp;
+    });
+
+    string out, err;
+    for (const auto* record : records)
+        write(*record, out, err);
+
+    for (auto& ring : rings)
+        ring->release();
+
+    auto dropped = m_dropped.exchange(0, memory_order_relaxed);
+    if (dropped) {
+        LogRecord record{};
+        record.timestamp = realtimeNs();
+        record.level = LogLevel::Warn;
+        record.len = snprintf(record.message, sizeof(record.message),
+                              "log buffer full, %llu lines dropped", static_cast<unsigned long long>(dropped));
+        write(record, out, err);
+    }
+
+    // forget the rings of exited threads once they are empty, the
+    // registry and the local copy then hold the only references
+    {
+        lock_guard<mutex> lock(m_ringsMutex);
+        for (auto it = m_rings.begin(); it != m_rings.end();) {
+            if (it->use_count() == 2 && (*it)->empty())
+                it = m_rings.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    if (!out.empty()) {
+        fwrite(out.data(), 1, out.size(), stdout);
+        fflush(stdout);
+    }
+
+    if (!err.empty()) {
+        fwrite(err.data(), 1, err.size(), stderr);
+        fflush(stderr);
+    }
+}
+
+void Logger::write(const LogRecord& record, string& out, string& err) {
+    auto& dest = record.level == LogLevel::Error ? err : out;
+
+    if (!m_json.load(memory_order_relaxed)) {
+        dest += levelEmoji(record.level);
+        dest += ' ';
+        dest.append(record.message, record.len);
+        dest += '\n';
+        return;
+    }
+
+    char header[128];
+    time_t secs = record.timestamp / 1000000000ull;
+    tm utc{};
+    gmtime_r(&secs, &utc);
+    auto n = strftime(header, sizeof(header), "{\"ts\":\"%Y-%m-%dT%H:%M:%S", &utc);
+    snprintf(header + n, sizeof(header) - n, ".%06lluZ\",\"level\":\"%s\",\"tid\":%d,\"msg\":",
+             static_cast<unsigned long long>(record.timestamp % 1000000000ull / 1000),
+             levelName(record.level), record.tid);
+
+    dest += header;
+    appendJsonString(dest, record.message, record.len);
+    dest += "}\n";
+}
+
+void Logger::writeDirect(LogLevel level, const string& message) {
+    LogRecord record{};
+    record.timestamp = realtimeNs();
+    record.tid = static_cast<pid_t>(syscall(SYS_gettid));
+    record.level = level;
+    record.len = min<size_t>(message.size(), LogRecord::c_capacity);
+    memcpy(record.message, message.data(), record.len);
+
+    string out, err;
+    write(record, out, err);
+
+    auto& line = out.empty() ? err : out;
+    auto* stream = out.empty() ? stderr : stdout;
+    fwrite(line.data(), 1, line.size(), stream);
+    fflush(stream);
+}
+
+void Logger::flush() {
+    if (getpid() != m_pid)
+        return;
+
+    drain();
+}
+
+void Logger::shutdown() {
+    if (getpid() != m_pid || !m_running.exchange(false))
+        return;
+
+    m_wake.notify_one();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+bool Logger::parseLevel(const string& name, LogLevel& level) {
+    const pair<const char*, LogLevel> levels[] = {
+            {"debug", LogLevel::Debug},
+            {"info", LogLevel::Info},
+            {"success", LogLevel::Ok},
+            {"warn", LogLevel::Warn},
+            {"error", LogLevel::Error},
+    };
+
+    for (const auto& [levelName, value] : levels) {
+        if (name == levelName) {
+            level = value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool LogRateLimiter::allow(uint64_t& suppressed) {
+    auto now = monotonicNs();
+    auto next = m_next.load(memory_order_relaxed);
+
+    if (now < next || !m_next.compare_exchange_strong(next, now + m_intervalNs, memory_order_relaxed)) {
+        m_suppressed.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    suppressed = m_suppressed.exchange(0, memory_order_relaxed);
+    return true;
+}
@@ -1,8 +1,16 @@
 #ifndef MEETING_SDK_LINUX_SAMPLE_LOG_H
 #define MEETING_SDK_LINUX_SAMPLE_LOG_H
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
-#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
 
 using namespace std;
 
@@ -10,23 +18,194 @@ namespace Emoji {
     const string checkMark = "✅";
     const string crossMark = "❌";
     const string hourglass = "⏳";
+    const string warning = "⚠️";
+    const string magnifier = "🔍";
 }
 
+/**
+ * Severity of a log line, Ok is what Log::success writes
+ */
+enum class LogLevel { Debug = 0, Info, Ok, Warn, Error };
+
+/**
+ * One formatted log line waiting in a ring
+ */
+struct LogRecord {
+    static constexpr unsigned c_capacity = 480;
+
+    uint64_t timestamp;
+    pid_t tid;
+    LogLevel level;
+    uint16_t len;
+    char message[c_capacity];
+};
+
+/**
+ * Single producer, single consumer ring owned by one logging thread
+ */
+class LogRing {
+public:
+    static constexpr unsigned c_slots = 256;
+
+private:
+    alignas(64) atomic<uint64_t> m_head{0};
+    alignas(64) atomic<uint64_t> m_tail{0};
+    uint64_t m_peeked = 0;
+    LogRecord m_slots[c_slots];
+
+public:
+    /**
+     * Claim the next free slot, nullptr if the ring is full
+     */
+    LogRecord* claim();
+
+    /**
+     * Make the claimed slot visible to the consumer
+     * @return number of records waiting to be drained
+     */
+    unsigned publish();
+
+    bool empty() const {
+        return m_head.load(memory_order_acquire) == m_tail.load(memory_order_relaxed);
+    }
+
+    /**
+     * Hand every published record to the consumer without freeing the slots.
+     * The records stay valid until release().
+     */
+    template <typename F>
+    void peek(F&& consume) {
+        auto tail = m_tail.load(memory_order_relaxed);
+        m_peeked = m_head.load(memory_order_acquire);
+
+        for (auto i = tail; i < m_peeked; i++)
+            consume(m_slots[i % c_slots]);
+    }
+
+    /**
+     * Free the slots handed out by the last peek()
+     */
+    void release() { m_tail.store(m_peeked, memory_order_release); }
+};
+
+/**
+ * Asynchronous logger. Callers format into their own thread's ring and never
+ * block; a background thread writes the rings out to stdout/stderr.
+ */
+class Logger {
+    mutex m_ringsMutex;
+    vector<shared_ptr<LogRing>> m_rings;
+
+    mutex m_drainMutex;
+    mutex m_wakeMutex;
+    condition_variable m_wake;
+    thread m_thread;
+    atomic<bool> m_running{false};
+
+    atomic<int> m_minLevel{static_cast<int>(LogLevel::Info)};
+    atomic<bool> m_json{false};
+    atomic<uint64_t> m_dropped{0};
+
+    pid_t m_pid;
+
+    Logger();
+    ~Logger();
+
+    LogRing& ring();
+    void run();
+    void drain();
+    void write(const LogRecord& record, string& out, string& err);
+    void writeDirect(LogLevel level, const string& message);
+
+public:
+    static Logger& getInstance();
+
+    void log(LogLevel level, const string& message);
+
+    /**
+     * Block until everything logged so far has been written
+     */
+    void flush();
+
+    /**
+     * Drain and stop the background thread, later lines are written synchronously
+     */
+    void shutdown();
+
+    void setLevel(LogLevel level) { m_minLevel = static_cast<int>(level); }
+    void setJson(bool json) { m_json = json; }
+
+    bool enabled(LogLevel level) const { return static_cast<int>(level) >= m_minLevel.load(memory_order_relaxed); }
+
+    uint64_t dropped() const { return m_dropped.load(memory_order_relaxed); }
+
+    /**
+     * Parse a level name such as "info" or "error"
+     */
+    static bool parseLevel(const string& name, LogLevel& level);
+};
+
+/**
+ * Allows one message per interval from a call site and counts the rest
+ */
+class LogRateLimiter {
+    const uint64_t m_intervalNs;
+    atomic<uint64_t> m_next{0};
+    atomic<uint64_t> m_suppressed{0};
+
+public:
+    explicit LogRateLimiter(uint64_t intervalMs) : m_intervalNs(intervalMs * 1000000) {}
+
+    /**
+     * @param suppressed set to the number of messages dropped since the last allowed one
+     * @return true if the caller should log
+     */
+    bool allow(uint64_t& suppressed);
+};
+
 class Log {
     public:
+        static void debug(const string& message) {
+            Logger::getInstance().log(LogLevel::Debug, message);
+        }
+
         static void success(const string& message) {
-            cout << Emoji::checkMark << " " << message << endl;
+            Logger::getInstance().log(LogLevel::Ok, message);
         }
 
         static void info(const std::string& message) {
-            cout << Emoji::hourglass << " " << message << endl;
+            Logger::getInstance().log(LogLevel::Info, message);
+        }
 
+        static void warn(const string& message) {
+            Logger::getInstance().log(LogLevel::Warn, message);
         }
 
         static void error(const string& message) {
-            cerr << Emoji::crossMark << " " << message << endl;
+            Logger::getInstance().log(LogLevel::Error, message);
+        }
+
+        static void flush() {
+            Logger::getInstance().flush();
         }
 };
 
+/**
+ * Rate limit a log statement per call site, for use on callback hot paths.
+ * The message expression is only evaluated when the line is let through.
+ *   LOG_EVERY_MS(1000, Log::info, "frame " + to_string(n));
+ */
+#define LOG_EVERY_MS(intervalMs, logFn, message)                                        \
+    do {                                                                                \
+        static LogRateLimiter _logLimiter(intervalMs);                                  \
+        uint64_t _logSuppressed;                                                        \
+        if (_logLimiter.allow(_logSuppressed)) {                                        \
+            if (_logSuppressed)                                                         \
+                logFn(string(message) + " (" + to_string(_logSuppressed) + " suppressed)"); \
+            else                                                                        \
+                logFn(message);                                                         \
+        }                                                                               \
+    } while (0)
+
 
 #endif //MEETING_SDK_LINUX_SAMPLE_LOG_H
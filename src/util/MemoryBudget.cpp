@@ -0,0 +1,122 @@
+#include "MemoryBudget.h"
+
+#include "Log.h"
+
+namespace {
+    // share of the budget at which each degradation step starts
+    constexpr double c_thresholds[] = {0, 0.80, 0.90, 1.0};
+
+    // a step is left once usage falls this far below where it started
+    constexpr double c_hysteresis = 0.10;
+}
+
+MemoryBudget& MemoryBudget::getInstance() {
+    static auto* instance = new MemoryBudget();
+    return *instance;
+}
+
+MemoryBudget::MemoryBudget() :
+        m_levelGauge(MetricsRegistry::getInstance().gauge(
+                "zoombot_degradation_level", "Current degradation step: 0 normal, 1 drop analysis, 2 decimate video, 3 drop video")) {
+    auto& registry = MetricsRegistry::getInstance();
+
+    for (unsigned i = 0; i < c_pools; i++) {
+        m_usedGauges[i] = &registry.gauge("zoombot_memory_bytes", "Media memory held against the budget",
+                                          "pool=\"" + string(poolName(static_cast<MemoryPool>(i))) + "\"");
+    }
+
+    for (unsigned i = 0; i < 4; i++) {
+        m_steps[i] = &registry.counter("zoombot_degradation_steps_total", "Times each degradation step was entered",
+                                       "level=\"" + string(degradationName(static_cast<Degradation>(i))) + "\"");
+    }
+}
+
+const char* MemoryBudget::poolName(MemoryPool pool) {
+    switch (pool) {
+        case MemoryPool::Audio: return "audio";
+        case MemoryPool::Video: return "video";
+        case MemoryPool::Analysis: return "analysis";
+        case MemoryPool::Socket: return "socket";
+    }
+    return "";
+}
+
+const char* MemoryBudget::degradationName(Degradation level) {
+    switch (level) {
+        case Degradation::Normal: return "normal";
+        case Degradation::DropAnalysis: return "drop_analysis";
+        case Degradation::DecimateVideo: return "decimate_video";
+        case Degradation::DropVideo: return "drop_video";
+    }
+    return "";
+}
+
+void MemoryBudget::setBudget(uint64_t bytes) {
+    m_budget.store(bytes, memory_order_relaxed);
+    update();
+}
+
+void MemoryBudget::reserve(MemoryPool pool, uint64_t bytes) {
+    auto index = static_cast<unsigned>(pool);
+    auto used = m_used[index].fetch_add(bytes, memory_order_relaxed) + bytes;
+    m_usedGauges[index]->set(used);
+    update();
+}
+
+bool MemoryBudget::tryReserve(MemoryPool pool, uint64_t bytes) {
+    auto budget = m_budget.load(memory_order_relaxed);
+    if (budget && used() + bytes > budget) {
+        update();
+        return false;
+    }
+
+    reserve(pool, bytes);
+    return true;
+}
+
+void MemoryBudget::release(MemoryPool pool, uint64_t bytes) {
+    auto index = static_cast<unsigned>(pool);
+    auto used = m_used[index].fetch_sub(bytes, memory_order_relaxed) - bytes;
+    m_usedGauges[index]->set(used);
+    update();
+}
+
+uint64_t MemoryBudget::used() const {
+    int64_t total = 0;
+    for (auto& used : m_used)
+        total += used.load(memory_order_relaxed);
+    return total;
+}
+
+uint64_t MemoryBudget::used(MemoryPool pool) const {
+    return m_used[static_cast<unsigned>(pool)].load(memory_order_relaxed);
+}
+
+void MemoryBudget::update() {
+    auto budget = m_budget.load(memory_order_relaxed);
+    auto current = m_level.load(memory_order_relaxed);
+    auto share = budget ? static_cast<double>(used()) / budget : 0.0;
+
+    // step up as far as usage reaches, step down only past the hysteresis
+    auto level = current;
+    while (level < 3 && share >= c_thresholds[level + 1])
+        level++;
+    while (level > 0 && share < c_thresholds[level] - c_hysteresis)
+        level--;
+
+    if (level == current || !m_level.compare_exchange_strong(current, level, memory_order_relaxed))
+        return;
+
+    m_levelGauge.set(level);
+
+    // a jump of several steps enters each one on the way
+    for (auto step = current + 1; step <= level; step++)
+        m_steps[step]->inc();
+
+    auto name = degradationName(static_cast<Degradation>(level));
+    auto usage = to_string(used() >> 20) + " of " + to_string(budget >> 20) + " MiB";
+    if (level > current)
+        Log::warn(string("memory budget: degrading to ") + name + ", " + usage + " in use");
+    else
+        Log::info(string("memory budget: recovered to ") + name + ", " + usage + " in use");
+}
@@ -0,0 +1,90 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_MEMORYBUDGET_H
+#define MEETING_SDK_LINUX_SAMPLE_MEMORYBUDGET_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "Metrics.h"
+
+using namespace std;
+
+/**
+ * What a piece of buffered media is for, in the order it is given up
+ */
+enum class MemoryPool {
+    Audio,
+    Video,
+    Analysis,
+    Socket
+};
+
+/**
+ * Degradation steps, each one includes the ones before it. Audio is never
+ * given up.
+ */
+enum class Degradation {
+    Normal,
+    DropAnalysis,
+    DecimateVideo,
+    DropVideo
+};
+
+/**
+ * One memory budget for all media buffered off the callback threads. Pools
+ * charge what they hold; as usage nears the budget the degradation level
+ * steps up, and back down with some hysteresis once usage falls. Every step
+ * is logged and exported as zoombot_degradation_level and
+ * zoombot_degradation_steps_total.
+ */
+class MemoryBudget {
+    static constexpr unsigned c_pools = 4;
+
+    atomic<int64_t> m_used[c_pools] = {};
+    atomic<uint64_t> m_budget{0};
+    atomic<int> m_level{0};
+
+    Gauge* m_usedGauges[c_pools];
+    Gauge& m_levelGauge;
+    Counter* m_steps[4];
+
+    MemoryBudget();
+
+    void update();
+
+public:
+    /**
+     * Never destroyed, queues may release memory during exit
+     */
+    static MemoryBudget& getInstance();
+
+    static const char* poolName(MemoryPool pool);
+    static const char* degradationName(Degradation level);
+
+    /**
+     * @param bytes total budget, 0 for unlimited
+     */
+    void setBudget(uint64_t bytes);
+    uint64_t budget() const { return m_budget.load(memory_order_relaxed); }
+
+    /**
+     * Charge memory that must be held regardless of the budget, e.g. audio
+     */
+    void reserve(MemoryPool pool, uint64_t bytes);
+
+    /**
+     * Charge memory only if it fits in the budget
+     * @return false if it would exceed the budget, nothing is charged
+     */
+    bool tryReserve(MemoryPool pool, uint64_t bytes);
+
+    void release(MemoryPool pool, uint64_t bytes);
+
+    uint64_t used() const;
+    uint64_t used(MemoryPool pool) const;
+
+    Degradation level() const { return static_cast<Degradation>(m_level.load(memory_order_relaxed)); }
+
+    bool allowAnalysis() const { return level() < Degradation::DropAnalysis; }
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_MEMORYBUDGET_H
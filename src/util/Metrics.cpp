@@ -0,0 +1,271 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Log.h"
+#include "Threads.h"
+
+namespace {
+// a client that stalls must not hold up the next scrape
+constexpr int c_clientTimeoutMs = 2000;
+// pause after a failed accept, e.g. EMFILE, rather than spin on it
+constexpr int c_acceptBackoffMs = 100;
+}
+
+thread_local unsigned t_metricShard = 0;
+
+unsigned assignMetricShard() {
+    static atomic<unsigned> next{0};
+    t_metricShard = next.fetch_add(1, memory_order_relaxed) % c_metricShards + 1;
+    return t_metricShard;
+}
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const auto& shard : m_shards)
+        total += shard.value.load(memory_order_relaxed);
+
+    return total;
+}
+
+double Histogram::bound(unsigned bucket) {
+    return static_cast<double>(1024ull << bucket) / 1e9;
+}
+
+void Histogram::snapshot(uint64_t (&buckets)[c_histogramBuckets], uint64_t& sum) const {
+    memset(buckets, 0, sizeof(buckets));
+    sum = 0;
+
+    for (const auto& shard : m_shards) {
+        for (unsigned i = 0; i < c_histogramBuckets; i++)
+            buckets[i] += shard.buckets[i].load(memory_order_relaxed);
+
+        sum += shard.sum.load(memory_order_relaxed);
+    }
+}
+
+CallbackMetrics::CallbackMetrics(const string& stream) :
+        m_interarrival(MetricsRegistry::getInstance().histogram("zoombot_callback_interarrival_seconds",
+                "Time between consecutive SDK callbacks", "stream=\"" + stream + "\"")),
+        m_duration(MetricsRegistry::getInstance().histogram("zoombot_callback_duration_seconds",
+                "Time spent inside an SDK callback", "stream=\"" + stream + "\"")),
+        m_bytes(MetricsRegistry::getInstance().counter("zoombot_bytes_written_total",
+                "Bytes written to the output sink", "stream=\"" + stream + "\"")),
+        m_dropped(MetricsRegistry::getInstance().counter("zoombot_dropped_total",
+                "Callbacks whose data was discarded", "stream=\"" + stream + "\"")) {}
+
+MetricsRegistry::Entry& MetricsRegistry::find(const string& name, const string& labels, const string& help, Type type) {
+    lock_guard<mutex> lock(m_mutex);
+
+    for (auto& entry : m_entries) {
+        if (entry->name == name && entry->labels == labels)
+            return *entry;
+    }
+
+    auto entry = make_unique<Entry>();
+    entry->name = name;
+    entry->labels = labels;
+    entry->help = help;
+    entry->type = type;
+
+    switch (type) {
+        case Type::Counter:
+            entry->counter = make_unique<Counter>();
+            break;
+        case Type::Gauge:
+            entry->gauge = make_unique<Gauge>();
+            break;
+        case Type::Histogram:
+            entry->histogram = make_unique<Histogram>();
+            break;
+    }
+
+    m_entries.push_back(move(entry));
+    return *m_entries.back();
+}
+
+Counter& MetricsRegistry::counter(const string& name, const string& help, const string& labels) {
+    return *find(name, labels, help, Type::Counter).counter;
+}
+
+Gauge& MetricsRegistry::gauge(const string& name, const string& help, const string& labels) {
+    return *find(name, labels, help, Type::Gauge).gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const string& name, const string& help, const string& labels) {
+    return *find(name, labels, help, Type::Histogram).histogram;
+}
+
+string MetricsRegistry::render() {
+    lock_guard<mutex> lock(m_mutex);
+    stringstream ss;
+    string lastName;
+
+    // all series of a metric family must be contiguous in the exposition
+    vector<const Entry*> entries;
+    for (const auto& entry : m_entries)
+        entries.push_back(entry.get());
+
+    stable_sort(entries.begin(), entries.end(), [](const Entry* a, const Entry* b) {
+        return a->name < b->name;
+    });
+
+    for (const auto* entry : entries) {
+        if (entry->name != lastName) {
+            const char* type = entry->type == Type::Counter ? "counter" :
+                               entry->type == Type::Gauge ? "gauge" : "histogram";
+            ss << "# HELP " << entry->name << " " << entry->help << "\n";
+            ss << "# TYPE " << entry->name << " " << type << "\n";
+            lastName = entry->name;
+        }
+
+        auto labels = entry->labels.empty() ? "" : "{" + entry->labels + "}";
+
+        switch (entry->type) {
+            case Type::Counter:
+                ss << entry->name << labels << " " << entry->counter->value() << "\n";
+                break;
+            case Type::Gauge:
+                ss << entry->name << labels << " " << entry->gauge->value() << "\n";
+                break;
+            case Type::Histogram: {
+                uint64_t buckets[c_histogramBuckets];
+                uint64_t sum;
+                entry->histogram->snapshot(buckets, sum);
+
+                auto prefix = entry->labels.empty() ? "" : entry->labels + ",";
+                uint64_t cumulative = 0;
+                for (unsigned i = 0; i < c_histogramBuckets; i++) {
+                    cumulative += buckets[i];
+                    ss << entry->name << "_bucket{" << prefix << "le=\"";
+                    if (i == c_histogramBuckets - 1)
+                        ss << "+Inf";
+                    else
+                        ss << Histogram::bound(i);
+                    ss << "\"} " << cumulative << "\n";
+                }
+
+                ss << entry->name << "_sum" << labels << " " << static_cast<double>(sum) / 1e9 << "\n";
+                ss << entry->name << "_count" << labels << " " << cumulative << "\n";
+                break;
+            }
+        }
+    }
+
+    return ss.str();
+}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool MetricsServer::start(int port) {
+    if (m_running)
+        return true;
+
+    m_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listenSocket == -1) {
+        Log::error("unable to create metrics socket");
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    if (bind(m_listenSocket, (const sockaddr*) &addr, sizeof(addr)) == -1 || listen(m_listenSocket, 4) == -1) {
+        Log::error("unable to listen for metrics on port " + to_string(port));
+        close(m_listenSocket);
+        m_listenSocket = -1;
+        return false;
+    }
+
+    m_running = true;
+    m_thread = thread(&MetricsServer::run, this);
+
+    Log::info("serving metrics on http://127.0.0.1:" + to_string(port) + "/metrics");
+    return true;
+}
+
+void MetricsServer::stop() {
+    if (!m_running.exchange(false))
+        return;
+
+    shutdown(m_listenSocket, SHUT_RDWR);
+    close(m_listenSocket);
+    m_listenSocket = -1;
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void MetricsServer::run() {
+    ThreadRegistry::getInstance().enroll(ThreadClass::Socket, "zoombot-metrics");
+
+    while (m_running) {
+        auto client = accept(m_listenSocket, nullptr, nullptr);
+        if (client == -1) {
+            if (!m_running || errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            LOG_EVERY_MS(10000, Log::warn, string("metrics accept failed: ") + strerror(errno));
+            this_thread::sleep_for(chrono::milliseconds(c_acceptBackoffMs));
+            continue;
+        }
+
+        timeval timeout{c_clientTimeoutMs / 1000, (c_clientTimeoutMs % 1000) * 1000};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        serve(client);
+        close(client);
+    }
+}
+
+void MetricsServer::serve(int client) {
+    char request[1024];
+    auto len = read(client, request, sizeof(request) - 1);
+    if (len <= 0)
+        return;
+
+    request[len] = 0;
+
+    string body, status = "200 OK";
+    if (strncmp(request, "GET /metrics", 12) == 0 || strncmp(request, "GET / ", 6) == 0)
+        body = MetricsRegistry::getInstance().render();
+    else if (strncmp(request, "GET /threads", 12) == 0)
+        body = ThreadRegistry::getInstance().dump();
+    else
+        status = "404 Not Found";
+
+    stringstream ss;
+    ss << "HTTP/1.0 " << status << "\r\n"
+       << "Content-Type: text/plain; version=0.0.4\r\n"
+       << "Content-Length: " << body.size() << "\r\n"
+       << "Connection: close\r\n\r\n"
+       << body;
+
+    auto response = ss.str();
+    const char* buf = response.c_str();
+    size_t remaining = response.size();
+    while (remaining > 0) {
+        auto ret = write(client, buf, remaining);
+        if (ret <= 0)
+            return;
+
+        buf += ret;
+        remaining -= ret;
+    }
+}
@@ -0,0 +1,248 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_METRICS_H
+#define MEETING_SDK_LINUX_SAMPLE_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+#include "Singleton.h"
+
+using namespace std;
+
+/**
+ * Number of per-thread shards behind every counter and histogram.
+ * Each thread is bound to one shard so updates rarely share a cache line.
+ */
+constexpr unsigned c_metricShards = 16;
+
+/**
+ * Histogram bucket count. Bucket i holds observations below 1024 * 2^i ns
+ * (roughly 2^i microseconds), the last bucket is +Inf.
+ */
+constexpr unsigned c_histogramBuckets = 24;
+
+namespace MetricsClock {
+    /**
+     * Monotonic clock in nanoseconds, cheap enough for callback entry/exit
+     */
+    inline uint64_t nowNs() {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+}
+
+/**
+ * Shard index + 1 of the calling thread, 0 until first use. Constant
+ * initialised so reading it needs no TLS init guard.
+ */
+extern thread_local unsigned t_metricShard;
+
+unsigned assignMetricShard();
+
+/**
+ * Index of the shard owned by the calling thread
+ */
+inline unsigned metricShard() {
+    auto shard = t_metricShard;
+    if (__builtin_expect(shard == 0, 0))
+        shard = assignMetricShard();
+
+    return shard - 1;
+}
+
+class Counter {
+    struct alignas(64) Shard {
+        atomic<uint64_t> value{0};
+    };
+
+    Shard m_shards[c_metricShards];
+
+public:
+    void inc(uint64_t n = 1) {
+        m_shards[metricShard()].value.fetch_add(n, memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+};
+
+class Gauge {
+    alignas(64) atomic<int64_t> m_value{0};
+
+public:
+    void set(int64_t v) { m_value.store(v, memory_order_relaxed); }
+    void add(int64_t n) { m_value.fetch_add(n, memory_order_relaxed); }
+    void sub(int64_t n) { m_value.fetch_sub(n, memory_order_relaxed); }
+
+    int64_t value() const { return m_value.load(memory_order_relaxed); }
+};
+
+class Histogram {
+    struct alignas(64) Shard {
+        atomic<uint64_t> buckets[c_histogramBuckets]{};
+        atomic<uint64_t> sum{0};
+    };
+
+    Shard m_shards[c_metricShards];
+
+public:
+    /**
+     * Record a duration
+     * @param ns duration in nanoseconds
+     */
+    void observe(uint64_t ns) {
+        auto us = ns >> 10;
+        unsigned bucket = us ? 64 - __builtin_clzll(us) : 0;
+        if (bucket >= c_histogramBuckets)
+            bucket = c_histogramBuckets - 1;
+
+        auto& shard = m_shards[metricShard()];
+        shard.buckets[bucket].fetch_add(1, memory_order_relaxed);
+        shard.sum.fetch_add(ns, memory_order_relaxed);
+    }
+
+    /**
+     * Upper bound of a bucket in seconds
+     */
+    static double bound(unsigned bucket);
+
+    void snapshot(uint64_t (&buckets)[c_histogramBuckets], uint64_t& sum) const;
+};
+
+/**
+ * RAII helper that records the time spent in a scope into a histogram
+ */
+class ScopedTimer {
+    Histogram& m_histogram;
+    uint64_t m_start;
+
+public:
+    explicit ScopedTimer(Histogram& histogram) : m_histogram(histogram), m_start(MetricsClock::nowNs()) {}
+    ~ScopedTimer() { m_histogram.observe(MetricsClock::nowNs() - m_start); }
+};
+
+/**
+ * The standard set of metrics kept for one stream of SDK callbacks.
+ * A stream is updated from a single SDK thread, so the arrival timestamp is
+ * a plain member.
+ */
+class CallbackMetrics {
+    Histogram& m_interarrival;
+    Histogram& m_duration;
+    Counter& m_bytes;
+    Counter& m_dropped;
+
+    uint64_t m_lastArrival = 0;
+
+public:
+    explicit CallbackMetrics(const string& stream);
+
+    /**
+     * Mark callback entry
+     * @return entry timestamp to hand back to leave()
+     */
+    uint64_t enter() {
+        auto now = MetricsClock::nowNs();
+        if (m_lastArrival)
+            m_interarrival.observe(now - m_lastArrival);
+        m_lastArrival = now;
+        return now;
+    }
+
+    void leave(uint64_t start) { m_duration.observe(MetricsClock::nowNs() - start); }
+
+    void written(uint64_t bytes) { m_bytes.inc(bytes); }
+    void dropped() { m_dropped.inc(); }
+
+    /**
+     * Times a whole callback body, whichever way it returns
+     */
+    class Scope {
+        CallbackMetrics& m_metrics;
+        uint64_t m_start;
+
+    public:
+        explicit Scope(CallbackMetrics& metrics) : m_metrics(metrics), m_start(metrics.enter()) {}
+        ~Scope() { m_metrics.leave(m_start); }
+
+        /**
+         * CLOCK_MONOTONIC at callback entry
+         */
+        uint64_t start() const { return m_start; }
+    };
+};
+
+/**
+ * Owns every metric in the process. Registration takes a lock and is meant for
+ * start-up or first use; the returned references stay valid for the process
+ * lifetime and are updated without locking.
+ */
+class MetricsRegistry : public Singleton<MetricsRegistry> {
+    friend class Singleton<MetricsRegistry>;
+
+    enum class Type { Counter, Gauge, Histogram };
+
+    struct Entry {
+        string name;
+        string labels;
+        string help;
+        Type type;
+        unique_ptr<Counter> counter;
+        unique_ptr<Gauge> gauge;
+        unique_ptr<Histogram> histogram;
+    };
+
+    mutex m_mutex;
+    vector<unique_ptr<Entry>> m_entries;
+
+    Entry& find(const string& name, const string& labels, const string& help, Type type);
+
+public:
+    /**
+     * Get or create a metric
+     * @param name Prometheus metric name
+     * @param help description rendered as # HELP
+     * @param labels label set without braces, e.g. stream="mixed"
+     */
+    Counter& counter(const string& name, const string& help, const string& labels = "");
+    Gauge& gauge(const string& name, const string& help, const string& labels = "");
+    Histogram& histogram(const string& name, const string& help, const string& labels = "");
+
+    /**
+     * Render all metrics in the Prometheus text exposition format
+     */
+    string render();
+};
+
+/**
+ * Minimal HTTP server that exposes the registry on 127.0.0.1
+ */
+class MetricsServer : public Singleton<MetricsServer> {
+    friend class Singleton<MetricsServer>;
+
+    int m_listenSocket = -1;
+    thread m_thread;
+    atomic<bool> m_running{false};
+
+    void run();
+    void serve(int client);
+
+public:
+    ~MetricsServer();
+
+    /**
+     * Start serving /metrics
+     * @param port TCP port on the loopback interface
+     * @return true if the server is listening
+     */
+    bool start(int port);
+    void stop();
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_METRICS_H
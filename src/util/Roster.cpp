@@ -0,0 +1,154 @@
+#include "Roster.h"
+
+#include <algorithm>
+#include <ctime>
+#include <mutex>
+
+#include "Json.h"
+#include "Log.h"
+
+Roster::Roster() :
+        m_count(MetricsRegistry::getInstance().gauge("zoombot_roster_participants",
+                "Participants in the meeting, the bot included")) {}
+
+bool Roster::update(uint32_t userId, const string& name, bool host, bool self) {
+    unique_lock<shared_mutex> lock(m_lock);
+
+    auto [it, added] = m_participants.try_emplace(userId);
+    auto& participant = it->second;
+    if (!added && participant.name == name && participant.host == host && participant.self == self)
+        return false;
+
+    if (added) {
+        participant.userId = userId;
+        participant.joinedNs = MetricsClock::nowNs();
+        participant.order = m_joins++;
+        m_count.set(static_cast<int64_t>(m_participants.size()));
+    }
+
+    participant.name = name;
+    participant.host = host;
+    participant.self = self;
+
+    m_generation.fetch_add(1, memory_order_release);
+    return true;
+}
+
+bool Roster::remove(uint32_t userId) {
+    unique_lock<shared_mutex> lock(m_lock);
+    if (!m_participants.erase(userId))
+        return false;
+
+    m_count.set(static_cast<int64_t>(m_participants.size()));
+    m_generation.fetch_add(1, memory_order_release);
+    return true;
+}
+
+void Roster::clear() {
+    unique_lock<shared_mutex> lock(m_lock);
+    if (m_participants.empty())
+        return;
+
+    m_participants.clear();
+    m_count.set(0);
+    m_generation.fetch_add(1, memory_order_release);
+}
+
+bool Roster::find(uint32_t userId, Participant& out) const {
+    shared_lock<shared_mutex> lock(m_lock);
+    auto it = m_participants.find(userId);
+    if (it == m_participants.end())
+        return false;
+
+    out = it->second;
+    return true;
+}
+
+string Roster::name(uint32_t userId) const {
+    shared_lock<shared_mutex> lock(m_lock);
+    auto it = m_participants.find(userId);
+    return it == m_participants.end() ? "" : it->second.name;
+}
+
+vector<Roster::Participant> Roster::snapshot() const {
+    vector<Participant> participants;
+    {
+        shared_lock<shared_mutex> lock(m_lock);
+        participants.reserve(m_participants.size());
+        for (auto& [userId, participant] : m_participants)
+            participants.push_back(participant);
+    }
+
+    sort(participants.begin(), participants.end(), [](const Participant& a, const Participant& b) {
+        return a.order < b.order;
+    });
+    return participants;
+}
+
+uint32_t Roster::firstOther() const {
+    shared_lock<shared_mutex> lock(m_lock);
+
+    const Participant* first = nullptr;
+    for (auto& [userId, participant] : m_participants) {
+        if (!participant.self && (!first || participant.order < first->order))
+            first = &participant;
+    }
+    return first ? first->userId : 0;
+}
+
+void Roster::appendParticipant(string& out, const Participant& participant) {
+    out += "{\"user_id\":" + to_string(participant.userId) + ",\"name\":";
+    JsonValue::appendString(out, participant.name);
+    out += ",\"host\":";
+    out += participant.host ? "true" : "false";
+    out += ",\"self\":";
+    out += participant.self ? "true" : "false";
+    out += ",\"joined_ns\":" + to_string(participant.joinedNs) + "}";
+}
+
+string Roster::toJson() const {
+    // read first, a change racing with the snapshot shows up as the next generation
+    auto generation = this->generation();
+    auto participants = snapshot();
+
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    string json = "{\"type\":\"roster\",\"generation\":" + to_string(generation) + ",\"time_ns\":"
+                  + to_string(static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec) + ",\"participants\":[";
+    for (size_t i = 0; i < participants.size(); i++) {
+        if (i)
+            json += ",";
+        appendParticipant(json, participants[i]);
+    }
+    json += "]}";
+    return json;
+}
+
+bool Roster::setOutput(const string& path) {
+    m_file.close();
+    m_file.clear();
+    m_file.open(path, ios::app);
+    if (!m_file) {
+        Log::warn("failed to open " + path + ", roster changes will not be recorded");
+        return false;
+    }
+
+    // the first publish() writes the roster as it is
+    m_published = 0;
+    return true;
+}
+
+string Roster::publish() {
+    auto generation = this->generation();
+    if (!generation || generation == m_published)
+        return "";
+
+    m_published = generation;
+    auto json = toJson();
+
+    // flushed per line, changes are rare and readers may follow the file live
+    if (m_file.is_open())
+        m_file << json << endl;
+    return json;
+}
@@ -0,0 +1,118 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_ROSTER_H
+#define MEETING_SDK_LINUX_SAMPLE_ROSTER_H
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Metrics.h"
+#include "Singleton.h"
+
+using namespace std;
+
+/**
+ * Who is in the meeting, kept from the SDK's participant join, leave and
+ * rename events so nothing has to walk the SDK's lists. Raw audio's node_id
+ * is the participant's user ID, so either finds them.
+ *
+ * Lookups take a shared lock and copy, safe from the audio and video
+ * threads. Every change bumps a generation, so a reader can tell in one
+ * atomic load whether anything it derived from the roster is stale.
+ */
+class Roster : public Singleton<Roster> {
+    friend class Singleton<Roster>;
+
+public:
+    struct Participant {
+        uint32_t userId = 0;
+        string name;
+        bool host = false;
+        bool self = false;
+
+        // monotonic time the participant was first seen, and the order of it
+        uint64_t joinedNs = 0;
+        uint64_t order = 0;
+    };
+
+private:
+    mutable shared_mutex m_lock;
+    unordered_map<uint32_t, Participant> m_participants;
+    uint64_t m_joins = 0;
+
+    atomic<uint64_t> m_generation{0};
+
+    // one snapshot per generation, next to the recording
+    ofstream m_file;
+    uint64_t m_published = 0;
+
+    Gauge& m_count;
+
+    Roster();
+
+    static void appendParticipant(string& out, const Participant& participant);
+
+public:
+    /**
+     * Add a participant or update their details, from the SDK's events
+     * @return whether anything changed
+     */
+    bool update(uint32_t userId, const string& name, bool host, bool self);
+
+    /**
+     * @return whether the participant was known
+     */
+    bool remove(uint32_t userId);
+
+    /**
+     * Forget everyone, e.g. on leaving the meeting
+     */
+    void clear();
+
+    /**
+     * Copy a participant's details
+     * @return false if nobody with that user ID is in the meeting
+     */
+    bool find(uint32_t userId, Participant& out) const;
+
+    /**
+     * Display name, empty if unknown
+     */
+    string name(uint32_t userId) const;
+
+    /**
+     * Incremented by every change
+     */
+    uint64_t generation() const { return m_generation.load(memory_order_acquire); }
+
+    /**
+     * Everyone in the meeting, in the order they were seen
+     */
+    vector<Participant> snapshot() const;
+
+    /**
+     * The first participant who joined other than the bot, 0 if none
+     */
+    uint32_t firstOther() const;
+
+    /**
+     * {"type":"roster","generation":N,"time_ns":T,"participants":[...]}
+     */
+    string toJson() const;
+
+    /**
+     * Append a snapshot to path whenever publish() sees a new generation
+     */
+    bool setOutput(const string& path);
+
+    /**
+     * Write the roster to the output if it changed since the last call, from the main loop
+     * @return the snapshot written, empty if unchanged
+     */
+    string publish();
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_ROSTER_H
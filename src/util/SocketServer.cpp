@@ -1,5 +1,7 @@
 #include "SocketServer.h"
 
+#include <cerrno>
+
 SocketServer::SocketServer() {
     pthread_mutex_init(&m_mutex, NULL);
 }
@@ -19,6 +21,8 @@ void SocketServer::threadKill(int sig, siginfo_t *info, void *ctx) {
 }
 
 void* SocketServer::run() {
+    ThreadRegistry::getInstance().enroll(ThreadClass::Socket, "zoombot-socket");
+
     if (pthread_mutex_trylock(&m_mutex) != 0) {
         Log::error("Unable to lock mutex");
         return nullptr;
@@ -55,36 +59,111 @@ void* SocketServer::run() {
 
     char buffer[c_bufferSize];
 
+    auto& clients = MetricsRegistry::getInstance().gauge("zoombot_socket_clients",
+                                                         "Clients connected to the meeting socket");
+
     for (;;) {
-        m_dataSocket = accept(m_listenSocket, NULL, NULL);
-        if (m_dataSocket == -1) {
+        auto fd = accept(m_listenSocket, NULL, NULL);
+        if (fd == -1) {
             Log::error("failed to accept connection");
             return nullptr;
         }
 
+        {
+            lock_guard<mutex> lock(m_writeLock);
+            m_dataSocket = fd;
+        }
+
+        clients.add(1);
+        m_connection++;
+
+        // control requests, one per line
+        string line;
+        bool overlong = false;
+
         for(;;) {
-            auto ret = read(m_dataSocket, buffer, 5);
+            auto ret = read(fd, buffer, c_bufferSize);
+
+            // a client gone with data still unread is reset rather than closed
+            if (ret == -1 && errno == ECONNRESET)
+                ret = 0;
+
             if (ret == -1) {
                 Log::error("failed to read socket");
+                disconnect(fd);
+                clients.sub(1);
                 return nullptr;
             }
 
-            buffer[c_bufferSize - 1] = 0;
+            if (ret == 0) {
+                Log::info("socket client disconnected");
+                disconnect(fd);
+                clients.sub(1);
+                break;
+            }
+
+            // raw audio leaves no room for responses, requests are read and dropped
+            if (m_rawAudio.load(memory_order_relaxed)) {
+                LOG_EVERY_MS(60000, Log::warn, "control requests are not accepted while the socket carries raw audio");
+                continue;
+            }
+
+            for (auto i = 0; i < ret; i++) {
+                if (buffer[i] != '\n') {
+                    if (line.size() < c_maxLine)
+                        line += buffer[i];
+                    else
+                        overlong = true;
+                    continue;
+                }
+
+                if (overlong)
+                    writeStr("{\"type\":\"response\",\"id\":null,\"ok\":false,\"error\":\"request too long\"}\n");
+                else if (line.find_first_not_of(" \t\r") != string::npos)
+                    request(line);
+
+                line.clear();
+                overlong = false;
+            }
         }
-        return nullptr;
     }
 
     return nullptr;
 }
 
+void SocketServer::disconnect(int fd) {
+    // writers check and use the fd under the same lock
+    lock_guard<mutex> lock(m_writeLock);
+    close(fd);
+    m_dataSocket = -1;
+}
+
+void SocketServer::request(const string& line) {
+    auto connection = m_connection.load();
+    ControlChannel::getInstance().submit(line, [this, connection](const string& response) {
+        if (m_connection == connection)
+            writeStr(response);
+    });
+}
+
 bool SocketServer::isReady() {
     return ready;
 }
 
 
 int SocketServer::writeBuf(const char* buf, int len) {
-    auto ret = write(m_dataSocket, buf, len);
+    // held across the check and the send, the reader closes the fd under it
+    lock_guard<mutex> lock(m_writeLock);
+
+    // nobody is listening yet, the data is simply not forwarded
+    if (m_dataSocket == -1)
+        return 0;
+
+    auto ret = send(m_dataSocket, buf, len, MSG_NOSIGNAL);
     if (ret == -1) {
+        if (errno == EPIPE)
+            return 0;
+
         Log::error("failed to write data");
         exit(EXIT_FAILURE);
     }
@@ -93,13 +172,7 @@ int SocketServer::writeBuf(const char* buf, int len) {
 }
 
 int SocketServer::writeBuf(const unsigned char* buf, int len) {
-    auto ret = write(m_dataSocket, buf, len);
-    if (ret == -1) {
-        Log::error("failed to write data");
-        exit(EXIT_FAILURE);
-    }
-
-    return 0;
+    return writeBuf(reinterpret_cast<const char*>(buf), len);
 }
 
 int SocketServer::writeStr(const string& str) {
@@ -128,14 +201,17 @@ void SocketServer::stop() {
         pthread_cancel(m_pid);
         m_pid = 0;
     }
-    if (m_listenSocket) {
+    if (m_listenSocket != -1) {
         close(m_listenSocket);
-        m_listenSocket = 0;
+        m_listenSocket = -1;
     }
 
-    if (m_dataSocket) {
-        close(m_dataSocket);
-        m_dataSocket = 0;
+    {
+        lock_guard<mutex> lock(m_writeLock);
+        if (m_dataSocket != -1) {
+            close(m_dataSocket);
+            m_dataSocket = -1;
+        }
     }
 
     Log::info("Stopped Socket Server");
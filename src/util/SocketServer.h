@@ -10,10 +10,15 @@
 #include <signal.h>
 #include <pthread.h>
 
+#include <atomic>
 #include <iostream>
+#include <mutex>
 
+#include "ControlChannel.h"
 #include "Singleton.h"
 #include "Log.h"
+#include "Metrics.h"
+#include "Threads.h"
 
 using namespace std;
 
@@ -24,20 +29,36 @@ class SocketServer : public Singleton<SocketServer> {
     const string c_socketPath = "/tmp/meeting.sock";
     const int c_bufferSize = 256;
 
+    // longest control request accepted
+    const size_t c_maxLine = 4096;
+
     struct sockaddr_un m_addr;
 
-    int m_listenSocket;
-    int m_dataSocket;
+    int m_listenSocket = -1;
+    int m_dataSocket = -1;
+
+    // counts accepted clients, so a response never reaches the next one
+    atomic<uint64_t> m_connection{0};
+
+    // responses from the main loop and data from the SDK threads share the
+    // socket; guards m_dataSocket too, it is closed under it
+    mutex m_writeLock;
 
-    pthread_t m_pid;
+    // the socket carries raw audio, a control response would corrupt it
+    atomic<bool> m_rawAudio{false};
+
+    pthread_t m_pid = 0;
     pthread_mutex_t m_mutex;
 
-    bool ready;
+    bool ready = false;
 
     void* run();
     static void* threadCreate(void* obj);
     static void threadKill(int sig, siginfo_t* info, void* ctx);
 
+    void request(const string& line);
+    void disconnect(int fd);
+
 public:
     SocketServer();
     ~SocketServer();
@@ -50,6 +71,13 @@ public:
 
     bool isReady();
 
+    /**
+     * The socket carries raw audio rather than JSON lines: control requests
+     * are refused, and callers should not write JSON to it
+     */
+    void setRawAudio(bool rawAudio) { m_rawAudio.store(rawAudio, memory_order_relaxed); }
+    bool isRawAudio() const { return m_rawAudio.load(memory_order_relaxed); }
+
     void cleanup();
 };
 
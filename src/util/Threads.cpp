@@ -0,0 +1,228 @@
+#include "Threads.h"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Log.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    pid_t currentTid() {
+        return static_cast<pid_t>(syscall(SYS_gettid));
+    }
+
+    /**
+     * Takes the thread out of the registry when it exits
+     */
+    struct Enrollment {
+        pid_t tid = 0;
+
+        ~Enrollment() {
+            if (tid)
+                ThreadRegistry::getInstance().leave(tid);
+        }
+    };
+
+    thread_local Enrollment t_enrollment;
+
+    /**
+     * The fields of /proc/<pid>/task/<tid>/stat after the command name,
+     * which may itself contain spaces and parentheses
+     */
+    vector<string> statFields(const string& stat) {
+        vector<string> fields;
+        auto close = stat.rfind(')');
+        if (close == string::npos)
+            return fields;
+
+        stringstream ss(stat.substr(close + 2));
+        string field;
+        while (ss >> field)
+            fields.push_back(field);
+
+        return fields;
+    }
+
+    string readLine(const fs::path& path) {
+        ifstream in(path);
+        string line;
+        getline(in, line);
+        return line;
+    }
+
+    string statusValue(const fs::path& path, const string& key) {
+        ifstream in(path);
+        string line;
+        while (getline(in, line)) {
+            if (line.compare(0, key.size(), key) == 0 && line[key.size()] == ':') {
+                auto value = line.find_first_not_of(" \t", key.size() + 1);
+                return value == string::npos ? "" : line.substr(value);
+            }
+        }
+        return "";
+    }
+}
+
+ThreadRegistry& ThreadRegistry::getInstance() {
+    static auto* instance = new ThreadRegistry();
+    return *instance;
+}
+
+const char* ThreadRegistry::className(ThreadClass threadClass) {
+    switch (threadClass) {
+        case ThreadClass::Main: return "main";
+        case ThreadClass::Socket: return "socket";
+        case ThreadClass::Writer: return "writer";
+        case ThreadClass::Analysis: return "analysis";
+    }
+    return "";
+}
+
+bool ThreadRegistry::parseCpus(const string& cpus, cpu_set_t& set) {
+    CPU_ZERO(&set);
+
+    stringstream ss(cpus);
+    string range;
+    while (getline(ss, range, ',')) {
+        char* end;
+        auto first = strtol(range.c_str(), &end, 10);
+        auto last = first;
+
+        if (end == range.c_str())
+            return false;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        if (*end || first < 0 || last < first || last >= CPU_SETSIZE)
+            return false;
+
+        for (auto cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, &set);
+    }
+
+    return CPU_COUNT(&set) > 0;
+}
+
+bool ThreadRegistry::apply(pid_t tid, const ThreadPolicy& policy, const string& name) {
+    auto ok = true;
+
+    cpu_set_t set;
+    if (!policy.cpus.empty() && parseCpus(policy.cpus, set) && sched_setaffinity(tid, sizeof(set), &set) == -1) {
+        Log::warn("failed to pin " + name + " to CPUs " + policy.cpus + ": " + strerror(errno));
+        ok = false;
+    }
+
+    if (policy.batch) {
+        sched_param param{};
+        if (sched_setscheduler(tid, SCHED_BATCH, &param) == -1) {
+            Log::warn("failed to set SCHED_BATCH on " + name + ": " + strerror(errno));
+            ok = false;
+        }
+    }
+
+    // per thread on Linux, lowering priority needs no privileges
+    if (policy.nice && setpriority(PRIO_PROCESS, tid, policy.nice) == -1) {
+        Log::warn("failed to renice " + name + ": " + strerror(errno));
+        ok = false;
+    }
+
+    return ok;
+}
+
+void ThreadRegistry::enroll(ThreadClass threadClass, const string& name) {
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+
+    auto tid = currentTid();
+    t_enrollment.tid = tid;
+
+    ThreadPolicy policy;
+    {
+        lock_guard<mutex> lock(m_lock);
+        m_threads[tid] = Entry{threadClass, name};
+
+        auto it = m_policies.find(threadClass);
+        if (it == m_policies.end())
+            return;
+        policy = it->second;
+    }
+
+    apply(tid, policy, name);
+}
+
+void ThreadRegistry::leave(pid_t tid) {
+    lock_guard<mutex> lock(m_lock);
+    m_threads.erase(tid);
+}
+
+bool ThreadRegistry::configure(ThreadClass threadClass, const ThreadPolicy& policy) {
+    cpu_set_t set;
+    if (!policy.cpus.empty() && !parseCpus(policy.cpus, set)) {
+        Log::error("invalid CPU list for " + string(className(threadClass)) + " threads: " + policy.cpus);
+        return false;
+    }
+
+    vector<pair<pid_t, string>> threads;
+    {
+        lock_guard<mutex> lock(m_lock);
+        m_policies[threadClass] = policy;
+
+        for (auto& [tid, entry] : m_threads) {
+            if (entry.threadClass == threadClass)
+                threads.emplace_back(tid, entry.name);
+        }
+    }
+
+    for (auto& [tid, name] : threads)
+        apply(tid, policy, name);
+
+    return true;
+}
+
+string ThreadRegistry::dump() {
+    map<pid_t, Entry> threads;
+    {
+        lock_guard<mutex> lock(m_lock);
+        threads = m_threads;
+    }
+
+    stringstream out;
+    out << left << setw(8) << "tid" << setw(17) << "name" << setw(10) << "class"
+        << setw(5) << "cpu" << setw(14) << "allowed" << setw(6) << "nice" << "policy\n";
+
+    error_code ec;
+    for (const auto& task : fs::directory_iterator("/proc/self/task", ec)) {
+        auto tid = static_cast<pid_t>(stol(task.path().filename().string()));
+        auto fields = statFields(readLine(task.path() / "stat"));
+
+        // after the name: state is field 3, nice 19, processor 39, policy 41
+        auto field = [&](size_t number) { return number - 3 < fields.size() ? fields[number - 3] : "?"; };
+
+        auto policy = field(41);
+        if (policy == "0") policy = "other";
+        else if (policy == "1") policy = "fifo";
+        else if (policy == "2") policy = "rr";
+        else if (policy == "3") policy = "batch";
+        else if (policy == "5") policy = "idle";
+
+        auto it = threads.find(tid);
+        out << setw(8) << tid
+            << setw(17) << readLine(task.path() / "comm")
+            << setw(10) << (it == threads.end() ? "other" : className(it->second.threadClass))
+            << setw(5) << field(39)
+            << setw(14) << statusValue(task.path() / "status", "Cpus_allowed_list")
+            << setw(6) << field(19)
+            << policy << "\n";
+    }
+
+    return out.str();
+}
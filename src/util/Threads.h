@@ -0,0 +1,87 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_THREADS_H
+#define MEETING_SDK_LINUX_SAMPLE_THREADS_H
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <sched.h>
+#include <sys/types.h>
+
+using namespace std;
+
+/**
+ * Placement groups for the bot's own threads. SDK threads are not ours to
+ * place, they inherit the main thread's CPU set when they are created.
+ */
+enum class ThreadClass {
+    Main,
+    Socket,
+    Writer,
+    Analysis
+};
+
+/**
+ * Where and how a class of threads runs
+ */
+struct ThreadPolicy {
+    // CPU list as in taskset -c, e.g. "0-3,6"; empty leaves it unchanged
+    string cpus;
+    int nice = 0;
+    bool batch = false;
+};
+
+/**
+ * Names the bot's threads and applies a per-class placement policy to them,
+ * including threads that started before the policy was configured.
+ */
+class ThreadRegistry {
+    struct Entry {
+        ThreadClass threadClass;
+        string name;
+    };
+
+    mutex m_lock;
+    map<pid_t, Entry> m_threads;
+    map<ThreadClass, ThreadPolicy> m_policies;
+
+    ThreadRegistry() = default;
+
+    bool apply(pid_t tid, const ThreadPolicy& policy, const string& name);
+
+public:
+    /**
+     * Never destroyed, threads may exit after static destructors ran
+     */
+    static ThreadRegistry& getInstance();
+
+    static const char* className(ThreadClass threadClass);
+
+    /**
+     * Parse a CPU list such as "0-3,6"
+     * @return false if it is malformed or names no CPU
+     */
+    static bool parseCpus(const string& cpus, cpu_set_t& set);
+
+    /**
+     * Name the calling thread and place it by its class. Call first thing
+     * on the thread; it leaves the registry when the thread exits.
+     * @param name at most 15 characters are kept by the kernel
+     */
+    void enroll(ThreadClass threadClass, const string& name);
+    void leave(pid_t tid);
+
+    /**
+     * Set the policy of a class and apply it to its running threads
+     * @return false if the CPU list is malformed
+     */
+    bool configure(ThreadClass threadClass, const ThreadPolicy& policy);
+
+    /**
+     * Every thread of the process with its class, the CPU it last ran on,
+     * its allowed CPUs, nice value and scheduling policy
+     */
+    string dump();
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_THREADS_H
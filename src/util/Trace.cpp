@@ -0,0 +1,171 @@
+#include "Trace.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Log.h"
+
+namespace {
+    thread_local TraceBuffer* t_buffer = nullptr;
+
+    // set while the current thread is inside a sampled TraceCallback
+    thread_local bool t_sampled = false;
+    thread_local uint32_t t_callbacks = 0;
+
+    void appendJsonString(ofstream& out, const string& str) {
+        out << '"';
+        for (auto c : str) {
+            if (c == '"' || c == '\\')
+                out << '\\';
+            if (static_cast<unsigned char>(c) >= 0x20)
+                out << c;
+        }
+        out << '"';
+    }
+}
+
+Tracer& Tracer::getInstance() {
+    // never destroyed, SDK threads may still trace during exit
+    static auto* instance = new Tracer();
+    return *instance;
+}
+
+TraceBuffer& Tracer::buffer() {
+    if (!t_buffer)
+        t_buffer = &createBuffer();
+
+    return *t_buffer;
+}
+
+TraceBuffer& Tracer::createBuffer() {
+    char name[16] = {0};
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+
+    auto buffer = make_shared<TraceBuffer>(static_cast<pid_t>(syscall(SYS_gettid)), name);
+
+    lock_guard<mutex> lock(m_buffersMutex);
+    m_buffers.push_back(buffer);
+    return *buffer;
+}
+
+void Tracer::enable() {
+    {
+        lock_guard<mutex> lock(m_buffersMutex);
+        for (auto& buffer : m_buffers)
+            buffer->clear();
+    }
+
+    m_enabled.store(true, memory_order_release);
+    Log::info("tracing enabled, sampling 1 in " + to_string(sampleEvery()) + " callbacks");
+}
+
+void Tracer::disable() {
+    m_enabled.store(false);
+    Log::info("tracing disabled");
+}
+
+void Tracer::handleToggle() {
+    if (m_exportPending) {
+        // a toggle that arrives meanwhile waits for the export
+        if (m_openCallbacks.load() > 0 && ++m_exportWaits < c_exportWaitTicks)
+            return;
+
+        if (m_openCallbacks.load() > 0)
+            Log::warn("exporting trace with " + to_string(m_openCallbacks.load()) + " callbacks still open");
+
+        m_exportPending = false;
+
+        auto path = m_dir + "/trace-" + to_string(time(nullptr)) + ".json";
+        if (exportJson(path))
+            Log::success("wrote trace to " + path);
+        return;
+    }
+
+    if (!m_toggleRequested.exchange(false, memory_order_relaxed))
+        return;
+
+    if (!enabled())
+        return enable();
+
+    // export on a later tick, spans that were open when tracing stopped finish first
+    disable();
+    m_exportPending = true;
+    m_exportWaits = 0;
+}
+
+bool Tracer::exportJson(const string& path) {
+    ofstream out(path, ios::out | ios::trunc);
+    if (!out.is_open()) {
+        Log::error("failed to open trace file: " + path);
+        return false;
+    }
+
+    auto pid = getpid();
+    bool first = true;
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    lock_guard<mutex> lock(m_buffersMutex);
+    for (const auto& buffer : m_buffers) {
+        out << (first ? "\n" : ",\n");
+        first = false;
+
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":";
+        appendJsonString(out, buffer->threadName.empty() ? to_string(buffer->tid) : buffer->threadName);
+        out << "}}";
+
+        buffer->forEach([&](const TraceEvent& event) {
+            char line[256];
+            snprintf(line, sizeof(line),
+                     ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"arg\":%llu}}",
+                     event.name, event.category, event.start / 1000.0, event.duration / 1000.0,
+                     pid, buffer->tid, static_cast<unsigned long long>(event.arg));
+            out << line;
+        });
+    }
+
+    out << "\n]}\n";
+    return out.good();
+}
+
+void TraceCallback::begin() {
+    auto& tracer = Tracer::getInstance();
+    if (t_callbacks++ % tracer.sampleEvery() != 0)
+        return;
+
+    // counted before checking again, so the exporter either sees this
+    // callback open or it sees tracing disabled
+    tracer.m_openCallbacks.fetch_add(1);
+    if (!tracer.m_enabled.load()) {
+        tracer.m_openCallbacks.fetch_sub(1);
+        return;
+    }
+
+    t_sampled = true;
+    m_start = MetricsClock::nowNs();
+}
+
+bool Tracer::sampled() {
+    return t_sampled;
+}
+
+TraceCallback::~TraceCallback() {
+    if (!m_start)
+        return;
+
+    t_sampled = false;
+
+    auto& tracer = Tracer::getInstance();
+    tracer.buffer().push({m_name, "callback", m_start, MetricsClock::nowNs() - m_start, m_arg});
+    tracer.m_openCallbacks.fetch_sub(1, memory_order_release);
+}
+
+TraceSpan::TraceSpan(const char* name, uint64_t arg) : m_name(name), m_arg(arg) {
+    if (t_sampled)
+        m_start = MetricsClock::nowNs();
+}
@@ -0,0 +1,181 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_TRACE_H
+#define MEETING_SDK_LINUX_SAMPLE_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "Metrics.h"
+
+using namespace std;
+
+/**
+ * A completed span. Names and categories must be string literals.
+ */
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    uint64_t start;
+    uint64_t duration;
+    uint64_t arg;
+};
+
+/**
+ * Fixed size per-thread event buffer, the oldest events are overwritten
+ */
+class TraceBuffer {
+public:
+    static constexpr unsigned c_events = 16384;
+
+private:
+    atomic<uint64_t> m_head{0};
+    TraceEvent m_events[c_events];
+
+public:
+    const pid_t tid;
+    const string threadName;
+
+    TraceBuffer(pid_t tid, string threadName) : tid(tid), threadName(move(threadName)) {}
+
+    void push(const TraceEvent& event) {
+        auto head = m_head.load(memory_order_relaxed);
+        m_events[head % c_events] = event;
+        m_head.store(head + 1, memory_order_release);
+    }
+
+    void clear() { m_head.store(0, memory_order_release); }
+
+    template <typename F>
+    void forEach(F&& consume) const {
+        auto head = m_head.load(memory_order_acquire);
+        auto first = head > c_events ? head - c_events : 0;
+
+        for (auto i = first; i < head; i++)
+            consume(m_events[i % c_events]);
+    }
+};
+
+/**
+ * Collects spans around the media pipeline stages and exports them in the
+ * Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+ * Disabled by default; a disabled span costs one relaxed load.
+ */
+class Tracer {
+    friend class TraceCallback;
+
+    // main loop ticks to wait for open callbacks before exporting anyway
+    static constexpr unsigned c_exportWaitTicks = 20;
+
+    atomic<bool> m_enabled{false};
+    atomic<uint32_t> m_sampleEvery{1};
+    atomic<bool> m_toggleRequested{false};
+
+    // sampled callbacks that have not pushed their span yet
+    atomic<int> m_openCallbacks{0};
+
+    // main loop only: tracing stopped, spans are exported once none are open
+    bool m_exportPending = false;
+    unsigned m_exportWaits = 0;
+
+    mutex m_buffersMutex;
+    vector<shared_ptr<TraceBuffer>> m_buffers;
+
+    string m_dir = "out";
+
+    Tracer() = default;
+
+    TraceBuffer& createBuffer();
+
+public:
+    static Tracer& getInstance();
+
+    bool enabled() const { return m_enabled.load(memory_order_relaxed); }
+
+    void enable();
+    void disable();
+
+    /**
+     * Trace one in every n callbacks
+     */
+    void setSampleEvery(uint32_t n) { m_sampleEvery = n ? n : 1; }
+    uint32_t sampleEvery() const { return m_sampleEvery.load(memory_order_relaxed); }
+
+    void setDir(const string& dir) { m_dir = dir; }
+
+    TraceBuffer& buffer();
+
+    /**
+     * Whether the callback running on this thread is traced; work it hands
+     * to another thread carries this along and is recorded with record()
+     */
+    static bool sampled();
+
+    /**
+     * Record a span measured elsewhere, e.g. queue wait across threads
+     */
+    void record(const char* name, const char* category, uint64_t start, uint64_t end, uint64_t arg = 0) {
+        if (enabled())
+            buffer().push({name, category, start, end - start, arg});
+    }
+
+    /**
+     * Write every buffered event as Chrome trace JSON
+     * @return true on success
+     */
+    bool exportJson(const string& path);
+
+    /**
+     * Async-signal-safe: ask the main loop to toggle tracing
+     */
+    void requestToggle() { m_toggleRequested.store(true, memory_order_relaxed); }
+
+    /**
+     * Called from the main loop on every tick. Starts tracing, or stops it
+     * and, on a later tick once the open callbacks have finished, exports
+     * the collected spans into the trace directory.
+     */
+    void handleToggle();
+};
+
+/**
+ * Span around a whole SDK callback. Takes the sampling decision that the
+ * nested TraceSpans of the same callback follow.
+ */
+class TraceCallback {
+    const char* m_name;
+    uint64_t m_arg;
+    uint64_t m_start = 0;
+
+    void begin();
+
+public:
+    TraceCallback(const char* name, uint64_t arg = 0) : m_name(name), m_arg(arg) {
+        if (__builtin_expect(Tracer::getInstance().enabled(), 0))
+            begin();
+    }
+
+    ~TraceCallback();
+};
+
+/**
+ * Span around one stage inside a traced callback
+ */
+class TraceSpan {
+    const char* m_name;
+    uint64_t m_arg;
+    uint64_t m_start = 0;
+
+public:
+    explicit TraceSpan(const char* name, uint64_t arg = 0);
+    ~TraceSpan() {
+        if (m_start)
+            Tracer::getInstance().buffer().push({m_name, "stage", m_start, MetricsClock::nowNs() - m_start, m_arg});
+    }
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_TRACE_H
@@ -0,0 +1,436 @@
+#include "WebSocket.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+namespace {
+    const char* c_acceptGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+    // larger messages are not something a speech service sends
+    constexpr uint64_t c_maxMessage = 16 << 20;
+
+    enum Opcode : uint8_t {
+        Continuation = 0x0,
+        Text = 0x1,
+        Binary = 0x2,
+        Close = 0x8,
+        Ping = 0x9,
+        Pong = 0xa
+    };
+
+    string base64(const unsigned char* data, size_t len) {
+        string out(4 * ((len + 2) / 3), '\0');
+        EVP_EncodeBlock(reinterpret_cast<unsigned char*>(out.data()), data, static_cast<int>(len));
+        return out;
+    }
+
+    string lower(string str) {
+        transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return tolower(c); });
+        return str;
+    }
+}
+
+WebSocket::~WebSocket() {
+    close();
+    if (m_ctx)
+        SSL_CTX_free(m_ctx);
+}
+
+bool WebSocket::fail(const string& error) {
+    m_error = error;
+
+    if (m_ssl) {
+        SSL_free(m_ssl);
+        m_ssl = nullptr;
+    }
+
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+    m_pending.clear();
+    m_pendingPos = 0;
+    return false;
+}
+
+bool WebSocket::connect(const string& url, const vector<string>& headers) {
+    close();
+    m_error.clear();
+
+    bool tls;
+    size_t rest;
+    if (url.rfind("wss://", 0) == 0) {
+        tls = true;
+        rest = 6;
+    } else if (url.rfind("ws://", 0) == 0) {
+        tls = false;
+        rest = 5;
+    } else {
+        return fail("unsupported URL " + url);
+    }
+
+    auto end = url.find_first_of("/?", rest);
+    auto authority = url.substr(rest, end == string::npos ? string::npos : end - rest);
+    auto target = end == string::npos ? "/" : url.substr(end);
+    if (target[0] == '?')
+        target = "/" + target;
+
+    auto host = authority;
+    string port = tls ? "443" : "80";
+    auto colon = authority.rfind(':');
+    if (colon != string::npos && authority.find(']', colon) == string::npos) {
+        host = authority.substr(0, colon);
+        port = authority.substr(colon + 1);
+    }
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+        host = host.substr(1, host.size() - 2);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* addrs = nullptr;
+    auto err = getaddrinfo(host.c_str(), port.c_str(), &hints, &addrs);
+    if (err != 0)
+        return fail("failed to resolve " + host + ": " + gai_strerror(err));
+
+    timeval timeout{c_ioTimeoutMs / 1000, (c_ioTimeoutMs % 1000) * 1000};
+    for (auto* addr = addrs; addr; addr = addr->ai_next) {
+        m_fd = socket(addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC, addr->ai_protocol);
+        if (m_fd == -1)
+            continue;
+
+        // the send timeout also bounds connect()
+        setsockopt(m_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        if (::connect(m_fd, addr->ai_addr, addr->ai_addrlen) == 0)
+            break;
+
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    freeaddrinfo(addrs);
+
+    if (m_fd == -1)
+        return fail("failed to connect to " + authority + ": " + strerror(errno));
+
+    int one = 1;
+    setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (tls) {
+        // SSL_write() cannot pass MSG_NOSIGNAL, a peer that went away must not kill the process
+        sigset_t pipe;
+        sigemptyset(&pipe);
+        sigaddset(&pipe, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipe, nullptr);
+
+        if (!m_ctx) {
+            m_ctx = SSL_CTX_new(TLS_client_method());
+            if (!m_ctx)
+                return fail("failed to create TLS context");
+
+            SSL_CTX_set_default_verify_paths(m_ctx);
+            SSL_CTX_set_verify(m_ctx, SSL_VERIFY_PEER, nullptr);
+        }
+
+        m_ssl = SSL_new(m_ctx);
+        SSL_set_fd(m_ssl, m_fd);
+        SSL_set_tlsext_host_name(m_ssl, host.c_str());
+        SSL_set1_host(m_ssl, host.c_str());
+
+        if (SSL_connect(m_ssl) != 1)
+            return fail("TLS handshake with " + host + " failed");
+    }
+
+    return handshake(authority, target, headers);
+}
+
+bool WebSocket::handshake(const string& host, const string& target, const vector<string>& headers) {
+    unsigned char nonce[16];
+    RAND_bytes(nonce, sizeof(nonce));
+    auto key = base64(nonce, sizeof(nonce));
+
+    string request = "GET " + target + " HTTP/1.1\r\n"
+                     "Host: " + host + "\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Key: " + key + "\r\n"
+                     "Sec-WebSocket-Version: 13\r\n";
+    for (auto& header : headers)
+        request += header + "\r\n";
+    request += "\r\n";
+
+    if (!writeAll(request.data(), request.size()))
+        return fail("failed to send the WebSocket upgrade to " + host);
+
+    string response;
+    char buf[1024];
+    size_t headerEnd;
+    while ((headerEnd = response.find("\r\n\r\n")) == string::npos) {
+        if (response.size() > 16384)
+            return fail("oversized upgrade response from " + host);
+
+        auto n = readSome(buf, sizeof(buf));
+        if (n <= 0)
+            return fail("no upgrade response from " + host);
+        response.append(buf, n);
+    }
+
+    // anything after the headers is already the first frame
+    m_pending.assign(response.begin() + headerEnd + 4, response.end());
+    m_pendingPos = 0;
+    response.resize(headerEnd);
+
+    auto statusLine = response.substr(0, response.find("\r\n"));
+    if (statusLine.find(" 101") == string::npos)
+        return fail("upgrade refused by " + host + ": " + statusLine);
+
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    auto accept = key + c_acceptGuid;
+    SHA1(reinterpret_cast<const unsigned char*>(accept.data()), accept.size(), digest);
+    auto expected = base64(digest, sizeof(digest));
+
+    auto headersLower = lower(response);
+    auto pos = headersLower.find("\r\nsec-websocket-accept:");
+    if (pos == string::npos)
+        return fail("upgrade response from " + host + " has no Sec-WebSocket-Accept");
+
+    auto valueStart = response.find_first_not_of(' ', pos + 23);
+    auto valueEnd = response.find("\r\n", valueStart);
+    auto value = response.substr(valueStart, valueEnd == string::npos ? string::npos : valueEnd - valueStart);
+    while (!value.empty() && value.back() == ' ')
+        value.pop_back();
+
+    if (value != expected)
+        return fail("bad Sec-WebSocket-Accept from " + host);
+
+    return true;
+}
+
+bool WebSocket::writeAll(const char* buf, size_t len) {
+    while (len) {
+        ssize_t n;
+        if (m_ssl) {
+            n = SSL_write(m_ssl, buf, static_cast<int>(len));
+        } else {
+            n = send(m_fd, buf, len, MSG_NOSIGNAL);
+            if (n == -1 && errno == EINTR)
+                continue;
+        }
+
+        if (n <= 0)
+            return false;
+
+        buf += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+ssize_t WebSocket::readSome(char* buf, size_t len) {
+    if (m_ssl) {
+        auto n = SSL_read(m_ssl, buf, static_cast<int>(len));
+        if (n > 0)
+            return n;
+        return SSL_get_error(m_ssl, n) == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+    }
+
+    ssize_t n;
+    while ((n = recv(m_fd, buf, len, 0)) == -1 && errno == EINTR);
+    return n;
+}
+
+bool WebSocket::readExact(char* buf, size_t len) {
+    auto buffered = min(len, m_pending.size() - m_pendingPos);
+    if (buffered) {
+        memcpy(buf, m_pending.data() + m_pendingPos, buffered);
+        m_pendingPos += buffered;
+        buf += buffered;
+        len -= buffered;
+    }
+
+    while (len) {
+        auto n = readSome(buf, len);
+        if (n <= 0)
+            return false;
+
+        buf += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+bool WebSocket::readable(int timeoutMs) {
+    if (m_pendingPos < m_pending.size() || (m_ssl && SSL_pending(m_ssl) > 0))
+        return true;
+
+    pollfd pfd{m_fd, POLLIN, 0};
+    int ret;
+    while ((ret = poll(&pfd, 1, timeoutMs)) == -1 && errno == EINTR);
+    return ret > 0;
+}
+
+bool WebSocket::sendFrame(uint8_t opcode, const char* data, size_t len) {
+    if (m_fd == -1)
+        return false;
+
+    size_t header = 2 + (len < 126 ? 0 : len < 65536 ? 2 : 8) + 4;
+    m_frame.resize(header + len);
+    auto* out = reinterpret_cast<unsigned char*>(m_frame.data());
+
+    out[0] = 0x80 | opcode;
+    size_t i = 2;
+    if (len < 126) {
+        out[1] = 0x80 | static_cast<uint8_t>(len);
+    } else if (len < 65536) {
+        out[1] = 0x80 | 126;
+        out[i++] = len >> 8;
+        out[i++] = len & 0xff;
+    } else {
+        out[1] = 0x80 | 127;
+        for (int shift = 56; shift >= 0; shift -= 8)
+            out[i++] = (static_cast<uint64_t>(len) >> shift) & 0xff;
+    }
+
+    // clients mask every frame
+    unsigned char mask[4];
+    RAND_bytes(mask, sizeof(mask));
+    memcpy(out + i, mask, 4);
+    i += 4;
+
+    for (size_t j = 0; j < len; j++)
+        out[i + j] = data[j] ^ mask[j & 3];
+
+    if (!writeAll(m_frame.data(), header + len))
+        return fail("failed to send: " + string(strerror(errno)));
+
+    return true;
+}
+
+bool WebSocket::sendBinary(const char* data, size_t len) {
+    return sendFrame(Binary, data, len);
+}
+
+bool WebSocket::sendText(const string& text) {
+    return sendFrame(Text, text.data(), text.size());
+}
+
+WebSocket::Status WebSocket::receive(string& message, int timeoutMs) {
+    message.clear();
+
+    if (m_fd == -1)
+        return Status::Closed;
+
+    if (!readable(timeoutMs))
+        return Status::Timeout;
+
+    bool fragmented = false;
+    for (;;) {
+        unsigned char head[2];
+        if (!readExact(reinterpret_cast<char*>(head), 2)) {
+            fail("connection lost");
+            return Status::Closed;
+        }
+
+        bool fin = head[0] & 0x80;
+        uint8_t opcode = head[0] & 0x0f;
+        bool masked = head[1] & 0x80;
+        uint64_t len = head[1] & 0x7f;
+
+        if (len >= 126) {
+            unsigned char ext[8];
+            auto bytes = len == 126 ? 2 : 8;
+            if (!readExact(reinterpret_cast<char*>(ext), bytes)) {
+                fail("connection lost");
+                return Status::Closed;
+            }
+
+            len = 0;
+            for (int i = 0; i < bytes; i++)
+                len = len << 8 | ext[i];
+        }
+
+        unsigned char mask[4] = {};
+        if (masked && !readExact(reinterpret_cast<char*>(mask), 4)) {
+            fail("connection lost");
+            return Status::Closed;
+        }
+
+        if (message.size() + len > c_maxMessage) {
+            fail("oversized message");
+            return Status::Closed;
+        }
+
+        if (opcode >= Close) {
+            char payload[125];
+            if (len > sizeof(payload) || !readExact(payload, len)) {
+                fail("bad control frame");
+                return Status::Closed;
+            }
+            for (size_t i = 0; i < len; i++)
+                payload[i] ^= mask[i & 3];
+
+            if (opcode == Ping) {
+                sendFrame(Pong, payload, len);
+            } else if (opcode == Close) {
+                // echo the status code back, then hang up
+                sendFrame(Close, payload, min<uint64_t>(len, 2));
+                fail(len >= 2 ? "closed by peer with status "
+                                + to_string(static_cast<unsigned char>(payload[0]) << 8
+                                            | static_cast<unsigned char>(payload[1]))
+                              : "closed by peer");
+                return Status::Closed;
+            }
+        } else {
+            auto offset = message.size();
+            message.resize(offset + len);
+            if (!readExact(message.data() + offset, len)) {
+                fail("connection lost");
+                return Status::Closed;
+            }
+            for (size_t i = 0; masked && i < len; i++)
+                message[offset + i] ^= mask[i & 3];
+
+            if (fin)
+                return Status::Message;
+            fragmented = true;
+        }
+
+        if (!fragmented && !readable(0))
+            return Status::Timeout;
+
+        // the rest of a fragmented message is already on its way
+        if (fragmented && !readable(c_ioTimeoutMs)) {
+            fail("timed out inside a message");
+            return Status::Closed;
+        }
+    }
+}
+
+void WebSocket::close() {
+    if (m_fd == -1)
+        return;
+
+    const char normal[2] = {0x03, static_cast<char>(0xe8)};
+    sendFrame(Close, normal, sizeof(normal));
+    fail("");
+}
@@ -0,0 +1,86 @@
+#ifndef MEETING_SDK_LINUX_SAMPLE_WEBSOCKET_H
+#define MEETING_SDK_LINUX_SAMPLE_WEBSOCKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <openssl/ssl.h>
+
+using namespace std;
+
+/**
+ * Blocking WebSocket client over TCP, or TLS for wss:// URLs. One thread
+ * sends and receives, and must not mind SIGPIPE being blocked on it; pings
+ * are answered inside receive(). Writes and reads that stall for longer
+ * than the I/O timeout fail, so a dead peer is noticed.
+ */
+class WebSocket {
+public:
+    enum class Status {
+        Message,
+        Timeout,
+        Closed
+    };
+
+private:
+    static constexpr int c_ioTimeoutMs = 5000;
+
+    int m_fd = -1;
+    SSL_CTX* m_ctx = nullptr;
+    SSL* m_ssl = nullptr;
+
+    // bytes received but not yet parsed, e.g. behind the handshake response
+    vector<char> m_pending;
+    size_t m_pendingPos = 0;
+
+    // frame header and masked payload, reused for every send
+    vector<char> m_frame;
+
+    string m_error;
+
+    bool writeAll(const char* buf, size_t len);
+    ssize_t readSome(char* buf, size_t len);
+    bool readExact(char* buf, size_t len);
+    bool readable(int timeoutMs);
+
+    bool sendFrame(uint8_t opcode, const char* data, size_t len);
+    bool handshake(const string& host, const string& target, const vector<string>& headers);
+    bool fail(const string& error);
+
+public:
+    WebSocket() = default;
+    ~WebSocket();
+
+    WebSocket(const WebSocket&) = delete;
+    WebSocket& operator=(const WebSocket&) = delete;
+
+    /**
+     * Connect and upgrade, closing any previous connection
+     * @param url ws://host[:port]/path or wss://...
+     * @param headers extra request headers, e.g. "Authorization: Token ..."
+     */
+    bool connect(const string& url, const vector<string>& headers = {});
+
+    bool sendBinary(const char* data, size_t len);
+    bool sendText(const string& text);
+
+    /**
+     * Wait up to timeoutMs for the next text or binary message
+     * @return Closed once the peer closed or the connection failed
+     */
+    Status receive(string& message, int timeoutMs);
+
+    /**
+     * Send a close frame if still connected and drop the connection
+     */
+    void close();
+
+    bool isOpen() const { return m_fd != -1; }
+    const string& error() const { return m_error; }
+};
+
+#endif //MEETING_SDK_LINUX_SAMPLE_WEBSOCKET_H
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/util/Json.h"
+#include "../src/util/Log.h"
+
+using namespace std;
+
+/**
+ * Measures how far an audio and a video recording of the same meeting are
+ * apart, from the .timing.jsonl files the bot writes next to them. Both are
+ * mapped onto the monotonic clock they were stamped with; the skew at a
+ * moment is how much further into its file the audio is than the video.
+ * A positive skew means the video has to be delayed by that much.
+ */
+
+struct Timing {
+    string path;
+    vector<double> mono;
+    vector<double> media;
+    size_t jumps = 0;
+    size_t gaps = 0;
+
+    // skew that appeared at jumps, a gap's remainder or a stop, rather than by drifting
+    double stepsNs = 0;
+    double missingNs = 0;
+    double filledNs = 0;
+    double driftPpm = 0;
+};
+
+void usage() {
+    cout << "usage: av_skew [--every <seconds>] <audio.timing.jsonl> <video.timing.jsonl>" << endl;
+}
+
+bool load(const string& path, Timing& timing) {
+    ifstream in(path);
+    if (!in) {
+        Log::error("failed to open " + path);
+        return false;
+    }
+
+    timing.path = path;
+
+    string line;
+    size_t number = 0;
+    while (getline(in, line)) {
+        number++;
+        if (line.empty())
+            continue;
+
+        JsonValue value;
+        if (!JsonValue::parse(line, value)) {
+            // a line cut short by a kill is expected at the end
+            Log::warn(path + ":" + to_string(number) + " is not JSON, skipped");
+            continue;
+        }
+
+        // a file reopened later appends another run with its own media clock
+        auto type = value["type"].asString();
+        if (type == "start") {
+            if (!timing.mono.empty())
+                break;
+            continue;
+        }
+
+        if (type == "gap") {
+            timing.gaps++;
+            timing.missingNs += value["missing_ns"].asNumber();
+            timing.filledNs += value["filled_ns"].asNumber();
+            continue;
+        }
+
+        auto mono = value["mono_ns"].asNumber(-1);
+        auto media = value["media_ns"].asNumber(-1);
+        if (mono < 0 || media < 0)
+            continue;
+
+        if (!timing.mono.empty() && mono < timing.mono.back())
+            continue;
+
+        auto jump = value["jump"].asBool();
+        if (jump && !timing.mono.empty())
+            timing.stepsNs += (mono - timing.mono.back()) - (media - timing.media.back());
+
+        timing.mono.push_back(mono);
+        timing.media.push_back(media);
+        timing.jumps += jump;
+        timing.driftPpm = value["drift_ppm"].asNumber();
+    }
+
+    if (timing.mono.empty()) {
+        Log::error(path + " has no timing points");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Position in the file of what was captured at mono, linear between points
+ */
+double mediaAt(const Timing& timing, double mono) {
+    auto it = upper_bound(timing.mono.begin(), timing.mono.end(), mono);
+    if (it == timing.mono.begin())
+        return timing.media.front();
+    if (it == timing.mono.end())
+        return timing.media.back();
+
+    auto i = static_cast<size_t>(it - timing.mono.begin());
+    auto span = timing.mono[i] - timing.mono[i - 1];
+    auto t = span > 0 ? (mono - timing.mono[i - 1]) / span : 1;
+    return timing.media[i - 1] + t * (timing.media[i] - timing.media[i - 1]);
+}
+
+string ms(double ns) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%+.1f ms", ns / 1e6);
+    return buf;
+}
+
+void summary(const string& name, const Timing& timing) {
+    auto duration = timing.mono.back() - timing.mono.front();
+    auto media = timing.media.back() - timing.media.front();
+
+    char drift[32] = "n/a";
+    if (media > 0)
+        snprintf(drift, sizeof(drift), "%.1f ppm", (duration - timing.stepsNs - media) / media * 1e6);
+
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%-6s %.3f s captured, %.3f s of media, drift %s overall, %.1f ppm at the end, %zu jump(s)",
+             name.c_str(), duration / 1e9, media / 1e9, drift, timing.driftPpm, timing.jumps);
+    cout << buf << endl;
+
+    if (timing.gaps) {
+        snprintf(buf, sizeof(buf), "%-6s %zu gap(s), %.3f s missing, %.3f s filled",
+                 "", timing.gaps, timing.missingNs / 1e9, timing.filledNs / 1e9);
+        cout << buf << endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    double every = 0;
+    vector<string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "-h" || arg == "--help") {
+            usage();
+            return 0;
+        }
+
+        if (arg == "--every" && i + 1 < argc) {
+            every = atof(argv[++i]);
+            continue;
+        }
+
+        paths.push_back(arg);
+    }
+
+    if (paths.size() != 2) {
+        usage();
+        return 1;
+    }
+
+    Timing audio, video;
+    if (!load(paths[0], audio) || !load(paths[1], video)) {
+        Log::flush();
+        return 1;
+    }
+
+    summary("audio", audio);
+    summary("video", video);
+
+    cout << "video starts " << ms(video.mono.front() - audio.mono.front()) << " after audio" << endl;
+
+    auto from = max(audio.mono.front(), video.mono.front());
+    auto to = min(audio.mono.back(), video.mono.back());
+    if (to <= from) {
+        Log::error("the recordings do not overlap");
+        Log::flush();
+        return 1;
+    }
+
+    auto skewAt = [&](double mono) { return mediaAt(audio, mono) - mediaAt(video, mono); };
+
+    // every point of either file, where the piecewise skew can turn
+    vector<double> points{from, to};
+    for (auto* timing : {&audio, &video})
+        for (auto mono : timing->mono)
+            if (mono > from && mono < to)
+                points.push_back(mono);
+
+    auto lo = skewAt(from), hi = lo;
+    for (auto mono : points) {
+        auto skew = skewAt(mono);
+        lo = min(lo, skew);
+        hi = max(hi, skew);
+    }
+
+    auto first = skewAt(from);
+    auto last = skewAt(to);
+
+    cout << "overlap " << (to - from) / 1e9 << " s" << endl;
+    cout << "skew at start " << ms(first) << ", at end " << ms(last)
+         << ", between " << ms(lo) << " and " << ms(hi) << endl;
+    cout << "suggested video delay " << ms(first) << endl;
+
+    if (every > 0) {
+        cout << "seconds,audio_ms,video_ms,skew_ms" << endl;
+        for (double t = 0; from + t * 1e9 <= to; t += every) {
+            auto mono = from + t * 1e9;
+            char row[96];
+            snprintf(row, sizeof(row), "%.3f,%.3f,%.3f,%.3f", t,
+                     mediaAt(audio, mono) / 1e6, mediaAt(video, mono) / 1e6, skewAt(mono) / 1e6);
+            cout << row << endl;
+        }
+    }
+
+    Log::flush();
+    return 0;
+}
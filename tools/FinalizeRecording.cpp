@@ -0,0 +1,54 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../src/raw_record/Finalizer.h"
+#include "../src/util/Log.h"
+
+using namespace std;
+
+/**
+ * Finalizes the recordings of a session after the fact, as the bot does on
+ * exit with --finalize: WAV and FLAC audio, MP4 video, the A/V mux and
+ * checksums, from its session journal.
+ */
+
+void usage() {
+    cout << "usage: finalize_recording [--jobs N] [--timeout S] <session.journal>" << endl;
+}
+
+int main(int argc, char** argv) {
+    unsigned int jobs = 0;
+    unsigned int timeoutS = 3600;
+    string journal;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "-h" || arg == "--help") {
+            usage();
+            return 0;
+        }
+
+        if (arg == "--jobs" && i + 1 < argc) {
+            jobs = strtoul(argv[++i], nullptr, 10);
+            continue;
+        }
+
+        if (arg == "--timeout" && i + 1 < argc) {
+            timeoutS = strtoul(argv[++i], nullptr, 10);
+            continue;
+        }
+
+        journal = arg;
+    }
+
+    if (journal.empty() || !timeoutS) {
+        usage();
+        return 1;
+    }
+
+    auto ok = Finalizer(jobs, timeoutS * 1000ull).run(journal);
+    Log::flush();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "../src/raw_record/RecordingJournal.h"
+#include "../src/util/Log.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+/**
+ * Cuts the recordings of a killed session back to their last consistent
+ * point, using the session journal. The bot does the same on start-up for
+ * the journals in its --journal-dir.
+ */
+
+void usage() {
+    cout << "usage: recover_recording [--dry-run] <session.journal | journal dir>..." << endl;
+}
+
+int main(int argc, char** argv) {
+    bool dryRun = false;
+    bool ok = true;
+    int paths = 0;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "--dry-run") {
+            dryRun = true;
+            continue;
+        }
+
+        if (arg == "-h" || arg == "--help") {
+            usage();
+            return 0;
+        }
+
+        paths++;
+        if (fs::is_directory(arg))
+            Log::info(to_string(RecordingJournal::recoverDir(arg, dryRun)) + " session(s) recovered in " + arg);
+        else
+            ok = RecordingJournal::recover(arg, dryRun) && ok;
+    }
+
+    Log::flush();
+
+    if (!paths) {
+        usage();
+        return 1;
+    }
+
+    return ok ? 0 : 1;
+}